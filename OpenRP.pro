@@ -20,38 +20,86 @@ LIBS += -lopenal -lvorbisfile -lassimp
 
 SOURCES += main.cpp\
         startupwindow.cpp \
+    gamemode.cpp \
+    gamehost.cpp \
     gamewindow.cpp \
+    headless.cpp \
+    gl/atlas.cpp \
+    gl/camera.cpp \
     gl/drawable.cpp \
+    gl/font.cpp \
     gl/material.cpp \
     gl/misc.cpp \
     gl/model.cpp \
+    gl/modelfile.cpp \
     gl/object.cpp \
     gl/objectbone.cpp \
+    gl/packer.cpp \
     gl/shader.cpp \
+    gl/sprite.cpp \
+    gl/streaming.cpp \
     gl/texture.cpp \
+    gl/texturearray.cpp \
+    gl/texturefile.cpp \
+    gl/texturememory.cpp \
+    gl/uniformblock.cpp \
     al/context.cpp \
     al/device.cpp \
     al/devicelist.cpp \
     al/emitter.cpp \
     al/loader.cpp \
+    core/scheduler.cpp \
+    core/framepacer.cpp \
+    core/luaheap.cpp \
+    core/gcpacer.cpp \
+    core/pool.cpp \
+    core/jobs.cpp \
+    core/manifest.cpp \
+    core/vfs.cpp \
+    world/simd.cpp \
+    world/vector.cpp \
+    world/quat.cpp \
+    world/matrix.cpp \
+    world/batch.cpp \
+    world/bounds.cpp \
+    world/spatial.cpp \
+    world/cull.cpp \
+    world/occlusion.cpp \
+    world/scene.cpp \
+    world/clip.cpp \
+    world/animation.cpp \
+    world/entities.cpp \
     link_enums.cpp \
     link.cpp
 
 HEADERS  += startupwindow.h \
+    gamehost.h \
     gamewindow.h \
     gamemode.h \
+    headless.h \
     shared.h \
     link.h \
     gl/all.h \
+    gl/atlas.h \
+    gl/camera.h \
     gl/drawable.h \
+    gl/font.h \
     gl/material.h \
     gl/misc.h \
     gl/model.h \
+    gl/modelfile.h \
     gl/object.h \
     gl/objectbone.h \
+    gl/packer.h \
     gl/shader.h \
     gl/shared.h \
+    gl/sprite.h \
+    gl/streaming.h \
     gl/texture.h \
+    gl/texturearray.h \
+    gl/texturefile.h \
+    gl/texturememory.h \
+    gl/uniformblock.h \
     al/all.h \
     al/context.h \
     al/device.h \
@@ -59,7 +107,33 @@ HEADERS  += startupwindow.h \
     al/emitter.h \
     al/enums.h \
     al/loader.h \
-    al/shared.h
+    al/shared.h \
+    core/all.h \
+    core/binding.h \
+    core/framepacer.h \
+    core/gcpacer.h \
+    core/jobs.h \
+    core/luaheap.h \
+    core/manifest.h \
+    core/pool.h \
+    core/scheduler.h \
+    core/shared.h \
+    core/vfs.h \
+    world/all.h \
+    world/animation.h \
+    world/batch.h \
+    world/bounds.h \
+    world/clip.h \
+    world/cull.h \
+    world/entities.h \
+    world/matrix.h \
+    world/occlusion.h \
+    world/quat.h \
+    world/scene.h \
+    world/shared.h \
+    world/simd.h \
+    world/spatial.h \
+    world/vector.h
 
 FORMS    += startupwindow.ui
 
@@ -68,23 +68,48 @@ void SoundContextProperties::setListenerOrientation(float a, float b, float c, f
     alListenerfv(AL_ORIENTATION,buf);
 }
 
-Lua::ReturnValues SoundContextProperties::luaQueryListenerPosition()
+FixedReturn<float, 3> SoundContextProperties::luaQueryListenerPosition()
 {
-    float d[3];
-    queryListenerPosition(d[0],d[1],d[2]);
-    return Lua::Return(d[0],d[1],d[2]);
+    FixedReturn<float, 3> r;
+    queryListenerPosition(r.m_values[0],r.m_values[1],r.m_values[2]);
+    return r;
 }
-Lua::ReturnValues SoundContextProperties::luaQueryListenerVelocity()
+FixedReturn<float, 3> SoundContextProperties::luaQueryListenerVelocity()
 {
-    float d[3];
-    queryListenerVelocity(d[0],d[1],d[2]);
-    return Lua::Return(d[0],d[1],d[2]);
+    FixedReturn<float, 3> r;
+    queryListenerVelocity(r.m_values[0],r.m_values[1],r.m_values[2]);
+    return r;
 }
-Lua::ReturnValues SoundContextProperties::luaQueryListenerOrientation()
+Vec3 SoundContextProperties::queryListenerPositionVec()
 {
-    float d[6];
-    queryListenerOrientation(d[0],d[1],d[2],d[3],d[4],d[5]);
-    return Lua::Return(d[0],d[1],d[2],d[3],d[4],d[5]);
+    glm::vec3 v;
+    alGetListenerfv(AL_POSITION,glm::value_ptr(v));
+    return Vec3(v);
+}
+Vec3 SoundContextProperties::queryListenerVelocityVec()
+{
+    glm::vec3 v;
+    alGetListenerfv(AL_VELOCITY,glm::value_ptr(v));
+    return Vec3(v);
+}
+void SoundContextProperties::setListenerPositionVec(Vec3 v)
+{
+    alListenerfv(AL_POSITION,glm::value_ptr(v.value()));
+}
+void SoundContextProperties::setListenerVelocityVec(Vec3 v)
+{
+    alListenerfv(AL_VELOCITY,glm::value_ptr(v.value()));
+}
+void SoundContextProperties::setListenerOrientationVec(Vec3 at, Vec3 up)
+{
+    ALfloat buf[6] = { at.X(), at.Y(), at.Z(), up.X(), up.Y(), up.Z() };
+    alListenerfv(AL_ORIENTATION,buf);
+}
+FixedReturn<float, 6> SoundContextProperties::luaQueryListenerOrientation()
+{
+    FixedReturn<float, 6> r;
+    queryListenerOrientation(r.m_values[0],r.m_values[1],r.m_values[2],r.m_values[3],r.m_values[4],r.m_values[5]);
+    return r;
 }
 
 ContextImpl::ContextImpl() : m_context(nullptr) {}
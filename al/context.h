@@ -2,6 +2,7 @@
 #define LUAAL_CONTEXT_H
 #include "shared.h"
 #include "enums.h"
+#include "../world/vector.h"
 
 namespace LuaApi {
     struct SoundContextProperties {
@@ -28,9 +29,15 @@ namespace LuaApi {
         static void setListenerOrientation(float, float, float,
                                    float, float, float);
         
-        static Lua::ReturnValues luaQueryListenerPosition();
-        static Lua::ReturnValues luaQueryListenerVelocity();
-        static Lua::ReturnValues luaQueryListenerOrientation();
+        static FixedReturn<float, 3> luaQueryListenerPosition();
+        static FixedReturn<float, 3> luaQueryListenerVelocity();
+        static FixedReturn<float, 6> luaQueryListenerOrientation();
+        
+        static Vec3 queryListenerPositionVec();
+        static Vec3 queryListenerVelocityVec();
+        static void setListenerPositionVec(Vec3);
+        static void setListenerVelocityVec(Vec3);
+        static void setListenerOrientationVec(Vec3 at, Vec3 up);
     };
 
     class DeviceImpl;
@@ -79,25 +79,34 @@ void SoundEmitterImpl::Rewind()
     alSourcei(m_source, AL_BUFFER, 0);
     alSourceQueueBuffers(m_source, m_buffers.size(), m_buffers.data());
 }
-Lua::ReturnValues SoundEmitterImpl::LuaQueryDirection() const
+FixedReturn<float, 3> SoundEmitterImpl::LuaQueryDirection() const
 {
     float x,y,z;
     queryDirection(x,y,z);
-    return Lua::Return(x,y,z);
+    return ReturnFixed(x,y,z);
 }
-Lua::ReturnValues SoundEmitterImpl::LuaQueryPosition() const
+FixedReturn<float, 3> SoundEmitterImpl::LuaQueryPosition() const
 {
     float x,y,z;
     queryPosition(x,y,z);
-    return Lua::Return(x,y,z);
+    return ReturnFixed(x,y,z);
 }
-Lua::ReturnValues SoundEmitterImpl::LuaQueryVelocity() const
+FixedReturn<float, 3> SoundEmitterImpl::LuaQueryVelocity() const
 {
     float x,y,z;
     queryVelocity(x,y,z);
-    return Lua::Return(x,y,z);
+    return ReturnFixed(x,y,z);
 }
 
+#define VEC_PROPERTY(FuncName, EnumName)\
+    Vec3 SoundEmitterImpl::LuaQuery##FuncName##Vec() const { glm::vec3 v; alGetSourcefv(m_source, EnumName, glm::value_ptr(v)); return Vec3(v); }\
+    void SoundEmitterImpl::LuaSet##FuncName##Vec(Vec3 v) { alSourcefv(m_source, EnumName, glm::value_ptr(v.value())); }
+
+VEC_PROPERTY(Position, AL_POSITION)
+VEC_PROPERTY(Velocity, AL_VELOCITY)
+VEC_PROPERTY(Direction, AL_DIRECTION)
+#undef VEC_PROPERTY
+
 #define GET_GENERIC_PROPERTY(FuncName, EnumName, public_type, internal_type, function_name, which_object)\
     public_type SoundEmitterImpl::query##FuncName() const { internal_type rv = 0; function_name(which_object, EnumName, &rv); return static_cast<public_type>(rv); }
 #define SET_GENERIC_PROPERTY(FuncName, EnumName, public_type, internal_type, function_name, which_object)\
@@ -2,6 +2,7 @@
 #define LUAAL_EMITTER_H
 #include "shared.h"
 #include "enums.h"
+#include "../world/vector.h"
 
 namespace LuaApi {
 
@@ -80,9 +81,16 @@ namespace LuaApi {
         int queryOffsetSamples() const;
         int queryOffsetBytes() const;
         
-        Lua::ReturnValues LuaQueryPosition() const;
-        Lua::ReturnValues LuaQueryVelocity() const;
-        Lua::ReturnValues LuaQueryDirection() const;
+        FixedReturn<float, 3> LuaQueryPosition() const;
+        FixedReturn<float, 3> LuaQueryVelocity() const;
+        FixedReturn<float, 3> LuaQueryDirection() const;
+        
+        Vec3 LuaQueryPositionVec() const;
+        Vec3 LuaQueryVelocityVec() const;
+        Vec3 LuaQueryDirectionVec() const;
+        void LuaSetPositionVec(Vec3);
+        void LuaSetVelocityVec(Vec3);
+        void LuaSetDirectionVec(Vec3);
     };
     
     typedef RefCounted<SoundEmitterImpl> SoundEmitter;
@@ -96,9 +104,11 @@ template <> struct MetatableDescriptor<LuaApi::SoundEmitterImpl> {
     static void metatable(Lua::member_function_storage<LuaApi::SoundEmitterImpl>& mt) {
 #define OAL_PROPERTY(prop) mt[ #prop ] = Lua::Transform(&LuaApi::SoundEmitterImpl::query##prop);\
                             mt[ "Set" #prop ] = Lua::Transform(&LuaApi::SoundEmitterImpl::set##prop)
-#define OAL_PROPERTY_ALT(prop) mt[ #prop ] = Lua::Transform(&LuaApi::SoundEmitterImpl::LuaQuery##prop);\
+#define OAL_PROPERTY_ALT(prop) mt[ #prop ] = LuaApi::PushFixed(&LuaApi::SoundEmitterImpl::LuaQuery##prop);\
                             mt[ "Set" #prop ] = Lua::Transform(&LuaApi::SoundEmitterImpl::set##prop)
 #define OAL_PROPERTY_RO(prop) mt[ #prop ] = Lua::Transform(&LuaApi::SoundEmitterImpl::query##prop)
+#define OAL_PROPERTY_VEC(prop) mt[ #prop "Vec" ] = Lua::Transform(&LuaApi::SoundEmitterImpl::LuaQuery##prop##Vec);\
+                            mt[ "Set" #prop "Vec" ] = Lua::Transform(&LuaApi::SoundEmitterImpl::LuaSet##prop##Vec)
 
         OAL_PROPERTY(Pitch);
         OAL_PROPERTY(Gain);
@@ -115,6 +125,9 @@ template <> struct MetatableDescriptor<LuaApi::SoundEmitterImpl> {
         OAL_PROPERTY_ALT(Position);
         OAL_PROPERTY_ALT(Velocity);
         OAL_PROPERTY_ALT(Direction);
+        OAL_PROPERTY_VEC(Position);
+        OAL_PROPERTY_VEC(Velocity);
+        OAL_PROPERTY_VEC(Direction);
         //OAL_PROPERTY_RO(SourceType);
         //OAL_PROPERTY_RO(SourceState);
         OAL_PROPERTY_RO(QueuedBuffers);
@@ -129,6 +142,7 @@ template <> struct MetatableDescriptor<LuaApi::SoundEmitterImpl> {
 #undef OAL_PROPERTY
 #undef OAL_PROPERTY_ALT
 #undef OAL_PROPERTY_RO
+#undef OAL_PROPERTY_VEC
         
         mt["IsValid"] = Lua::Transform(&LuaApi::SoundEmitterImpl::IsValid);
         mt["Play"] = Lua::Transform(&LuaApi::SoundEmitterImpl::Play);
@@ -136,5 +150,40 @@ template <> struct MetatableDescriptor<LuaApi::SoundEmitterImpl> {
         mt["Stop"] = Lua::Transform(&LuaApi::SoundEmitterImpl::Stop);
         mt["Rewind"] = Lua::Transform(&LuaApi::SoundEmitterImpl::Rewind);
     }
+    // Setters with default arguments stay on the generic path.
+    static void direct(LuaApi::DirectMethods<LuaApi::SoundEmitterImpl>& dm) {
+#define OAL_GETTER(prop) dm.Add( #prop, &LuaApi::SoundEmitterImpl::query##prop)
+#define OAL_GETTER_ALT(prop) dm.Add( #prop, &LuaApi::SoundEmitterImpl::LuaQuery##prop)
+        OAL_GETTER(Pitch);
+        OAL_GETTER(Gain);
+        OAL_GETTER(MaxDistance);
+        OAL_GETTER(Rolloff);
+        OAL_GETTER(RefDistance);
+        OAL_GETTER(MinGain);
+        OAL_GETTER(MaxGain);
+        OAL_GETTER(ConeOuterGain);
+        OAL_GETTER(ConeInnerAngle);
+        OAL_GETTER(ConeOuterAngle);
+        OAL_GETTER(RelativePosition);
+        OAL_GETTER(Looping);
+        OAL_GETTER_ALT(Position);
+        OAL_GETTER_ALT(Velocity);
+        OAL_GETTER_ALT(Direction);
+        OAL_GETTER(QueuedBuffers);
+        OAL_GETTER(ProcessedBuffers);
+        OAL_GETTER(OffsetSeconds);
+        OAL_GETTER(OffsetSamples);
+        OAL_GETTER(OffsetBytes);
+        OAL_GETTER(Frequency);
+        OAL_GETTER(Bits);
+        OAL_GETTER(Channels);
+        OAL_GETTER(ByteSize);
+#undef OAL_GETTER
+#undef OAL_GETTER_ALT
+        dm.Add("Play", &LuaApi::SoundEmitterImpl::Play);
+        dm.Add("Pause", &LuaApi::SoundEmitterImpl::Pause);
+        dm.Add("Stop", &LuaApi::SoundEmitterImpl::Stop);
+        dm.Add("Rewind", &LuaApi::SoundEmitterImpl::Rewind);
+    }
 };
 #endif
@@ -1,6 +1,9 @@
 #include "loader.h"
+#include <QDataStream>
 #include <cstring>
 #include <vorbis/vorbisfile.h>
+#include "../core/manifest.h"
+#include "../core/vfs.h"
 
 enum {
     OGG_MAIN_BUFFER_SIZE = 8 * MEGABYTE,
@@ -12,6 +15,65 @@ enum {
 
 namespace LuaApi {
     namespace SoundLoader {
+        SEB_BufferFormat FormatOf(int channels, int sampleBytes)
+        {
+            SEB_BufferFormat fmt = SBF_INVALID;
+            if(sampleBytes == 1)
+            {
+                switch(channels)
+                {
+                case 1:
+                    fmt = SBF_MONO_8;
+                    break;
+                case 2:
+                    fmt = SBF_STEREO_8;
+                    break;
+                case 4:
+                    fmt = SBF_QUAD_8;
+                    break;
+                case 6:
+                    fmt = SBF_51CHN_8;
+                    break;
+                case 7:
+                    fmt = SBF_61CHN_8;
+                    break;
+                case 8:
+                    fmt = SBF_71CHN_8;
+                    break;
+                default:
+                    break;
+                }
+            }
+            else if(sampleBytes == 2)
+            {
+                switch(channels)
+                {
+                case 1:
+                    fmt = SBF_MONO_16;
+                    break;
+                case 2:
+                    fmt = SBF_STEREO_16;
+                    break;
+                case 4:
+                    fmt = SBF_QUAD_16;
+                    break;
+                case 6:
+                    fmt = SBF_51CHN_16;
+                    break;
+                case 7:
+                    fmt = SBF_61CHN_16;
+                    break;
+                case 8:
+                    fmt = SBF_71CHN_16;
+                    break;
+                default:
+                    break;
+                }
+            }
+            
+            return fmt;
+        }
+        
         namespace OggLoader {
         
             class OggFileReaderCallback {
@@ -90,6 +152,18 @@ namespace LuaApi {
             }
             
             
+            // Vorbis orders 5.1 and up differently from OpenAL.
+            template <typename T>
+            void Reorder(T* start, std::size_t groupCount, int channels)
+            {
+                if(channels == 6)
+                    Reorder6(start, groupCount);
+                else if(channels == 7)
+                    Reorder7(start, groupCount);
+                else if(channels == 8)
+                    Reorder8(start, groupCount);
+            }
+            
             static thread_local std::vector<unsigned char> g_oggMainBuffer;
             static thread_local std::vector<unsigned char> g_oggSubBuffer;
             
@@ -120,59 +194,7 @@ namespace LuaApi {
                 // Just change this to 1 to use 8-bit audio data.
                 int constexpr sampleByteSize = 2;
                 
-                SEB_BufferFormat fmt = SBF_INVALID;
-                if(sampleByteSize == 1)
-                {
-                    switch(info.channels)
-                    {
-                    case 1:
-                        fmt = SBF_MONO_8;
-                        break;
-                    case 2:
-                        fmt = SBF_STEREO_8;
-                        break;
-                    case 4:
-                        fmt = SBF_QUAD_8;
-                        break;
-                    case 6:
-                        fmt = SBF_51CHN_8;
-                        break;
-                    case 7:
-                        fmt = SBF_61CHN_8;
-                        break;
-                    case 8:
-                        fmt = SBF_71CHN_8;
-                        break;
-                    default:
-                        break;
-                    }
-                }
-                else if(sampleByteSize == 2)
-                {
-                    switch(info.channels)
-                    {
-                    case 1:
-                        fmt = SBF_MONO_16;
-                        break;
-                    case 2:
-                        fmt = SBF_STEREO_16;
-                        break;
-                    case 4:
-                        fmt = SBF_QUAD_16;
-                        break;
-                    case 6:
-                        fmt = SBF_51CHN_16;
-                        break;
-                    case 7:
-                        fmt = SBF_61CHN_16;
-                        break;
-                    case 8:
-                        fmt = SBF_71CHN_16;
-                        break;
-                    default:
-                        break;
-                    }
-                }
+                SEB_BufferFormat fmt = FormatOf(info.channels, sampleByteSize);
                 
                 if(fmt == SBF_INVALID)
                 {
@@ -214,18 +236,7 @@ namespace LuaApi {
                     {
                         long const samples = (buffer.size() / sampleByteSize) / info.channels;
                         
-                        if(info.channels == 6)
-                        {
-                            Reorder6(reinterpret_cast<typename sizedElement<sampleByteSize>::type*>(buffer.data()), samples);
-                        }
-                        else if(info.channels == 7)
-                        {
-                            Reorder7(reinterpret_cast<typename sizedElement<sampleByteSize>::type*>(buffer.data()), samples);
-                        }
-                        else if(info.channels == 8)
-                        {
-                            Reorder8(reinterpret_cast<typename sizedElement<sampleByteSize>::type*>(buffer.data()), samples);
-                        }
+                        Reorder(reinterpret_cast<typename sizedElement<sampleByteSize>::type*>(buffer.data()), samples, info.channels);
                         emitter->queueData(fmt, buffer.data(), buffer.size(), info.rate);
                         buffer.clear();
                     }
@@ -235,18 +246,7 @@ namespace LuaApi {
                 {
                     long const samples = (buffer.size() / sampleByteSize) / info.channels;
                     
-                    if(info.channels == 6)
-                    {
-                        Reorder6(reinterpret_cast<typename sizedElement<sampleByteSize>::type*>(buffer.data()), samples);
-                    }
-                    else if(info.channels == 7)
-                    {
-                        Reorder7(reinterpret_cast<typename sizedElement<sampleByteSize>::type*>(buffer.data()), samples);
-                    }
-                    else if(info.channels == 8)
-                    {
-                        Reorder8(reinterpret_cast<typename sizedElement<sampleByteSize>::type*>(buffer.data()), samples);
-                    }
+                    Reorder(reinterpret_cast<typename sizedElement<sampleByteSize>::type*>(buffer.data()), samples, info.channels);
                     emitter->queueData(fmt, buffer.data(), buffer.size(), info.rate);
                     buffer.clear();
                 }
@@ -254,15 +254,102 @@ namespace LuaApi {
                 tempBuffer.clear();
                 return emitter;
             }
+            
+            bool DecodeOGG(QIODevice& f, std::size_t maxBytes, int& channels, std::uint32_t& rate,
+                           std::vector<unsigned char>& pcm) {
+                pcm.clear();
+                if(!f.isOpen())
+                    return false;
+                
+                OggFileReaderCallback ofrc(f);
+                OggVorbis_File vorbFile;
+                if(ov_open_callbacks(reinterpret_cast<void*>(&ofrc),&vorbFile, nullptr, 0, ofrc.Callbacks()) != 0)
+                    return false;
+                vorbis_info* pInfo = ov_info(&vorbFile, -1);
+                if(!pInfo || FormatOf(pInfo->channels, 2) == SBF_INVALID)
+                {
+                    ov_clear(&vorbFile);
+                    return false;
+                }
+                channels = pInfo->channels;
+                rate = static_cast<std::uint32_t>(pInfo->rate);
+                
+                std::vector<unsigned char> temp(OGG_SUB_BUFFER_SIZE);
+                int section = 0;
+                for(;;) {
+                    long bytes = ov_read(&vorbFile, reinterpret_cast<char*>(temp.data()),
+                                         temp.size(), 0, 2, 1, &section);
+                    if(bytes < 0 || pcm.size() + bytes > maxBytes)
+                    {
+                        ov_clear(&vorbFile);
+                        pcm.clear();
+                        return false;
+                    }
+                    if(!bytes)
+                        break;
+                    pcm.insert(pcm.end(), temp.begin(), temp.begin() + bytes);
+                }
+                ov_clear(&vorbFile);
+                Reorder(reinterpret_cast<std::uint16_t*>(pcm.data()), pcm.size() / 2 / channels, channels);
+                return !pcm.empty();
+            }
         } // OggLoader
         
+        namespace PcmLoader {
+            SoundEmitter LoadPCM(QIODevice& f) {
+                SoundEmitter emitter;
+                if(!f.isOpen())
+                    return emitter;
+                
+                QDataStream in(&f);
+                in.setByteOrder(QDataStream::LittleEndian);
+                quint32 magic, version, channels, sampleBytes, rate, bytes;
+                in >> magic >> version >> channels >> sampleBytes >> rate >> bytes;
+                SEB_BufferFormat const fmt = FormatOf(static_cast<int>(channels), static_cast<int>(sampleBytes));
+                if(in.status() != QDataStream::Ok || magic != MAGIC || version != VERSION ||
+                        fmt == SBF_INVALID || !bytes || bytes > f.size())
+                    return emitter;
+                
+                std::vector<unsigned char> pcm(bytes);
+                if(in.readRawData(reinterpret_cast<char*>(pcm.data()), static_cast<int>(bytes)) != static_cast<int>(bytes))
+                    return emitter;
+                emitter.Init();
+                if(!emitter->Init() || !emitter->queueData(fmt, pcm.data(), pcm.size(), rate))
+                    emitter.SoftRelease();
+                return emitter;
+            }
+            
+            bool WritePCM(QIODevice& f, int channels, int sampleBytes, std::uint32_t rate,
+                          std::vector<unsigned char> const& pcm) {
+                QDataStream out(&f);
+                out.setByteOrder(QDataStream::LittleEndian);
+                out << quint32(MAGIC) << quint32(VERSION) << quint32(channels) << quint32(sampleBytes)
+                    << quint32(rate) << quint32(pcm.size());
+                out.writeRawData(reinterpret_cast<char const*>(pcm.data()), static_cast<int>(pcm.size()));
+                return out.status() == QDataStream::Ok;
+            }
+        } // PcmLoader
+        
         SoundEmitter LoadFile(std::string const& filename) {
-            QFile f(QString::fromStdString(filename));
-            if(!f.open(QFile::ReadOnly))
+            // Cooked sounds skip decoding altogether.
+            std::string const cooked = AssetManifest::Instance().lookup(filename, AssetManifest::SOUND);
+            if(!cooked.empty())
+            {
+                std::unique_ptr<QIODevice> f = Vfs::Instance().open(cooked);
+                if(f)
+                {
+                    SoundEmitter emitter = PcmLoader::LoadPCM(*f);
+                    if(emitter.IsValid())
+                        return emitter;
+                }
+            }
+            
+            std::unique_ptr<QIODevice> f = Vfs::Instance().open(filename);
+            if(!f)
                 return SoundEmitter();
             
             // We only support Ogg so far...
-            return OggLoader::LoadOGG(f);
+            return OggLoader::LoadOGG(*f);
         }
     } // SoundLoader
 } // LuaApi
@@ -1,11 +1,33 @@
 #ifndef LUAAL_LOADER_H
 #define LUAAL_LOADER_H
+#include <vector>
 #include "shared.h"
 #include "emitter.h"
 
 namespace LuaApi {
     namespace SoundLoader {
         SoundEmitter LoadFile(std::string const&);
+        // SBF_INVALID if OpenAL has no format for the layout.
+        SEB_BufferFormat FormatOf(int channels, int sampleBytes);
+        namespace OggLoader {
+            SoundEmitter LoadOGG(QIODevice&);
+            // The whole stream as 16 bit PCM in OpenAL's channel order.
+            // False if it fails to decode or would exceed maxBytes.
+            bool DecodeOGG(QIODevice&, std::size_t maxBytes, int& channels, std::uint32_t& rate,
+                           std::vector<unsigned char>& pcm);
+        }
+        // Sounds cooked to raw PCM: magic, version, channels, bytes per
+        // sample, rate and byte count as little endian 32 bit words, then
+        // the samples.
+        namespace PcmLoader {
+            enum : std::uint32_t {
+                MAGIC = 0x5350524F, // "ORPS"
+                VERSION = 1
+            };
+            SoundEmitter LoadPCM(QIODevice&);
+            bool WritePCM(QIODevice&, int channels, int sampleBytes, std::uint32_t rate,
+                          std::vector<unsigned char> const& pcm);
+        }
     }
 }
 
@@ -0,0 +1,170 @@
+#include "assets.h"
+#include <QDir>
+#include <QFile>
+#include <QImage>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vorbis/vorbisenc.h>
+
+namespace Bench {
+
+static float const g_pi = 3.14159265358979f;
+
+static bool GenerateTexture(QString const& path)
+{
+    QImage img(TEXTURE_SIZE, TEXTURE_SIZE, QImage::Format_RGBA8888);
+    std::uint32_t seed = 0x12345678u;
+    for(int y = 0; y < img.height(); ++y)
+    {
+        uchar* line = img.scanLine(y);
+        for(int x = 0; x < img.width(); ++x)
+        {
+            // Gradient plus xorshift noise, so PNG compression has real work to undo.
+            seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+            line[x * 4 + 0] = static_cast<uchar>(x * 255 / img.width());
+            line[x * 4 + 1] = static_cast<uchar>(y * 255 / img.height());
+            line[x * 4 + 2] = static_cast<uchar>(seed & 0xFF);
+            line[x * 4 + 3] = 255;
+        }
+    }
+    return img.save(path, "PNG");
+}
+
+static bool GenerateModel(QString const& path)
+{
+    QFile f(path);
+    if(!f.open(QFile::WriteOnly | QFile::Truncate | QFile::Text))
+        return false;
+    QTextStream out(&f);
+    
+    int const n = MODEL_GRID;
+    float const inv = 1.f / (n - 1);
+    for(int y = 0; y < n; ++y)
+    {
+        for(int x = 0; x < n; ++x)
+        {
+            float u = x * inv;
+            float v = y * inv;
+            float h = 0.1f * std::sin(u * 8.f * g_pi) * std::cos(v * 8.f * g_pi);
+            out << "v " << (u - 0.5f) << " " << h << " " << (v - 0.5f) << "\n";
+            out << "vt " << u << " " << v << "\n";
+            out << "vn 0 1 0\n";
+        }
+    }
+    out << "usemtl default\n";
+    for(int y = 0; y + 1 < n; ++y)
+    {
+        for(int x = 0; x + 1 < n; ++x)
+        {
+            int a = y * n + x + 1;
+            int b = a + 1;
+            int c = a + n;
+            int d = c + 1;
+            out << "f " << a << "/" << a << "/" << a << " "
+                       << c << "/" << c << "/" << c << " "
+                       << b << "/" << b << "/" << b << "\n";
+            out << "f " << b << "/" << b << "/" << b << " "
+                       << c << "/" << c << "/" << c << " "
+                       << d << "/" << d << "/" << d << "\n";
+        }
+    }
+    return out.status() == QTextStream::Ok;
+}
+
+static bool WritePage(QFile& f, ogg_page const& og)
+{
+    return f.write(reinterpret_cast<char const*>(og.header), og.header_len) == og.header_len &&
+            f.write(reinterpret_cast<char const*>(og.body), og.body_len) == og.body_len;
+}
+
+static bool GenerateSound(QString const& path)
+{
+    QFile f(path);
+    if(!f.open(QFile::WriteOnly | QFile::Truncate))
+        return false;
+    
+    vorbis_info vi;
+    vorbis_info_init(&vi);
+    if(vorbis_encode_init_vbr(&vi, SOUND_CHANNELS, SOUND_RATE, 0.4f) != 0)
+    {
+        vorbis_info_clear(&vi);
+        return false;
+    }
+    vorbis_comment vc;
+    vorbis_comment_init(&vc);
+    vorbis_dsp_state vd;
+    vorbis_block vb;
+    vorbis_analysis_init(&vd, &vi);
+    vorbis_block_init(&vd, &vb);
+    ogg_stream_state os;
+    ogg_stream_init(&os, 1);
+    
+    bool ok = true;
+    ogg_page og;
+    ogg_packet op;
+    {
+        ogg_packet header, comments, codebooks;
+        vorbis_analysis_headerout(&vd, &vc, &header, &comments, &codebooks);
+        ogg_stream_packetin(&os, &header);
+        ogg_stream_packetin(&os, &comments);
+        ogg_stream_packetin(&os, &codebooks);
+        while(ok && ogg_stream_flush(&os, &og))
+            ok = WritePage(f, og);
+    }
+    
+    long const total = static_cast<long>(SOUND_SECONDS) * SOUND_RATE;
+    long const chunk = 1024;
+    for(long written = 0; ok; )
+    {
+        long frames = std::min(chunk, total - written);
+        if(frames > 0)
+        {
+            float** buffer = vorbis_analysis_buffer(&vd, frames);
+            for(long i = 0; i < frames; ++i)
+            {
+                float t = static_cast<float>(written + i) / SOUND_RATE;
+                buffer[0][i] = 0.5f * std::sin(2.f * g_pi * 440.f * t);
+                buffer[1][i] = 0.5f * std::sin(2.f * g_pi * 660.f * t);
+            }
+            written += frames;
+        }
+        vorbis_analysis_wrote(&vd, (frames > 0) ? frames : 0);
+        
+        while(ok && vorbis_analysis_blockout(&vd, &vb) == 1)
+        {
+            vorbis_analysis(&vb, nullptr);
+            vorbis_bitrate_addblock(&vb);
+            while(ok && vorbis_bitrate_flushpacket(&vd, &op))
+            {
+                ogg_stream_packetin(&os, &op);
+                while(ok && ogg_stream_pageout(&os, &og))
+                    ok = WritePage(f, og);
+            }
+        }
+        if(frames <= 0)
+            break;
+    }
+    while(ok && ogg_stream_flush(&os, &og))
+        ok = WritePage(f, og);
+    
+    ogg_stream_clear(&os);
+    vorbis_block_clear(&vb);
+    vorbis_dsp_clear(&vd);
+    vorbis_comment_clear(&vc);
+    vorbis_info_clear(&vi);
+    return ok;
+}
+
+bool GenerateAssets(std::string const& directory)
+{
+    QDir dir(QString::fromStdString(directory));
+    if(!dir.mkpath("."))
+        return false;
+    return GenerateTexture(dir.filePath("texture.png")) &&
+            GenerateModel(dir.filePath("model.obj")) &&
+            GenerateSound(dir.filePath("sound.ogg"));
+}
+
+}
@@ -0,0 +1,19 @@
+#ifndef BENCH_ASSETS_H
+#define BENCH_ASSETS_H
+#include <string>
+
+namespace Bench {
+    enum {
+        TEXTURE_SIZE = 1024,
+        MODEL_GRID = 160,
+        SOUND_SECONDS = 10,
+        SOUND_RATE = 44100,
+        SOUND_CHANNELS = 2
+    };
+    
+    // Writes texture.png, model.obj and sound.ogg into the directory.
+    // Run by qmake after linking (see bench.pro).
+    bool GenerateAssets(std::string const& directory);
+}
+
+#endif
@@ -0,0 +1,73 @@
+#-------------------------------------------------
+#
+# OpenRP micro-benchmarks
+#
+# Synthetic assets are generated into $$OUT_PWD/assets after linking,
+# so the suite needs nothing outside the source tree.
+#
+#-------------------------------------------------
+
+QT       += core gui
+
+CONFIG   += console c++14
+CONFIG   -= app_bundle
+
+TARGET = openrp-bench
+TEMPLATE = app
+LIBS += -lopenal -lvorbisfile -lvorbisenc -lvorbis -logg -lassimp
+INCLUDEPATH += ..
+
+SOURCES += main.cpp \
+    benchmark.cpp \
+    assets.cpp \
+    loaders.cpp \
+    bindings.cpp \
+    refcount.cpp \
+    scene.cpp \
+    spatial.cpp \
+    occlusion.cpp \
+    ../gl/atlas.cpp \
+    ../gl/camera.cpp \
+    ../gl/drawable.cpp \
+    ../gl/font.cpp \
+    ../gl/material.cpp \
+    ../gl/misc.cpp \
+    ../gl/model.cpp \
+    ../gl/modelfile.cpp \
+    ../gl/object.cpp \
+    ../gl/objectbone.cpp \
+    ../gl/packer.cpp \
+    ../gl/shader.cpp \
+    ../gl/sprite.cpp \
+    ../gl/streaming.cpp \
+    ../gl/texture.cpp \
+    ../gl/texturearray.cpp \
+    ../gl/texturefile.cpp \
+    ../gl/texturememory.cpp \
+    ../gl/uniformblock.cpp \
+    ../al/context.cpp \
+    ../al/device.cpp \
+    ../al/emitter.cpp \
+    ../al/loader.cpp \
+    ../core/pool.cpp \
+    ../core/jobs.cpp \
+    ../core/manifest.cpp \
+    ../core/vfs.cpp \
+    ../world/simd.cpp \
+    ../world/vector.cpp \
+    ../world/quat.cpp \
+    ../world/matrix.cpp \
+    ../world/batch.cpp \
+    ../world/bounds.cpp \
+    ../world/spatial.cpp \
+    ../world/occlusion.cpp \
+    ../world/scene.cpp \
+    ../world/clip.cpp \
+    ../world/animation.cpp
+
+HEADERS += benchmark.h \
+    assets.h
+
+include(../../../Repository/LuaPP/qt_luapp.pri)
+
+QMAKE_POST_LINK += $$shell_quote($$OUT_PWD/$$TARGET) --generate $$shell_quote($$OUT_PWD/assets)
@@ -0,0 +1,149 @@
+#include "benchmark.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+
+// Every heap allocation in the process is counted, so cases can show
+// whether a call path allocates at all.
+static std::atomic<std::uint64_t> g_allocations(0);
+
+void* operator new(std::size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if(void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace Bench {
+
+Registry& Registry::Instance()
+{
+    static Registry r;
+    return r;
+}
+void Registry::Add(Case c) { m_cases.push_back(std::move(c)); }
+std::vector<Case> const& Registry::Cases() const { return m_cases; }
+
+static std::string g_assetPath;
+std::string const& AssetPath() { return g_assetPath; }
+void SetAssetPath(std::string p) { g_assetPath = std::move(p); }
+
+std::uint64_t AllocationCount() { return g_allocations.load(std::memory_order_relaxed); }
+
+Result Run(Case const& c)
+{
+    Result r;
+    r.Name = c.Name;
+    r.Iterations = c.Iterations;
+    r.Samples = (c.Samples > 0) ? c.Samples : 1;
+    r.MeanNs = r.MedianNs = r.MinNs = r.MaxNs = r.BytesPerSecond = r.AllocationsPerIteration = 0.0;
+    r.Skipped = false;
+    
+    if(c.Setup && !c.Setup())
+    {
+        r.Skipped = true;
+        return r;
+    }
+    
+    std::uint64_t perSample = c.Iterations / r.Samples;
+    if(perSample == 0)
+        perSample = 1;
+    
+    // One untimed sample to warm caches and lazy initialisation.
+    c.Body(perSample);
+    
+    std::vector<double> samples;
+    samples.reserve(r.Samples);
+    double total = 0.0;
+    std::uint64_t allocations = AllocationCount();
+    for(std::uint32_t i = 0; i < r.Samples; ++i)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        c.Body(perSample);
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        total += ns;
+        samples.push_back(ns / perSample);
+    }
+    allocations = AllocationCount() - allocations;
+    if(c.Teardown)
+        c.Teardown();
+    
+    std::sort(samples.begin(), samples.end());
+    r.Iterations = perSample * r.Samples;
+    r.MeanNs = total / r.Iterations;
+    r.MedianNs = samples[samples.size() / 2];
+    r.MinNs = samples.front();
+    r.MaxNs = samples.back();
+    if(c.BytesPerIteration > 0 && r.MeanNs > 0.0)
+        r.BytesPerSecond = c.BytesPerIteration * (1.0e9 / r.MeanNs);
+    r.AllocationsPerIteration = static_cast<double>(allocations) / r.Iterations;
+    return r;
+}
+
+static std::string Escape(std::string const& s)
+{
+    std::string out;
+    for(auto it = s.begin(); it != s.end(); ++it)
+    {
+        if(*it == '"' || *it == '\\')
+            out.push_back('\\');
+        out.push_back(*it);
+    }
+    return out;
+}
+
+std::string ToJson(std::vector<Result> const& results)
+{
+    std::ostringstream os;
+    os.precision(6);
+    os << std::fixed;
+    os << "{\n  \"benchmarks\": [\n";
+    for(std::size_t i = 0; i < results.size(); ++i)
+    {
+        Result const& r = results[i];
+        os << "    {\"name\": \"" << Escape(r.Name) << "\""
+           << ", \"skipped\": " << (r.Skipped ? "true" : "false")
+           << ", \"iterations\": " << r.Iterations
+           << ", \"samples\": " << r.Samples
+           << ", \"mean_ns\": " << r.MeanNs
+           << ", \"median_ns\": " << r.MedianNs
+           << ", \"min_ns\": " << r.MinNs
+           << ", \"max_ns\": " << r.MaxNs
+           << ", \"bytes_per_second\": " << r.BytesPerSecond
+           << ", \"allocs_per_iteration\": " << r.AllocationsPerIteration
+           << "}" << ((i + 1 < results.size()) ? "," : "") << "\n";
+    }
+    os << "  ]\n}\n";
+    return os.str();
+}
+
+std::string ToCsv(std::vector<Result> const& results)
+{
+    std::ostringstream os;
+    os.precision(6);
+    os << std::fixed;
+    os << "name,skipped,iterations,samples,mean_ns,median_ns,min_ns,max_ns,bytes_per_second,allocs_per_iteration\n";
+    for(auto it = results.begin(); it != results.end(); ++it)
+    {
+        os << it->Name << ","
+           << (it->Skipped ? 1 : 0) << ","
+           << it->Iterations << ","
+           << it->Samples << ","
+           << it->MeanNs << ","
+           << it->MedianNs << ","
+           << it->MinNs << ","
+           << it->MaxNs << ","
+           << it->BytesPerSecond << ","
+           << it->AllocationsPerIteration << "\n";
+    }
+    return os.str();
+}
+
+}
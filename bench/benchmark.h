@@ -0,0 +1,55 @@
+#ifndef BENCH_BENCHMARK_H
+#define BENCH_BENCHMARK_H
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Bench {
+    // One benchmark case. The body runs `count` iterations per call; the
+    // harness splits Iterations into Samples calls of equal size so cheap
+    // operations are not dominated by clock overhead.
+    struct Case {
+        std::string Name;
+        std::uint64_t Iterations;
+        std::uint32_t Samples;
+        std::uint64_t BytesPerIteration;
+        std::function<bool()> Setup;
+        std::function<void(std::uint64_t count)> Body;
+        std::function<void()> Teardown;
+    };
+    
+    struct Result {
+        std::string Name;
+        std::uint64_t Iterations;
+        std::uint32_t Samples;
+        double MeanNs;
+        double MedianNs;
+        double MinNs;
+        double MaxNs;
+        double BytesPerSecond;
+        // Heap allocations through operator new, averaged over the timed
+        // samples.
+        double AllocationsPerIteration;
+        bool Skipped;
+    };
+    
+    class Registry {
+        std::vector<Case> m_cases;
+    public:
+        static Registry& Instance();
+        void Add(Case);
+        std::vector<Case> const& Cases() const;
+    };
+    
+    Result Run(Case const&);
+    std::uint64_t AllocationCount();
+    std::string ToJson(std::vector<Result> const&);
+    std::string ToCsv(std::vector<Result> const&);
+    
+    // Directory holding the synthetic assets generated at build time.
+    std::string const& AssetPath();
+    void SetAssetPath(std::string);
+}
+
+#endif
@@ -0,0 +1,94 @@
+#include "benchmark.h"
+#include "../gl/all.h"
+
+namespace Bench {
+
+// Lua -> C++ call overhead. Every case runs a Lua loop of n calls; the
+// empty loop is reported as its own case so it can be subtracted.
+// A second state registers the objects without their direct methods, to
+// compare against the generic LuaPP dispatch.
+class LuaBench {
+    Lua::State m_state;
+    bool m_direct;
+    bool m_ready;
+    
+    template <typename X>
+    void registerObject()
+    {
+        if(m_direct)
+            LuaApi::RegisterObject<X>(m_state);
+        else
+            m_state.luapp_register_object<X>();
+    }
+public:
+    explicit LuaBench(bool direct) : m_state(Lua::State::create()), m_direct(direct), m_ready(false) {}
+    
+    bool Init()
+    {
+        if(m_ready)
+            return true;
+        m_state.luapp_register_metatables();
+        m_state.requiref("_G", luaopen_base, 1);
+        m_state.pop(1);
+        registerObject<LuaApi::Timer>();
+        registerObject<LuaApi::ObjectMaterial>();
+        registerObject<LuaApi::Texture>();
+        
+        static char const* const code =
+                "function bench_empty(n) for i = 1, n do end end\n"
+                "local timer = Timer.New()\n"
+                "function bench_timef(n) local t = timer for i = 1, n do t:TimeF() end end\n"
+                "function bench_update(n) local t = timer for i = 1, n do t:Update() end end\n"
+                "local material = Material.New()\n"
+                "function bench_setdiffuse(n) local m = material for i = 1, n do m:SetDiffuseColor(0.5, 0.25, 1.0) end end\n"
+                "function bench_diffuse(n) local m = material for i = 1, n do m:DiffuseColor() end end\n"
+                "function bench_isvalid(n) local m = material for i = 1, n do m:IsValid() end end\n"
+                "local texture = Texture.New()\n"
+                "function bench_texsize(n) local t = texture for i = 1, n do t:Size() end end\n";
+        if(m_state.loadstring(code) != 0 || m_state.pcall() != 0)
+            return false;
+        m_ready = true;
+        return true;
+    }
+    
+    void Call(char const* fn, std::uint64_t n)
+    {
+        m_state.getglobal(fn);
+        m_state.pushinteger(static_cast<lua_Integer>(n));
+        if(m_state.pcall(1) != 0)
+            m_state.pop(1);
+    }
+};
+
+void RegisterBindingBenchmarks()
+{
+    Registry& r = Registry::Instance();
+    auto direct = std::make_shared<LuaBench>(true);
+    auto generic = std::make_shared<LuaBench>(false);
+    
+    struct Entry { char const* name; char const* fn; };
+    static Entry const entries[] = {
+        { "lua/empty_loop", "bench_empty" },
+        { "lua/Timer:TimeF", "bench_timef" },
+        { "lua/Timer:Update", "bench_update" },
+        { "lua/Material:SetDiffuseColor", "bench_setdiffuse" },
+        { "lua/Material:DiffuseColor", "bench_diffuse" },
+        { "lua/Material:IsValid", "bench_isvalid" },
+        { "lua/Texture:Size", "bench_texsize" }
+    };
+    
+    for(std::size_t i = 0; i < sizeof(entries) / sizeof(entries[0]); ++i)
+    {
+        char const* fn = entries[i].fn;
+        r.Add({ entries[i].name, 2000000, 20, 0,
+                [=]() { return direct->Init(); },
+                [=](std::uint64_t n) { direct->Call(fn, n); },
+                nullptr });
+        r.Add({ std::string(entries[i].name) + "/generic", 2000000, 20, 0,
+                [=]() { return generic->Init(); },
+                [=](std::uint64_t n) { generic->Call(fn, n); },
+                nullptr });
+    }
+}
+
+}
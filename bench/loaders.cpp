@@ -0,0 +1,109 @@
+#include "benchmark.h"
+#include "assets.h"
+#include "../gl/all.h"
+#include "../al/all.h"
+#include <QBuffer>
+#include <QFile>
+#include <QOpenGLContext>
+
+namespace Bench {
+
+static std::string Asset(char const* name)
+{
+    return AssetPath() + "/" + name;
+}
+
+static bool HasContext()
+{
+    return QOpenGLContext::currentContext() != nullptr;
+}
+
+enum {
+    UPLOAD_VERTICES = 65536
+};
+
+void RegisterLoaderBenchmarks()
+{
+    Registry& r = Registry::Instance();
+    
+    {
+        auto model = std::make_shared<LuaApi::ModelImpl>();
+        r.Add({ "ModelImpl::load/obj", 20, 20, 0,
+                [=]() { return HasContext() && model->load(Asset("model.obj")); },
+                [=](std::uint64_t n) { for(std::uint64_t i = 0; i < n; ++i) model->load(Asset("model.obj")); },
+                nullptr });
+    }
+    
+    {
+        auto texture = std::make_shared<LuaApi::TextureImpl>();
+        auto load = [=](bool mipmaps) {
+            return texture->load(Asset("texture.png"), Lua::CopyToArg<bool>(mipmaps));
+        };
+        std::uint64_t const bytes = static_cast<std::uint64_t>(TEXTURE_SIZE) * TEXTURE_SIZE * 4;
+        r.Add({ "TextureImpl::load/png", 20, 20, bytes,
+                [=]() { return HasContext() && load(false); },
+                [=](std::uint64_t n) { for(std::uint64_t i = 0; i < n; ++i) load(false); },
+                [=]() { texture->unload(); } });
+        r.Add({ "TextureImpl::load/png+mipmaps", 20, 20, bytes,
+                [=]() { return HasContext() && load(true); },
+                [=](std::uint64_t n) { for(std::uint64_t i = 0; i < n; ++i) load(true); },
+                [=]() { texture->unload(); } });
+    }
+    
+    {
+        // Icons packed into a fresh atlas; pages grow as they fill.
+        auto atlas = std::make_shared<LuaApi::TextureAtlasImpl>();
+        auto icon = std::make_shared<QImage>(64, 64, QImage::Format_RGBA8888);
+        icon->fill(Qt::white);
+        r.Add({ "TextureAtlasImpl::add/64x64", 4096, 10, 64 * 64 * 4,
+                [=]() { atlas->Clear(); return HasContext(); },
+                [=](std::uint64_t n) { for(std::uint64_t i = 0; i < n; ++i) atlas->add(*icon); },
+                [=]() { atlas->Clear(); } });
+    }
+    
+    {
+        std::uint64_t const pcmBytes = static_cast<std::uint64_t>(SOUND_SECONDS) * SOUND_RATE * SOUND_CHANNELS * 2;
+        r.Add({ "SoundLoader::LoadFile/ogg", 10, 10, pcmBytes,
+                []() { return QFile::exists(QString::fromStdString(Asset("sound.ogg"))); },
+                [](std::uint64_t n) { for(std::uint64_t i = 0; i < n; ++i) LuaApi::SoundLoader::LoadFile(Asset("sound.ogg")); },
+                nullptr });
+        
+        // Decode from memory so only Vorbis decoding and buffer handling are measured.
+        auto encoded = std::make_shared<QByteArray>();
+        r.Add({ "SoundLoader::LoadOGG/memory", 10, 10, pcmBytes,
+                [=]() {
+                    QFile f(QString::fromStdString(Asset("sound.ogg")));
+                    if(!f.open(QFile::ReadOnly))
+                        return false;
+                    *encoded = f.readAll();
+                    return !encoded->isEmpty();
+                },
+                [=](std::uint64_t n) {
+                    for(std::uint64_t i = 0; i < n; ++i)
+                    {
+                        QBuffer buffer(encoded.get());
+                        buffer.open(QBuffer::ReadOnly);
+                        LuaApi::SoundLoader::OggLoader::LoadOGG(buffer);
+                    }
+                },
+                nullptr });
+    }
+    
+    {
+        auto storage = std::make_shared<LuaApi::ModelStorageImpl>();
+        auto data = std::make_shared<Lua::Array<float>>();
+        r.Add({ "ModelStorageImpl::set3d/64k", 200, 20, UPLOAD_VERTICES * 3 * sizeof(float),
+                [=]() {
+                    if(!HasContext() || !storage->create(UPLOAD_VERTICES))
+                        return false;
+                    data->m_data.resize(UPLOAD_VERTICES * 3);
+                    for(std::size_t i = 0; i < data->m_data.size(); ++i)
+                        data->m_data[i] = static_cast<float>(i);
+                    return true;
+                },
+                [=](std::uint64_t n) { for(std::uint64_t i = 0; i < n; ++i) storage->set3d(0, *data); },
+                [=]() { storage->unload(); } });
+    }
+}
+
+}
@@ -0,0 +1,92 @@
+#include "benchmark.h"
+#include "assets.h"
+#include <QCommandLineParser>
+#include <QFile>
+#include <QGuiApplication>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <cstdio>
+
+namespace Bench {
+    void RegisterLoaderBenchmarks();
+    void RegisterBindingBenchmarks();
+    void RegisterRefCountBenchmarks();
+    void RegisterSceneBenchmarks();
+    void RegisterSpatialBenchmarks();
+    void RegisterOcclusionBenchmarks();
+}
+
+int main(int argc, char* argv[])
+{
+    if(qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+    
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addOptions({
+        { "generate", "Write the synthetic assets into <dir> and exit.", "dir" },
+        { "assets", "Directory holding the synthetic assets.", "dir",
+          QCoreApplication::applicationDirPath() + "/assets" },
+        { "format", "Output format: json or csv.", "format", "json" },
+        { "filter", "Only run benchmarks whose name contains <text>.", "text" },
+        { "output", "Write results to <file> instead of stdout.", "file" }
+    });
+    parser.process(app);
+    
+    if(parser.isSet("generate"))
+    {
+        if(!Bench::GenerateAssets(parser.value("generate").toStdString()))
+        {
+            std::fprintf(stderr, "Unable to generate benchmark assets in %s\n", qPrintable(parser.value("generate")));
+            return 1;
+        }
+        return 0;
+    }
+    Bench::SetAssetPath(parser.value("assets").toStdString());
+    
+    QSurfaceFormat format;
+    format.setRenderableType(QSurfaceFormat::OpenGL);
+    format.setProfile(QSurfaceFormat::CoreProfile);
+    format.setVersion(4,4);
+    QOffscreenSurface surface;
+    surface.setFormat(format);
+    surface.create();
+    QOpenGLContext context;
+    context.setFormat(format);
+    if(!context.create() || !context.makeCurrent(&surface))
+        std::fprintf(stderr, "No OpenGL 4.4 context; GL benchmarks will be skipped.\n");
+    
+    Bench::RegisterLoaderBenchmarks();
+    Bench::RegisterBindingBenchmarks();
+    Bench::RegisterRefCountBenchmarks();
+    Bench::RegisterSceneBenchmarks();
+    Bench::RegisterSpatialBenchmarks();
+    Bench::RegisterOcclusionBenchmarks();
+    
+    std::string filter = parser.value("filter").toStdString();
+    std::vector<Bench::Result> results;
+    std::vector<Bench::Case> const& cases = Bench::Registry::Instance().Cases();
+    for(auto it = cases.begin(); it != cases.end(); ++it)
+    {
+        if(!filter.empty() && it->Name.find(filter) == std::string::npos)
+            continue;
+        std::fprintf(stderr, "%s...\n", it->Name.c_str());
+        results.push_back(Bench::Run(*it));
+    }
+    
+    std::string out = (parser.value("format") == "csv") ? Bench::ToCsv(results) : Bench::ToJson(results);
+    if(parser.isSet("output"))
+    {
+        QFile f(parser.value("output"));
+        if(!f.open(QFile::WriteOnly | QFile::Truncate) ||
+                f.write(out.data(), out.size()) != static_cast<qint64>(out.size()))
+        {
+            std::fprintf(stderr, "Unable to write %s\n", qPrintable(parser.value("output")));
+            return 1;
+        }
+    }
+    else
+        std::fputs(out.c_str(), stdout);
+    return 0;
+}
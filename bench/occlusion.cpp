@@ -0,0 +1,59 @@
+#include "benchmark.h"
+#include "../world/all.h"
+
+namespace Bench {
+
+namespace {
+    // A street of 200 buildings either side of the camera.
+    void BuildStreet(LuaApi::OcclusionBufferImpl& buffer)
+    {
+        for(int i = 0; i < 100; ++i)
+        {
+            float z = -5.f - static_cast<float>(i) * 6.f;
+            buffer.AddOccluderBox(-30.f, 0.f, z - 5.f, -6.f, 20.f, z);
+            buffer.AddOccluderBox(6.f, 0.f, z - 5.f, 30.f, 20.f, z);
+        }
+    }
+
+    LuaApi::Mat4 Camera()
+    {
+        LuaApi::Mat4 m;
+        m.SetPerspective(glm::radians(60.f), 16.f / 9.f, 0.1f, 1000.f);
+        return m;
+    }
+}
+
+void RegisterOcclusionBenchmarks()
+{
+    Registry& r = Registry::Instance();
+
+    auto buffer = std::make_shared<LuaApi::OcclusionBuffer>();
+    auto setup = [=]() {
+        buffer->Init();
+        BuildStreet(**buffer);
+        (*buffer)->Render(Camera());
+        return true;
+    };
+    auto teardown = [=]() { buffer->SoftRelease(); };
+
+    r.Add({ "occlusion/Render:200-boxes", 2000, 20, 0, setup,
+            [=](std::uint64_t n) {
+                LuaApi::Mat4 camera = Camera();
+                for(std::uint64_t i = 0; i < n; ++i)
+                    (*buffer)->Render(camera);
+            },
+            teardown });
+    // Half the boxes sit behind the buildings, half in the street.
+    r.Add({ "occlusion/TestBox", 2000000, 20, 0, setup,
+            [=](std::uint64_t n) {
+                for(std::uint64_t i = 0; i < n; ++i)
+                {
+                    float x = (i & 1) ? -40.f : -1.f;
+                    float z = -10.f - static_cast<float>(i % 500);
+                    (*buffer)->TestBox(x, 0.f, z - 1.f, x + 2.f, 2.f, z);
+                }
+            },
+            teardown });
+}
+
+}
@@ -0,0 +1,103 @@
+#include "benchmark.h"
+#include "../gl/all.h"
+
+namespace Bench {
+
+namespace {
+    // Keeps the optimiser from folding the loops away.
+    template <typename T>
+    void Escape(T const& value)
+    {
+        asm volatile("" : : "g"(&value) : "memory");
+    }
+    
+    GLenum Touch(LuaApi::DrawableState const& state)
+    {
+        return state.DrawMode();
+    }
+}
+
+// RefCounted against the std::shared_ptr it replaced, plus the draw-state
+// handoff that used to copy 18 handles twice per drawable per frame.
+void RegisterRefCountBenchmarks()
+{
+    Registry& r = Registry::Instance();
+    
+    auto timer = std::make_shared<LuaApi::Timer>();
+    auto baseline = std::make_shared<std::shared_ptr<LuaApi::TimerImpl>>();
+    r.Add({ "refcount/RefCounted:copy", 20000000, 20, 0,
+            [=]() { timer->Init(); return timer->IsValid(); },
+            [=](std::uint64_t n) {
+                for(std::uint64_t i = 0; i < n; ++i)
+                {
+                    LuaApi::Timer copy(*timer);
+                    Escape(copy);
+                }
+            },
+            [=]() { timer->SoftRelease(); } });
+    r.Add({ "refcount/shared_ptr:copy", 20000000, 20, 0,
+            [=]() { *baseline = std::make_shared<LuaApi::TimerImpl>(); return true; },
+            [=](std::uint64_t n) {
+                for(std::uint64_t i = 0; i < n; ++i)
+                {
+                    std::shared_ptr<LuaApi::TimerImpl> copy(*baseline);
+                    Escape(copy);
+                }
+            },
+            [=]() { baseline->reset(); } });
+    
+    r.Add({ "refcount/RefCounted:create", 5000000, 20, 0,
+            nullptr,
+            [](std::uint64_t n) {
+                for(std::uint64_t i = 0; i < n; ++i)
+                {
+                    LuaApi::Timer t;
+                    t.Init();
+                    Escape(t);
+                }
+            },
+            nullptr });
+    r.Add({ "refcount/make_shared:create", 5000000, 20, 0,
+            nullptr,
+            [](std::uint64_t n) {
+                for(std::uint64_t i = 0; i < n; ++i)
+                {
+                    auto t = std::make_shared<LuaApi::TimerImpl>();
+                    Escape(t);
+                }
+            },
+            nullptr });
+    
+    auto state = std::make_shared<LuaApi::DrawableState>();
+    auto prepare = [=]() {
+        LuaApi::Texture tex;
+        tex.Init();
+        LuaApi::Shader shd;
+        shd.Init();
+        state->SetFallbackTexture(tex);
+        state->SetShader(shd);
+        return true;
+    };
+    r.Add({ "drawstate/copy", 2000000, 20, 0,
+            prepare,
+            [=](std::uint64_t n) {
+                for(std::uint64_t i = 0; i < n; ++i)
+                {
+                    LuaApi::DrawableState copy(*state);
+                    Escape(Touch(copy));
+                }
+            },
+            nullptr });
+    r.Add({ "drawstate/reference", 2000000, 20, 0,
+            prepare,
+            [=](std::uint64_t n) {
+                for(std::uint64_t i = 0; i < n; ++i)
+                {
+                    LuaApi::DrawableState const& ref = *state;
+                    Escape(Touch(ref));
+                }
+            },
+            nullptr });
+}
+
+}
@@ -0,0 +1,72 @@
+#include "benchmark.h"
+#include "../world/all.h"
+
+namespace Bench {
+
+namespace {
+    // 16 characters of 1024 nodes each under one root: wide enough to
+    // split across threads, deep enough that dirtiness has to propagate.
+    std::size_t const g_characters = 16;
+    std::size_t const g_nodesPerCharacter = 1024;
+
+    LuaApi::SceneImpl::NodeId Child(LuaApi::SceneImpl& scene, LuaApi::SceneImpl::NodeId parent)
+    {
+        return scene.CreateNode(Lua::CopyToArg<LuaApi::SceneImpl::NodeId>(parent));
+    }
+
+    LuaApi::SceneImpl::NodeId BuildScene(LuaApi::SceneImpl& scene)
+    {
+        LuaApi::SceneImpl::NodeId root = Child(scene, 0);
+        for(std::size_t c = 0; c < g_characters; ++c)
+        {
+            LuaApi::SceneImpl::NodeId character = Child(scene, root);
+            // Chains of eight, like limbs.
+            for(std::size_t i = 0; i < g_nodesPerCharacter / 8; ++i)
+            {
+                LuaApi::SceneImpl::NodeId parent = character;
+                for(std::size_t j = 0; j < 8; ++j)
+                {
+                    parent = Child(scene, parent);
+                    scene.SetTranslationXYZ(parent, 0.f, 0.1f, 0.f);
+                }
+            }
+        }
+        scene.Update();
+        return root;
+    }
+}
+
+void RegisterSceneBenchmarks()
+{
+    Registry& r = Registry::Instance();
+
+    auto scene = std::make_shared<LuaApi::Scene>();
+    auto root = std::make_shared<LuaApi::SceneImpl::NodeId>(0);
+    auto setup = [=]() {
+        scene->Init();
+        *root = BuildScene(**scene);
+        return true;
+    };
+    auto teardown = [=]() { scene->SoftRelease(); };
+
+    r.Add({ "scene/Update:root-moved", 2000, 20, 0, setup,
+            [=](std::uint64_t n) {
+                for(std::uint64_t i = 0; i < n; ++i)
+                {
+                    (*scene)->SetTranslationXYZ(*root, static_cast<float>(i & 15), 0.f, 0.f);
+                    (*scene)->Update();
+                }
+            },
+            teardown });
+    r.Add({ "scene/Update:one-moved", 200000, 20, 0, setup,
+            [=](std::uint64_t n) {
+                for(std::uint64_t i = 0; i < n; ++i)
+                {
+                    (*scene)->SetTranslationXYZ(static_cast<LuaApi::SceneImpl::NodeId>(*root + 100), static_cast<float>(i & 15), 0.f, 0.f);
+                    (*scene)->Update();
+                }
+            },
+            teardown });
+}
+
+}
@@ -0,0 +1,63 @@
+#include "benchmark.h"
+#include "../world/all.h"
+
+namespace Bench {
+
+namespace {
+    // A 200 x 200 field of small spheres, roughly one per unit square.
+    std::uint32_t const g_items = 40000;
+    float const g_extent = 200.f;
+
+    float Coordinate(std::uint32_t i) { return static_cast<float>(i % 200); }
+    float Row(std::uint32_t i) { return static_cast<float>(i / 200); }
+}
+
+void RegisterSpatialBenchmarks()
+{
+    Registry& r = Registry::Instance();
+
+    auto grid = std::make_shared<LuaApi::SpatialGrid>();
+    auto keys = std::make_shared<std::vector<LuaApi::SpatialGridImpl::Key>>();
+    auto setup = [=]() {
+        grid->Init();
+        for(std::uint32_t i = 0; i < g_items; ++i)
+            (*grid)->SetSphere(i + 1, Coordinate(i), 0.f, Row(i), 0.5f);
+        return true;
+    };
+    auto teardown = [=]() { grid->SoftRelease(); };
+
+    // Jitter that mostly stays within the item's cells.
+    r.Add({ "spatial/SetSphere:small-move", 2000000, 20, 0, setup,
+            [=](std::uint64_t n) {
+                for(std::uint64_t i = 0; i < n; ++i)
+                {
+                    std::uint32_t item = static_cast<std::uint32_t>(i % g_items);
+                    float jitter = static_cast<float>(i & 7) * 0.05f;
+                    (*grid)->SetSphere(item + 1, Coordinate(item) + jitter, 0.f, Row(item), 0.5f);
+                }
+            },
+            teardown });
+    r.Add({ "spatial/queryBox:16x16", 200000, 20, 0, setup,
+            [=](std::uint64_t n) {
+                for(std::uint64_t i = 0; i < n; ++i)
+                {
+                    float x = static_cast<float>(i % 184);
+                    keys->clear();
+                    (*grid)->queryBox(LuaApi::Aabb{glm::vec3(x, -1.f, x), glm::vec3(x + 16.f, 1.f, x + 16.f)}, *keys);
+                }
+            },
+            teardown });
+    r.Add({ "spatial/raycast:diagonal", 200000, 20, 0, setup,
+            [=](std::uint64_t n) {
+                std::vector<std::pair<float, LuaApi::SpatialGridImpl::Key>> hits;
+                glm::vec3 dir = glm::normalize(glm::vec3(1.f, 0.f, 1.f));
+                for(std::uint64_t i = 0; i < n; ++i)
+                {
+                    hits.clear();
+                    (*grid)->raycast(glm::vec3(static_cast<float>(i % 100), 0.f, 0.f), dir, g_extent, hits);
+                }
+            },
+            teardown });
+}
+
+}
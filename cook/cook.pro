@@ -0,0 +1,37 @@
+#-------------------------------------------------
+#
+# openrp-cook: offline asset cooker
+#
+# Usage: openrp-cook --gamemode <name>, or openrp-cook <data folder>.
+#
+#-------------------------------------------------
+
+QT       += core gui
+
+CONFIG   += console c++14
+CONFIG   -= app_bundle
+
+TARGET = openrp-cook
+TEMPLATE = app
+LIBS += -lopenal -lvorbisfile -lvorbisenc -lvorbis -logg -lassimp
+INCLUDEPATH += ..
+
+SOURCES += main.cpp \
+    cooker.cpp \
+    ../gl/modelfile.cpp \
+    ../gl/texturefile.cpp \
+    ../al/context.cpp \
+    ../al/device.cpp \
+    ../al/emitter.cpp \
+    ../al/loader.cpp \
+    ../core/jobs.cpp \
+    ../core/manifest.cpp \
+    ../core/vfs.cpp \
+    ../world/simd.cpp \
+    ../world/vector.cpp \
+    ../world/quat.cpp \
+    ../world/matrix.cpp
+
+HEADERS += cooker.h
+
+include(../../../Repository/LuaPP/qt_luapp.pri)
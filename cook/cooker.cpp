@@ -0,0 +1,274 @@
+#include "cooker.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QImage>
+#include <QImageReader>
+#include <QSaveFile>
+#include <QSet>
+#include <cstdio>
+#include <unordered_map>
+#include <unordered_set>
+#include <assimp/Importer.hpp>
+#include "core/jobs.h"
+#include "core/vfs.h"
+#include "gl/modelfile.h"
+#include "gl/texturefile.h"
+#include "al/loader.h"
+
+namespace Cook {
+
+using LuaApi::AssetManifest;
+
+Cooker::Cooker(std::string const& dataPath, Options const& options) :
+    m_dataPath(dataPath),
+    m_options(options)
+{
+}
+
+char const* Cooker::Extension(AssetManifest::Kind kind)
+{
+    switch(kind)
+    {
+    case AssetManifest::MODEL:
+        return ".orpm";
+    case AssetManifest::TEXTURE:
+        return ".orpt";
+    case AssetManifest::SOUND:
+    default:
+        return ".orps";
+    }
+}
+
+void Cooker::collect()
+{
+    m_jobs.clear();
+    QSet<QString> imageFormats;
+    for(QByteArray const& format : QImageReader::supportedImageFormats())
+        imageFormats.insert(QString::fromLatin1(format).toLower());
+    Assimp::Importer importer;
+
+    QString const root = QString::fromStdString(m_manifest.root());
+    QString const cooked = QString::fromStdString(m_manifest.folder());
+    QDirIterator it(root, QDir::Files, QDirIterator::Subdirectories);
+    while(it.hasNext())
+    {
+        QString const path = it.next();
+        if(path.startsWith(cooked))
+            continue;
+        QString const suffix = QFileInfo(path).suffix().toLower();
+        Job job;
+        if(suffix == "ogg")
+            job.Kind = AssetManifest::SOUND;
+        else if(imageFormats.contains(suffix))
+            job.Kind = AssetManifest::TEXTURE;
+        else if(!suffix.isEmpty() && importer.IsExtensionSupported(("." + suffix).toStdString()))
+            job.Kind = AssetManifest::MODEL;
+        else
+            continue;
+        job.Absolute = path.toStdString();
+        job.Relative = m_manifest.relative(job.Absolute);
+        job.State = Job::PENDING;
+        m_jobs.push_back(std::move(job));
+    }
+}
+
+bool Cooker::cook(Job& job) const
+{
+    std::string const output = m_manifest.folder() + job.Output;
+    switch(job.Kind)
+    {
+    case AssetManifest::MODEL:
+    {
+        LuaApi::ModelFile file;
+        return file.import(job.Absolute) && file.write(output);
+    }
+    case AssetManifest::TEXTURE:
+    {
+        LuaApi::TextureFile file;
+        return file.cook(QImage(QString::fromStdString(job.Absolute)), m_options.Compress) && file.write(output);
+    }
+    case AssetManifest::SOUND:
+    {
+        QFile source(QString::fromStdString(job.Absolute));
+        int channels = 0;
+        std::uint32_t rate = 0;
+        std::vector<unsigned char> pcm;
+        if(!source.open(QFile::ReadOnly) ||
+                !LuaApi::SoundLoader::OggLoader::DecodeOGG(source, m_options.MaxSoundBytes, channels, rate, pcm))
+        {
+            // Too long, most likely; it keeps streaming from the source.
+            job.State = Job::UNCOOKED;
+            return false;
+        }
+        QSaveFile f(QString::fromStdString(output));
+        return f.open(QFile::WriteOnly) &&
+                LuaApi::SoundLoader::PcmLoader::WritePCM(f, channels, 2, rate, pcm) && f.commit();
+    }
+    default:
+        return false;
+    }
+}
+
+std::size_t Cooker::prune()
+{
+    // Entries whose source is gone, or that this cook couldn't make
+    std::unordered_set<std::string> sources;
+    for(Job const& job : m_jobs)
+    {
+        if(job.State == Job::COOKED || job.State == Job::UP_TO_DATE)
+            sources.insert(job.Relative);
+    }
+    std::vector<std::string> stale;
+    for(auto const& it : m_manifest.entries())
+    {
+        if(!sources.count(it.first))
+            stale.push_back(it.first);
+    }
+    for(std::string const& source : stale)
+        m_manifest.erase(source);
+
+    // Outputs no entry refers to
+    std::unordered_set<std::string> outputs;
+    for(auto const& it : m_manifest.entries())
+        outputs.insert(it.second.m_output);
+    std::size_t removed = 0;
+    QDir folder(QString::fromStdString(m_manifest.folder()));
+    for(QString const& name : folder.entryList(QDir::Files))
+    {
+        if(name == AssetManifest::FILE_NAME || outputs.count(name.toStdString()))
+            continue;
+        if(folder.remove(name))
+            ++removed;
+    }
+    return removed;
+}
+
+bool Cooker::run(Summary& summary)
+{
+    summary = Summary();
+    m_manifest.read(m_dataPath);
+    if(!QFileInfo(QString::fromStdString(m_manifest.root())).isDir())
+    {
+        std::fprintf(stderr, "%s is not a directory\n", m_manifest.root().c_str());
+        return false;
+    }
+    if(!QDir().mkpath(QString::fromStdString(m_manifest.folder())))
+    {
+        std::fprintf(stderr, "Unable to create %s\n", m_manifest.folder().c_str());
+        return false;
+    }
+    collect();
+
+    // Hashing reads every source, so it runs on all cores too.
+    LuaApi::ParallelFor(m_jobs.size(), 1, [this](std::size_t begin, std::size_t end) {
+        for(std::size_t i = begin; i < end; ++i)
+        {
+            Job& job = m_jobs[i];
+            QFileInfo const info(QString::fromStdString(job.Absolute));
+            job.Size = info.size();
+            job.Modified = info.lastModified().toMSecsSinceEpoch();
+            job.Hash = AssetManifest::HashFile(job.Absolute);
+            job.Output = job.Hash + Extension(job.Kind);
+        }
+    });
+
+    // Unchanged sources keep their output; the rest are cooked once per
+    // distinct output.
+    std::unordered_map<std::string, std::size_t> owners;
+    std::vector<std::size_t> pending;
+    for(std::size_t i = 0; i < m_jobs.size(); ++i)
+    {
+        Job& job = m_jobs[i];
+        job.Owner = i;
+        if(job.Hash.empty())
+        {
+            job.State = Job::FAILED;
+            continue;
+        }
+        AssetManifest::Entry const* entry = m_manifest.find(job.Relative);
+        bool const exists = QFileInfo::exists(QString::fromStdString(m_manifest.folder() + job.Output));
+        if(!m_options.Force && entry && entry->m_kind == job.Kind && entry->m_hash == job.Hash && exists)
+        {
+            job.State = Job::UP_TO_DATE;
+            continue;
+        }
+        auto owner = owners.emplace(job.Output, i);
+        if(owner.second)
+            pending.push_back(i);
+        else
+            job.Owner = owner.first->second;
+    }
+
+    LuaApi::ParallelFor(pending.size(), 1, [this, &pending](std::size_t begin, std::size_t end) {
+        for(std::size_t i = begin; i < end; ++i)
+        {
+            Job& job = m_jobs[pending[i]];
+            if(cook(job))
+                job.State = Job::COOKED;
+            else if(job.State != Job::UNCOOKED)
+                job.State = Job::FAILED;
+        }
+    });
+
+    for(Job& job : m_jobs)
+    {
+        if(job.State == Job::PENDING)
+            job.State = m_jobs[job.Owner].State;
+        switch(job.State)
+        {
+        case Job::UP_TO_DATE:
+            ++summary.UpToDate;
+            break;
+        case Job::COOKED:
+            ++summary.Cooked;
+            if(m_options.Verbose)
+                std::printf("cooked %s -> %s\n", job.Relative.c_str(), job.Output.c_str());
+            break;
+        case Job::UNCOOKED:
+            ++summary.Uncooked;
+            if(m_options.Verbose)
+                std::printf("left %s as it is\n", job.Relative.c_str());
+            break;
+        default:
+            ++summary.Failed;
+            std::fprintf(stderr, "Unable to cook %s\n", job.Relative.c_str());
+            break;
+        }
+        if(job.State == Job::COOKED || job.State == Job::UP_TO_DATE)
+            m_manifest.set({ job.Relative, job.Kind, job.Output, job.Hash, job.Size, job.Modified });
+    }
+
+    summary.Pruned = prune();
+    if(!m_manifest.write())
+    {
+        std::fprintf(stderr, "Unable to write %s%s\n", m_manifest.folder().c_str(), AssetManifest::FILE_NAME);
+        return false;
+    }
+    return summary.Failed == 0;
+}
+
+bool Cooker::Pack(std::string const& folder, std::string const& archive, bool compress)
+{
+    QDir const root(QString::fromStdString(folder));
+    QString const suffix = QString(".") + LuaApi::Vfs::EXTENSION;
+    QString const output = QFileInfo(QString::fromStdString(archive)).absoluteFilePath();
+    std::vector<std::string> files;
+    QDirIterator it(root.absolutePath(), QDir::Files, QDirIterator::Subdirectories);
+    while(it.hasNext())
+    {
+        QString const path = it.next();
+        if(path.endsWith(suffix, Qt::CaseInsensitive) || path == output)
+            continue;
+        files.push_back(root.relativeFilePath(path).toStdString());
+    }
+    if(!LuaApi::PakArchive::Write(archive, root.absolutePath().toStdString(), files, compress))
+    {
+        std::fprintf(stderr, "Unable to write %s\n", archive.c_str());
+        return false;
+    }
+    std::printf("%zu files packed into %s\n", files.size(), archive.c_str());
+    return true;
+}
+
+}
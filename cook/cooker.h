@@ -0,0 +1,63 @@
+#ifndef OPENRP_COOK_COOKER_H
+#define OPENRP_COOK_COOKER_H
+#include <string>
+#include <vector>
+#include "core/manifest.h"
+
+namespace Cook {
+    struct Options {
+        // Cook everything again, even sources whose hash is unchanged.
+        bool Force = false;
+        // BC1/BC3 textures; RGBA8 otherwise.
+        bool Compress = true;
+        // Longer sounds keep decoding from their source at runtime.
+        std::size_t MaxSoundBytes = 4 * 1024 * 1024;
+        bool Verbose = false;
+    };
+
+    struct Summary {
+        std::size_t Cooked = 0;
+        std::size_t UpToDate = 0;
+        std::size_t Uncooked = 0;
+        std::size_t Failed = 0;
+        std::size_t Pruned = 0;
+    };
+
+    // Cooks one data folder into its .cooked folder. Sources are keyed by
+    // content hash: one whose hash matches its manifest entry is only
+    // restamped, and outputs are named after the hash, so identical files
+    // share them. Entries and outputs nothing refers to any more are
+    // removed before the manifest is written.
+    class Cooker {
+        struct Job {
+            std::string Relative;
+            std::string Absolute;
+            LuaApi::AssetManifest::Kind Kind;
+            std::string Hash;
+            std::int64_t Size;
+            std::int64_t Modified;
+            std::string Output;
+            enum { PENDING, UP_TO_DATE, COOKED, UNCOOKED, FAILED } State;
+            // Job that cooks the shared output, if not this one.
+            std::size_t Owner;
+        };
+        std::string m_dataPath;
+        Options m_options;
+        LuaApi::AssetManifest m_manifest;
+        std::vector<Job> m_jobs;
+
+        void collect();
+        bool cook(Job&) const;
+        std::size_t prune();
+    public:
+        Cooker(std::string const& dataPath, Options const&);
+
+        bool run(Summary&);
+        static char const* Extension(LuaApi::AssetManifest::Kind);
+        // Everything under folder but other archives, cooked files
+        // included, into one pak the runtime mounts at folder.
+        static bool Pack(std::string const& folder, std::string const& archive, bool compress);
+    };
+}
+
+#endif
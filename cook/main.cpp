@@ -0,0 +1,67 @@
+#include "cooker.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <cstdio>
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Cooks a gamemode's data folder into the formats the runtime loads fastest.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("data", "Data folder to cook; see --gamemode.", "[data]");
+    parser.addOptions({
+        { "gamemode", "Cook gamemode/<name>/data/ under the current directory.", "name" },
+        { "force", "Cook every source, even unchanged ones." },
+        { "jobs", "Use <count> threads instead of one per core.", "count" },
+        { "max-sound-seconds", "Leave stereo sounds longer than <seconds> to stream from their source.", "seconds", "30" },
+        { "uncompressed", "Keep textures as RGBA8 instead of BC1/BC3." },
+        { "pak", "Then pack the gamemode folder, cooked files included, into <file>.", "file" },
+        { "pak-compress", "Deflate the pak's entries where it pays off." },
+        { "verbose", "List every file cooked." }
+    });
+    parser.process(app);
+
+    QString data;
+    if(parser.isSet("gamemode"))
+        data = QDir::currentPath() + "/gamemode/" + parser.value("gamemode") + "/data/";
+    else if(!parser.positionalArguments().isEmpty())
+        data = parser.positionalArguments().front();
+    else
+        parser.showHelp(1);
+
+    if(parser.isSet("jobs"))
+    {
+        int const jobs = parser.value("jobs").toInt();
+        if(jobs < 1)
+        {
+            std::fprintf(stderr, "--jobs needs a positive count\n");
+            return 1;
+        }
+        QThreadPool::globalInstance()->setMaxThreadCount(jobs);
+    }
+
+    Cook::Options options;
+    options.Force = parser.isSet("force");
+    options.Compress = !parser.isSet("uncompressed");
+    options.Verbose = parser.isSet("verbose");
+    // 16 bit stereo at 44.1 kHz
+    options.MaxSoundBytes = static_cast<std::size_t>(parser.value("max-sound-seconds").toDouble() * 44100 * 2 * 2);
+
+    QElapsedTimer timer;
+    timer.start();
+    Cook::Summary summary;
+    bool good = Cook::Cooker(data.toStdString(), options).run(summary);
+    std::printf("%zu cooked, %zu up to date, %zu left as source, %zu failed, %zu stale outputs removed in %.2fs\n",
+                summary.Cooked, summary.UpToDate, summary.Uncooked, summary.Failed, summary.Pruned,
+                timer.elapsed() / 1000.);
+    // The data folder sits in the gamemode's, which GameHost mounts paks at.
+    if(good && parser.isSet("pak"))
+        good = Cook::Cooker::Pack(QDir::cleanPath(data + "/..").toStdString(), parser.value("pak").toStdString(),
+                                  parser.isSet("pak-compress"));
+    return good ? 0 : 1;
+}
@@ -0,0 +1,13 @@
+#ifndef LUACORE_ALL_H
+#define LUACORE_ALL_H
+#include "shared.h"
+#include "scheduler.h"
+#include "framepacer.h"
+#include "luaheap.h"
+#include "gcpacer.h"
+#include "binding.h"
+#include "jobs.h"
+#include "manifest.h"
+#include "vfs.h"
+
+#endif
@@ -0,0 +1,362 @@
+#ifndef LUACORE_BINDING_H
+#define LUACORE_BINDING_H
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+#include "shared.h"
+
+namespace LuaApi {
+    // Direct method dispatch for RefCounted objects.
+    // The generic path goes Lua -> LuaPP functor -> RefCounted lambda ->
+    // member functor, and builds every table from a std::map. Methods listed
+    // in a descriptor's direct() instead become plain C closures that check
+    // the userdata, unwrap the handle and call the member through the
+    // pointer kept in their upvalue. Arguments are limited to numbers, bool,
+    // std::string and RefCounted handles; results to those (minus handles)
+    // and FixedReturn. Everything else stays on the generic path.
+    namespace binding {
+        template <typename A, typename = void>
+        struct Arg;
+
+        template <typename A>
+        struct Arg<A, typename std::enable_if<std::is_floating_point<A>::value>::type> {
+            static void Check(lua_State* s, int i) { luaL_checknumber(s, i); }
+            static A Get(lua_State* s, int i) { return static_cast<A>(lua_tonumber(s, i)); }
+        };
+
+        // Whether the number at i, truncated, is a value of A. Casting one
+        // that isn't (negative to unsigned, NaN, too large) is undefined.
+        template <typename A>
+        bool Fits(lua_State* s, int i) {
+            typedef std::numeric_limits<A> limits;
+            if(lua_isinteger(s, i))
+            {
+                lua_Integer v = lua_tointeger(s, i);
+                if(v < 0)
+                    return limits::is_signed && v >= static_cast<lua_Integer>(limits::min());
+                return static_cast<std::uint64_t>(v) <= static_cast<std::uint64_t>(limits::max());
+            }
+            lua_Number v = std::trunc(lua_tonumber(s, i));
+            lua_Number bound = std::ldexp(lua_Number(1), limits::digits);
+            return v < bound && v >= (limits::is_signed ? -bound : lua_Number(0));
+        }
+
+        template <typename A>
+        struct Arg<A, typename std::enable_if<std::is_integral<A>::value && !std::is_same<A, bool>::value>::type> {
+            static void Check(lua_State* s, int i) {
+                luaL_checknumber(s, i);
+                luaL_argcheck(s, Fits<A>(s, i), i, "number out of range");
+            }
+            static A Get(lua_State* s, int i) {
+                if(lua_isinteger(s, i))
+                    return static_cast<A>(lua_tointeger(s, i));
+                return static_cast<A>(lua_tonumber(s, i));
+            }
+        };
+
+        template <>
+        struct Arg<bool> {
+            static void Check(lua_State*, int) {}
+            static bool Get(lua_State* s, int i) { return lua_toboolean(s, i) != 0; }
+        };
+
+        template <>
+        struct Arg<std::string> {
+            static void Check(lua_State* s, int i) { luaL_checkstring(s, i); }
+            static std::string Get(lua_State* s, int i) {
+                std::size_t len = 0;
+                char const* str = lua_tolstring(s, i, &len);
+                return std::string(str, len);
+            }
+        };
+
+        // nil clears the handle.
+        template <typename U>
+        struct Arg<RefCounted<U>> {
+            static void Check(lua_State* s, int i) {
+                if(!lua_isnoneornil(s, i))
+                    luaL_checkudata(s, i, MetatableDescriptor<RefCounted<U>>::name());
+            }
+            static RefCounted<U> Get(lua_State* s, int i) {
+                if(lua_isnoneornil(s, i))
+                    return RefCounted<U>();
+                return *static_cast<RefCounted<U>*>(lua_touserdata(s, i));
+            }
+        };
+
+        inline int Push(lua_State* s, bool v) { lua_pushboolean(s, v ? 1 : 0); return 1; }
+        inline int Push(lua_State* s, std::string const& v) { lua_pushlstring(s, v.data(), v.size()); return 1; }
+        template <typename V>
+        typename std::enable_if<std::is_floating_point<V>::value, int>::type Push(lua_State* s, V v) { lua_pushnumber(s, static_cast<lua_Number>(v)); return 1; }
+        template <typename V>
+        typename std::enable_if<std::is_integral<V>::value && !std::is_same<V, bool>::value, int>::type Push(lua_State* s, V v) { lua_pushinteger(s, static_cast<lua_Integer>(v)); return 1; }
+        template <typename V, std::size_t N>
+        int Push(lua_State* s, FixedReturn<V, N> const& v) { return v.Push(s); }
+
+        template <typename R>
+        struct Result {
+            template <typename F>
+            static int Call(lua_State* s, F const& fnc) { return Push(s, fnc()); }
+        };
+        template <>
+        struct Result<void> {
+            template <typename F>
+            static int Call(lua_State*, F const& fnc) { fnc(); return 0; }
+        };
+
+        template <typename ... A>
+        struct CheckAll;
+        template <>
+        struct CheckAll<> {
+            static void Run(lua_State*, int) {}
+        };
+        template <typename A, typename ... Rest>
+        struct CheckAll<A, Rest...> {
+            static void Run(lua_State* s, int i) {
+                Arg<typename std::decay<A>::type>::Check(s, i);
+                CheckAll<Rest...>::Run(s, i + 1);
+            }
+        };
+
+        template <typename T, typename M, typename ... A>
+        struct FixedGetter {
+            template <std::size_t ... I>
+            static int Call(lua_State* s, T const& self, M fnc, std::index_sequence<I...>) {
+                CheckAll<A...>::Run(s, 2);
+                return (self.*fnc)(Arg<typename std::decay<A>::type>::Get(s, static_cast<int>(I) + 2)...).Push(s);
+            }
+        };
+
+        template <typename T, typename M, typename R, typename ... A>
+        struct Method {
+            template <std::size_t ... I>
+            static int invoke(lua_State* s, T& self, M fnc, std::index_sequence<I...>) {
+                return Result<R>::Call(s, [&]() -> R {
+                    return (self.*fnc)(Arg<typename std::decay<A>::type>::Get(s, static_cast<int>(I) + 2)...);
+                });
+            }
+
+            // Exceptions are turned into a message on the stack, so that no
+            // C++ object is alive when lua_error unwinds.
+            static int protectedCall(lua_State* s, T& self, M fnc) {
+                try {
+                    return invoke(s, self, fnc, std::index_sequence_for<A...>());
+                } catch(std::exception& e) {
+                    lua_pushstring(s, e.what());
+                }
+                return -1;
+            }
+
+            static int Call(lua_State* s) {
+                RefCounted<T>* handle = static_cast<RefCounted<T>*>(luaL_checkudata(s, 1, MetatableDescriptor<RefCounted<T>>::name()));
+                T* self = handle->TryGet();
+                if(!self)
+                    return luaL_error(s, "Usage of invalid entity: %s", MetatableDescriptor<T>::name());
+                CheckAll<A...>::Run(s, 2);
+
+                M fnc;
+                std::memcpy(&fnc, lua_touserdata(s, lua_upvalueindex(1)), sizeof(M));
+                int n = protectedCall(s, *self, fnc);
+                if(n < 0)
+                    return lua_error(s);
+                return n;
+            }
+        };
+
+        // A method that reads its own arguments from index 2 on. It returns
+        // the number of results, or -1 with an error message on top of the
+        // stack; raising the error is left to Call, after the method's
+        // locals are gone.
+        template <typename T>
+        struct RawMethod {
+            typedef int (T::*M)(lua_State*);
+
+            static int protectedCall(lua_State* s, T& self, M fnc) {
+                try {
+                    return (self.*fnc)(s);
+                } catch(std::exception& e) {
+                    lua_pushstring(s, e.what());
+                }
+                return -1;
+            }
+
+            static int Call(lua_State* s) {
+                RefCounted<T>* handle = static_cast<RefCounted<T>*>(luaL_checkudata(s, 1, MetatableDescriptor<RefCounted<T>>::name()));
+                T* self = handle->TryGet();
+                if(!self)
+                    return luaL_error(s, "Usage of invalid entity: %s", MetatableDescriptor<T>::name());
+
+                M fnc;
+                std::memcpy(&fnc, lua_touserdata(s, lua_upvalueindex(1)), sizeof(M));
+                int n = protectedCall(s, *self, fnc);
+                if(n < 0)
+                    return lua_error(s);
+                return n;
+            }
+        };
+    }
+
+    template <typename T>
+    class DirectMethods {
+        enum { MAX_MEMBER_SIZE = 32 };
+        struct Entry {
+            char const* m_name;
+            lua_CFunction m_call;
+            unsigned char m_member[MAX_MEMBER_SIZE];
+            std::size_t m_size;
+        };
+        std::vector<Entry> m_entries;
+
+        template <typename M>
+        void add(char const* name, lua_CFunction call, M fnc) {
+            static_assert(sizeof(M) <= MAX_MEMBER_SIZE, "Member function pointer too large");
+            Entry e;
+            e.m_name = name;
+            e.m_call = call;
+            std::memcpy(e.m_member, &fnc, sizeof(M));
+            e.m_size = sizeof(M);
+            m_entries.push_back(e);
+        }
+
+        // Looks methods up in the direct table before falling back to the
+        // original __index function. Upvalues: table, original __index.
+        static int index(lua_State* s) {
+            lua_pushvalue(s, 2);
+            if(lua_rawget(s, lua_upvalueindex(1)) != LUA_TNIL)
+                return 1;
+            lua_pop(s, 1);
+            lua_pushvalue(s, lua_upvalueindex(2));
+            lua_pushvalue(s, 1);
+            lua_pushvalue(s, 2);
+            lua_call(s, 2, 1);
+            return 1;
+        }
+
+        void fill(lua_State* s, int table) const {
+            for(auto it = m_entries.begin(); it != m_entries.end(); ++it)
+            {
+                std::memcpy(lua_newuserdata(s, it->m_size), it->m_member, it->m_size);
+                lua_pushcclosure(s, it->m_call, 1);
+                lua_setfield(s, table, it->m_name);
+            }
+        }
+    public:
+        template <typename R, typename ... A>
+        void Add(char const* name, R (T::*fnc)(A...)) {
+            add(name, &binding::Method<T, R (T::*)(A...), R, A...>::Call, fnc);
+        }
+        template <typename R, typename ... A>
+        void Add(char const* name, R (T::*fnc)(A...) const) {
+            add(name, &binding::Method<T, R (T::*)(A...) const, R, A...>::Call, fnc);
+        }
+        void AddRaw(char const* name, int (T::*fnc)(lua_State*)) {
+            add(name, &binding::RawMethod<T>::Call, fnc);
+        }
+
+        // Called through pcall with the DirectMethods as light userdata, once
+        // LuaPP has built the metatable.
+        static int Install(lua_State* s) {
+            DirectMethods const* self = static_cast<DirectMethods const*>(lua_touserdata(s, 1));
+            char const* name = MetatableDescriptor<RefCounted<T>>::name();
+            if(luaL_getmetatable(s, name) != LUA_TTABLE)
+                return luaL_error(s, "Metatable %s is not registered", name);
+            int mt = lua_gettop(s);
+
+            // A table __index is used as is, so lookups stay inside the VM.
+            int type = lua_getfield(s, mt, "__index");
+            if(type == LUA_TTABLE)
+            {
+                self->fill(s, lua_gettop(s));
+                return 0;
+            }
+            int original = lua_gettop(s);
+            if(type == LUA_TNIL)
+            {
+                lua_createtable(s, 0, static_cast<int>(self->m_entries.size()));
+                self->fill(s, lua_gettop(s));
+                lua_setfield(s, mt, "__index");
+                return 0;
+            }
+            lua_createtable(s, 0, static_cast<int>(self->m_entries.size()));
+            self->fill(s, lua_gettop(s));
+            lua_pushvalue(s, original);
+            lua_pushcclosure(s, &DirectMethods::index, 2);
+            lua_setfield(s, mt, "__index");
+            return 0;
+        }
+    };
+
+    namespace binding {
+        template <typename X, typename = void>
+        struct Installer {
+            static void Run(Lua::State&) {}
+        };
+
+        template <typename T>
+        struct Installer<RefCounted<T>, decltype(MetatableDescriptor<T>::direct(std::declval<DirectMethods<T>&>()))> {
+            static void Run(Lua::State& state) {
+                DirectMethods<T> methods;
+                MetatableDescriptor<T>::direct(methods);
+                state.pushcfunction(&DirectMethods<T>::Install);
+                state.pushlightuserdata(&methods);
+                if(state.pcall(1) != 0)
+                {
+                    std::string error = state.tostdstring(-1);
+                    state.pop(1);
+                    throw std::runtime_error(error);
+                }
+            }
+        };
+    }
+
+    // PushFixed for const getters taking arguments, which are read like a
+    // direct method's.
+    template <typename T, typename V, std::size_t N, typename A, typename ... Rest>
+    Lua::ClassMemberFunctor<T> PushFixed(FixedReturn<V, N> (T::*fnc)(A, Rest...) const) {
+        typedef FixedReturn<V, N> (T::*M)(A, Rest...) const;
+        return Lua::ToFnc([fnc](T& obj, lua_State* state) -> int {
+            return binding::FixedGetter<T, M, A, Rest...>::Call(state, obj, fnc, std::index_sequence_for<A, Rest...>());
+        });
+    }
+
+    // For raw methods returning lists: fills the table at reuse, or a new
+    // one if that isn't a table, with values as a sequence and clears any
+    // entries past count. Leaves the table and count on the stack.
+    inline int PushSequence(lua_State* s, int reuse, std::uint32_t const* values, std::size_t count) {
+        if(lua_type(s, reuse) == LUA_TTABLE)
+        {
+            lua_pushvalue(s, reuse);
+            for(lua_Integer i = static_cast<lua_Integer>(count) + 1; ; ++i)
+            {
+                bool empty = lua_rawgeti(s, -1, i) == LUA_TNIL;
+                lua_pop(s, 1);
+                if(empty)
+                    break;
+                lua_pushnil(s);
+                lua_rawseti(s, -2, i);
+            }
+        }
+        else
+            lua_createtable(s, static_cast<int>(count), 0);
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            lua_pushinteger(s, static_cast<lua_Integer>(values[i]));
+            lua_rawseti(s, -2, static_cast<lua_Integer>(i + 1));
+        }
+        lua_pushinteger(s, static_cast<lua_Integer>(count));
+        return 2;
+    }
+
+    // luapp_register_object, plus the direct methods of descriptors that
+    // declare a static direct(DirectMethods<T>&).
+    template <typename X>
+    void RegisterObject(Lua::State& state) {
+        state.luapp_register_object<X>();
+        binding::Installer<X>::Run(state);
+    }
+}
+
+#endif
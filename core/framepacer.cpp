@@ -0,0 +1,134 @@
+#include "framepacer.h"
+#include <thread>
+
+namespace LuaApi {
+
+static double const g_frameSmoothing = 0.05;
+
+int FramePacer::s_swapInterval = 1;
+
+FramePacer::FramePacer()
+    : m_cap(0.f),
+      m_backgroundCap(FramePacer::DEFAULT_BACKGROUND_RATE),
+      m_hiddenTickRate(FramePacer::DEFAULT_HIDDEN_TICK_RATE),
+      m_focused(true),
+      m_visible(true),
+      m_lowLatency(false),
+      m_spinMargin(std::chrono::microseconds(FramePacer::DEFAULT_SPIN_MARGIN_US)),
+      m_frameStart(FramePacer::clock::now()),
+      m_deadline(m_frameStart),
+      m_lastFrame(0.0),
+      m_avgFrame(0.0),
+      m_frames(0)
+{
+}
+
+void FramePacer::SetSwapInterval(int i) { s_swapInterval = (i > 0) ? i : 0; }
+int FramePacer::SwapInterval() { return s_swapInterval; }
+
+void FramePacer::SetCap(float fps) { m_cap = (fps > 0.f) ? fps : 0.f; }
+float FramePacer::Cap() const { return m_cap; }
+void FramePacer::SetBackgroundCap(float fps) { m_backgroundCap = (fps > 0.f) ? fps : 0.f; }
+float FramePacer::BackgroundCap() const { return m_backgroundCap; }
+void FramePacer::SetHiddenTickRate(float hz) { m_hiddenTickRate = (hz > 0.f) ? hz : 0.f; }
+float FramePacer::HiddenTickRate() const { return m_hiddenTickRate; }
+void FramePacer::SetLowLatency(bool l) { m_lowLatency = l; }
+bool FramePacer::LowLatency() const { return m_lowLatency; }
+void FramePacer::SetSpinMargin(float ms)
+{
+    if(ms < 0.f)
+        ms = 0.f;
+    m_spinMargin = std::chrono::duration_cast<clock::duration>(std::chrono::duration<float, std::milli>(ms));
+}
+
+void FramePacer::SetFocused(bool f) { m_focused = f; }
+void FramePacer::SetVisible(bool v) { m_visible = v; }
+bool FramePacer::Visible() const { return m_visible; }
+bool FramePacer::Throttled() const { return !m_focused || !m_visible; }
+
+float FramePacer::EffectiveCap() const
+{
+    if(m_focused || m_backgroundCap <= 0.f)
+        return m_cap;
+    if(m_cap <= 0.f)
+        return m_backgroundCap;
+    return (m_cap < m_backgroundCap) ? m_cap : m_backgroundCap;
+}
+
+void FramePacer::BeginFrame()
+{
+    clock::time_point now = FramePacer::clock::now();
+    double dt = std::chrono::duration<double, std::milli>(now - m_frameStart).count();
+    if(m_frames > 0)
+    {
+        m_lastFrame = dt;
+        m_avgFrame = (m_frames == 1) ? dt : (m_avgFrame + (dt - m_avgFrame) * g_frameSmoothing);
+    }
+    ++m_frames;
+    
+    // Deadlines advance from the previous deadline, not from "now", so a
+    // late frame doesn't push every following frame late as well.
+    float cap = EffectiveCap();
+    if(cap > 0.f)
+    {
+        clock::duration period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / cap));
+        m_deadline += period;
+        if(m_deadline < now)
+            m_deadline = now + period;
+    }
+    else
+        m_deadline = now;
+    m_frameStart = now;
+}
+
+double FramePacer::FrameBudget() const
+{
+    float cap = EffectiveCap();
+    if(cap > 0.f)
+        return 1.0 / cap;
+    return 0.0;
+}
+
+double FramePacer::FrameElapsed() const
+{
+    return std::chrono::duration<double>(FramePacer::clock::now() - m_frameStart).count();
+}
+
+int FramePacer::SleepMilliseconds() const
+{
+    clock::duration remaining = m_deadline - FramePacer::clock::now() - m_spinMargin;
+    if(remaining <= clock::duration::zero())
+        return 0;
+    return static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(remaining).count());
+}
+
+void FramePacer::SpinUntilDeadline() const
+{
+    while(FramePacer::clock::now() < m_deadline)
+        std::this_thread::yield();
+}
+
+void FramePacer::WaitForDeadline() const
+{
+    clock::duration remaining = m_deadline - FramePacer::clock::now() - m_spinMargin;
+    if(remaining > clock::duration::zero())
+        std::this_thread::sleep_for(remaining);
+    SpinUntilDeadline();
+}
+
+int FramePacer::HiddenTickMilliseconds() const
+{
+    if(m_hiddenTickRate <= 0.f)
+        return 0;
+    return static_cast<int>(1000.f / m_hiddenTickRate);
+}
+
+float FramePacer::LastFrameTime() const { return static_cast<float>(m_lastFrame); }
+float FramePacer::AverageFrameTime() const { return static_cast<float>(m_avgFrame); }
+
+Lua::ReturnValues FramePacer::LuaStats() const
+{
+    return Lua::Return(LastFrameTime(), AverageFrameTime(), EffectiveCap(), Throttled());
+}
+
+}
@@ -0,0 +1,70 @@
+#ifndef LUACORE_FRAMEPACER_H
+#define LUACORE_FRAMEPACER_H
+#include "shared.h"
+
+namespace LuaApi {
+    // Decides when the next frame may start.
+    // Coarse waiting is left to the caller (a timer, so the event loop keeps
+    // running); the last SpinMargin() of every wait is spent spinning here,
+    // since sleeping is too imprecise to hit a deadline on its own.
+    class FramePacer {
+    public:
+        typedef std::chrono::steady_clock clock;
+        enum {
+            DEFAULT_BACKGROUND_RATE = 15,
+            DEFAULT_HIDDEN_TICK_RATE = 4,
+            DEFAULT_SPIN_MARGIN_US = 1500
+        };
+    private:
+        static int s_swapInterval;
+        
+        float m_cap;
+        float m_backgroundCap;
+        float m_hiddenTickRate;
+        bool m_focused;
+        bool m_visible;
+        bool m_lowLatency;
+        clock::duration m_spinMargin;
+        clock::time_point m_frameStart;
+        clock::time_point m_deadline;
+        
+        double m_lastFrame;
+        double m_avgFrame;
+        std::uint64_t m_frames;
+    public:
+        FramePacer();
+        
+        static void SetSwapInterval(int);
+        static int SwapInterval();
+        
+        void SetCap(float);
+        float Cap() const;
+        void SetBackgroundCap(float);
+        float BackgroundCap() const;
+        void SetHiddenTickRate(float);
+        float HiddenTickRate() const;
+        void SetLowLatency(bool);
+        bool LowLatency() const;
+        void SetSpinMargin(float);
+        
+        void SetFocused(bool);
+        void SetVisible(bool);
+        bool Visible() const;
+        bool Throttled() const;
+        float EffectiveCap() const;
+        
+        void BeginFrame();
+        double FrameBudget() const;
+        double FrameElapsed() const;
+        int SleepMilliseconds() const;
+        void SpinUntilDeadline() const;
+        void WaitForDeadline() const;
+        int HiddenTickMilliseconds() const;
+        
+        float LastFrameTime() const;
+        float AverageFrameTime() const;
+        Lua::ReturnValues LuaStats() const;
+    };
+}
+
+#endif
@@ -0,0 +1,120 @@
+#include "gcpacer.h"
+
+namespace LuaApi {
+
+static double const g_costSmoothing = 0.05;
+
+GcPacer::GcPacer() :
+    m_active(false),
+    m_minSlice(GcPacer::DEFAULT_MIN_SLICE_US * 1e-6),
+    m_maxSlice(GcPacer::DEFAULT_MAX_SLICE_US * 1e-6),
+    m_ceiling(static_cast<std::size_t>(GcPacer::DEFAULT_CEILING_MB) * MEGABYTE),
+    m_cycleLive(0)
+{
+    ResetStats();
+}
+
+void GcPacer::Start(Lua::State& state, LuaHeap const& heap)
+{
+    state.gc(LUA_GCSTOP, 0);
+    m_active = true;
+    m_cycleLive = heap.LiveBytes();
+}
+
+void GcPacer::Stop(Lua::State& state)
+{
+    if(!m_active)
+        return;
+    state.gc(LUA_GCRESTART, 0);
+    m_active = false;
+}
+
+bool GcPacer::Active() const { return m_active; }
+
+void GcPacer::SetSliceLimits(float minMs, float maxMs)
+{
+    if(minMs < 0.f)
+        minMs = 0.f;
+    if(maxMs < minMs)
+        maxMs = minMs;
+    m_minSlice = minMs * 1e-3;
+    m_maxSlice = maxMs * 1e-3;
+}
+
+float GcPacer::MinSlice() const { return static_cast<float>(m_minSlice * 1e3); }
+float GcPacer::MaxSlice() const { return static_cast<float>(m_maxSlice * 1e3); }
+void GcPacer::SetCeiling(std::size_t bytes) { m_ceiling = bytes; }
+std::size_t GcPacer::Ceiling() const { return m_ceiling; }
+
+void GcPacer::Step(Lua::State& state, LuaHeap const& heap, double budget, double elapsed)
+{
+    if(!m_active)
+        return;
+
+    clock::time_point start = GcPacer::clock::now();
+    if(m_ceiling > 0 && heap.LiveBytes() > m_ceiling)
+    {
+        state.gc(LUA_GCCOLLECT, 0);
+        ++m_fullCollects;
+        ++m_cycles;
+        m_cycleLive = heap.LiveBytes();
+    }
+    else
+    {
+        if(budget <= 0.0)
+            budget = 1.0 / GcPacer::FALLBACK_RATE;
+        double slice = budget - elapsed;
+        // Allocation is outrunning the collector; take the largest slice
+        // until a cycle completes.
+        if(heap.LiveBytes() > 2 * m_cycleLive)
+            slice = m_maxSlice;
+        if(slice < m_minSlice)
+            slice = m_minSlice;
+        if(slice > m_maxSlice)
+            slice = m_maxSlice;
+
+        clock::time_point end = start + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(slice));
+        do {
+            ++m_steps;
+            // A finished cycle ends the slice; starting the next one right
+            // away would only rescan what was just marked.
+            if(state.gc(LUA_GCSTEP, 0))
+            {
+                ++m_cycles;
+                m_cycleLive = heap.LiveBytes();
+                break;
+            }
+        } while(GcPacer::clock::now() < end);
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(GcPacer::clock::now() - start).count();
+    m_lastCost = ms;
+    m_avgCost = (m_frames == 0) ? ms : (m_avgCost + (ms - m_avgCost) * g_costSmoothing);
+    if(ms > m_maxCost)
+        m_maxCost = ms;
+    ++m_frames;
+}
+
+void GcPacer::ResetStats()
+{
+    m_lastCost = 0.0;
+    m_avgCost = 0.0;
+    m_maxCost = 0.0;
+    m_frames = 0;
+    m_steps = 0;
+    m_cycles = 0;
+    m_fullCollects = 0;
+}
+
+float GcPacer::LastCost() const { return static_cast<float>(m_lastCost); }
+float GcPacer::AverageCost() const { return static_cast<float>(m_avgCost); }
+float GcPacer::MaxCost() const { return static_cast<float>(m_maxCost); }
+std::uint64_t GcPacer::Cycles() const { return m_cycles; }
+std::uint64_t GcPacer::FullCollects() const { return m_fullCollects; }
+
+Lua::ReturnValues GcPacer::LuaStats() const
+{
+    return Lua::Return(LastCost(), AverageCost(), MaxCost(), m_steps, m_cycles, m_fullCollects);
+}
+
+}
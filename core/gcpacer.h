@@ -0,0 +1,67 @@
+#ifndef LUACORE_GCPACER_H
+#define LUACORE_GCPACER_H
+#include "shared.h"
+#include "luaheap.h"
+
+namespace LuaApi {
+    // Runs the Lua collector on the engine's schedule.
+    // Once the gamemode has started, automatic collection is stopped and the
+    // collector only advances in Step(), which the host calls after
+    // end_frame with whatever is left of the frame. A slice never gets less
+    // than the minimum, so garbage can't pile up when frames run long, and
+    // only crossing the ceiling forces a full collection.
+    class GcPacer {
+    public:
+        typedef std::chrono::steady_clock clock;
+        enum {
+            DEFAULT_MIN_SLICE_US = 250,
+            DEFAULT_MAX_SLICE_US = 4000,
+            DEFAULT_CEILING_MB = 256,
+            // Stepping also runs uncapped frames, which have no budget of
+            // their own; assume this rate for them.
+            FALLBACK_RATE = 60
+        };
+    private:
+        bool m_active;
+        double m_minSlice;
+        double m_maxSlice;
+        std::size_t m_ceiling;
+        std::size_t m_cycleLive;
+
+        double m_lastCost;
+        double m_avgCost;
+        double m_maxCost;
+        std::uint64_t m_frames;
+        std::uint64_t m_steps;
+        std::uint64_t m_cycles;
+        std::uint64_t m_fullCollects;
+    public:
+        GcPacer();
+
+        void Start(Lua::State&, LuaHeap const&);
+        void Stop(Lua::State&);
+        bool Active() const;
+
+        // Milliseconds.
+        void SetSliceLimits(float, float);
+        float MinSlice() const;
+        float MaxSlice() const;
+        // Bytes, 0 disables the emergency collection.
+        void SetCeiling(std::size_t);
+        std::size_t Ceiling() const;
+
+        // budget and elapsed are the frame's budget and time spent so far,
+        // in seconds, as reported by FramePacer.
+        void Step(Lua::State&, LuaHeap const&, double budget, double elapsed);
+
+        void ResetStats();
+        float LastCost() const;
+        float AverageCost() const;
+        float MaxCost() const;
+        std::uint64_t Cycles() const;
+        std::uint64_t FullCollects() const;
+        Lua::ReturnValues LuaStats() const;
+    };
+}
+
+#endif
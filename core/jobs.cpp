@@ -0,0 +1,112 @@
+#include "jobs.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <QRunnable>
+#include <QThreadPool>
+
+namespace LuaApi {
+
+namespace {
+    struct Batch {
+        std::atomic<std::size_t> m_next;
+        std::size_t m_count;
+        std::size_t m_chunk;
+        RangeFunction const* m_fnc;
+        
+        std::mutex m_lock;
+        std::condition_variable m_done;
+        std::size_t m_pending;
+        
+        void Run()
+        {
+            for(;;)
+            {
+                std::size_t begin = m_next.fetch_add(m_chunk);
+                if(begin >= m_count)
+                    return;
+                (*m_fnc)(begin, std::min(begin + m_chunk, m_count));
+            }
+        }
+    };
+    
+    class BatchWorker : public QRunnable {
+        Batch& m_batch;
+    public:
+        explicit BatchWorker(Batch& batch) : m_batch(batch) { setAutoDelete(true); }
+        void run() override
+        {
+            m_batch.Run();
+            std::lock_guard<std::mutex> lock(m_batch.m_lock);
+            if(--m_batch.m_pending == 0)
+                m_batch.m_done.notify_all();
+        }
+    };
+    
+    class TaskWorker : public QRunnable {
+        TaskFunction m_fnc;
+    public:
+        explicit TaskWorker(TaskFunction fnc) : m_fnc(std::move(fnc)) { setAutoDelete(true); }
+        void run() override { m_fnc(); }
+    };
+}
+
+std::size_t WorkerCount()
+{
+    int n = QThreadPool::globalInstance()->maxThreadCount();
+    return (n > 0) ? static_cast<std::size_t>(n) : 1;
+}
+
+void ParallelFor(std::size_t count, std::size_t grain, RangeFunction const& fnc)
+{
+    if(count == 0)
+        return;
+    if(grain == 0)
+        grain = 1;
+    std::size_t workers = WorkerCount();
+    if(count <= grain || workers <= 1)
+    {
+        fnc(0, count);
+        return;
+    }
+    
+    // A few chunks per thread evens out uneven ranges.
+    std::size_t chunk = std::max(grain, count / (workers * 4));
+    std::size_t chunks = (count + chunk - 1) / chunk;
+    
+    Batch batch;
+    batch.m_next = 0;
+    batch.m_count = count;
+    batch.m_chunk = chunk;
+    batch.m_fnc = &fnc;
+    batch.m_pending = 0;
+    
+    QThreadPool* pool = QThreadPool::globalInstance();
+    for(std::size_t i = 1; i < std::min(workers, chunks); ++i)
+    {
+        BatchWorker* worker = new BatchWorker(batch);
+        {
+            std::lock_guard<std::mutex> lock(batch.m_lock);
+            ++batch.m_pending;
+        }
+        if(!pool->tryStart(worker))
+        {
+            std::lock_guard<std::mutex> lock(batch.m_lock);
+            --batch.m_pending;
+            delete worker;
+            break;
+        }
+    }
+    
+    batch.Run();
+    std::unique_lock<std::mutex> lock(batch.m_lock);
+    batch.m_done.wait(lock, [&batch]() { return batch.m_pending == 0; });
+}
+
+void RunAsync(TaskFunction fnc)
+{
+    QThreadPool::globalInstance()->start(new TaskWorker(std::move(fnc)));
+}
+
+}
@@ -0,0 +1,24 @@
+#ifndef LUACORE_JOBS_H
+#define LUACORE_JOBS_H
+#include <functional>
+#include "shared.h"
+
+namespace LuaApi {
+    // Data-parallel loops on the global QThreadPool.
+    // [0, count) is cut into chunks of at least grain items which the pool
+    // threads and the calling thread pull until none are left; the call
+    // returns once every chunk has run. Pool threads that are busy are simply
+    // not used, so nesting can't deadlock. The body runs off the main thread:
+    // it must not throw and must not touch the Lua state or GL.
+    typedef std::function<void(std::size_t, std::size_t)> RangeFunction;
+    void ParallelFor(std::size_t count, std::size_t grain, RangeFunction const&);
+    std::size_t WorkerCount();
+
+    // Background task on the same pool, queued while every thread is busy.
+    // Same rules as a ParallelFor body; results go back through whatever
+    // the task shares with the main thread.
+    typedef std::function<void()> TaskFunction;
+    void RunAsync(TaskFunction);
+}
+
+#endif
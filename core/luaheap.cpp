@@ -0,0 +1,253 @@
+#include "luaheap.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace LuaApi {
+
+namespace {
+    // 8-byte steps up to 128 bytes, 16-byte steps up to 256, then 64-byte
+    // steps up to 512. Lua's strings, tables, closures and small array parts
+    // mostly land in the first two ranges.
+    std::size_t const g_classSizes[LuaHeap::CLASS_COUNT] = {
+        8, 16, 24, 32, 40, 48, 56, 64,
+        72, 80, 88, 96, 104, 112, 120, 128,
+        144, 160, 176, 192, 208, 224, 240, 256,
+        320, 384, 448, 512
+    };
+
+    inline std::size_t ClassOf(std::size_t size)
+    {
+        if(size <= 128)
+            return (size == 0) ? 0 : (size - 1) / 8;
+        if(size <= 256)
+            return 16 + (size - 129) / 16;
+        return 24 + (size - 257) / 64;
+    }
+
+    double const g_rateSmoothing = 0.1;
+
+    char const* const g_categoryNames[LuaHeap::CATEGORY_COUNT] = {
+        "startup", "tick", "frame", "input", "other"
+    };
+}
+
+LuaHeap::Scope::Scope(LuaHeap& heap, Category category) :
+    m_heap(heap),
+    m_previous(heap.CurrentCategory())
+{
+    m_heap.SetCategory(category);
+}
+
+LuaHeap::Scope::~Scope()
+{
+    m_heap.SetCategory(m_previous);
+}
+
+LuaHeap::LuaHeap() :
+    m_live(0),
+    m_peak(0),
+    m_limit(0),
+    m_allocated(0),
+    m_allocations(0),
+    m_failed(0),
+    m_category(OTHER),
+    m_sampleTime(clock::now()),
+    m_sampleAllocated(0),
+    m_frameBytes(0),
+    m_rate(0.0)
+{
+    for(std::size_t i = 0; i < CLASS_COUNT; ++i)
+        m_free[i] = nullptr;
+    for(std::size_t i = 0; i < CATEGORY_COUNT; ++i)
+        m_categories[i] = CategoryStats{0, 0};
+}
+
+LuaHeap::~LuaHeap()
+{
+    for(auto it = m_chunks.begin(); it != m_chunks.end(); ++it)
+        std::free(*it);
+}
+
+bool LuaHeap::owns(void* ptr) const
+{
+    char* p = static_cast<char*>(ptr);
+    auto it = std::upper_bound(m_chunks.begin(), m_chunks.end(), p);
+    if(it == m_chunks.begin())
+        return false;
+    --it;
+    return p < *it + CHUNK_SIZE;
+}
+
+void* LuaHeap::allocSmall(std::size_t size)
+{
+    std::size_t cls = ClassOf(size);
+    FreeBlock*& list = m_free[cls];
+    if(!list)
+    {
+        char* chunk = static_cast<char*>(std::malloc(CHUNK_SIZE));
+        if(!chunk)
+            return nullptr;
+        m_chunks.insert(std::upper_bound(m_chunks.begin(), m_chunks.end(), chunk), chunk);
+
+        std::size_t const blockSize = g_classSizes[cls];
+        for(std::size_t i = CHUNK_SIZE / blockSize; i-- > 0; )
+        {
+            FreeBlock* b = reinterpret_cast<FreeBlock*>(chunk + i * blockSize);
+            b->m_next = list;
+            list = b;
+        }
+    }
+    FreeBlock* b = list;
+    list = b->m_next;
+    return b;
+}
+
+void LuaHeap::freeSmall(void* ptr, std::size_t size)
+{
+    FreeBlock*& list = m_free[ClassOf(size)];
+    FreeBlock* b = static_cast<FreeBlock*>(ptr);
+    b->m_next = list;
+    list = b;
+}
+
+void* LuaHeap::realloc(void* ptr, std::size_t osize, std::size_t nsize)
+{
+    // Blocks that are small but not ours were made by the default
+    // allocator before Install() and are treated like large ones.
+    bool const pooled = ptr && osize <= MAX_SMALL_SIZE && owns(ptr);
+    if(nsize == 0)
+    {
+        if(pooled)
+            freeSmall(ptr, osize);
+        else
+            std::free(ptr);
+        return nullptr;
+    }
+
+    if(pooled && nsize <= MAX_SMALL_SIZE && ClassOf(nsize) == ClassOf(osize))
+        return ptr;
+    if(!pooled && nsize > MAX_SMALL_SIZE)
+        return std::realloc(ptr, nsize);
+
+    void* block = (nsize <= MAX_SMALL_SIZE) ? allocSmall(nsize) : nullptr;
+    if(!block)
+    {
+        // Lua expects shrinking to succeed, so fall back to realloc'd memory;
+        // owns() keeps telling the two apart when the block is released.
+        if(!pooled)
+            return std::realloc(ptr, nsize);
+        block = std::malloc(nsize);
+        if(!block)
+            return nullptr;
+    }
+    if(ptr)
+    {
+        std::memcpy(block, ptr, std::min(osize, nsize));
+        if(pooled)
+            freeSmall(ptr, osize);
+        else
+            std::free(ptr);
+    }
+    return block;
+}
+
+void* LuaHeap::Alloc(void* ud, void* ptr, std::size_t osize, std::size_t nsize)
+{
+    LuaHeap& heap = *static_cast<LuaHeap*>(ud);
+    // For new blocks Lua passes the object type in osize.
+    if(!ptr)
+        osize = 0;
+
+    std::size_t const grow = (nsize > osize) ? nsize - osize : 0;
+    if(grow && heap.m_limit && heap.m_live + grow > heap.m_limit)
+    {
+        ++heap.m_failed;
+        return nullptr;
+    }
+
+    void* block = heap.realloc(ptr, osize, nsize);
+    if(!block && nsize)
+    {
+        ++heap.m_failed;
+        return nullptr;
+    }
+
+    heap.m_live = (heap.m_live > osize) ? heap.m_live - osize : 0;
+    heap.m_live += nsize;
+    if(heap.m_live > heap.m_peak)
+        heap.m_peak = heap.m_live;
+    if(grow)
+    {
+        CategoryStats& stats = heap.m_categories[heap.m_category];
+        heap.m_allocated += grow;
+        stats.m_bytes += grow;
+        if(!ptr)
+        {
+            ++heap.m_allocations;
+            ++stats.m_count;
+        }
+    }
+    return block;
+}
+
+void LuaHeap::Install(Lua::State& state)
+{
+    state.setallocf(&LuaHeap::Alloc, this);
+    m_live = static_cast<std::size_t>(state.gc(LUA_GCCOUNT, 0)) * 1024 + static_cast<std::size_t>(state.gc(LUA_GCCOUNTB, 0));
+    m_peak = m_live;
+}
+
+void LuaHeap::SetCategory(Category category) { m_category = category; }
+LuaHeap::Category LuaHeap::CurrentCategory() const { return m_category; }
+
+LuaHeap::Category LuaHeap::CategoryFromName(std::string const& name)
+{
+    for(std::size_t i = 0; i < CATEGORY_COUNT; ++i)
+    {
+        if(name == g_categoryNames[i])
+            return static_cast<Category>(i);
+    }
+    throw std::runtime_error("Unknown heap category: " + name);
+}
+
+void LuaHeap::SetLimit(std::size_t limit) { m_limit = limit; }
+std::size_t LuaHeap::Limit() const { return m_limit; }
+
+std::size_t LuaHeap::LiveBytes() const { return m_live; }
+std::size_t LuaHeap::PeakBytes() const { return m_peak; }
+std::size_t LuaHeap::ReservedBytes() const { return m_chunks.size() * CHUNK_SIZE; }
+std::uint64_t LuaHeap::AllocatedBytes() const { return m_allocated; }
+std::uint64_t LuaHeap::Allocations() const { return m_allocations; }
+std::uint64_t LuaHeap::FailedAllocations() const { return m_failed; }
+std::uint64_t LuaHeap::FrameBytes() const { return m_frameBytes; }
+double LuaHeap::AllocationRate() const { return m_rate; }
+void LuaHeap::ResetPeak() { m_peak = m_live; }
+
+void LuaHeap::EndFrame()
+{
+    clock::time_point now = clock::now();
+    double seconds = std::chrono::duration<double>(now - m_sampleTime).count();
+    m_frameBytes = m_allocated - m_sampleAllocated;
+    if(seconds > 0.0)
+    {
+        double rate = m_frameBytes / seconds;
+        m_rate = (m_rate == 0.0) ? rate : (m_rate + (rate - m_rate) * g_rateSmoothing);
+    }
+    m_sampleTime = now;
+    m_sampleAllocated = m_allocated;
+}
+
+Lua::ReturnValues LuaHeap::LuaStats() const
+{
+    return Lua::Return(static_cast<std::uint64_t>(m_live), static_cast<std::uint64_t>(m_peak), m_rate, m_allocations, static_cast<std::uint64_t>(m_limit));
+}
+
+Lua::ReturnValues LuaHeap::LuaCategoryStats(std::string const& name) const
+{
+    CategoryStats const& stats = m_categories[CategoryFromName(name)];
+    return Lua::Return(stats.m_bytes, stats.m_count);
+}
+
+}
@@ -0,0 +1,105 @@
+#ifndef LUACORE_LUAHEAP_H
+#define LUACORE_LUAHEAP_H
+#include <vector>
+#include "shared.h"
+
+namespace LuaApi {
+    // Allocator behind the script VM.
+    // Blocks up to MAX_SMALL_SIZE come from per-size-class slabs carved out of
+    // CHUNK_SIZE chunks, which covers nearly every string, table, closure and
+    // array part Lua allocates; anything bigger goes to realloc. The heap is
+    // bound to one lua_State and is not thread safe.
+    class LuaHeap {
+    public:
+        typedef std::chrono::steady_clock clock;
+        enum Category {
+            STARTUP,
+            TICK,
+            FRAME,
+            INPUT,
+            OTHER,
+            CATEGORY_COUNT
+        };
+        enum {
+            MAX_SMALL_SIZE = 512,
+            CLASS_COUNT = 28,
+            CHUNK_SIZE = 64 * 1024
+        };
+
+        // Charges allocations made while alive to a category.
+        class Scope {
+            LuaHeap& m_heap;
+            Category m_previous;
+        public:
+            Scope(LuaHeap&, Category);
+            ~Scope();
+        };
+    private:
+        struct FreeBlock {
+            FreeBlock* m_next;
+        };
+        struct CategoryStats {
+            std::uint64_t m_bytes;
+            std::uint64_t m_count;
+        };
+
+        FreeBlock* m_free[CLASS_COUNT];
+        std::vector<char*> m_chunks;
+
+        std::size_t m_live;
+        std::size_t m_peak;
+        std::size_t m_limit;
+        std::uint64_t m_allocated;
+        std::uint64_t m_allocations;
+        std::uint64_t m_failed;
+        Category m_category;
+        CategoryStats m_categories[CATEGORY_COUNT];
+
+        clock::time_point m_sampleTime;
+        std::uint64_t m_sampleAllocated;
+        std::uint64_t m_frameBytes;
+        double m_rate;
+
+        bool owns(void*) const;
+        void* allocSmall(std::size_t);
+        void freeSmall(void*, std::size_t);
+        void* realloc(void*, std::size_t, std::size_t);
+    public:
+        LuaHeap();
+        ~LuaHeap();
+        LuaHeap(LuaHeap const&) =delete;
+        LuaHeap& operator= (LuaHeap const&) =delete;
+
+        static void* Alloc(void* ud, void* ptr, std::size_t osize, std::size_t nsize);
+
+        // Switches a freshly created state over to this heap. Blocks the
+        // state allocated before are released through realloc as usual.
+        void Install(Lua::State&);
+
+        void SetCategory(Category);
+        Category CurrentCategory() const;
+        static Category CategoryFromName(std::string const&);
+
+        // 0 disables the limit. Allocations that would cross it fail, which
+        // Lua turns into a full collection and, failing that, a memory error.
+        void SetLimit(std::size_t);
+        std::size_t Limit() const;
+
+        std::size_t LiveBytes() const;
+        std::size_t PeakBytes() const;
+        std::size_t ReservedBytes() const;
+        std::uint64_t AllocatedBytes() const;
+        std::uint64_t Allocations() const;
+        std::uint64_t FailedAllocations() const;
+        std::uint64_t FrameBytes() const;
+        double AllocationRate() const;
+        void ResetPeak();
+
+        void EndFrame();
+
+        Lua::ReturnValues LuaStats() const;
+        Lua::ReturnValues LuaCategoryStats(std::string const&) const;
+    };
+}
+
+#endif
@@ -0,0 +1,171 @@
+#include "manifest.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <algorithm>
+#include <vector>
+#include "vfs.h"
+
+namespace LuaApi {
+
+namespace {
+    char const* const g_kindNames[AssetManifest::KIND_COUNT] = {
+        "model", "texture", "sound"
+    };
+}
+
+char const* const AssetManifest::FOLDER = ".cooked";
+char const* const AssetManifest::FILE_NAME = "manifest.json";
+
+AssetManifest& AssetManifest::Instance()
+{
+    static AssetManifest manifest;
+    return manifest;
+}
+char const* AssetManifest::KindName(Kind kind)
+{
+    return g_kindNames[kind];
+}
+bool AssetManifest::KindFromName(std::string const& name, Kind& kind)
+{
+    for(std::size_t i = 0; i < KIND_COUNT; ++i)
+    {
+        if(name == g_kindNames[i])
+        {
+            kind = static_cast<Kind>(i);
+            return true;
+        }
+    }
+    return false;
+}
+std::string AssetManifest::HashFile(std::string const& path)
+{
+    std::unique_ptr<QIODevice> f = Vfs::Instance().open(path);
+    if(!f)
+        return std::string();
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    if(!hash.addData(f.get()))
+        return std::string();
+    return hash.result().toHex().toStdString();
+}
+
+bool AssetManifest::read(std::string const& dataPath)
+{
+    clear();
+    m_root = QDir::cleanPath(QFileInfo(QString::fromStdString(dataPath)).absoluteFilePath()).toStdString() + "/";
+    QByteArray const json = Vfs::Instance().read(folder() + FILE_NAME);
+    if(json.isEmpty())
+        return false;
+    QJsonObject const root = QJsonDocument::fromJson(json).object();
+    if(root.value("version").toInt() != VERSION)
+        return false;
+    QJsonArray const assets = root.value("assets").toArray();
+    for(QJsonValue const& value : assets)
+    {
+        QJsonObject const asset = value.toObject();
+        Entry entry;
+        if(!KindFromName(asset.value("kind").toString().toStdString(), entry.m_kind))
+            continue;
+        entry.m_source = asset.value("source").toString().toStdString();
+        entry.m_output = asset.value("output").toString().toStdString();
+        entry.m_hash = asset.value("hash").toString().toStdString();
+        // Doubles hold these exactly for another quarter of a million years.
+        entry.m_size = static_cast<std::int64_t>(asset.value("size").toDouble());
+        entry.m_modified = static_cast<std::int64_t>(asset.value("modified").toDouble());
+        if(!entry.m_source.empty() && !entry.m_output.empty())
+            m_entries[entry.m_source] = std::move(entry);
+    }
+    return true;
+}
+bool AssetManifest::write() const
+{
+    if(m_root.empty() || !QDir().mkpath(QString::fromStdString(folder())))
+        return false;
+    // Sorted, so the file diffs cleanly between cooks.
+    std::vector<Entry const*> sorted;
+    for(auto const& it : m_entries)
+        sorted.push_back(&it.second);
+    std::sort(sorted.begin(), sorted.end(), [](Entry const* a, Entry const* b) { return a->m_source < b->m_source; });
+    QJsonArray assets;
+    for(Entry const* entry : sorted)
+    {
+        QJsonObject asset;
+        asset["source"] = QString::fromStdString(entry->m_source);
+        asset["kind"] = QString(KindName(entry->m_kind));
+        asset["output"] = QString::fromStdString(entry->m_output);
+        asset["hash"] = QString::fromStdString(entry->m_hash);
+        asset["size"] = static_cast<double>(entry->m_size);
+        asset["modified"] = static_cast<double>(entry->m_modified);
+        assets.append(asset);
+    }
+    QJsonObject root;
+    root["version"] = static_cast<int>(VERSION);
+    root["assets"] = assets;
+    QSaveFile f(QString::fromStdString(folder() + FILE_NAME));
+    if(!f.open(QFile::WriteOnly))
+        return false;
+    f.write(QJsonDocument(root).toJson());
+    return f.commit();
+}
+void AssetManifest::clear()
+{
+    m_root.clear();
+    m_entries.clear();
+}
+
+std::string AssetManifest::lookup(std::string const& path, Kind kind) const
+{
+    if(m_entries.empty())
+        return std::string();
+    auto it = m_entries.find(relative(path));
+    if(it == m_entries.end() || it->second.m_kind != kind)
+        return std::string();
+    Entry const& entry = it->second;
+    QFileInfo const source(QString::fromStdString(path));
+    if(source.exists() && (source.size() != entry.m_size ||
+                           source.lastModified().toMSecsSinceEpoch() != entry.m_modified))
+        return std::string();
+    std::string const cooked = folder() + entry.m_output;
+    return Vfs::Instance().exists(cooked) ? cooked : std::string();
+}
+std::string AssetManifest::relative(std::string const& path) const
+{
+    if(m_root.empty())
+        return std::string();
+    std::string const absolute = QDir::cleanPath(QFileInfo(QString::fromStdString(path)).absoluteFilePath()).toStdString();
+    if(absolute.compare(0, m_root.size(), m_root) != 0)
+        return std::string();
+    return absolute.substr(m_root.size());
+}
+AssetManifest::Entry const* AssetManifest::find(std::string const& relative) const
+{
+    auto it = m_entries.find(relative);
+    return it != m_entries.end() ? &it->second : nullptr;
+}
+void AssetManifest::set(Entry entry)
+{
+    std::string const key = entry.m_source;
+    m_entries[key] = std::move(entry);
+}
+void AssetManifest::erase(std::string const& relative)
+{
+    m_entries.erase(relative);
+}
+std::unordered_map<std::string, AssetManifest::Entry> const& AssetManifest::entries() const
+{
+    return m_entries;
+}
+std::string const& AssetManifest::root() const
+{
+    return m_root;
+}
+std::string AssetManifest::folder() const
+{
+    return m_root + FOLDER + "/";
+}
+
+}
@@ -0,0 +1,71 @@
+#ifndef LUACORE_MANIFEST_H
+#define LUACORE_MANIFEST_H
+#include <unordered_map>
+#include "shared.h"
+
+namespace LuaApi {
+    // The cooked assets of a data folder, as written by openrp-cook.
+    // <data>/.cooked/manifest.json maps each source file, relative to the
+    // data folder, to its cooked file in the same directory. Entries also
+    // keep the content hash the cooker used to skip unchanged files, and
+    // the size and modification time of the source, which is all the
+    // runtime compares: a source edited since cooking loads as usual until
+    // the next cook. Sources missing altogether load from their cooked
+    // file, so a build may ship without them. Sources inside a pak
+    // archive are not compared; the pak is assumed to match its cook.
+    //
+    // One instance per process, read when a gamemode starts.
+    class AssetManifest {
+    public:
+        enum Kind {
+            MODEL,
+            TEXTURE,
+            SOUND,
+            KIND_COUNT
+        };
+        enum {
+            VERSION = 1
+        };
+        struct Entry {
+            std::string m_source;
+            Kind m_kind;
+            // File name within the cooked folder.
+            std::string m_output;
+            std::string m_hash;
+            std::int64_t m_size;
+            std::int64_t m_modified;
+        };
+    private:
+        // Absolute, with a trailing slash.
+        std::string m_root;
+        std::unordered_map<std::string, Entry> m_entries;
+    public:
+        static char const* const FOLDER;
+        static char const* const FILE_NAME;
+
+        static AssetManifest& Instance();
+        static char const* KindName(Kind);
+        static bool KindFromName(std::string const&, Kind&);
+        // Hex SHA-1 of the file's contents; empty if it can't be read.
+        static std::string HashFile(std::string const& path);
+
+        // Switches to a data folder. False if it has no manifest, or one
+        // this build can't read; the manifest is then empty.
+        bool read(std::string const& dataPath);
+        bool write() const;
+        void clear();
+
+        // The cooked file to load instead of path, or empty.
+        std::string lookup(std::string const& path, Kind) const;
+        // path relative to the data folder; empty if outside it.
+        std::string relative(std::string const& path) const;
+        Entry const* find(std::string const& relative) const;
+        void set(Entry);
+        void erase(std::string const& relative);
+        std::unordered_map<std::string, Entry> const& entries() const;
+        std::string const& root() const;
+        std::string folder() const;
+    };
+}
+
+#endif
@@ -0,0 +1,98 @@
+#include "pool.h"
+#include <atomic>
+#include <new>
+
+namespace LuaApi {
+namespace impl {
+
+namespace {
+    // 16-byte steps up to 256 bytes, then 384, 512, 768 and 1024.
+    enum { CLASS_COUNT = 20 };
+    
+    std::size_t const g_classSizes[CLASS_COUNT] = {
+        16, 32, 48, 64, 80, 96, 112, 128,
+        144, 160, 176, 192, 208, 224, 240, 256,
+        384, 512, 768, 1024
+    };
+    
+    inline std::size_t ClassOf(std::size_t size)
+    {
+        if(size <= 256)
+            return (size == 0) ? 0 : (size - 1) / 16;
+        if(size <= 384)
+            return 16;
+        if(size <= 512)
+            return 17;
+        if(size <= 768)
+            return 18;
+        return 19;
+    }
+    
+    struct FreeBlock {
+        FreeBlock* m_next;
+    };
+    
+    struct ThreadLists {
+        FreeBlock* m_free[CLASS_COUNT];
+        std::ptrdiff_t m_live;
+        ThreadLists() : m_live(0) { for(std::size_t i = 0; i < CLASS_COUNT; ++i) m_free[i] = nullptr; }
+    };
+    
+    thread_local ThreadLists t_lists;
+    std::atomic<std::size_t> g_reserved(0);
+    
+    FreeBlock* Refill(std::size_t cls)
+    {
+        std::size_t const blockSize = g_classSizes[cls];
+        std::size_t const count = SizeClassPool::CHUNK_SIZE / blockSize;
+        char* chunk = static_cast<char*>(::operator new(SizeClassPool::CHUNK_SIZE));
+        g_reserved += SizeClassPool::CHUNK_SIZE;
+        
+        FreeBlock* head = nullptr;
+        for(std::size_t i = count; i-- > 0; )
+        {
+            FreeBlock* b = reinterpret_cast<FreeBlock*>(chunk + i * blockSize);
+            b->m_next = head;
+            head = b;
+        }
+        return head;
+    }
+}
+
+void* SizeClassPool::Allocate(std::size_t size)
+{
+    if(size > SizeClassPool::MAX_POOLED_SIZE)
+        return ::operator new(size);
+    
+    std::size_t cls = ClassOf(size);
+    FreeBlock*& list = t_lists.m_free[cls];
+    if(!list)
+        list = Refill(cls);
+    FreeBlock* b = list;
+    list = b->m_next;
+    ++t_lists.m_live;
+    return b;
+}
+
+void SizeClassPool::Free(void* ptr, std::size_t size)
+{
+    if(!ptr)
+        return;
+    if(size > SizeClassPool::MAX_POOLED_SIZE)
+    {
+        ::operator delete(ptr);
+        return;
+    }
+    
+    FreeBlock*& list = t_lists.m_free[ClassOf(size)];
+    FreeBlock* b = static_cast<FreeBlock*>(ptr);
+    b->m_next = list;
+    list = b;
+    --t_lists.m_live;
+}
+
+std::ptrdiff_t SizeClassPool::ThreadLiveBlocks() { return t_lists.m_live; }
+std::size_t SizeClassPool::ReservedBytes() { return g_reserved; }
+
+}
+}
@@ -0,0 +1,30 @@
+#ifndef LUACORE_POOL_H
+#define LUACORE_POOL_H
+#include <cstddef>
+#include <cstdint>
+
+namespace LuaApi {
+    namespace impl {
+        // Size-class allocator for small engine objects.
+        // Free lists are per thread and need no locking. Chunks are never
+        // returned to the system, so a block may be freed on a different
+        // thread than the one that allocated it: it joins that thread's list.
+        class SizeClassPool {
+        public:
+            enum {
+                ALIGNMENT = 16,
+                MAX_POOLED_SIZE = 1024,
+                CHUNK_SIZE = 64 * 1024
+            };
+            
+            static void* Allocate(std::size_t);
+            static void Free(void*, std::size_t);
+            
+            // Blocks allocated minus blocks freed on the calling thread.
+            static std::ptrdiff_t ThreadLiveBlocks();
+            static std::size_t ReservedBytes();
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,123 @@
+#include "scheduler.h"
+#include <algorithm>
+#include <cmath>
+
+namespace LuaApi {
+
+static double const g_maxFrameSeconds = 1.0;
+static double const g_costSmoothing = 0.05;
+
+TickScheduler::TickScheduler()
+    : m_step(1.0 / TickScheduler::DEFAULT_RATE),
+      m_maxSteps(TickScheduler::DEFAULT_MAX_STEPS),
+      m_accumulator(0.0),
+      m_running(false)
+{
+    ResetStats();
+}
+
+void TickScheduler::SetRate(float hz)
+{
+    if(!(hz > 0.f))
+        return;
+    m_step = 1.0 / static_cast<double>(hz);
+}
+float TickScheduler::Rate() const { return static_cast<float>(1.0 / m_step); }
+void TickScheduler::SetMaxSteps(std::uint32_t n) { m_maxSteps = (n > 0) ? n : 1; }
+std::uint32_t TickScheduler::MaxSteps() const { return m_maxSteps; }
+
+void TickScheduler::Reset()
+{
+    m_accumulator = 0.0;
+    m_last = TickScheduler::clock::now();
+    m_running = true;
+}
+
+double TickScheduler::elapsed()
+{
+    clock::time_point now = TickScheduler::clock::now();
+    if(!m_running)
+    {
+        m_last = now;
+        m_running = true;
+        return 0.0;
+    }
+    
+    double seconds = std::chrono::duration<double>(now - m_last).count();
+    m_last = now;
+    return seconds;
+}
+
+std::uint32_t TickScheduler::Advance()
+{
+    return Advance(elapsed());
+}
+
+std::uint32_t TickScheduler::Advance(double seconds)
+{
+    // A stall longer than this (debugger, window drag) is not worth replaying.
+    return advance(seconds, g_maxFrameSeconds, m_maxSteps);
+}
+
+std::uint32_t TickScheduler::AdvanceBackground(double period)
+{
+    double const window = std::max(g_maxFrameSeconds, 2.0 * period);
+    std::uint32_t const steps = static_cast<std::uint32_t>(std::ceil(2.0 * period / m_step));
+    return advance(elapsed(), window, std::max(m_maxSteps, steps));
+}
+
+std::uint32_t TickScheduler::advance(double seconds, double maxElapsed, std::uint32_t maxSteps)
+{
+    if(seconds > maxElapsed)
+    {
+        m_dropped += static_cast<std::uint64_t>((seconds - maxElapsed) / m_step);
+        seconds = maxElapsed;
+    }
+    
+    m_accumulator += seconds;
+    double steps = std::floor(m_accumulator / m_step);
+    m_accumulator -= steps * m_step;
+    
+    std::uint32_t due = static_cast<std::uint32_t>(steps);
+    if(due > maxSteps)
+    {
+        m_dropped += due - maxSteps;
+        due = maxSteps;
+    }
+    return due;
+}
+
+double TickScheduler::StepSeconds() const { return m_step; }
+float TickScheduler::Alpha() const { return static_cast<float>(m_accumulator / m_step); }
+
+void TickScheduler::RecordTick(clock::duration d)
+{
+    double ms = std::chrono::duration<double, std::milli>(d).count();
+    m_lastCost = ms;
+    m_avgCost = (m_ticks == 0) ? ms : (m_avgCost + (ms - m_avgCost) * g_costSmoothing);
+    if(ms > m_maxCost)
+        m_maxCost = ms;
+    ++m_ticks;
+}
+
+void TickScheduler::ResetStats()
+{
+    m_ticks = 0;
+    m_dropped = 0;
+    m_lastCost = 0.0;
+    m_avgCost = 0.0;
+    m_maxCost = 0.0;
+}
+
+std::uint64_t TickScheduler::Ticks() const { return m_ticks; }
+std::uint64_t TickScheduler::DroppedTicks() const { return m_dropped; }
+float TickScheduler::LastTickCost() const { return static_cast<float>(m_lastCost); }
+float TickScheduler::AverageTickCost() const { return static_cast<float>(m_avgCost); }
+float TickScheduler::MaxTickCost() const { return static_cast<float>(m_maxCost); }
+
+Lua::ReturnValues TickScheduler::LuaStats() const
+{
+    return Lua::Return(m_ticks, m_dropped, LastTickCost(), AverageTickCost(), MaxTickCost());
+}
+
+}
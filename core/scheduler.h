@@ -0,0 +1,61 @@
+#ifndef LUACORE_SCHEDULER_H
+#define LUACORE_SCHEDULER_H
+#include "shared.h"
+
+namespace LuaApi {
+    // Fixed-step simulation clock.
+    // The engine asks Advance() how many ticks are due before every frame,
+    // runs them, and hands Alpha() to the renderer for interpolation.
+    class TickScheduler {
+    public:
+        typedef std::chrono::steady_clock clock;
+        enum {
+            DEFAULT_RATE = 30,
+            DEFAULT_MAX_STEPS = 5
+        };
+    private:
+        double m_step;
+        std::uint32_t m_maxSteps;
+        double m_accumulator;
+        clock::time_point m_last;
+        bool m_running;
+        
+        double elapsed();
+        std::uint32_t advance(double elapsed, double maxElapsed, std::uint32_t maxSteps);
+        
+        std::uint64_t m_ticks;
+        std::uint64_t m_dropped;
+        double m_lastCost;
+        double m_avgCost;
+        double m_maxCost;
+    public:
+        TickScheduler();
+        
+        void SetRate(float);
+        float Rate() const;
+        void SetMaxSteps(std::uint32_t);
+        std::uint32_t MaxSteps() const;
+        
+        void Reset();
+        std::uint32_t Advance();
+        std::uint32_t Advance(double);
+        // For a timer firing every period seconds, slower than the tick
+        // rate: the step cap stretches to cover two periods, so ticks
+        // are only dropped when the timer itself stalls.
+        std::uint32_t AdvanceBackground(double period);
+        double StepSeconds() const;
+        float Alpha() const;
+        
+        void RecordTick(clock::duration);
+        void ResetStats();
+        std::uint64_t Ticks() const;
+        std::uint64_t DroppedTicks() const;
+        float LastTickCost() const;
+        float AverageTickCost() const;
+        float MaxTickCost() const;
+        
+        Lua::ReturnValues LuaStats() const;
+    };
+}
+
+#endif
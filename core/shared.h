@@ -0,0 +1,8 @@
+#ifndef LUACORE_SHARED_H
+#define LUACORE_SHARED_H
+#include <chrono>
+#include "state.h"
+#include "library.h"
+#include "../shared.h"
+
+#endif
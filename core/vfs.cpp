@@ -0,0 +1,442 @@
+#include "vfs.h"
+#include <QBuffer>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtEndian>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+namespace LuaApi {
+
+namespace {
+    // Keeps its archive mapped for as long as it is open.
+    class PakDevice : public QBuffer {
+        std::shared_ptr<PakArchive> m_pak;
+        QByteArray m_bytes;
+    public:
+        PakDevice(std::shared_ptr<PakArchive> pak, QByteArray bytes) :
+            m_pak(std::move(pak)),
+            m_bytes(std::move(bytes))
+        {
+            setBuffer(&m_bytes);
+            open(QIODevice::ReadOnly);
+        }
+    };
+
+    std::string Absolute(std::string const& path)
+    {
+        return QDir::cleanPath(QFileInfo(QString::fromStdString(path)).absoluteFilePath()).toStdString();
+    }
+
+    std::uint64_t Align(std::uint64_t offset)
+    {
+        return (offset + PakArchive::ALIGNMENT - 1) / PakArchive::ALIGNMENT * PakArchive::ALIGNMENT;
+    }
+
+    template <typename T>
+    void Put(QByteArray& out, T value)
+    {
+        char bytes[sizeof(T)];
+        qToLittleEndian(value, reinterpret_cast<uchar*>(bytes));
+        out.append(bytes, sizeof(T));
+    }
+
+    // Searches package.path; pushes the chunk and its file name, or the
+    // files tried. -1 with the message pushed if a file fails to compile.
+    int SearchPath(lua_State* s, char const* name)
+    {
+        lua_getglobal(s, "package");
+        lua_getfield(s, -1, "path");
+        std::string const templates = lua_isstring(s, -1) ? lua_tostring(s, -1) : "";
+        lua_pop(s, 2);
+        std::string module = name;
+        std::replace(module.begin(), module.end(), '.', '/');
+
+        std::string tried;
+        std::size_t begin = 0;
+        while(begin < templates.size())
+        {
+            std::size_t end = templates.find(';', begin);
+            if(end == std::string::npos)
+                end = templates.size();
+            std::string file = templates.substr(begin, end - begin);
+            begin = end + 1;
+            if(file.empty())
+                continue;
+            for(std::size_t at = file.find('?'); at != std::string::npos; at = file.find('?', at + module.size()))
+                file.replace(at, 1, module);
+
+            Vfs const& vfs = Vfs::Instance();
+            if(!vfs.exists(file))
+            {
+                tried += "\n\tno file '" + file + "'";
+                continue;
+            }
+            QByteArray const chunk = vfs.read(file);
+            std::string const chunkName = "@" + file;
+            if(luaL_loadbufferx(s, chunk.constData(), chunk.size(), chunkName.c_str(), nullptr) != LUA_OK)
+            {
+                lua_pushfstring(s, "error loading module '%s' from file '%s':\n\t%s",
+                                name, file.c_str(), lua_tostring(s, -1));
+                return -1;
+            }
+            lua_pushstring(s, file.c_str());
+            return 2;
+        }
+        lua_pushstring(s, tried.c_str());
+        return 1;
+    }
+}
+
+// PakArchive
+PakArchive::PakArchive() :
+    m_data(nullptr),
+    m_size(0),
+    m_count(0),
+    m_index(nullptr),
+    m_names(nullptr)
+{
+}
+PakArchive::~PakArchive()
+{
+    if(m_data)
+        m_file.unmap(const_cast<uchar*>(m_data));
+}
+
+bool PakArchive::open(std::string const& path)
+{
+    m_file.setFileName(QString::fromStdString(path));
+    if(m_data || !m_file.open(QFile::ReadOnly) || m_file.size() < HEADER_SIZE)
+        return false;
+    m_size = static_cast<std::uint64_t>(m_file.size());
+    m_data = m_file.map(0, m_file.size());
+    if(!m_data)
+        return false;
+
+    std::uint32_t const magic = qFromLittleEndian<quint32>(m_data);
+    std::uint32_t const version = qFromLittleEndian<quint32>(m_data + 4);
+    std::uint64_t const count = qFromLittleEndian<quint32>(m_data + 8);
+    std::uint64_t const namesSize = qFromLittleEndian<quint32>(m_data + 12);
+    if(magic != MAGIC || version != VERSION || HEADER_SIZE + count * ENTRY_SIZE + namesSize > m_size)
+        return false;
+    m_count = static_cast<std::uint32_t>(count);
+    m_index = m_data + HEADER_SIZE;
+    m_names = reinterpret_cast<char const*>(m_index + count * ENTRY_SIZE);
+
+    // Checked once here, so lookups can trust the index.
+    for(std::uint32_t i = 0; i < m_count; ++i)
+    {
+        unsigned char const* record = m_index + i * ENTRY_SIZE;
+        std::uint64_t const nameOffset = qFromLittleEndian<quint32>(record + 32);
+        std::uint64_t const nameSize = qFromLittleEndian<quint16>(record + 36);
+        Entry const e = entry(i);
+        if(nameOffset + nameSize > namesSize || e.m_offset > m_size || e.m_storedSize > m_size - e.m_offset ||
+                e.m_size > INT_MAX || e.m_storedSize > INT_MAX ||
+                (e.m_compression == STORED && e.m_storedSize != e.m_size) ||
+                (e.m_compression != STORED && e.m_compression != ZLIB) ||
+                (i > 0 && hash(i - 1) > hash(i)))
+        {
+            m_count = 0;
+            return false;
+        }
+    }
+    return true;
+}
+
+std::uint64_t PakArchive::hash(std::uint32_t i) const
+{
+    return qFromLittleEndian<quint64>(m_index + i * ENTRY_SIZE);
+}
+bool PakArchive::matches(std::uint32_t i, std::string const& relative) const
+{
+    unsigned char const* record = m_index + i * ENTRY_SIZE;
+    std::uint32_t const nameOffset = qFromLittleEndian<quint32>(record + 32);
+    std::uint16_t const nameSize = qFromLittleEndian<quint16>(record + 36);
+    return nameSize == relative.size() && std::memcmp(m_names + nameOffset, relative.data(), nameSize) == 0;
+}
+PakArchive::Entry PakArchive::entry(std::uint32_t i) const
+{
+    unsigned char const* record = m_index + i * ENTRY_SIZE;
+    Entry e;
+    e.m_offset = qFromLittleEndian<quint64>(record + 8);
+    e.m_storedSize = qFromLittleEndian<quint64>(record + 16);
+    e.m_size = qFromLittleEndian<quint64>(record + 24);
+    e.m_compression = static_cast<Compression>(qFromLittleEndian<quint16>(record + 38));
+    return e;
+}
+
+bool PakArchive::find(std::string const& relative, Entry& out) const
+{
+    std::uint64_t const h = Hash(relative);
+    std::uint32_t first = 0;
+    std::uint32_t count = m_count;
+    while(count > 0)
+    {
+        std::uint32_t const step = count / 2;
+        if(hash(first + step) < h)
+        {
+            first += step + 1;
+            count -= step + 1;
+        }
+        else
+            count = step;
+    }
+    for(std::uint32_t i = first; i < m_count && hash(i) == h; ++i)
+    {
+        if(matches(i, relative))
+        {
+            out = entry(i);
+            return true;
+        }
+    }
+    return false;
+}
+unsigned char const* PakArchive::data(Entry const& e) const
+{
+    return m_data + e.m_offset;
+}
+QByteArray PakArchive::read(Entry const& e) const
+{
+    char const* blob = reinterpret_cast<char const*>(data(e));
+    if(e.m_compression == STORED)
+        return QByteArray(blob, static_cast<int>(e.m_size));
+    QByteArray bytes = qUncompress(reinterpret_cast<uchar const*>(blob), static_cast<int>(e.m_storedSize));
+    return static_cast<std::uint64_t>(bytes.size()) == e.m_size ? bytes : QByteArray();
+}
+std::uint32_t PakArchive::count() const
+{
+    return m_count;
+}
+
+std::uint64_t PakArchive::Hash(std::string const& path)
+{
+    std::uint64_t h = 14695981039346656037ull;
+    for(char c : path)
+    {
+        h ^= static_cast<unsigned char>(c);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+bool PakArchive::Write(std::string const& path, std::string const& root,
+                       std::vector<std::string> const& files, bool compress)
+{
+    struct Item {
+        std::string m_name;
+        std::uint64_t m_hash;
+        std::uint64_t m_size;
+        std::uint32_t m_nameOffset;
+        // Only kept for entries that deflated well; the rest are read
+        // again while writing.
+        QByteArray m_compressed;
+        std::uint64_t m_offset;
+    };
+    std::vector<Item> items;
+    items.reserve(files.size());
+    for(std::string const& file : files)
+    {
+        if(file.size() > 0xFFFF)
+            return false;
+        QFile f(QString::fromStdString(root + "/" + file));
+        if(!f.open(QFile::ReadOnly) || f.size() > INT_MAX)
+            return false;
+        Item item;
+        item.m_name = file;
+        item.m_hash = Hash(file);
+        item.m_size = static_cast<std::uint64_t>(f.size());
+        if(compress)
+        {
+            QByteArray compressed = qCompress(f.readAll());
+            if(static_cast<std::uint64_t>(compressed.size()) <= item.m_size - item.m_size / 8)
+                item.m_compressed = std::move(compressed);
+        }
+        items.push_back(std::move(item));
+    }
+    std::sort(items.begin(), items.end(), [](Item const& a, Item const& b) {
+        return a.m_hash != b.m_hash ? a.m_hash < b.m_hash : a.m_name < b.m_name;
+    });
+
+    QByteArray names;
+    for(Item& item : items)
+    {
+        item.m_nameOffset = static_cast<std::uint32_t>(names.size());
+        names.append(item.m_name.data(), static_cast<int>(item.m_name.size()));
+    }
+    std::uint64_t offset = Align(HEADER_SIZE + items.size() * ENTRY_SIZE + names.size());
+    for(Item& item : items)
+    {
+        item.m_offset = offset;
+        offset = Align(offset + (item.m_compressed.isEmpty() ? item.m_size : item.m_compressed.size()));
+    }
+
+    QByteArray head;
+    Put<quint32>(head, MAGIC);
+    Put<quint32>(head, VERSION);
+    Put<quint32>(head, static_cast<quint32>(items.size()));
+    Put<quint32>(head, static_cast<quint32>(names.size()));
+    for(Item const& item : items)
+    {
+        bool const deflated = !item.m_compressed.isEmpty();
+        Put<quint64>(head, item.m_hash);
+        Put<quint64>(head, item.m_offset);
+        Put<quint64>(head, deflated ? item.m_compressed.size() : item.m_size);
+        Put<quint64>(head, item.m_size);
+        Put<quint32>(head, item.m_nameOffset);
+        Put<quint16>(head, static_cast<quint16>(item.m_name.size()));
+        Put<quint16>(head, deflated ? ZLIB : STORED);
+    }
+    head.append(names);
+
+    QSaveFile out(QString::fromStdString(path));
+    if(!out.open(QFile::WriteOnly) || out.write(head) != head.size())
+        return false;
+    for(Item const& item : items)
+    {
+        QByteArray const padding(static_cast<int>(item.m_offset - out.pos()), '\0');
+        if(out.write(padding) != padding.size())
+            return false;
+        QByteArray blob = item.m_compressed;
+        if(blob.isEmpty())
+        {
+            QFile f(QString::fromStdString(root + "/" + item.m_name));
+            if(!f.open(QFile::ReadOnly))
+                return false;
+            blob = f.readAll();
+            if(static_cast<std::uint64_t>(blob.size()) != item.m_size)
+                return false;
+        }
+        if(out.write(blob) != blob.size())
+            return false;
+    }
+    return out.commit();
+}
+
+// Vfs
+char const* const Vfs::EXTENSION = "pak";
+
+Vfs& Vfs::Instance()
+{
+    static Vfs vfs;
+    return vfs;
+}
+
+bool Vfs::mount(std::string const& archive, std::string const& mountPoint, int priority)
+{
+    auto pak = std::make_shared<PakArchive>();
+    if(!pak->open(archive))
+        return false;
+    Mount m;
+    m.m_archive = Absolute(archive);
+    m.m_point = Absolute(mountPoint) + "/";
+    m.m_priority = priority;
+    m.m_pak = std::move(pak);
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_mounts.erase(std::remove_if(m_mounts.begin(), m_mounts.end(), [&m](Mount const& other) {
+        return other.m_archive == m.m_archive;
+    }), m_mounts.end());
+    // Searched front to back: highest priority first, newest first among equals.
+    auto at = std::find_if(m_mounts.begin(), m_mounts.end(), [&m](Mount const& other) {
+        return other.m_priority <= m.m_priority;
+    });
+    m_mounts.insert(at, std::move(m));
+    return true;
+}
+bool Vfs::unmount(std::string const& archive)
+{
+    std::string const absolute = Absolute(archive);
+    std::lock_guard<std::mutex> lock(m_lock);
+    auto it = std::find_if(m_mounts.begin(), m_mounts.end(), [&absolute](Mount const& m) {
+        return m.m_archive == absolute;
+    });
+    if(it == m_mounts.end())
+        return false;
+    // Devices still open keep the mapping alive.
+    m_mounts.erase(it);
+    return true;
+}
+std::size_t Vfs::mountFolder(std::string const& folder, int priority)
+{
+    QDir const dir(QString::fromStdString(folder));
+    QStringList const archives = dir.entryList({ QString("*.") + EXTENSION }, QDir::Files, QDir::Name);
+    std::size_t mounted = 0;
+    for(QString const& name : archives)
+    {
+        if(mount(dir.filePath(name).toStdString(), folder, priority))
+            ++mounted;
+    }
+    return mounted;
+}
+void Vfs::clear()
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_mounts.clear();
+}
+
+std::shared_ptr<PakArchive> Vfs::resolve(std::string const& path, PakArchive::Entry& entry) const
+{
+    if(path.empty() || path[0] == ':')
+        return nullptr;
+    std::string const absolute = Absolute(path);
+    std::lock_guard<std::mutex> lock(m_lock);
+    for(Mount const& m : m_mounts)
+    {
+        if(absolute.compare(0, m.m_point.size(), m.m_point) == 0 &&
+                m.m_pak->find(absolute.substr(m.m_point.size()), entry))
+            return m.m_pak;
+    }
+    return nullptr;
+}
+
+bool Vfs::exists(std::string const& path) const
+{
+    PakArchive::Entry entry;
+    return resolve(path, entry) || QFileInfo(QString::fromStdString(path)).isFile();
+}
+std::unique_ptr<QIODevice> Vfs::open(std::string const& path) const
+{
+    PakArchive::Entry entry;
+    if(std::shared_ptr<PakArchive> pak = resolve(path, entry))
+    {
+        if(entry.m_compression == PakArchive::STORED)
+        {
+            // No copy: the buffer reads the mapping.
+            QByteArray const bytes = QByteArray::fromRawData(reinterpret_cast<char const*>(pak->data(entry)),
+                                                             static_cast<int>(entry.m_size));
+            return std::unique_ptr<QIODevice>(new PakDevice(std::move(pak), bytes));
+        }
+        QByteArray bytes = pak->read(entry);
+        if(bytes.isNull())
+            return nullptr;
+        return std::unique_ptr<QIODevice>(new PakDevice(std::move(pak), std::move(bytes)));
+    }
+    std::unique_ptr<QFile> file(new QFile(QString::fromStdString(path)));
+    if(!file->open(QFile::ReadOnly))
+        return nullptr;
+    return std::move(file);
+}
+QByteArray Vfs::read(std::string const& path) const
+{
+    PakArchive::Entry entry;
+    if(std::shared_ptr<PakArchive> pak = resolve(path, entry))
+        return pak->read(entry);
+    QFile file(QString::fromStdString(path));
+    if(!file.open(QFile::ReadOnly))
+        return QByteArray();
+    return file.readAll();
+}
+
+int Vfs::LuaSearcher(lua_State* s)
+{
+    // Nothing with a destructor may be live when lua_error jumps.
+    char const* name = luaL_checkstring(s, 1);
+    int const results = SearchPath(s, name);
+    if(results < 0)
+        return lua_error(s);
+    return results;
+}
+
+}
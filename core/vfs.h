@@ -0,0 +1,113 @@
+#ifndef LUACORE_VFS_H
+#define LUACORE_VFS_H
+#include <mutex>
+#include <vector>
+#include <QIODevice>
+#include "shared.h"
+
+namespace LuaApi {
+    // A read-only archive of files, memory-mapped whole. Layout, all
+    // little endian:
+    //
+    //   header   magic, version, entry count, name table size (32 bit)
+    //   index    per entry: path hash, blob offset, stored size, size
+    //            (64 bit), name offset (32 bit), name size, compression
+    //            (16 bit); sorted by hash
+    //   names    the entries' paths, relative and '/' separated
+    //   blobs    each aligned to ALIGNMENT
+    //
+    // Stored blobs are served straight from the mapping. ZLIB blobs are in
+    // qCompress's format and are inflated on every read.
+    class PakArchive {
+    public:
+        enum : std::uint32_t {
+            MAGIC = 0x4B50524F, // "ORPK"
+            VERSION = 1,
+            HEADER_SIZE = 16,
+            ENTRY_SIZE = 40,
+            ALIGNMENT = 64
+        };
+        enum Compression : std::uint16_t {
+            STORED,
+            ZLIB
+        };
+        struct Entry {
+            std::uint64_t m_offset;
+            std::uint64_t m_storedSize;
+            std::uint64_t m_size;
+            Compression m_compression;
+        };
+    private:
+        QFile m_file;
+        unsigned char const* m_data;
+        std::uint64_t m_size;
+        std::uint32_t m_count;
+        unsigned char const* m_index;
+        char const* m_names;
+
+        std::uint64_t hash(std::uint32_t) const;
+        bool matches(std::uint32_t, std::string const&) const;
+        Entry entry(std::uint32_t) const;
+    public:
+        PakArchive();
+        ~PakArchive();
+        PakArchive(PakArchive const&) = delete;
+        PakArchive& operator=(PakArchive const&) = delete;
+
+        // False if the file can't be mapped or fails validation.
+        bool open(std::string const& path);
+        bool find(std::string const& relative, Entry&) const;
+        unsigned char const* data(Entry const&) const;
+        QByteArray read(Entry const&) const;
+        std::uint32_t count() const;
+
+        // FNV-1a, 64 bit.
+        static std::uint64_t Hash(std::string const&);
+        // Packs root/<file> for every relative path in files. With
+        // compress, entries are deflated when that saves an eighth or more.
+        static bool Write(std::string const& path, std::string const& root,
+                          std::vector<std::string> const& files, bool compress);
+    };
+
+    // Every file the engine loads goes through here. Archives are mounted
+    // at a directory and shadow the loose files beneath it; among
+    // archives, the higher priority wins, then the later mount. Paths not
+    // found in any archive, Qt resources included, are read from disk.
+    //
+    // Mounting happens on the main thread; lookups may come from any.
+    class Vfs {
+        struct Mount {
+            std::string m_archive;
+            // Absolute, with a trailing slash.
+            std::string m_point;
+            int m_priority;
+            std::shared_ptr<PakArchive> m_pak;
+        };
+        mutable std::mutex m_lock;
+        std::vector<Mount> m_mounts;
+
+        std::shared_ptr<PakArchive> resolve(std::string const& path, PakArchive::Entry&) const;
+    public:
+        static char const* const EXTENSION;
+
+        static Vfs& Instance();
+
+        bool mount(std::string const& archive, std::string const& mountPoint, int priority);
+        bool unmount(std::string const& archive);
+        // Mounts every archive directly in folder at folder, in name
+        // order, so pak1 overrides pak0. Returns how many mounted.
+        std::size_t mountFolder(std::string const& folder, int priority);
+        void clear();
+
+        bool exists(std::string const& path) const;
+        // Positioned at the start; null if the file can't be found.
+        std::unique_ptr<QIODevice> open(std::string const& path) const;
+        // Empty if the file can't be found.
+        QByteArray read(std::string const& path) const;
+
+        // package.searchers entry resolving package.path through the Vfs.
+        static int LuaSearcher(lua_State*);
+    };
+}
+
+#endif
@@ -0,0 +1,226 @@
+#include "gamehost.h"
+#include <QCoreApplication>
+#include <QDir>
+
+static QString tr(char const* text)
+{
+    return QCoreApplication::translate("GameHost", text);
+}
+
+GameHost::GameHost(GameMode gamemode) :
+    state(Lua::State::create()),
+    m_gamemode(gamemode),
+    m_basePath(QDir::currentPath())
+{
+    m_heap.Install(state);
+    state.luapp_register_metatables();
+}
+
+GameHost::~GameHost()
+{
+}
+
+static const luaL_Reg loadedlibs[] = {
+    {"_G", luaopen_base},
+    {LUA_LOADLIBNAME, luaopen_package},
+    {LUA_COLIBNAME, luaopen_coroutine},
+    {LUA_TABLIBNAME, luaopen_table},
+    {LUA_STRLIBNAME, luaopen_string},
+    {LUA_MATHLIBNAME, luaopen_math},
+    {LUA_UTF8LIBNAME, luaopen_utf8},
+    {NULL, NULL}
+};
+
+std::string GameHost::DataPath() const
+{
+     return m_basePath.toStdString() + "/gamemode/" + m_gamemode.SubFolder.toStdString() + "/data/";
+}
+
+LuaApi::TickScheduler& GameHost::Scheduler()
+{
+    return m_scheduler;
+}
+
+LuaApi::FramePacer& GameHost::Pacer()
+{
+    return m_pacer;
+}
+
+LuaApi::LuaHeap& GameHost::Heap()
+{
+    return m_heap;
+}
+
+LuaApi::GcPacer& GameHost::Collector()
+{
+    return m_collector;
+}
+
+GameMode const& GameHost::Mode() const
+{
+    return m_gamemode;
+}
+
+void GameHost::SetRequireCPath(std::string const& cpath)
+{
+    state.getglobal("package");
+    state.pushstdstring(cpath);
+    state.setfield(-2, "cpath");
+    state.pop(1);
+}
+
+void GameHost::SetRequirePath(std::string const& path)
+{
+    state.getglobal("package");
+    state.pushstdstring(path);
+    state.setfield(-2, "path");
+    state.pop(1);
+}
+
+bool GameHost::registerLuaFunctions(GL_t* gl)
+{
+    LuaApi::LuaHeap::Scope heapScope(m_heap, LuaApi::LuaHeap::STARTUP);
+    {
+        const luaL_Reg* lib;
+        for(lib = loadedlibs; lib->func; lib++) {
+            state.requiref(lib->name,lib->func,1);
+            state.pop(1);
+        }
+    }
+    SetRequireCPath(std::string());
+    SetRequirePath(std::string());
+    // require reads through the Vfs instead of the file searcher.
+    state.getglobal("package");
+    state.getfield(-1, "searchers");
+    state.pushcfunction(&LuaApi::Vfs::LuaSearcher);
+    state.rawseti(-2, 2);
+    state.pop(2);
+
+    std::string ApiPath = m_basePath.toStdString() + "/api/";
+    std::string GmPath = m_basePath.toStdString() + "/gamemode/" + m_gamemode.SubFolder.toStdString() + "/";
+    
+    // Archives shadow the loose files of the folder they sit in.
+    LuaApi::Vfs& vfs = LuaApi::Vfs::Instance();
+    vfs.clear();
+    vfs.mountFolder(ApiPath, 0);
+    vfs.mountFolder(GmPath, 1);
+    // Loaders prefer what openrp-cook made of this gamemode's data.
+    LuaApi::AssetManifest::Instance().read(DataPath());
+    try {
+        m_link.Init(gl,this,state);
+    } catch(std::exception& e) {
+        FatalError(tr("Loading Error"),e.what());
+        return false;
+    }
+    
+    std::string ApiRequirements =
+            ApiPath + "?.lua;" +
+            ApiPath + "modules/?.lua;" +
+            ApiPath + "lua/?.lua";
+    
+    std::string GamemodeRequirements =
+            ApiRequirements + ";" +
+            GmPath + "?.lua;" +
+            GmPath + "modules/?.lua;" +
+            GmPath + "lua/?.lua";
+    
+    for(auto it = m_gamemode.Modules.begin(); it != m_gamemode.Modules.end(); ++it)
+    {
+        QString str = *it;
+        if(str.at(0) != '/')
+        {
+            str = m_basePath + "/gamemode/" + m_gamemode.SubFolder + "/" + *it;
+            SetRequirePath(GamemodeRequirements);
+        }
+        else
+        {
+            str.remove(0,1);
+            str = m_basePath + "/" + str;
+            SetRequirePath(ApiRequirements);
+        }
+
+        std::string const file = str.toStdString();
+        int status = LUA_ERRFILE;
+        if(vfs.exists(file))
+        {
+            QByteArray const chunk = vfs.read(file);
+            status = state.loadbuffer(chunk.constData(), chunk.size(), ("@" + file).c_str());
+        }
+        else
+            state.pushstdstring("cannot open " + file);
+        if(status != 0)
+        {
+            FatalError(tr("Error loading gamemode %1").arg(m_gamemode.Name),tr("Lua Error while opening module file %1.\nLua Error: %2").arg(str).arg(QString::fromStdString(state.tostdstring(1))));
+            return false;
+        }
+        if(state.pcall() != 0)
+        {
+            FatalError(tr("Error loading gamemode %1").arg(m_gamemode.Name),tr("Lua Error while loading module file %1.\nLua Error: %2").arg(str).arg(QString::fromStdString(state.tostdstring(1))));
+            return false;
+        }
+    }
+    
+    SetRequirePath(GamemodeRequirements);
+    return true;
+}
+
+bool GameHost::runStartup()
+{
+    LuaApi::LuaHeap::Scope heapScope(m_heap, LuaApi::LuaHeap::STARTUP);
+    if(state.getglobal("startup") != LUA_TFUNCTION)
+    {
+        state.pop(1);
+        return true;
+    }
+    if(state.pcall() != 0)
+    {
+        FatalError(tr("Error running gamemode %1").arg(m_gamemode.Name),tr("Lua Error while loading window.\nLua Error: %1").arg(QString::fromStdString(state.tostdstring(1))));
+        return false;
+    }
+    m_scheduler.Reset();
+    m_collector.Start(state, m_heap);
+    return true;
+}
+
+bool GameHost::preCallLuaFunction(const char* name)
+{
+    if(state.getglobal(name) != LUA_TFUNCTION)
+    {
+        state.pop(1);
+        return false;
+    }
+    return true;
+}
+
+bool GameHost::callLuaFunction(const char* name, int args)
+{
+    if(state.pcall(args) != 0)
+    {
+        FatalError(tr("Error running gamemode %1").arg(m_gamemode.Name),
+                   tr("Lua Error while calling fundamental function: %1.\nLua Error: %2").arg(QString(name)).arg(QString::fromStdString(state.tostdstring(1))));
+        return false;
+    }
+    return true;
+}
+
+bool GameHost::runTicks(std::uint32_t steps)
+{
+    LuaApi::LuaHeap::Scope heapScope(m_heap, LuaApi::LuaHeap::TICK);
+    for(std::uint32_t i = 0; i < steps; ++i)
+    {
+        if(!preCallLuaFunction("tick"))
+            return true;
+        
+        LuaApi::TickScheduler::clock::time_point start = LuaApi::TickScheduler::clock::now();
+        state.pushnumber(m_scheduler.StepSeconds());
+        if(!callLuaFunction("tick",1))
+            return false;
+        m_scheduler.RecordTick(LuaApi::TickScheduler::clock::now() - start);
+    }
+    return true;
+}
+
+void GameHost::collectGarbage()
+{
+    m_collector.Step(state, m_heap, m_pacer.FrameBudget(), m_pacer.FrameElapsed());
+}
@@ -0,0 +1,54 @@
+#ifndef GAMEHOST_H
+#define GAMEHOST_H
+
+#include <QString>
+#include "shared.h"
+#include "al/all.h"
+#include "gl/all.h"
+#include "core/all.h"
+#include "state.h"
+#include "gamemode.h"
+#include "link.h"
+
+// Owns the Lua VM and the gamemode running in it.
+// GameWindow drives it from a visible window, HeadlessRunner from an
+// offscreen surface; both only supply GL and report fatal errors.
+class GameHost
+{
+public:
+    explicit GameHost(GameMode gamemode);
+    virtual ~GameHost();
+    std::string DataPath() const;
+    LuaApi::TickScheduler& Scheduler();
+    LuaApi::FramePacer& Pacer();
+    LuaApi::LuaHeap& Heap();
+    LuaApi::GcPacer& Collector();
+    GameMode const& Mode() const;
+
+protected:
+    bool registerLuaFunctions(GL_t*);
+    bool runStartup();
+    bool runTicks(std::uint32_t);
+    void collectGarbage();
+    
+    void SetRequireCPath(std::string const&);
+    void SetRequirePath(std::string const&);
+    
+    virtual void FatalError(QString const& title, QString const& description) =0;
+    
+    bool preCallLuaFunction(char const*);
+    bool callLuaFunction(char const*, int =0);
+    
+    // Declared before the state: the VM frees into it while closing.
+    LuaApi::LuaHeap m_heap;
+    Lua::State state;
+
+    GameMode m_gamemode;
+    LuaApi::Link m_link;
+    QString m_basePath;
+    LuaApi::TickScheduler m_scheduler;
+    LuaApi::FramePacer m_pacer;
+    LuaApi::GcPacer m_collector;
+};
+
+#endif // GAMEHOST_H
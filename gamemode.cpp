@@ -0,0 +1,31 @@
+#include "gamemode.h"
+
+static QList<GameMode> const g_gamemodes = {
+    { "Roleplay", "rp", QStringList() << "main.lua" }
+};
+
+QList<GameMode> const& GameMode::Available()
+{
+    return g_gamemodes;
+}
+
+bool GameMode::Find(QString const& name, GameMode& out)
+{
+    for(auto it = g_gamemodes.begin(); it != g_gamemodes.end(); ++it)
+    {
+        if(it->Name.compare(name, Qt::CaseInsensitive) == 0 ||
+                it->SubFolder.compare(name, Qt::CaseInsensitive) == 0)
+        {
+            out = *it;
+            return true;
+        }
+    }
+    return false;
+}
+
+GameMode GameMode::WithApi() const
+{
+    GameMode gm = *this;
+    gm.Modules.insert(gm.Modules.begin(),"/api/openrp.lua");
+    return gm;
+}
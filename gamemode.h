@@ -1,11 +1,16 @@
 #ifndef GAMEMODE_H
 #define GAMEMODE_H
+#include <QList>
 #include <QStringList>
 
 struct GameMode {
     QString Name;
     QString SubFolder;
     QStringList Modules;
+    
+    static QList<GameMode> const& Available();
+    static bool Find(QString const& name, GameMode& out);
+    GameMode WithApi() const;
 };
 
 
@@ -1,7 +1,6 @@
 #include "gamewindow.h"
 #include <QCoreApplication>
 #include <QMessageBox>
-#include <QDir>
 #include <QKeyEvent>
 #include <QMouseEvent>
 #include <cmath>
@@ -9,13 +8,19 @@
 
 GameWindow::GameWindow(QWindow* parent, GameMode gamemode, StartupWindow* startupWindow) :
     QOpenGLWindow(QOpenGLWindow::NoPartialUpdate, parent),
-    state(Lua::State::create()),
-    m_gamemode(gamemode),
+    GameHost(gamemode),
     m_startupWindow(startupWindow),
-    m_basePath(QDir::currentPath())
+    m_frameRequested(false),
+    m_framePending(false),
+    m_failed(false)
 {
     this->setTitle(tr("OpenRP - %1 - %2").arg(QCoreApplication::applicationVersion()).arg(m_gamemode.Name));
-    state.luapp_register_metatables();
+    
+    m_frameTimer.setSingleShot(true);
+    m_frameTimer.setTimerType(Qt::PreciseTimer);
+    connect(&m_frameTimer, &QTimer::timeout, this, &GameWindow::onFrameTimer);
+    connect(&m_hiddenTimer, &QTimer::timeout, this, &GameWindow::onHiddenTick);
+    connect(this, &QOpenGLWindow::frameSwapped, this, &GameWindow::onFrameSwapped);
 }
 
 void GameWindow::printContextInformations()
@@ -43,130 +48,17 @@ void GameWindow::printContextInformations()
     qDebug() << qPrintable(glType) << qPrintable(glVersion) << qPrintable(glProfile);
 }
 
-void GameWindow::FatalError(QString const& title, QString const& description)
-{
-    hide();
-    QMessageBox::critical(nullptr,title,description);
-    CloseToStartupWindow();
-}
-
 void GameWindow::initializeGL()
 {
     initializeOpenGLFunctions();
     printContextInformations();
     
-    if(!registerLuaFunctions())
+    if(!registerLuaFunctions(this))
         return;
 
     glClearColor(0.0f,0.0f,0.0f,1.0f);
     glClearDepthf(0.0f);
-    if(state.getglobal("startup") != LUA_TFUNCTION)
-    {
-        state.pop(1);
-        return;
-    }
-    if(state.pcall() != 0)
-    {
-        hide();
-        QMessageBox::critical(nullptr,tr("Error running gamemode %1").arg(m_gamemode.Name),tr("Lua Error while loading window.\nLua Error: %1").arg(QString::fromStdString(state.tostdstring(1))));
-        CloseToStartupWindow();
-        return;
-    }
-}
-
-static const luaL_Reg loadedlibs[] = {
-    {"_G", luaopen_base},
-    {LUA_LOADLIBNAME, luaopen_package},
-    {LUA_COLIBNAME, luaopen_coroutine},
-    {LUA_TABLIBNAME, luaopen_table},
-    {LUA_STRLIBNAME, luaopen_string},
-    {LUA_MATHLIBNAME, luaopen_math},
-    {LUA_UTF8LIBNAME, luaopen_utf8},
-    {NULL, NULL}
-};
-
-std::string GameWindow::DataPath() const
-{
-     return m_basePath.toStdString() + "/gamemode/" + m_gamemode.SubFolder.toStdString() + "/data/";
-}
-
-void GameWindow::SetRequireCPath(std::string const& cpath)
-{
-    state.getglobal("package");
-    state.pushstdstring(cpath);
-    state.setfield(-2, "cpath");
-    state.pop(1);
-}
-
-void GameWindow::SetRequirePath(std::string const& path)
-{
-    state.getglobal("package");
-    state.pushstdstring(path);
-    state.setfield(-2, "path");
-    state.pop(1);
-}
-
-bool GameWindow::registerLuaFunctions()
-{
-    {
-        const luaL_Reg* lib;
-        for(lib = loadedlibs; lib->func; lib++) {
-            state.requiref(lib->name,lib->func,1);
-            state.pop(1);
-        }
-    }
-    SetRequireCPath(std::string());
-    SetRequirePath(std::string());
-    try {
-        m_link.Init(this,this,state);
-    } catch(std::exception& e) {
-        FatalError(tr("Loading Error"),e.what());
-        return false;
-    }
-
-    std::string ApiPath = m_basePath.toStdString() + "/api/";
-    std::string GmPath = m_basePath.toStdString() + "/gamemode/" + m_gamemode.SubFolder.toStdString() + "/";
-    
-    std::string ApiRequirements =
-            ApiPath + "?.lua;" +
-            ApiPath + "modules/?.lua;" +
-            ApiPath + "lua/?.lua";
-    
-    std::string GamemodeRequirements =
-            ApiRequirements + ";" +
-            GmPath + "?.lua;" +
-            GmPath + "modules/?.lua;" +
-            GmPath + "lua/?.lua";
-    
-    for(auto it = m_gamemode.Modules.begin(); it != m_gamemode.Modules.end(); ++it)
-    {
-        QString str = *it;
-        if(str.at(0) != '/')
-        {
-            str = m_basePath + "/gamemode/" + m_gamemode.SubFolder + "/" + *it;
-            SetRequirePath(GamemodeRequirements);
-        }
-        else
-        {
-            str.remove(0,1);
-            str = m_basePath + "/" + str;
-            SetRequirePath(ApiRequirements);
-        }
-
-        if(state.loadfile(str.toStdString().c_str()) != 0)
-        {
-            FatalError(tr("Error loading gamemode %1").arg(m_gamemode.Name),tr("Lua Error while opening module file %1.\nLua Error: %2").arg(str).arg(QString::fromStdString(state.tostdstring(1))));
-            return false;
-        }
-        if(state.pcall() != 0)
-        {
-            FatalError(tr("Error loading gamemode %1").arg(m_gamemode.Name),tr("Lua Error while loading module file %1.\nLua Error: %2").arg(str).arg(QString::fromStdString(state.tostdstring(1))));
-            return false;
-        }
-    }
-    
-    SetRequirePath(GamemodeRequirements);
-    return true;
+    runStartup();
 }
 
 void GameWindow::CloseToStartupWindow()
@@ -183,27 +75,15 @@ void GameWindow::CloseToDesktop()
     close();
 }
 
-bool GameWindow::preCallLuaFunction(const char* name)
-{
-    if(state.getglobal(name) != LUA_TFUNCTION)
-    {
-        state.pop(1);
-        return false;
-    }
-    return true;
-}
-
-bool GameWindow::callLuaFunction(const char* name, int args)
+void GameWindow::FatalError(QString const& title, QString const& description)
 {
-    if(state.pcall(args) != 0)
-    {
-        hide();
-        QMessageBox::critical(nullptr,tr("Error running gamemode %1").arg(m_gamemode.Name),
-                              tr("Lua Error while calling fundamental function: %1.\nLua Error: %2").arg(QString(name)).arg(QString::fromStdString(state.tostdstring(1))));
-        CloseToStartupWindow();
-        return false;
-    }
-    return true;
+    // Nothing may tick the failed state while the dialog's loop runs.
+    m_failed = true;
+    m_frameTimer.stop();
+    m_hiddenTimer.stop();
+    hide();
+    QMessageBox::critical(nullptr,title,description);
+    CloseToStartupWindow();
 }
 
 void GameWindow::resizeGL(int w, int h)
@@ -221,18 +101,100 @@ void GameWindow::resizeGL(int w, int h)
 void GameWindow::paintGL()
 {
     QOpenGLWindow::paintGL();
+    if(m_failed)
+        return;
+    
+    if(!runTicks(m_scheduler.Advance()))
+        return;
+    
+    LuaApi::LuaHeap::Scope heapScope(m_heap, LuaApi::LuaHeap::FRAME);
+    if(preCallLuaFunction("frame"))
+    {
+        state.pushnumber(m_scheduler.Alpha());
+        if(callLuaFunction("frame",1))
+            m_frameRequested = true;
+    }
+    else if(preCallLuaFunction("tick"))
+    {
+        state.pop(1);
+        m_frameRequested = true;
+    }
+}
+
+void GameWindow::onFrameSwapped()
+{
+    if(!m_frameRequested)
+        return;
+    m_frameRequested = false;
+    
+    if(m_pacer.LowLatency())
+    {
+        // Don't let the driver queue frames ahead of us: the next frame
+        // starts (and reads input) only once this one is on screen.
+        makeCurrent();
+        glFinish();
+    }
+    scheduleFrame();
+}
+
+void GameWindow::scheduleFrame()
+{
+    if(m_failed)
+        return;
+    if(!m_pacer.Visible())
+    {
+        m_framePending = true;
+        return;
+    }
     
-    if(preCallLuaFunction("frame") &&
-        callLuaFunction("frame"))
+    if(m_pacer.LowLatency())
     {
+        m_pacer.WaitForDeadline();
         this->update();
+        return;
     }
+    
+    int sleep = m_pacer.SleepMilliseconds();
+    if(sleep > 0)
+        m_frameTimer.start(sleep);
+    else
+        onFrameTimer();
+}
+
+void GameWindow::onFrameTimer()
+{
+    m_pacer.SpinUntilDeadline();
+    this->update();
+}
+
+void GameWindow::onHiddenTick()
+{
+    if(m_failed)
+    {
+        m_hiddenTimer.stop();
+        return;
+    }
+    // The rate may have changed since the window hid.
+    int const interval = m_pacer.HiddenTickMilliseconds();
+    if(interval <= 0)
+    {
+        m_hiddenTimer.stop();
+        return;
+    }
+    if(m_hiddenTimer.interval() != interval)
+        m_hiddenTimer.setInterval(interval);
+    
+    makeCurrent();
+    if(runTicks(m_scheduler.AdvanceBackground(interval / 1000.0)))
+        collectGarbage();
 }
 
 void GameWindow::paintUnderGL()
 {
     QOpenGLWindow::paintUnderGL();
+    m_pacer.BeginFrame();
     
+    LuaApi::LuaHeap::Scope heapScope(m_heap, LuaApi::LuaHeap::FRAME);
     if(preCallLuaFunction("begin_frame"))
         callLuaFunction("begin_frame");
 }
@@ -241,13 +203,20 @@ void GameWindow::paintOverGL()
 {
     QOpenGLWindow::paintOverGL();
     
-    if(preCallLuaFunction("end_frame"))
-        callLuaFunction("end_frame");
+    {
+        LuaApi::LuaHeap::Scope heapScope(m_heap, LuaApi::LuaHeap::FRAME);
+        if(preCallLuaFunction("end_frame"))
+            callLuaFunction("end_frame");
+    }
+    LuaApi::TextureStreamer::Instance().EndFrame();
+    collectGarbage();
+    m_heap.EndFrame();
 }
 
 void GameWindow::focusInEvent(QFocusEvent* e)
 {
     QOpenGLWindow::focusInEvent(e);
+    m_pacer.SetFocused(true);
     
     if(preCallLuaFunction("focus"))
     {
@@ -260,6 +229,7 @@ void GameWindow::focusInEvent(QFocusEvent* e)
 void GameWindow::focusOutEvent(QFocusEvent* e)
 {
     QOpenGLWindow::focusOutEvent(e);
+    m_pacer.SetFocused(false);
     
     if(preCallLuaFunction("focus"))
     {
@@ -272,6 +242,16 @@ void GameWindow::focusOutEvent(QFocusEvent* e)
 void GameWindow::hideEvent(QHideEvent* e)
 {
     QOpenGLWindow::hideEvent(e);
+    m_pacer.SetVisible(false);
+    if(m_failed)
+        return;
+    if(m_frameTimer.isActive())
+    {
+        m_frameTimer.stop();
+        m_framePending = true;
+    }
+    if(m_pacer.HiddenTickMilliseconds() > 0)
+        m_hiddenTimer.start(m_pacer.HiddenTickMilliseconds());
     
     if(preCallLuaFunction("show"))
     {
@@ -284,6 +264,16 @@ void GameWindow::hideEvent(QHideEvent* e)
 void GameWindow::exposeEvent(QExposeEvent* e)
 {
     QOpenGLWindow::exposeEvent(e);
+    m_pacer.SetVisible(isExposed());
+    if(isExposed())
+    {
+        m_hiddenTimer.stop();
+        if(m_framePending)
+        {
+            m_framePending = false;
+            this->update();
+        }
+    }
     
     if(preCallLuaFunction("show"))
     {
@@ -297,6 +287,7 @@ void GameWindow::keyPressEvent(QKeyEvent* e)
 {
     QOpenGLWindow::keyPressEvent(e);
     
+    LuaApi::LuaHeap::Scope heapScope(m_heap, LuaApi::LuaHeap::INPUT);
     if(preCallLuaFunction("keydown"))
     {
         state.pushinteger(e->key());
@@ -311,6 +302,7 @@ void GameWindow::keyReleaseEvent(QKeyEvent* e)
 {
     QOpenGLWindow::keyReleaseEvent(e);
     
+    LuaApi::LuaHeap::Scope heapScope(m_heap, LuaApi::LuaHeap::INPUT);
     if(preCallLuaFunction("keyup"))
     {
         state.pushinteger(e->key());
@@ -325,6 +317,7 @@ void GameWindow::mouseMoveEvent(QMouseEvent* e)
 {
     QOpenGLWindow::mouseMoveEvent(e);
     
+    LuaApi::LuaHeap::Scope heapScope(m_heap, LuaApi::LuaHeap::INPUT);
     if(preCallLuaFunction("mousemove"))
     {
         state.pushinteger(e->x());
@@ -338,6 +331,7 @@ void GameWindow::mousePressEvent(QMouseEvent* e)
 {
     QOpenGLWindow::mousePressEvent(e);
     
+    LuaApi::LuaHeap::Scope heapScope(m_heap, LuaApi::LuaHeap::INPUT);
     if(preCallLuaFunction("mousedown"))
     {
         state.pushinteger(e->button());
@@ -352,6 +346,7 @@ void GameWindow::mouseReleaseEvent(QMouseEvent* e)
 {
     QOpenGLWindow::mouseReleaseEvent(e);
     
+    LuaApi::LuaHeap::Scope heapScope(m_heap, LuaApi::LuaHeap::INPUT);
     if(preCallLuaFunction("mouseup"))
     {
         state.pushinteger(e->button());
@@ -391,6 +386,7 @@ void GameWindow::wheelEvent(QWheelEvent* e)
         y == 0)
         return;
     
+    LuaApi::LuaHeap::Scope heapScope(m_heap, LuaApi::LuaHeap::INPUT);
     if(preCallLuaFunction("wheel"))
     {
         state.pushnumber(x);
@@ -2,23 +2,18 @@
 #define GAMEWINDOW_H
 
 #include <QOpenGLWindow>
-#include "shared.h"
-#include "al/all.h"
-#include "gl/all.h"
-#include "state.h"
-#include "gamemode.h"
-#include "link.h"
+#include <QTimer>
+#include "gamehost.h"
 
 class StartupWindow;
 
-class GameWindow : public QOpenGLWindow, public GL_t
+class GameWindow : public QOpenGLWindow, public GL_t, public GameHost
 {
     Q_OBJECT
 
 public:
     explicit GameWindow(QWindow* parent, GameMode gamemode, StartupWindow* startupWindow);
     ~GameWindow();
-    std::string DataPath() const;
 
 protected:
     void initializeGL() override;
@@ -41,24 +36,25 @@ protected:
     void wheelEvent(QWheelEvent *) override;
 
     void printContextInformations();
-    bool registerLuaFunctions();
 
     void CloseToStartupWindow();
     void CloseToDesktop();
-    void SetRequireCPath(std::string const&);
-    void SetRequirePath(std::string const&);
     
-    void FatalError(QString const& title, QString const& description);
+    void FatalError(QString const& title, QString const& description) override;
     
 private:
-    bool preCallLuaFunction(char const*);
-    bool callLuaFunction(char const*, int =0);
-    Lua::State state;
+    void scheduleFrame();
+    void onFrameSwapped();
+    void onFrameTimer();
+    void onHiddenTick();
 
-    GameMode m_gamemode;
     StartupWindow* m_startupWindow;
-    LuaApi::Link m_link;
-    QString m_basePath;
+    QTimer m_frameTimer;
+    QTimer m_hiddenTimer;
+    bool m_frameRequested;
+    bool m_framePending;
+    // Set by FatalError; the VM is not run again.
+    bool m_failed;
 };
 
 #endif // GAMEWINDOW_H
@@ -2,12 +2,22 @@
 #define LUAGL_ALL_H
 
 #include "shared.h"
+#include "uniformblock.h"
 #include "camera.h"
 #include "material.h"
 #include "texture.h"
+#include "texturearray.h"
+#include "texturefile.h"
+#include "packer.h"
+#include "atlas.h"
+#include "streaming.h"
+#include "texturememory.h"
 #include "shader.h"
+#include "sprite.h"
+#include "font.h"
 #include "drawable.h"
 #include "model.h"
+#include "modelfile.h"
 #include "objectbone.h"
 #include "object.h"
 #include "misc.h"
@@ -0,0 +1,187 @@
+#include "atlas.h"
+#include <QImage>
+#include <algorithm>
+#include <cstring>
+
+namespace LuaApi {
+
+// AtlasPages
+AtlasPages::AtlasPages(std::uint32_t size, bool mipmaps) :
+    m_size(size),
+    m_mipmaps(mipmaps),
+    m_mipsDirty(false),
+    m_textures(0)
+{}
+
+bool AtlasPages::reserve(std::size_t pages)
+{
+    std::uint32_t const capacity = m_array.IsValid() ? m_array->layers() : 0;
+    if(pages <= capacity)
+        return true;
+    TextureArray grown;
+    grown.Init();
+    grown->setlabel(TextureMemory::ATLAS, "TextureAtlas");
+    std::uint32_t const layers = std::max<std::uint32_t>(capacity * 2, static_cast<std::uint32_t>(pages));
+    if(!grown->allocate(m_size, m_size, layers, m_mipmaps ? LEVELS : 1))
+        return false;
+    if(capacity && !grown->copylayers(*m_array, capacity))
+        return false;
+    m_array = grown;
+    return true;
+}
+
+bool AtlasPages::add(QImage const& image, std::uint32_t& page, std::uint32_t& x, std::uint32_t& y)
+{
+    if(image.isNull())
+        return false;
+    int const width = image.width();
+    int const height = image.height();
+    int const paddedWidth = width + 2 * CELL;
+    int const paddedHeight = height + 2 * CELL;
+    int const grid = static_cast<int>(m_size / CELL);
+    int const cellsX = (paddedWidth + CELL - 1) / CELL;
+    int const cellsY = (paddedHeight + CELL - 1) / CELL;
+    if(cellsX > grid || cellsY > grid)
+        return false;
+
+    int cx = 0, cy = 0;
+    std::size_t target = 0;
+    while(target < m_pages.size() && !m_pages[target].insert(cellsX, cellsY, cx, cy))
+        ++target;
+    if(target == m_pages.size())
+    {
+        if(!reserve(m_pages.size() + 1))
+            return false;
+        m_pages.emplace_back(grid, grid);
+        m_pages.back().insert(cellsX, cellsY, cx, cy);
+    }
+
+    // Extrude the edge texels into the border.
+    QImage const rgba = image.convertToFormat(QImage::Format_RGBA8888);
+    std::vector<unsigned char> padded(paddedWidth * paddedHeight * 4);
+    for(int py = 0; py < paddedHeight; ++py)
+    {
+        int const sy = std::min(std::max(py - CELL, 0), height - 1);
+        unsigned char const* src = rgba.constScanLine(sy);
+        unsigned char* dst = &padded[py * paddedWidth * 4];
+        for(int px = 0; px < CELL; ++px)
+            std::memcpy(dst + px * 4, src, 4);
+        std::memcpy(dst + CELL * 4, src, width * 4);
+        for(int px = CELL + width; px < paddedWidth; ++px)
+            std::memcpy(dst + px * 4, src + (width - 1) * 4, 4);
+    }
+    if(!m_array->setregion(static_cast<std::uint32_t>(target), cx * CELL, cy * CELL,
+                           paddedWidth, paddedHeight, padded.data()))
+        return false;
+
+    page = static_cast<std::uint32_t>(target);
+    x = static_cast<std::uint32_t>(cx * CELL + CELL);
+    y = static_cast<std::uint32_t>(cy * CELL + CELL);
+    m_mipsDirty = m_mipmaps;
+    ++m_textures;
+    return true;
+}
+
+TextureArray const& AtlasPages::pages()
+{
+    if(m_mipsDirty && m_array.IsValid())
+    {
+        m_array->generatemipmaps();
+        m_mipsDirty = false;
+    }
+    return m_array;
+}
+std::uint32_t AtlasPages::pagesize() const
+{
+    return m_size;
+}
+std::size_t AtlasPages::pagecount() const
+{
+    return m_pages.size();
+}
+std::size_t AtlasPages::texturecount() const
+{
+    return m_textures;
+}
+float AtlasPages::fill() const
+{
+    if(m_pages.empty())
+        return 0.f;
+    float sum = 0.f;
+    for(SkylinePacker const& p : m_pages)
+        sum += p.occupancy();
+    return sum / m_pages.size();
+}
+float AtlasPages::pagefill(std::size_t page) const
+{
+    return page < m_pages.size() ? m_pages[page].occupancy() : 0.f;
+}
+
+// TextureAtlasImpl
+TextureAtlasImpl::TextureAtlasImpl() :
+    m_pageSize(DEFAULT_PAGE_SIZE),
+    m_mipmaps(true)
+{}
+
+void TextureAtlasImpl::Configure(std::uint32_t pageSize, bool mipmaps)
+{
+    pageSize = std::max<std::uint32_t>(pageSize, 4 * AtlasPages::CELL);
+    if(pageSize == m_pageSize && mipmaps == m_mipmaps)
+        return;
+    m_pageSize = pageSize;
+    m_mipmaps = mipmaps;
+    m_pages.reset();
+}
+void TextureAtlasImpl::Clear()
+{
+    m_pages.reset();
+}
+
+Texture TextureAtlasImpl::add(QImage const& image)
+{
+    Texture texture;
+    if(!m_pages)
+        m_pages = std::make_shared<AtlasPages>(m_pageSize, m_mipmaps);
+    std::uint32_t page, x, y;
+    if(!m_pages->add(image, page, x, y))
+        return texture;
+    texture.Init();
+    texture->place(m_pages, page, x, y, image.width(), image.height());
+    return texture;
+}
+Lua::ReturnValues TextureAtlasImpl::Load(std::string const& path)
+{
+    QImage const image = TextureFile::ReadImage(path);
+    if(image.isNull())
+        return Lua::Return();
+    Texture texture = add(image);
+    if(!texture.IsValid())
+    {
+        texture.Init();
+        if(!texture->load(path, Lua::CopyToArg<bool>(m_mipmaps)))
+            return Lua::Return();
+    }
+    return Lua::Return(texture);
+}
+std::uint32_t TextureAtlasImpl::PageSize() const
+{
+    return m_pageSize;
+}
+std::size_t TextureAtlasImpl::PageCount() const
+{
+    return m_pages ? m_pages->pagecount() : 0;
+}
+std::size_t TextureAtlasImpl::TextureCount() const
+{
+    return m_pages ? m_pages->texturecount() : 0;
+}
+float TextureAtlasImpl::Fill() const
+{
+    return m_pages ? m_pages->fill() : 0.f;
+}
+float TextureAtlasImpl::PageFill(std::size_t page) const
+{
+    return m_pages ? m_pages->pagefill(page) : 0.f;
+}
+
+}
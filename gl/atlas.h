@@ -0,0 +1,106 @@
+#ifndef LUAGL_ATLAS_H
+#define LUAGL_ATLAS_H
+#include <memory>
+#include <vector>
+#include "shared.h"
+#include "packer.h"
+#include "texture.h"
+#include "texturearray.h"
+
+namespace LuaApi {
+    // The pages of a texture atlas: layers of one TextureArray, each
+    // packed with a skyline. Shared by the TextureAtlas and every texture
+    // placed in it, so those outlive the atlas object. When a page is
+    // added past the array's capacity the array is replaced by one twice
+    // as deep and the old layers are copied over on the GPU.
+    //
+    // Images are placed on a grid of CELL texels and surrounded by CELL
+    // texels of their own edge. With at most LEVELS mip levels a cell
+    // shrinks to one texel at the smallest, so neighbours never bleed
+    // into each other.
+    class AtlasPages {
+    public:
+        enum {
+            LEVELS = 3,
+            CELL = 1 << (LEVELS - 1)
+        };
+    private:
+        std::uint32_t m_size;
+        bool m_mipmaps;
+        std::vector<SkylinePacker> m_pages;
+        TextureArray m_array;
+        bool m_mipsDirty;
+        std::size_t m_textures;
+
+        bool reserve(std::size_t pages);
+    public:
+        AtlasPages(std::uint32_t size, bool mipmaps);
+        AtlasPages(AtlasPages const&) =delete;
+        AtlasPages& operator= (AtlasPages const&) =delete;
+
+        // Packs and uploads an image; x and y are its top left corner on
+        // the page. False if it would not fit an empty page.
+        bool add(QImage const&, std::uint32_t& page, std::uint32_t& x, std::uint32_t& y);
+        // The array, mipmaps regenerated if textures were added.
+        TextureArray const& pages();
+        std::uint32_t pagesize() const;
+        std::size_t pagecount() const;
+        std::size_t texturecount() const;
+        // Packed area, padding included, over all pages or one.
+        float fill() const;
+        float pagefill(std::size_t) const;
+    };
+
+    // Packs many small textures into a few array textures, so sprites
+    // using them draw without rebinding. Textures from Load behave as
+    // usual in Lua, and resolve to a page and rectangle on it; images too
+    // large for a page load as standalone textures. Space is not reused
+    // after a texture is released.
+    class TextureAtlasImpl {
+        std::shared_ptr<AtlasPages> m_pages;
+        std::uint32_t m_pageSize;
+        bool m_mipmaps;
+    public:
+        enum {
+            DEFAULT_PAGE_SIZE = 2048
+        };
+
+        TextureAtlasImpl();
+
+        // For textures added from now on; earlier ones keep their pages.
+        void Configure(std::uint32_t pageSize, bool mipmaps);
+        // Textures added from now on start on new pages.
+        void Clear();
+        // Invalid if the image is empty or larger than a page.
+        Texture add(QImage const&);
+        Lua::ReturnValues Load(std::string const& path);
+        std::uint32_t PageSize() const;
+        std::size_t PageCount() const;
+        std::size_t TextureCount() const;
+        float Fill() const;
+        float PageFill(std::size_t) const;
+    };
+
+    typedef RefCounted<TextureAtlasImpl> TextureAtlas;
+}
+
+template <> struct MetatableDescriptor<LuaApi::TextureAtlasImpl> {
+    static char const* name() { return "textureatlas_mt"; }
+    static char const* luaname() { return "TextureAtlas"; }
+    static char const* constructor() { return "New"; }
+    static bool construct(LuaApi::TextureAtlasImpl* v) { return Lua::DefaultConstructor(v); }
+    static void metatable(Lua::member_function_storage<LuaApi::TextureAtlasImpl>& mt) {
+#define REG_FNC(name) mt[ #name ] = Lua::Transform(&LuaApi::TextureAtlasImpl::name)
+        REG_FNC(Configure);
+        REG_FNC(Clear);
+        REG_FNC(Load);
+        REG_FNC(PageSize);
+        REG_FNC(PageCount);
+        REG_FNC(TextureCount);
+        REG_FNC(Fill);
+        REG_FNC(PageFill);
+#undef REG_FNC
+    }
+};
+
+#endif
@@ -0,0 +1,175 @@
+#include "camera.h"
+#include "uniformblock.h"
+#include "../world/simd.h"
+#include <cmath>
+#include <cstring>
+
+namespace LuaApi {
+namespace {
+// std140 layout of the Camera block.
+struct CameraBlock {
+    float m_view[16];
+    float m_projection[16];
+    float m_viewProjection[16];
+    float m_position[4];
+    float m_params[4];
+};
+static_assert(sizeof(CameraBlock) == 224, "Camera block must match its std140 layout");
+
+SharedUniformBlock g_block(CameraImpl::UBO_BINDING, sizeof(CameraBlock));
+std::uint64_t g_nextCamera = 1;
+}
+
+// CameraImpl
+char const* CameraImpl::blockName() { return "Camera"; }
+
+CameraImpl::CameraImpl() :
+    m_position(0.f),
+    m_rotation(1.f, 0.f, 0.f, 0.f),
+    m_fovy(glm::radians(60.f)),
+    m_aspect(16.f / 9.f),
+    m_near(0.1f),
+    m_far(1000.f),
+    m_ortho(false),
+    m_orthoBounds{-1.f, 1.f, -1.f, 1.f},
+    m_viewDirty(true),
+    m_projectionDirty(true),
+    m_view(1.f),
+    m_projection(1.f),
+    m_viewProjection(1.f),
+    m_frustum(),
+    m_version(0),
+    m_id(g_nextCamera++)
+{}
+
+void CameraImpl::update() const
+{
+    if(!m_viewDirty && !m_projectionDirty)
+        return;
+    if(m_viewDirty)
+    {
+        // Inverse of the rigid transform: transposed rotation, rotated and
+        // negated translation.
+        glm::quat inv = glm::conjugate(m_rotation);
+        m_view = glm::mat4_cast(inv);
+        m_view[3] = glm::vec4(inv * -m_position, 1.f);
+        m_viewDirty = false;
+    }
+    if(m_projectionDirty)
+    {
+        if(m_ortho)
+            m_projection = glm::ortho(m_orthoBounds[0], m_orthoBounds[1], m_orthoBounds[2], m_orthoBounds[3], m_near, m_far);
+        else
+            m_projection = glm::perspective(m_fovy, m_aspect, m_near, m_far);
+        m_projectionDirty = false;
+    }
+    simd::MulMat4(glm::value_ptr(m_projection), glm::value_ptr(m_view), glm::value_ptr(m_viewProjection));
+    m_frustum = Frustum::FromMatrix(m_viewProjection);
+    ++m_version;
+}
+
+void CameraImpl::SetPosition(float x, float y, float z)
+{
+    m_position = glm::vec3(x, y, z);
+    m_viewDirty = true;
+}
+FixedReturn<float, 3> CameraImpl::Position() const
+{
+    return ReturnFixed(m_position.x, m_position.y, m_position.z);
+}
+void CameraImpl::SetRotation(Quat q)
+{
+    m_rotation = glm::normalize(q.value());
+    m_viewDirty = true;
+}
+Quat CameraImpl::Rotation() const { return Quat(m_rotation); }
+void CameraImpl::SetLookAt(Vec3 eye, Vec3 target, Vec3 up)
+{
+    glm::vec3 forward = target.value() - eye.value();
+    if(glm::dot(forward, forward) < 1e-12f || glm::length(glm::cross(forward, up.value())) < 1e-6f)
+        return;
+    m_position = eye.value();
+    m_rotation = glm::conjugate(glm::quat_cast(glm::lookAt(eye.value(), target.value(), up.value())));
+    m_viewDirty = true;
+}
+void CameraImpl::SetWorld(Mat4 m)
+{
+    glm::vec3 scale;
+    DecomposeTRS(m.value(), m_position, m_rotation, scale);
+    m_viewDirty = true;
+}
+
+void CameraImpl::SetPerspective(float fovy, float aspect, float zNear, float zFar)
+{
+    m_ortho = false;
+    m_fovy = fovy;
+    m_aspect = aspect;
+    m_near = zNear;
+    m_far = zFar;
+    m_projectionDirty = true;
+}
+void CameraImpl::SetOrtho(float left, float right, float bottom, float top, float zNear, float zFar)
+{
+    m_ortho = true;
+    m_orthoBounds[0] = left;
+    m_orthoBounds[1] = right;
+    m_orthoBounds[2] = bottom;
+    m_orthoBounds[3] = top;
+    m_aspect = top != bottom ? (right - left) / (top - bottom) : 1.f;
+    m_near = zNear;
+    m_far = zFar;
+    m_projectionDirty = true;
+}
+void CameraImpl::SetAspect(float aspect)
+{
+    if(m_aspect == aspect)
+        return;
+    m_aspect = aspect;
+    if(m_ortho)
+    {
+        // Keep the height, refit the width around the centre.
+        float cx = (m_orthoBounds[0] + m_orthoBounds[1]) * 0.5f;
+        float hw = (m_orthoBounds[3] - m_orthoBounds[2]) * aspect * 0.5f;
+        m_orthoBounds[0] = cx - hw;
+        m_orthoBounds[1] = cx + hw;
+    }
+    m_projectionDirty = true;
+}
+
+glm::mat4 const& CameraImpl::view() const { update(); return m_view; }
+glm::mat4 const& CameraImpl::projection() const { update(); return m_projection; }
+glm::mat4 const& CameraImpl::viewProjection() const { update(); return m_viewProjection; }
+Frustum const& CameraImpl::frustum() const { update(); return m_frustum; }
+Mat4 CameraImpl::View() const { return Mat4(view()); }
+Mat4 CameraImpl::Projection() const { return Mat4(projection()); }
+Mat4 CameraImpl::ViewProjection() const { return Mat4(viewProjection()); }
+bool CameraImpl::IntersectsSphere(float x, float y, float z, float radius) const
+{
+    return frustum().Intersects(glm::vec3(x, y, z), radius);
+}
+bool CameraImpl::IntersectsBox(float minX, float minY, float minZ, float maxX, float maxY, float maxZ) const
+{
+    Aabb box;
+    box.m_min = glm::vec3(minX, minY, minZ);
+    box.m_max = glm::vec3(maxX, maxY, maxZ);
+    return frustum().Intersects(box);
+}
+
+bool CameraImpl::Upload() const
+{
+    update();
+    CameraBlock block;
+    std::memcpy(block.m_view, glm::value_ptr(m_view), sizeof(block.m_view));
+    std::memcpy(block.m_projection, glm::value_ptr(m_projection), sizeof(block.m_projection));
+    std::memcpy(block.m_viewProjection, glm::value_ptr(m_viewProjection), sizeof(block.m_viewProjection));
+    block.m_position[0] = m_position.x;
+    block.m_position[1] = m_position.y;
+    block.m_position[2] = m_position.z;
+    block.m_position[3] = 1.f;
+    block.m_params[0] = m_near;
+    block.m_params[1] = m_far;
+    block.m_params[2] = m_ortho ? 0.f : m_fovy;
+    block.m_params[3] = m_aspect;
+    return g_block.upload(&block, sizeof(block), m_id, m_version);
+}
+}
@@ -0,0 +1,117 @@
+#ifndef LUAGL_CAMERA_H
+#define LUAGL_CAMERA_H
+#include "shared.h"
+#include "../world/bounds.h"
+#include "../world/matrix.h"
+
+namespace LuaApi {
+    // View and projection with cached products.
+    // Setters only mark the view or the projection dirty; the matrices and
+    // frustum planes are rebuilt on the next read or Upload().
+    //
+    // Upload() writes the camera into one uniform buffer shared by every
+    // program, bound at UBO_BINDING, and skips the write if that buffer
+    // already holds this camera's current state. Programs get the block
+    // bound when they link, so nothing is set per program or per draw:
+    //
+    //   layout(std140) uniform Camera {
+    //       mat4 g_view;
+    //       mat4 g_projection;
+    //       mat4 g_viewProjection;
+    //       vec4 g_cameraPosition;   // w = 1
+    //       vec4 g_cameraParams;     // near, far, vertical fov, aspect
+    //   };
+    class CameraImpl {
+    public:
+        enum { UBO_BINDING = 0 };
+        static char const* blockName();
+    private:
+        glm::vec3 m_position;
+        glm::quat m_rotation;
+        float m_fovy;
+        float m_aspect;
+        float m_near;
+        float m_far;
+        bool m_ortho;
+        float m_orthoBounds[4];
+
+        mutable bool m_viewDirty;
+        mutable bool m_projectionDirty;
+        mutable glm::mat4 m_view;
+        mutable glm::mat4 m_projection;
+        mutable glm::mat4 m_viewProjection;
+        mutable Frustum m_frustum;
+        // Bumped whenever the cached matrices change.
+        mutable std::uint64_t m_version;
+        std::uint64_t m_id;
+
+        void update() const;
+    public:
+        CameraImpl();
+
+        void SetPosition(float, float, float);
+        FixedReturn<float, 3> Position() const;
+        void SetRotation(Quat);
+        Quat Rotation() const;
+        void SetLookAt(Vec3 eye, Vec3 target, Vec3 up);
+        // Position and rotation of a world matrix, e.g. a scene node's;
+        // scale is ignored.
+        void SetWorld(Mat4);
+
+        // fovy in radians.
+        void SetPerspective(float fovy, float aspect, float zNear, float zFar);
+        void SetOrtho(float left, float right, float bottom, float top, float zNear, float zFar);
+        void SetAspect(float);
+
+        glm::mat4 const& view() const;
+        glm::mat4 const& projection() const;
+        glm::mat4 const& viewProjection() const;
+        Frustum const& frustum() const;
+        Mat4 View() const;
+        Mat4 Projection() const;
+        Mat4 ViewProjection() const;
+        bool IntersectsSphere(float x, float y, float z, float radius) const;
+        bool IntersectsBox(float minX, float minY, float minZ, float maxX, float maxY, float maxZ) const;
+
+        // Needs a current GL context; false if the uniform buffer can't be
+        // created.
+        bool Upload() const;
+    };
+
+    typedef RefCounted<CameraImpl> Camera;
+}
+
+template <> struct MetatableDescriptor<LuaApi::CameraImpl> {
+    static char const* name() { return "camera_mt"; }
+    static char const* luaname() { return "Camera"; }
+    static char const* constructor() { return "New"; }
+    static bool construct(LuaApi::CameraImpl* v) { return Lua::DefaultConstructor(v); }
+    static void metatable(Lua::member_function_storage<LuaApi::CameraImpl>& mt) {
+#define REG_FNC(name) mt[ #name ] = Lua::Transform(&LuaApi::CameraImpl::name)
+        REG_FNC(SetPosition);
+        mt["Position"] = LuaApi::PushFixed(&LuaApi::CameraImpl::Position);
+        REG_FNC(SetRotation);
+        REG_FNC(Rotation);
+        REG_FNC(SetLookAt);
+        REG_FNC(SetWorld);
+        REG_FNC(SetPerspective);
+        REG_FNC(SetOrtho);
+        REG_FNC(SetAspect);
+        REG_FNC(View);
+        REG_FNC(Projection);
+        REG_FNC(ViewProjection);
+        REG_FNC(IntersectsSphere);
+        REG_FNC(IntersectsBox);
+        REG_FNC(Upload);
+#undef REG_FNC
+    }
+    static void direct(LuaApi::DirectMethods<LuaApi::CameraImpl>& dm) {
+        dm.Add("SetPosition", &LuaApi::CameraImpl::SetPosition);
+        dm.Add("Position", &LuaApi::CameraImpl::Position);
+        dm.Add("IntersectsSphere", &LuaApi::CameraImpl::IntersectsSphere);
+        dm.Add("IntersectsBox", &LuaApi::CameraImpl::IntersectsBox);
+        dm.Add("Upload", &LuaApi::CameraImpl::Upload);
+    }
+};
+
+#endif
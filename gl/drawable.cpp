@@ -5,16 +5,21 @@
 namespace LuaApi {
 
 // DrawableState
-bool DrawableState::Apply() {
+bool DrawableState::Apply() const {
     if(!(m_shader.IsValid() && m_shader->good()))
         return false;
     
     for(std::size_t i = 0; i < DrawableState::MAX_TEXTURES; ++i)
     {
-        if(m_textures[i].IsValid() && m_textures[i]->good())
-        {
-            m_textures[i]->texture()->bind(i);
-        }
+        if(!m_textures[i].IsValid())
+            continue;
+        m_textures[i]->request(0.f);
+        // Streamed textures have nothing to bind until their first mips land.
+        QOpenGLTexture* texture = m_textures[i]->texture();
+        if(!texture && m_fallback.IsValid())
+            texture = m_fallback->texture();
+        if(texture)
+            texture->bind(i);
     }
     
     if(m_mode != GL_FILL)
@@ -23,7 +28,7 @@ bool DrawableState::Apply() {
     }
     return true;
 }
-void DrawableState::UnApply() {
+void DrawableState::UnApply() const {
     if(m_mode != GL_FILL)
     {
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
@@ -34,7 +39,8 @@ void DrawableState::SetShader(Shader shd) { m_shader = shd; }
 void DrawableState::SetTexture(Texture tex, std::size_t index) {
     if(index >= DrawableState::MAX_TEXTURES)
         return;
-    m_textures[index] = (tex.IsValid() && tex->good()) ? tex : m_fallback;
+    // Atlased textures have no texture object of their own to bind.
+    m_textures[index] = (tex.IsValid() && tex->good() && !tex->atlased()) ? tex : m_fallback;
 }
 void DrawableState::SetFallbackTexture(Texture fb) {
     m_fallback = fb;
@@ -67,7 +73,10 @@ void DrawableBase::OnDraw() {}
 void DrawableBase::OnPostDraw() {
     GetDrawState().UnApply();
 }
-DrawableState DrawableBase::GetDrawState() { return DrawableState(); }
+DrawableState const& DrawableBase::GetDrawState() {
+    static DrawableState const empty;
+    return empty;
+}
 void DrawableBase::Draw() {
     if(OnPreDraw())
     {
@@ -15,8 +15,8 @@ namespace LuaApi {
         Texture m_textures[MAX_TEXTURES];
         GLenum m_mode = GL_FILL;
         
-        bool Apply();
-        void UnApply();
+        bool Apply() const;
+        void UnApply() const;
     public:
         DrawableState() =default;
         DrawableState(DrawableState const&) =default;
@@ -42,7 +42,7 @@ namespace LuaApi {
         virtual void OnDraw();
         virtual void OnPostDraw();
         
-        virtual DrawableState GetDrawState();
+        virtual DrawableState const& GetDrawState();
         virtual void Draw();
     };
 }
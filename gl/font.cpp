@@ -0,0 +1,466 @@
+#include "font.h"
+#include <QFontDatabase>
+#include <QFontMetricsF>
+#include <QGlyphRun>
+#include <QImage>
+#include <QPainter>
+#include <QPainterPath>
+#include <QTextLayout>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "../core/vfs.h"
+
+namespace {
+
+double const FAR_AWAY = 1e20;
+
+// Squared distance transform of one row or column (Felzenszwalb &
+// Huttenlocher): f holds 0 on feature pixels, FAR_AWAY elsewhere.
+void distance1d(double* f, int n, double* d, int* v, double* z)
+{
+    int k = 0;
+    v[0] = 0;
+    z[0] = -std::numeric_limits<double>::infinity();
+    z[1] = std::numeric_limits<double>::infinity();
+    for(int q = 1; q < n; ++q)
+    {
+        double s = ((f[q] + double(q) * q) - (f[v[k]] + double(v[k]) * v[k])) / (2.0 * (q - v[k]));
+        while(s <= z[k])
+        {
+            --k;
+            s = ((f[q] + double(q) * q) - (f[v[k]] + double(v[k]) * v[k])) / (2.0 * (q - v[k]));
+        }
+        ++k;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = std::numeric_limits<double>::infinity();
+    }
+    k = 0;
+    for(int q = 0; q < n; ++q)
+    {
+        while(z[k + 1] < q)
+            ++k;
+        double const r = q - v[k];
+        d[q] = r * r + f[v[k]];
+    }
+    std::copy(d, d + n, f);
+}
+
+void distance2d(std::vector<double>& grid, int width, int height)
+{
+    int const n = std::max(width, height);
+    std::vector<double> f(n), d(n), z(n + 1);
+    std::vector<int> v(n);
+    for(int x = 0; x < width; ++x)
+    {
+        for(int y = 0; y < height; ++y)
+            f[y] = grid[y * width + x];
+        distance1d(f.data(), height, d.data(), v.data(), z.data());
+        for(int y = 0; y < height; ++y)
+            grid[y * width + x] = f[y];
+    }
+    for(int y = 0; y < height; ++y)
+        distance1d(&grid[y * width], width, d.data(), v.data(), z.data());
+}
+
+}
+
+namespace LuaApi {
+
+// FontImpl
+FontImpl::FontImpl() :
+    m_loaded(false),
+    m_lineHeight(0.f),
+    m_atlasLayers(0)
+{}
+
+void FontImpl::reset()
+{
+    m_faces.clear();
+    m_glyphs.clear();
+    m_pages.clear();
+    m_atlas.SoftRelease();
+    m_atlasLayers = 0;
+}
+
+bool FontImpl::load(QString const& family, bool bold, bool italic)
+{
+    reset();
+    m_font = QFont(family);
+    m_font.setPixelSize(SDF_SIZE);
+    m_font.setBold(bold);
+    m_font.setItalic(italic);
+    // Outlines are scaled after rendering, so hinting to the grid at
+    // SDF_SIZE would only distort them.
+    m_font.setHintingPreference(QFont::PreferNoHinting);
+    m_font.setKerning(true);
+    m_lineHeight = static_cast<float>(QFontMetricsF(m_font).height());
+    m_loaded = true;
+    return true;
+}
+bool FontImpl::Load(std::string const& family, Lua::Arg<bool> const& bold, Lua::Arg<bool> const& italic)
+{
+    return load(QString::fromStdString(family), bold.get_safe(false), italic.get_safe(false));
+}
+bool FontImpl::LoadFile(std::string const& path)
+{
+    // Registered once per path; the database keeps the data until exit.
+    static std::unordered_map<std::string, int> registered;
+    auto it = registered.find(path);
+    if(it == registered.end())
+    {
+        int const id = QFontDatabase::addApplicationFontFromData(Vfs::Instance().read(path));
+        if(id < 0)
+            return false;
+        it = registered.emplace(path, id).first;
+    }
+    int const id = it->second;
+    QStringList const families = QFontDatabase::applicationFontFamilies(id);
+    if(families.isEmpty())
+        return false;
+    return load(families.front(), false, false);
+}
+bool FontImpl::IsValid() const
+{
+    return m_loaded;
+}
+
+std::uint32_t FontImpl::face(QRawFont const& font)
+{
+    for(std::size_t i = 0; i < m_faces.size(); ++i)
+    {
+        if(m_faces[i] == font)
+            return static_cast<std::uint32_t>(i);
+    }
+    m_faces.push_back(font);
+    return static_cast<std::uint32_t>(m_faces.size() - 1);
+}
+
+FontImpl::Glyph const& FontImpl::glyph(std::uint32_t face, QRawFont const& font, quint32 index)
+{
+    std::uint64_t const key = (std::uint64_t(face) << 32) | index;
+    auto it = m_glyphs.find(key);
+    if(it != m_glyphs.end())
+        return it->second;
+    // One that doesn't fit is cached as blank too, so a full atlas rejects
+    // it once rather than rendering it on every layout. Pages only free up
+    // when another font is loaded, which clears the cache anyway.
+    Glyph& g = m_glyphs[key];
+    render(font, index, g);
+    return g;
+}
+
+void FontImpl::render(QRawFont const& font, quint32 index, Glyph& g)
+{
+    g = Glyph();
+    QPainterPath const path = font.pathForGlyph(index);
+    QRectF const bounds = path.boundingRect();
+    if(path.isEmpty() || bounds.isEmpty())
+        return;
+
+    int const x0 = static_cast<int>(std::floor(bounds.left())) - SPREAD;
+    int const y0 = static_cast<int>(std::floor(bounds.top())) - SPREAD;
+    int const width = static_cast<int>(std::ceil(bounds.right())) + SPREAD - x0;
+    int const height = static_cast<int>(std::ceil(bounds.bottom())) + SPREAD - y0;
+    // One texel of gutter keeps linear filtering off the neighbours.
+    std::uint32_t page;
+    int px, py;
+    if(!allocate(width + 1, height + 1, page, px, py))
+        return;
+
+    int const mw = width * OVERSAMPLE;
+    int const mh = height * OVERSAMPLE;
+    QImage mask(mw, mh, QImage::Format_ARGB32_Premultiplied);
+    mask.fill(Qt::transparent);
+    {
+        QPainter painter(&mask);
+        painter.scale(OVERSAMPLE, OVERSAMPLE);
+        painter.translate(-x0, -y0);
+        painter.fillPath(path, Qt::black);
+    }
+
+    // Squared distances to the nearest pixel outside and inside the outline.
+    std::vector<double> outside(mw * mh);
+    std::vector<double> inside(mw * mh);
+    for(int y = 0; y < mh; ++y)
+    {
+        QRgb const* line = reinterpret_cast<QRgb const*>(mask.constScanLine(y));
+        for(int x = 0; x < mw; ++x)
+        {
+            bool const in = qAlpha(line[x]) > 127;
+            outside[y * mw + x] = in ? 0.0 : FAR_AWAY;
+            inside[y * mw + x] = in ? FAR_AWAY : 0.0;
+        }
+    }
+    distance2d(outside, mw, mh);
+    distance2d(inside, mw, mh);
+
+    Page& target = m_pages[page];
+    float const scale = 1.f / (2.f * SPREAD * OVERSAMPLE);
+    for(int y = 0; y < height; ++y)
+    {
+        unsigned char* row = &target.m_distance[(py + y) * PAGE_SIZE + px];
+        for(int x = 0; x < width; ++x)
+        {
+            int const c = (y * OVERSAMPLE + OVERSAMPLE / 2) * mw + x * OVERSAMPLE + OVERSAMPLE / 2;
+            // Pixel centres sit half a pixel off the edge.
+            float const d = outside[c] > 0.0 ?
+                        static_cast<float>(std::sqrt(outside[c])) - 0.5f :
+                        0.5f - static_cast<float>(std::sqrt(inside[c]));
+            float const value = std::min(std::max(0.5f - d * scale, 0.f), 1.f);
+            row[x] = static_cast<unsigned char>(value * 255.f + 0.5f);
+        }
+    }
+    if(target.m_dirtyX1 <= target.m_dirtyX0)
+    {
+        target.m_dirtyX0 = px;
+        target.m_dirtyY0 = py;
+        target.m_dirtyX1 = px + width;
+        target.m_dirtyY1 = py + height;
+    }
+    else
+    {
+        target.m_dirtyX0 = std::min(target.m_dirtyX0, px);
+        target.m_dirtyY0 = std::min(target.m_dirtyY0, py);
+        target.m_dirtyX1 = std::max(target.m_dirtyX1, px + width);
+        target.m_dirtyY1 = std::max(target.m_dirtyY1, py + height);
+    }
+
+    float const texel = 1.f / PAGE_SIZE;
+    g.m_x = static_cast<float>(x0);
+    g.m_y = static_cast<float>(y0);
+    g.m_width = static_cast<float>(width);
+    g.m_height = static_cast<float>(height);
+    g.m_u0 = px * texel;
+    g.m_v0 = py * texel;
+    g.m_u1 = (px + width) * texel;
+    g.m_v1 = (py + height) * texel;
+    g.m_page = page;
+}
+
+bool FontImpl::allocate(int width, int height, std::uint32_t& page, int& x, int& y)
+{
+    if(width > PAGE_SIZE || height > PAGE_SIZE)
+        return false;
+    // Shelves on the newest page; earlier pages are full.
+    for(;;)
+    {
+        if(!m_pages.empty())
+        {
+            Page& p = m_pages.back();
+            if(p.m_cursorX + width > PAGE_SIZE)
+            {
+                p.m_shelfY += p.m_shelfHeight;
+                p.m_shelfHeight = 0;
+                p.m_cursorX = 0;
+            }
+            if(p.m_shelfY + height <= PAGE_SIZE)
+            {
+                page = static_cast<std::uint32_t>(m_pages.size() - 1);
+                x = p.m_cursorX;
+                y = p.m_shelfY;
+                p.m_cursorX += width;
+                p.m_shelfHeight = std::max(p.m_shelfHeight, height);
+                return true;
+            }
+        }
+        if(m_pages.size() >= MAX_PAGES)
+            return false;
+        Page p;
+        p.m_distance.assign(PAGE_SIZE * PAGE_SIZE, 0);
+        p.m_shelfY = p.m_shelfHeight = p.m_cursorX = 0;
+        p.m_dirtyX0 = p.m_dirtyY0 = p.m_dirtyX1 = p.m_dirtyY1 = 0;
+        m_pages.push_back(std::move(p));
+    }
+}
+
+bool FontImpl::upload()
+{
+    if(m_pages.empty())
+        return false;
+    bool whole = false;
+    if(!m_atlas.IsValid() || m_atlasLayers != m_pages.size())
+    {
+        // The layer count is fixed at creation. Quads already batched keep
+        // the old array alive through the batch.
+        TextureArray atlas;
+        atlas.Init();
+        atlas->setlabel(TextureMemory::FONT, m_font.family().toStdString());
+        if(!atlas->create(PAGE_SIZE, PAGE_SIZE, static_cast<std::uint32_t>(m_pages.size()), false))
+            return false;
+        m_atlas = atlas;
+        m_atlasLayers = static_cast<std::uint32_t>(m_pages.size());
+        whole = true;
+    }
+    std::vector<unsigned char> rgba;
+    for(std::size_t i = 0; i < m_pages.size(); ++i)
+    {
+        Page& p = m_pages[i];
+        if(whole)
+        {
+            p.m_dirtyX0 = p.m_dirtyY0 = 0;
+            p.m_dirtyX1 = p.m_dirtyY1 = PAGE_SIZE;
+        }
+        if(p.m_dirtyX1 <= p.m_dirtyX0)
+            continue;
+        int const width = p.m_dirtyX1 - p.m_dirtyX0;
+        int const height = p.m_dirtyY1 - p.m_dirtyY0;
+        rgba.resize(width * height * 4);
+        unsigned char* out = rgba.data();
+        for(int y = 0; y < height; ++y)
+        {
+            unsigned char const* in = &p.m_distance[(p.m_dirtyY0 + y) * PAGE_SIZE + p.m_dirtyX0];
+            for(int x = 0; x < width; ++x, out += 4)
+            {
+                out[0] = out[1] = out[2] = 255;
+                out[3] = in[x];
+            }
+        }
+        m_atlas->setregion(static_cast<std::uint32_t>(i), p.m_dirtyX0, p.m_dirtyY0, width, height, rgba.data());
+        p.m_dirtyX0 = p.m_dirtyY0 = p.m_dirtyX1 = p.m_dirtyY1 = 0;
+    }
+    return true;
+}
+
+bool FontImpl::layout(std::string const& text, float x, float y, float size, float wrap, std::uint32_t color,
+                      std::vector<SpriteVertex>* vertices, float& width, float& height)
+{
+    width = 0.f;
+    height = 0.f;
+    if(!m_loaded || size <= 0.f)
+        return false;
+    float const scale = size / SDF_SIZE;
+
+    QString string = QString::fromStdString(text);
+    string.replace(QLatin1Char('\n'), QChar::LineSeparator);
+    QTextLayout layout(string, m_font);
+    QTextOption option;
+    option.setWrapMode(wrap > 0.f ? QTextOption::WrapAtWordBoundaryOrAnywhere : QTextOption::NoWrap);
+    layout.setTextOption(option);
+    layout.beginLayout();
+    qreal lineY = 0;
+    qreal lineWidth = 0;
+    for(;;)
+    {
+        QTextLine line = layout.createLine();
+        if(!line.isValid())
+            break;
+        line.setLineWidth(wrap > 0.f ? wrap / scale : 1e6);
+        line.setPosition(QPointF(0, lineY));
+        lineY += line.height();
+        lineWidth = std::max(lineWidth, line.naturalTextWidth());
+    }
+    layout.endLayout();
+    width = static_cast<float>(lineWidth) * scale;
+    height = static_cast<float>(lineY) * scale;
+    if(!vertices)
+        return true;
+
+    for(QGlyphRun const& run : layout.glyphRuns())
+    {
+        QRawFont const font = run.rawFont();
+        std::uint32_t const f = face(font);
+        QVector<quint32> const indexes = run.glyphIndexes();
+        QVector<QPointF> const positions = run.positions();
+        for(int i = 0; i < indexes.size(); ++i)
+        {
+            Glyph const& g = glyph(f, font, indexes[i]);
+            if(g.m_width <= 0.f)
+                continue;
+            float const x0 = x + (static_cast<float>(positions[i].x()) + g.m_x) * scale;
+            float const y0 = y + (static_cast<float>(positions[i].y()) + g.m_y) * scale;
+            float const x1 = x0 + g.m_width * scale;
+            float const y1 = y0 + g.m_height * scale;
+            float const layer = static_cast<float>(g.m_page);
+            SpriteVertex const quad[4] = {
+                { x0, y0, g.m_u0, g.m_v0, layer, color },
+                { x1, y0, g.m_u1, g.m_v0, layer, color },
+                { x0, y1, g.m_u0, g.m_v1, layer, color },
+                { x1, y1, g.m_u1, g.m_v1, layer, color }
+            };
+            vertices->insert(vertices->end(), quad, quad + 4);
+        }
+    }
+    return true;
+}
+
+bool FontImpl::use(SpriteBatchImpl& batch)
+{
+    return upload() && batch.use(m_atlas, true);
+}
+
+void FontImpl::Draw(SpriteBatch batch, std::string const& text, float x, float y, float size, Lua::Arg<float> const& wrap)
+{
+    if(!batch.IsValid())
+        return;
+    float width, height;
+    m_scratch.clear();
+    if(!layout(text, x, y, size, wrap.get_safe(0.f), batch->color(), &m_scratch, width, height) ||
+            m_scratch.empty() || !use(*batch))
+        return;
+    batch->vertices(m_scratch.data(), m_scratch.size());
+}
+Lua::ReturnValues FontImpl::Measure(std::string const& text, float size, Lua::Arg<float> const& wrap)
+{
+    float width, height;
+    layout(text, 0.f, 0.f, size, wrap.get_safe(0.f), 0, nullptr, width, height);
+    return Lua::Return(width, height);
+}
+float FontImpl::LineHeight(float size) const
+{
+    return m_lineHeight * size / SDF_SIZE;
+}
+std::size_t FontImpl::GlyphCount() const
+{
+    return m_glyphs.size();
+}
+std::size_t FontImpl::PageCount() const
+{
+    return m_pages.size();
+}
+
+// TextBlockImpl
+TextBlockImpl::TextBlockImpl() :
+    m_width(0.f),
+    m_height(0.f)
+{}
+
+bool TextBlockImpl::Set(Font font, std::string const& text, float size, Lua::Arg<float> const& wrap)
+{
+    Clear();
+    if(!font.IsValid() || !font->layout(text, 0.f, 0.f, size, wrap.get_safe(0.f), 0xFFFFFFFF, &m_vertices, m_width, m_height))
+        return false;
+    m_font = std::move(font);
+    return true;
+}
+void TextBlockImpl::Clear()
+{
+    m_font.SoftRelease();
+    m_vertices.clear();
+    m_width = 0.f;
+    m_height = 0.f;
+}
+void TextBlockImpl::Draw(SpriteBatch batch, float x, float y)
+{
+    if(!batch.IsValid() || !m_font.IsValid() || m_vertices.empty() || !m_font->use(*batch))
+        return;
+    std::uint32_t const color = batch->color();
+    for(std::size_t i = 0; i < m_vertices.size(); i += 4)
+    {
+        SpriteVertex const& tl = m_vertices[i];
+        SpriteVertex const& br = m_vertices[i + 3];
+        batch->quad(x + tl.m_x, y + tl.m_y, br.m_x - tl.m_x, br.m_y - tl.m_y,
+                    tl.m_u, tl.m_v, br.m_u, br.m_v, tl.m_layer, color);
+    }
+}
+FixedReturn<float, 2> TextBlockImpl::Size() const
+{
+    return ReturnFixed(m_width, m_height);
+}
+std::size_t TextBlockImpl::QuadCount() const
+{
+    return m_vertices.size() / 4;
+}
+
+}
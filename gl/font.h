@@ -0,0 +1,162 @@
+#ifndef LUAGL_FONT_H
+#define LUAGL_FONT_H
+#include <unordered_map>
+#include <vector>
+#include <QFont>
+#include <QRawFont>
+#include "shared.h"
+#include "sprite.h"
+#include "texturearray.h"
+
+namespace LuaApi {
+    // Text drawn from a signed distance field glyph atlas.
+    // Each glyph is rendered once, on first use, at SDF_SIZE pixels per em
+    // and scaled to any size when drawn. Shaping, kerning and font fallback
+    // come from QTextLayout; glyphs are cached per face, so fallback faces
+    // share the atlas. All pages are layers of one TextureArray, so text in
+    // one font draws as a single SpriteBatch run.
+    //
+    // Pages live on the CPU as distance bytes. New glyphs extend a dirty
+    // rectangle that is uploaded before the next draw; adding a page
+    // replaces the array with one a layer larger.
+    //
+    // Coordinates are pixels with the origin at the top left of the text's
+    // first line. Loading another font starts a new atlas, so TextBlocks
+    // built from the old one must be Set again.
+    class FontImpl {
+    public:
+        enum {
+            SDF_SIZE = 48,
+            // Distance range each side of the outline, in SDF_SIZE pixels.
+            SPREAD = 6,
+            // The outline is rasterised this much larger for the distance
+            // transform.
+            OVERSAMPLE = 4,
+            PAGE_SIZE = 1024,
+            MAX_PAGES = 16
+        };
+        // Quad relative to the pen on the baseline, in SDF_SIZE pixels;
+        // empty for blank glyphs.
+        struct Glyph {
+            float m_x, m_y, m_width, m_height;
+            float m_u0, m_v0, m_u1, m_v1;
+            std::uint32_t m_page;
+        };
+    private:
+        struct Page {
+            std::vector<unsigned char> m_distance;
+            int m_shelfY;
+            int m_shelfHeight;
+            int m_cursorX;
+            // Not yet uploaded; empty when m_dirtyX1 <= m_dirtyX0.
+            int m_dirtyX0, m_dirtyY0, m_dirtyX1, m_dirtyY1;
+        };
+
+        QFont m_font;
+        bool m_loaded;
+        float m_lineHeight;
+        std::vector<QRawFont> m_faces;
+        std::unordered_map<std::uint64_t, Glyph> m_glyphs;
+        std::vector<Page> m_pages;
+        TextureArray m_atlas;
+        std::uint32_t m_atlasLayers;
+        std::vector<SpriteVertex> m_scratch;
+
+        void reset();
+        bool load(QString const& family, bool bold, bool italic);
+        std::uint32_t face(QRawFont const&);
+        Glyph const& glyph(std::uint32_t face, QRawFont const&, quint32 index);
+        // Leaves the glyph blank if the atlas has no room for it.
+        void render(QRawFont const&, quint32 index, Glyph&);
+        bool allocate(int width, int height, std::uint32_t& page, int& x, int& y);
+        bool upload();
+    public:
+        FontImpl();
+        FontImpl(FontImpl const&) =delete;
+        FontImpl& operator= (FontImpl const&) =delete;
+
+        bool Load(std::string const& family, Lua::Arg<bool> const& bold, Lua::Arg<bool> const& italic);
+        // Registers a font file with the application, then loads its family.
+        bool LoadFile(std::string const& path);
+        bool IsValid() const;
+
+        // For C++ producers: lays out text at size pixels per em from
+        // (x, y), wrapping at wrap pixels if positive, and appends four
+        // vertices per visible glyph. Without vertices only measures.
+        bool layout(std::string const& text, float x, float y, float size, float wrap, std::uint32_t color,
+                    std::vector<SpriteVertex>* vertices, float& width, float& height);
+        // Uploads new glyphs and binds the atlas on the batch.
+        bool use(SpriteBatchImpl&);
+
+        // In the batch's current colour.
+        void Draw(SpriteBatch, std::string const& text, float x, float y, float size, Lua::Arg<float> const& wrap);
+        // Width and height.
+        Lua::ReturnValues Measure(std::string const& text, float size, Lua::Arg<float> const& wrap);
+        float LineHeight(float size) const;
+        std::size_t GlyphCount() const;
+        std::size_t PageCount() const;
+    };
+
+    typedef RefCounted<FontImpl> Font;
+
+    // Laid-out text kept as quads, for labels that rarely change. This is a
+    // CPU cache of the layout only: drawing one skips shaping and measuring
+    // but still copies its quads into the batch's stream like any text.
+    class TextBlockImpl {
+        Font m_font;
+        std::vector<SpriteVertex> m_vertices;
+        float m_width;
+        float m_height;
+    public:
+        TextBlockImpl();
+
+        bool Set(Font, std::string const& text, float size, Lua::Arg<float> const& wrap);
+        void Clear();
+        // In the batch's current colour.
+        void Draw(SpriteBatch, float x, float y);
+        FixedReturn<float, 2> Size() const;
+        std::size_t QuadCount() const;
+    };
+
+    typedef RefCounted<TextBlockImpl> TextBlock;
+}
+
+template <> struct MetatableDescriptor<LuaApi::FontImpl> {
+    static char const* name() { return "font_mt"; }
+    static char const* luaname() { return "Font"; }
+    static char const* constructor() { return "New"; }
+    static bool construct(LuaApi::FontImpl* v) { return Lua::DefaultConstructor(v); }
+    static void metatable(Lua::member_function_storage<LuaApi::FontImpl>& mt) {
+#define REG_FNC(name) mt[ #name ] = Lua::Transform(&LuaApi::FontImpl::name)
+        REG_FNC(Load);
+        REG_FNC(LoadFile);
+        REG_FNC(IsValid);
+        REG_FNC(Draw);
+        REG_FNC(Measure);
+        REG_FNC(LineHeight);
+        REG_FNC(GlyphCount);
+        REG_FNC(PageCount);
+#undef REG_FNC
+    }
+};
+
+template <> struct MetatableDescriptor<LuaApi::TextBlockImpl> {
+    static char const* name() { return "textblock_mt"; }
+    static char const* luaname() { return "TextBlock"; }
+    static char const* constructor() { return "New"; }
+    static bool construct(LuaApi::TextBlockImpl* v) { return Lua::DefaultConstructor(v); }
+    static void metatable(Lua::member_function_storage<LuaApi::TextBlockImpl>& mt) {
+#define REG_FNC(name) mt[ #name ] = Lua::Transform(&LuaApi::TextBlockImpl::name)
+        REG_FNC(Set);
+        REG_FNC(Clear);
+        REG_FNC(Draw);
+        mt["Size"] = LuaApi::PushFixed(&LuaApi::TextBlockImpl::Size);
+        REG_FNC(QuadCount);
+#undef REG_FNC
+    }
+    static void direct(LuaApi::DirectMethods<LuaApi::TextBlockImpl>& dm) {
+        dm.Add("Draw", &LuaApi::TextBlockImpl::Draw);
+    }
+};
+
+#endif
@@ -45,9 +45,9 @@ ObjectMaterialImpl::ObjectMaterialImpl()
         Property3& p = m_##Prop;\
         p.m_x = x; p.m_y = y; p.m_z = z;\
     }\
-    Lua::ReturnValues ObjectMaterialImpl::Name() const {\
+    FixedReturn<float, 3> ObjectMaterialImpl::Name() const {\
         Property3 const& p = m_##Prop;\
-        return Lua::Return(p.m_x, p.m_y, p.m_z);\
+        return ReturnFixed(p.m_x, p.m_y, p.m_z);\
     }
 #define COLPROP1(Name, Prop)\
     void ObjectMaterialImpl::Set##Name(float x) {\
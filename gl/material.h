@@ -54,10 +54,10 @@ namespace LuaApi {
         void SetShininess(float);
         void SetShininessStrength(float);
         
-        Lua::ReturnValues DiffuseColor() const;
-        Lua::ReturnValues SpecularColor() const;
-        Lua::ReturnValues AmbientColor() const;
-        Lua::ReturnValues EmissiveColor() const;
+        FixedReturn<float, 3> DiffuseColor() const;
+        FixedReturn<float, 3> SpecularColor() const;
+        FixedReturn<float, 3> AmbientColor() const;
+        FixedReturn<float, 3> EmissiveColor() const;
         float Opacity() const;
         float Shininess() const;
         float ShininessStrength() const;
@@ -121,6 +121,38 @@ template <> struct MetatableDescriptor<LuaApi::ObjectMaterialImpl> {
     static void metatable(Lua::member_function_storage<LuaApi::ObjectMaterialImpl>& mt) {
 #define REG_FNC(name) mt[ #name ] = Lua::Transform(&LuaApi::ObjectMaterialImpl::name)
 #define REG_TXFNC(prop) REG_FNC(prop##Texture); REG_FNC(prop##UV); REG_FNC(Set##prop##Texture); REG_FNC(Set##prop##UV);
+        REG_FNC(SetDiffuseColor);
+        REG_FNC(SetSpecularColor);
+        REG_FNC(SetAmbientColor);
+        REG_FNC(SetEmissiveColor);
+        REG_FNC(SetOpacity);
+        REG_FNC(SetShininess);
+        REG_FNC(SetShininessStrength);
+        mt[ "DiffuseColor" ] = LuaApi::PushFixed(&LuaApi::ObjectMaterialImpl::DiffuseColor);
+        mt[ "SpecularColor" ] = LuaApi::PushFixed(&LuaApi::ObjectMaterialImpl::SpecularColor);
+        mt[ "AmbientColor" ] = LuaApi::PushFixed(&LuaApi::ObjectMaterialImpl::AmbientColor);
+        mt[ "EmissiveColor" ] = LuaApi::PushFixed(&LuaApi::ObjectMaterialImpl::EmissiveColor);
+        REG_FNC(Opacity);
+        REG_FNC(Shininess);
+        REG_FNC(ShininessStrength);
+        
+        REG_TXFNC(Diffuse);
+        REG_TXFNC(Specular);
+        REG_TXFNC(Ambient);
+        REG_TXFNC(Emissive);
+        REG_TXFNC(Normals);
+        REG_TXFNC(Height);
+        REG_TXFNC(Opacity);
+        REG_TXFNC(Shininess);
+        REG_TXFNC(Displacement);
+        REG_TXFNC(Lightmap);
+        REG_TXFNC(Reflection);
+#undef REG_FNC
+#undef REG_TXFNC
+    }
+    static void direct(LuaApi::DirectMethods<LuaApi::ObjectMaterialImpl>& dm) {
+#define REG_FNC(name) dm.Add( #name, &LuaApi::ObjectMaterialImpl::name)
+#define REG_TXFNC(prop) REG_FNC(prop##UV); REG_FNC(Set##prop##Texture); REG_FNC(Set##prop##UV);
         REG_FNC(SetDiffuseColor);
         REG_FNC(SetSpecularColor);
         REG_FNC(SetAmbientColor);
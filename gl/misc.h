@@ -40,6 +40,15 @@ template <> struct MetatableDescriptor<LuaApi::TimerImpl> {
         mt["TimeF"] = Lua::Transform(&LuaApi::TimerImpl::timef);
         mt["Update"] = Lua::Transform(&LuaApi::TimerImpl::update);
     }
+    static void direct(LuaApi::DirectMethods<LuaApi::TimerImpl>& dm) {
+        dm.Add("Reset", &LuaApi::TimerImpl::reset);
+        dm.Add("Running", &LuaApi::TimerImpl::running);
+        dm.Add("Start", &LuaApi::TimerImpl::start);
+        dm.Add("Stop", &LuaApi::TimerImpl::stop);
+        dm.Add("TimeI", &LuaApi::TimerImpl::timei);
+        dm.Add("TimeF", &LuaApi::TimerImpl::timef);
+        dm.Add("Update", &LuaApi::TimerImpl::update);
+    }
 };
 
 #endif
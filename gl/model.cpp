@@ -52,8 +52,25 @@ std::uint32_t ModelData_Indexed::indices() const { return m_indices; }
 }
 
 // ModelStorageImpl
+ModelStorageImpl::ModelStorageImpl() :
+    m_bounds{glm::vec3(0.f), glm::vec3(0.f)},
+    m_sphere(0.f),
+    m_hasBounds(false)
+{
+}
+
+void ModelStorageImpl::setBounds(float const* points, std::size_t count, std::size_t stride)
+{
+    m_hasBounds = count > 0;
+    if(!m_hasBounds)
+        return;
+    m_bounds = Aabb::FromPoints(points, count, stride);
+    m_sphere = LuaApi::BoundingSphere(m_bounds, points, count, stride);
+}
+
 bool ModelStorageImpl::create(std::uint32_t vxCount)
 {
+    m_hasBounds = false;
     m_data = std::unique_ptr<impl::ModelData_Base>(new impl::ModelData_NonIndexed);
     if(!m_data->Create())
     {
@@ -65,6 +82,7 @@ bool ModelStorageImpl::create(std::uint32_t vxCount)
 }
 bool ModelStorageImpl::create_indexed(std::uint32_t vxCount)
 {
+    m_hasBounds = false;
     m_data = std::unique_ptr<impl::ModelData_Base>(new impl::ModelData_Indexed);
     if(!m_data->Create())
     {
@@ -156,6 +174,8 @@ bool ModelStorageImpl::set3d(std::size_t attrib, const Lua::Array<float>& data)
     if(data.m_data.empty())
     {
         buf->unload();
+        if(attrib == 0)
+            m_hasBounds = false;
         return true;
     }
     if(data.m_data.size() != m_data->vertices() * 3)
@@ -166,6 +186,8 @@ bool ModelStorageImpl::set3d(std::size_t attrib, const Lua::Array<float>& data)
     buf->buffer()->setUsagePattern(QOpenGLBuffer::StaticDraw);
     buf->buffer()->allocate(data.m_data.data(), data.m_data.size() * sizeof(data.m_data[0]));
     buf->buffer()->release();
+    if(attrib == 0)
+        setBounds(data.m_data.data(), m_data->vertices(), 3);
     return true;
 }
 bool ModelStorageImpl::set4d(std::size_t attrib, const Lua::Array<float>& data)
@@ -178,6 +200,8 @@ bool ModelStorageImpl::set4d(std::size_t attrib, const Lua::Array<float>& data)
     if(data.m_data.empty())
     {
         buf->unload();
+        if(attrib == 0)
+            m_hasBounds = false;
         return true;
     }
     if(data.m_data.size() != m_data->vertices() * 4)
@@ -188,6 +212,29 @@ bool ModelStorageImpl::set4d(std::size_t attrib, const Lua::Array<float>& data)
     buf->buffer()->setUsagePattern(QOpenGLBuffer::StaticDraw);
     buf->buffer()->allocate(data.m_data.data(), data.m_data.size() * sizeof(data.m_data[0]));
     buf->buffer()->release();
+    if(attrib == 0)
+        setBounds(data.m_data.data(), m_data->vertices(), 4);
+    return true;
+}
+bool ModelStorageImpl::setpoints(std::size_t attrib, Vec3Array points)
+{
+    if(!m_data || !points.IsValid())
+        return false;
+    impl::SharedBuffer* buf = m_data->VBO(attrib);
+    if(!buf)
+        return false;
+    // Points are kept padded to vec4, so they upload as they are.
+    std::vector<glm::vec4> const& data = points->points();
+    if(data.size() != m_data->vertices())
+        return false;
+    if(!buf->create() || !buf->buffer()->bind())
+        return false;
+    buf->setTupleSize(4);
+    buf->buffer()->setUsagePattern(QOpenGLBuffer::StaticDraw);
+    buf->buffer()->allocate(data.data(), static_cast<int>(data.size() * sizeof(data[0])));
+    buf->buffer()->release();
+    if(attrib == 0)
+        setBounds(reinterpret_cast<float const*>(data.data()), data.size(), 4);
     return true;
 }
 bool ModelStorageImpl::lock()
@@ -247,8 +294,31 @@ void ModelStorageImpl::draw()
         f->glDrawArrays(GL_TRIANGLES, 0, m_data->vertices());
     }
 }
-void ModelStorageImpl::unload() { m_data.reset(); }
+void ModelStorageImpl::unload()
+{
+    m_data.reset();
+    m_hasBounds = false;
+}
 impl::ModelData_Base* ModelStorageImpl::data() const { return m_data.get(); }
 bool ModelStorageImpl::good() const { return m_data.get() != nullptr; }
 
+bool ModelStorageImpl::hasBounds() const { return m_hasBounds; }
+Aabb const& ModelStorageImpl::bounds() const { return m_bounds; }
+glm::vec4 const& ModelStorageImpl::sphere() const { return m_sphere; }
+
+FixedReturn<float, 6> ModelStorageImpl::Bounds() const
+{
+    if(!m_hasBounds)
+        return ReturnFixed(0.f, 0.f, 0.f, 0.f, 0.f, 0.f);
+    return ReturnFixed(m_bounds.m_min.x, m_bounds.m_min.y, m_bounds.m_min.z,
+                       m_bounds.m_max.x, m_bounds.m_max.y, m_bounds.m_max.z);
+}
+
+FixedReturn<float, 4> ModelStorageImpl::BoundingSphere() const
+{
+    if(!m_hasBounds)
+        return ReturnFixed(0.f, 0.f, 0.f, 0.f);
+    return ReturnFixed(m_sphere.x, m_sphere.y, m_sphere.z, m_sphere.w);
+}
+
 }
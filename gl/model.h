@@ -1,6 +1,8 @@
 #ifndef LUAGL_MODEL_H
 #define LUAGL_MODEL_H
 #include "shared.h"
+#include "../world/batch.h"
+#include "../world/bounds.h"
 namespace LuaApi {
 	class ModelStorageImpl;
     namespace impl {
@@ -73,7 +75,15 @@ namespace LuaApi {
     
     class ModelStorageImpl {
         std::unique_ptr<impl::ModelData_Base> m_data;
+        // Of attribute 0, in model space.
+        Aabb m_bounds;
+        glm::vec4 m_sphere;
+        bool m_hasBounds;
+        
+        void setBounds(float const* points, std::size_t count, std::size_t stride);
     public:
+        ModelStorageImpl();
+        
         bool create(std::uint32_t);
         bool create_indexed(std::uint32_t);
         bool setindices(Lua::Array<std::uint16_t> const&);
@@ -82,12 +92,20 @@ namespace LuaApi {
         bool set2d(std::size_t attrib, Lua::Array<float> const&);
         bool set3d(std::size_t attrib, Lua::Array<float> const&);
         bool set4d(std::size_t attrib, Lua::Array<float> const&);
+        bool setpoints(std::size_t attrib, Vec3Array);
         bool lock();
         void bind();
         void draw();
         void unload();
         impl::ModelData_Base* data() const;
         bool good() const;
+        
+        bool hasBounds() const;
+        Aabb const& bounds() const;
+        glm::vec4 const& sphere() const;
+        // min xyz, max xyz / centre xyz, radius; zeros without positions.
+        FixedReturn<float, 6> Bounds() const;
+        FixedReturn<float, 4> BoundingSphere() const;
     };
     
     typedef RefCounted<ModelStorageImpl> ModelStorage;
@@ -109,9 +127,13 @@ template <> struct MetatableDescriptor<LuaApi::ModelStorageImpl> {
         mt["Set2D"] = Lua::Transform(&LuaApi::ModelStorageImpl::set2d);
         mt["Set3D"] = Lua::Transform(&LuaApi::ModelStorageImpl::set3d);
         mt["Set4D"] = Lua::Transform(&LuaApi::ModelStorageImpl::set4d);
+        mt["SetPoints"] = Lua::Transform(&LuaApi::ModelStorageImpl::setpoints);
         mt["SetIndices"] = Lua::Transform(&LuaApi::ModelStorageImpl::setindices);
         mt["SetIndices32"] = Lua::Transform(&LuaApi::ModelStorageImpl::setindices_32);
         mt["Unload"] = Lua::Transform(&LuaApi::ModelStorageImpl::unload);
+        mt["HasBounds"] = Lua::Transform(&LuaApi::ModelStorageImpl::hasBounds);
+        mt["Bounds"] = LuaApi::PushFixed(&LuaApi::ModelStorageImpl::Bounds);
+        mt["BoundingSphere"] = LuaApi::PushFixed(&LuaApi::ModelStorageImpl::BoundingSphere);
     }
 };
 #endif
@@ -0,0 +1,525 @@
+#include "modelfile.h"
+#include <QDataStream>
+#include <QSaveFile>
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <assimp/Importer.hpp>
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+#include <assimp/config.h>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include "../world/animation.h"
+#include "../core/vfs.h"
+
+namespace LuaApi {
+
+namespace {
+
+GLenum TextureWrapToGL(aiTextureMapMode tmm)
+{
+    switch(tmm)
+    {
+    default:
+    case aiTextureMapMode_Wrap:
+        return GL_REPEAT;
+    case aiTextureMapMode_Decal:
+    case aiTextureMapMode_Clamp:
+        return GL_CLAMP_TO_BORDER;
+    case aiTextureMapMode_Mirror:
+        return GL_MIRRORED_REPEAT;
+    }
+}
+
+// Pre-order, so every parent lands before its children.
+void CollectNodes(aiNode const* node, std::uint32_t parent, std::vector<ModelNode>& out)
+{
+    std::uint32_t index = static_cast<std::uint32_t>(out.size());
+    out.emplace_back();
+    ModelNode& n = out.back();
+    n.m_name = node->mName.C_Str();
+    n.m_parent = parent;
+    // aiMatrix4x4 is row-major.
+    n.m_transform = glm::transpose(glm::make_mat4(&node->mTransformation.a1));
+    n.m_meshes.assign(node->mMeshes, node->mMeshes + node->mNumMeshes);
+    for(std::size_t i = 0; i < node->mNumChildren; ++i)
+        CollectNodes(node->mChildren[i], index, out);
+}
+
+// Lets Assimp open the model and whatever it references, .mtl files and
+// the like, through the Vfs.
+class VfsIOStream : public Assimp::IOStream {
+    std::unique_ptr<QIODevice> m_device;
+public:
+    explicit VfsIOStream(std::unique_ptr<QIODevice> device) : m_device(std::move(device)) {}
+    std::size_t Read(void* buffer, std::size_t size, std::size_t count) override
+    {
+        if(!size)
+            return 0;
+        qint64 const read = m_device->read(static_cast<char*>(buffer), static_cast<qint64>(size * count));
+        return read > 0 ? static_cast<std::size_t>(read) / size : 0;
+    }
+    std::size_t Write(void const*, std::size_t, std::size_t) override { return 0; }
+    aiReturn Seek(std::size_t offset, aiOrigin origin) override
+    {
+        qint64 base = 0;
+        if(origin == aiOrigin_CUR)
+            base = m_device->pos();
+        else if(origin == aiOrigin_END)
+            base = m_device->size();
+        return m_device->seek(base + static_cast<qint64>(offset)) ? aiReturn_SUCCESS : aiReturn_FAILURE;
+    }
+    std::size_t Tell() const override { return static_cast<std::size_t>(m_device->pos()); }
+    std::size_t FileSize() const override { return static_cast<std::size_t>(m_device->size()); }
+    void Flush() override {}
+};
+
+class VfsIOSystem : public Assimp::IOSystem {
+public:
+    bool Exists(char const* file) const override { return Vfs::Instance().exists(file); }
+    char getOsSeparator() const override { return '/'; }
+    Assimp::IOStream* Open(char const* file, char const* mode) override
+    {
+        if(std::strchr(mode, 'w') || std::strchr(mode, 'a'))
+            return nullptr;
+        std::unique_ptr<QIODevice> device = Vfs::Instance().open(file);
+        return device ? new VfsIOStream(std::move(device)) : nullptr;
+    }
+    void Close(Assimp::IOStream* stream) override { delete stream; }
+};
+
+// Cooked file fields. Arrays are a count and their elements; every read
+// checks the count against what is left of the file before allocating.
+void write(QDataStream& out, std::uint32_t v) { out << quint32(v); }
+void write(QDataStream& out, float v) { out.writeRawData(reinterpret_cast<char const*>(&v), sizeof(v)); }
+void write(QDataStream& out, glm::vec3 const& v) { out.writeRawData(reinterpret_cast<char const*>(&v[0]), sizeof(v)); }
+void write(QDataStream& out, glm::mat4 const& v) { out.writeRawData(reinterpret_cast<char const*>(&v[0][0]), sizeof(v)); }
+void write(QDataStream& out, std::string const& v)
+{
+    write(out, static_cast<std::uint32_t>(v.size()));
+    out.writeRawData(v.data(), static_cast<int>(v.size()));
+}
+template <typename T>
+void write(QDataStream& out, std::vector<T> const& v)
+{
+    write(out, static_cast<std::uint32_t>(v.size()));
+    out.writeRawData(reinterpret_cast<char const*>(v.data()), static_cast<int>(v.size() * sizeof(T)));
+}
+
+bool read(QDataStream& in, std::uint32_t& v)
+{
+    quint32 value;
+    in >> value;
+    v = value;
+    return in.status() == QDataStream::Ok;
+}
+template <typename T>
+bool readRaw(QDataStream& in, T& v)
+{
+    return in.readRawData(reinterpret_cast<char*>(&v), sizeof(T)) == static_cast<int>(sizeof(T));
+}
+bool readCount(QDataStream& in, std::size_t elementSize, std::uint32_t& count)
+{
+    return read(in, count) && static_cast<std::uint64_t>(count) * elementSize <=
+            static_cast<std::uint64_t>(in.device()->bytesAvailable());
+}
+bool read(QDataStream& in, std::string& v)
+{
+    std::uint32_t size;
+    if(!readCount(in, 1, size))
+        return false;
+    v.resize(size);
+    return in.readRawData(&v[0], static_cast<int>(size)) == static_cast<int>(size);
+}
+template <typename T>
+bool read(QDataStream& in, std::vector<T>& v)
+{
+    std::uint32_t count;
+    if(!readCount(in, sizeof(T), count))
+        return false;
+    v.resize(count);
+    int const bytes = static_cast<int>(count * sizeof(T));
+    return in.readRawData(reinterpret_cast<char*>(v.data()), bytes) == bytes;
+}
+
+}
+
+bool ModelFile::import(std::string const& path)
+{
+    clear();
+    Assimp::Importer importer;
+    importer.SetIOHandler(new VfsIOSystem);
+    // Four weights per vertex, and no more joints per mesh than a palette holds.
+    importer.SetPropertyInteger(AI_CONFIG_PP_SBBC_MAX_BONES, AnimatorImpl::MAX_JOINTS);
+    aiScene const* scene = importer.ReadFile(path,
+                                             aiProcess_CalcTangentSpace |
+                                             aiProcess_Triangulate |
+                                             aiProcess_JoinIdenticalVertices |
+                                             aiProcess_SortByPType |
+                                             aiProcess_LimitBoneWeights |
+                                             aiProcess_SplitByBoneCount);
+    if(!scene)
+        return false;
+
+    if(scene->mRootNode)
+        CollectNodes(scene->mRootNode, NO_PARENT, m_nodes);
+    std::unordered_map<std::string, std::uint32_t> nodeIds;
+    for(std::size_t i = 0; i < m_nodes.size(); ++i)
+        nodeIds.emplace(m_nodes[i].m_name, static_cast<std::uint32_t>(i));
+
+    // The clips, keyed in seconds
+    for(std::size_t i = 0; i < scene->mNumAnimations; ++i)
+    {
+        aiAnimation const* anim = scene->mAnimations[i];
+        double const tps = anim->mTicksPerSecond > 0. ? anim->mTicksPerSecond : 25.;
+
+        m_clips.emplace_back();
+        Clip& clip = m_clips.back();
+        clip.m_name = anim->mName.C_Str();
+        clip.m_duration = static_cast<float>(anim->mDuration / tps);
+        for(std::size_t j = 0; j < anim->mNumChannels; ++j)
+        {
+            aiNodeAnim const* channel = anim->mChannels[j];
+            clip.m_tracks.emplace_back();
+            AnimationClipImpl::Track& track = clip.m_tracks.back();
+            track.m_node = channel->mNodeName.C_Str();
+            for(std::size_t k = 0; k < channel->mNumPositionKeys; ++k)
+            {
+                aiVectorKey const& key = channel->mPositionKeys[k];
+                track.m_positionTimes.push_back(static_cast<float>(key.mTime / tps));
+                track.m_positions.push_back(glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+            }
+            for(std::size_t k = 0; k < channel->mNumRotationKeys; ++k)
+            {
+                aiQuatKey const& key = channel->mRotationKeys[k];
+                track.m_rotationTimes.push_back(static_cast<float>(key.mTime / tps));
+                track.m_rotations.push_back(glm::normalize(glm::quat(key.mValue.w, key.mValue.x, key.mValue.y, key.mValue.z)));
+            }
+            for(std::size_t k = 0; k < channel->mNumScalingKeys; ++k)
+            {
+                aiVectorKey const& key = channel->mScalingKeys[k];
+                track.m_scaleTimes.push_back(static_cast<float>(key.mTime / tps));
+                track.m_scales.push_back(glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+            }
+        }
+    }
+
+    // The meshes
+    m_meshes.reserve(scene->mNumMeshes);
+    for(std::size_t i = 0; i < scene->mNumMeshes; ++i)
+    {
+        aiMesh const* mesh = scene->mMeshes[i];
+        m_meshes.emplace_back();
+        Mesh& out = m_meshes.back();
+        out.m_name = mesh->mName.C_Str();
+        out.m_vertices = mesh->mNumVertices;
+        out.m_material = mesh->mMaterialIndex;
+        bool const skinned = mesh->HasBones();
+
+        out.m_indices.reserve(mesh->mNumFaces * 3);
+        for(std::size_t j = 0; j < mesh->mNumFaces; ++j)
+        {
+            aiFace const& face = mesh->mFaces[j];
+            if(face.mNumIndices != 3)
+                return false;
+            out.m_indices.insert(out.m_indices.end(), face.mIndices, face.mIndices + 3);
+        }
+
+        // Room for every slot up front; the references below must stay put.
+        out.m_attributes.reserve(4 + AI_MAX_NUMBER_OF_TEXTURECOORDS + AI_MAX_NUMBER_OF_COLOR_SETS + 2);
+        auto attribute = [&out, mesh](std::uint32_t index, std::uint32_t components) -> std::vector<float>& {
+            out.m_attributes.push_back({ index, components, std::vector<float>() });
+            out.m_attributes.back().m_data.reserve(mesh->mNumVertices * components);
+            return out.m_attributes.back().m_data;
+        };
+        auto add3 = [](std::vector<float>& data, aiVector3D const* v, std::size_t count) {
+            for(std::size_t k = 0; k < count; ++k)
+                data.insert(data.end(), { v[k].x, v[k].y, v[k].z });
+        };
+        if(mesh->HasPositions())
+            add3(attribute(0, 3), mesh->mVertices, mesh->mNumVertices);
+        if(mesh->HasNormals())
+            add3(attribute(1, 3), mesh->mNormals, mesh->mNumVertices);
+        if(mesh->HasTangentsAndBitangents())
+        {
+            add3(attribute(2, 3), mesh->mTangents, mesh->mNumVertices);
+            add3(attribute(3, 3), mesh->mBitangents, mesh->mNumVertices);
+        }
+        // Skinned meshes give UV and colour set 5 to the joints.
+        for(std::uint32_t j = 0; j < AI_MAX_NUMBER_OF_TEXTURECOORDS; ++j)
+        {
+            std::uint32_t const components = mesh->mNumUVComponents[j];
+            if(!mesh->HasTextureCoords(j) || (skinned && j == 5) || components < 1 || components > 3)
+                continue;
+            std::vector<float>& data = attribute(4 + j * 2, components);
+            for(std::size_t k = 0; k < mesh->mNumVertices; ++k)
+            {
+                aiVector3D const& uv = mesh->mTextureCoords[j][k];
+                data.insert(data.end(), &uv.x, &uv.x + components);
+            }
+        }
+        for(std::uint32_t j = 0; j < AI_MAX_NUMBER_OF_COLOR_SETS; ++j)
+        {
+            if(!mesh->HasVertexColors(j) || (skinned && j == 5))
+                continue;
+            std::vector<float>& data = attribute(5 + j * 2, 4);
+            for(std::size_t k = 0; k < mesh->mNumVertices; ++k)
+            {
+                aiColor4D const& col = mesh->mColors[j][k];
+                data.insert(data.end(), { col.r, col.g, col.b, col.a });
+            }
+        }
+
+        // Gather the joint weights
+        if(skinned)
+        {
+            std::vector<float>& joints = attribute(14, 4);
+            std::vector<float>& weights = attribute(15, 4);
+            joints.assign(mesh->mNumVertices * 4, 0.f);
+            weights.assign(mesh->mNumVertices * 4, 0.f);
+            for(std::size_t j = 0; j < mesh->mNumBones; ++j)
+            {
+                aiBone const* bone = mesh->mBones[j];
+                auto node = nodeIds.find(bone->mName.C_Str());
+                if(node == nodeIds.end())
+                    return false;
+                out.m_joints.push_back(node->second);
+                out.m_inverseBind.push_back(glm::transpose(glm::make_mat4(&bone->mOffsetMatrix.a1)));
+                for(std::size_t k = 0; k < bone->mNumWeights; ++k)
+                {
+                    aiVertexWeight const& vw = bone->mWeights[k];
+                    if(vw.mVertexId >= mesh->mNumVertices)
+                        continue;
+                    // Replace the smallest of the four slots.
+                    float* vj = &joints[vw.mVertexId * 4];
+                    float* vwt = &weights[vw.mVertexId * 4];
+                    std::size_t slot = std::min_element(vwt, vwt + 4) - vwt;
+                    if(vwt[slot] < vw.mWeight)
+                    {
+                        vj[slot] = static_cast<float>(j);
+                        vwt[slot] = vw.mWeight;
+                    }
+                }
+            }
+            for(std::size_t j = 0; j < weights.size(); j += 4)
+            {
+                float* vwt = &weights[j];
+                float sum = vwt[0] + vwt[1] + vwt[2] + vwt[3];
+                if(sum > 0.f)
+                    for(std::size_t k = 0; k < 4; ++k)
+                        vwt[k] /= sum;
+            }
+        }
+    }
+
+    // The materials
+    m_materials.reserve(scene->mNumMaterials);
+    for(std::size_t i = 0; i < scene->mNumMaterials; ++i)
+    {
+        m_materials.emplace_back();
+        Material& dstMat = m_materials.back();
+        dstMat.m_diffuse = dstMat.m_specular = dstMat.m_ambient = dstMat.m_emissive = dstMat.m_oss = glm::vec3(0.f);
+        for(MaterialTexture& texture : dstMat.m_textures)
+            texture = { std::string(), 0, GL_REPEAT };
+
+        aiMaterial* material = scene->mMaterials[i];
+        aiColor3D color;
+        float f;
+        if(material->Get(AI_MATKEY_COLOR_DIFFUSE,color) == AI_SUCCESS)
+            dstMat.m_diffuse = glm::vec3(color.r, color.g, color.b);
+        if(material->Get(AI_MATKEY_COLOR_SPECULAR,color) == AI_SUCCESS)
+            dstMat.m_specular = glm::vec3(color.r, color.g, color.b);
+        if(material->Get(AI_MATKEY_COLOR_AMBIENT,color) == AI_SUCCESS)
+            dstMat.m_ambient = glm::vec3(color.r, color.g, color.b);
+        if(material->Get(AI_MATKEY_COLOR_EMISSIVE,color) == AI_SUCCESS)
+            dstMat.m_emissive = glm::vec3(color.r, color.g, color.b);
+        if(material->Get(AI_MATKEY_OPACITY,f) == AI_SUCCESS)
+            dstMat.m_oss.x = f;
+        if(material->Get(AI_MATKEY_SHININESS,f) == AI_SUCCESS)
+            dstMat.m_oss.y = f;
+        if(material->Get(AI_MATKEY_SHININESS_STRENGTH,f) == AI_SUCCESS)
+            dstMat.m_oss.z = f;
+
+        aiString str;
+        unsigned int uv = 0;
+        aiTextureMapMode tmm = aiTextureMapMode_Wrap;
+
+#define MAP_ASSIMP_MAT(assimp_mat, tex_unit)\
+        if(material->GetTexture(assimp_mat,0,&str,nullptr,&uv,nullptr,nullptr,&tmm) == AI_SUCCESS) {\
+            dstMat.m_textures[tex_unit].m_path = str.C_Str();\
+            dstMat.m_textures[tex_unit].m_uv = uv;\
+            dstMat.m_textures[tex_unit].m_wrap = TextureWrapToGL(tmm);\
+        }
+
+        MAP_ASSIMP_MAT(aiTextureType_DIFFUSE, 0);
+        MAP_ASSIMP_MAT(aiTextureType_SPECULAR, 1);
+        MAP_ASSIMP_MAT(aiTextureType_AMBIENT, 2);
+        MAP_ASSIMP_MAT(aiTextureType_EMISSIVE, 3);
+        MAP_ASSIMP_MAT(aiTextureType_NORMALS, 4);
+        MAP_ASSIMP_MAT(aiTextureType_HEIGHT, 5);
+        MAP_ASSIMP_MAT(aiTextureType_OPACITY, 6);
+        MAP_ASSIMP_MAT(aiTextureType_SHININESS, 7);
+        MAP_ASSIMP_MAT(aiTextureType_DISPLACEMENT, 8);
+        MAP_ASSIMP_MAT(aiTextureType_LIGHTMAP, 9);
+        MAP_ASSIMP_MAT(aiTextureType_REFLECTION, 10);
+#undef MAP_ASSIMP_MAT
+    }
+    return true;
+}
+
+bool ModelFile::read(std::string const& path)
+{
+    clear();
+    std::unique_ptr<QIODevice> f = Vfs::Instance().open(path);
+    if(!f)
+        return false;
+    QDataStream in(f.get());
+    in.setByteOrder(QDataStream::LittleEndian);
+    std::uint32_t magic, version, count;
+    if(!LuaApi::read(in, magic) || !LuaApi::read(in, version) || magic != MAGIC || version != VERSION)
+        return false;
+
+    bool good = readCount(in, 1, count);
+    m_nodes.resize(good ? count : 0);
+    for(ModelNode& node : m_nodes)
+    {
+        good = good && LuaApi::read(in, node.m_name) && LuaApi::read(in, node.m_parent) &&
+                readRaw(in, node.m_transform) && LuaApi::read(in, node.m_meshes);
+    }
+    good = good && readCount(in, 1, count);
+    m_meshes.resize(good ? count : 0);
+    for(Mesh& mesh : m_meshes)
+    {
+        good = good && LuaApi::read(in, mesh.m_name) && LuaApi::read(in, mesh.m_vertices) &&
+                LuaApi::read(in, mesh.m_material) && LuaApi::read(in, mesh.m_indices) && readCount(in, 1, count);
+        mesh.m_attributes.resize(good ? count : 0);
+        for(Attribute& attribute : mesh.m_attributes)
+        {
+            good = good && LuaApi::read(in, attribute.m_index) && LuaApi::read(in, attribute.m_components) &&
+                    LuaApi::read(in, attribute.m_data);
+        }
+        good = good && LuaApi::read(in, mesh.m_joints) && LuaApi::read(in, mesh.m_inverseBind);
+    }
+    good = good && readCount(in, 1, count);
+    m_materials.resize(good ? count : 0);
+    for(Material& material : m_materials)
+    {
+        good = good && readRaw(in, material.m_diffuse) && readRaw(in, material.m_specular) &&
+                readRaw(in, material.m_ambient) && readRaw(in, material.m_emissive) && readRaw(in, material.m_oss);
+        for(MaterialTexture& texture : material.m_textures)
+        {
+            good = good && LuaApi::read(in, texture.m_path) && LuaApi::read(in, texture.m_uv) &&
+                    LuaApi::read(in, texture.m_wrap);
+        }
+    }
+    good = good && readCount(in, 1, count);
+    m_clips.resize(good ? count : 0);
+    for(Clip& clip : m_clips)
+    {
+        good = good && LuaApi::read(in, clip.m_name) && readRaw(in, clip.m_duration) && readCount(in, 1, count);
+        clip.m_tracks.resize(good ? count : 0);
+        for(AnimationClipImpl::Track& track : clip.m_tracks)
+        {
+            good = good && LuaApi::read(in, track.m_node) &&
+                    LuaApi::read(in, track.m_positionTimes) && LuaApi::read(in, track.m_positions) &&
+                    LuaApi::read(in, track.m_rotationTimes) && LuaApi::read(in, track.m_rotations) &&
+                    LuaApi::read(in, track.m_scaleTimes) && LuaApi::read(in, track.m_scales);
+        }
+    }
+
+    // Reject what the builder would trip over.
+    for(Mesh const& mesh : m_meshes)
+    {
+        for(Attribute const& attribute : mesh.m_attributes)
+            good = good && attribute.m_components >= 1 && attribute.m_components <= 4 &&
+                    attribute.m_data.size() == static_cast<std::size_t>(mesh.m_vertices) * attribute.m_components;
+        good = good && mesh.m_joints.size() == mesh.m_inverseBind.size();
+    }
+    if(!good || in.status() != QDataStream::Ok)
+    {
+        clear();
+        return false;
+    }
+    return true;
+}
+
+bool ModelFile::write(std::string const& path) const
+{
+    QSaveFile f(QString::fromStdString(path));
+    if(!f.open(QFile::WriteOnly))
+        return false;
+    QDataStream out(&f);
+    out.setByteOrder(QDataStream::LittleEndian);
+    LuaApi::write(out, std::uint32_t(MAGIC));
+    LuaApi::write(out, std::uint32_t(VERSION));
+
+    LuaApi::write(out, static_cast<std::uint32_t>(m_nodes.size()));
+    for(ModelNode const& node : m_nodes)
+    {
+        LuaApi::write(out, node.m_name);
+        LuaApi::write(out, node.m_parent);
+        LuaApi::write(out, node.m_transform);
+        LuaApi::write(out, node.m_meshes);
+    }
+    LuaApi::write(out, static_cast<std::uint32_t>(m_meshes.size()));
+    for(Mesh const& mesh : m_meshes)
+    {
+        LuaApi::write(out, mesh.m_name);
+        LuaApi::write(out, mesh.m_vertices);
+        LuaApi::write(out, mesh.m_material);
+        LuaApi::write(out, mesh.m_indices);
+        LuaApi::write(out, static_cast<std::uint32_t>(mesh.m_attributes.size()));
+        for(Attribute const& attribute : mesh.m_attributes)
+        {
+            LuaApi::write(out, attribute.m_index);
+            LuaApi::write(out, attribute.m_components);
+            LuaApi::write(out, attribute.m_data);
+        }
+        LuaApi::write(out, mesh.m_joints);
+        LuaApi::write(out, mesh.m_inverseBind);
+    }
+    LuaApi::write(out, static_cast<std::uint32_t>(m_materials.size()));
+    for(Material const& material : m_materials)
+    {
+        LuaApi::write(out, material.m_diffuse);
+        LuaApi::write(out, material.m_specular);
+        LuaApi::write(out, material.m_ambient);
+        LuaApi::write(out, material.m_emissive);
+        LuaApi::write(out, material.m_oss);
+        for(MaterialTexture const& texture : material.m_textures)
+        {
+            LuaApi::write(out, texture.m_path);
+            LuaApi::write(out, texture.m_uv);
+            LuaApi::write(out, texture.m_wrap);
+        }
+    }
+    LuaApi::write(out, static_cast<std::uint32_t>(m_clips.size()));
+    for(Clip const& clip : m_clips)
+    {
+        LuaApi::write(out, clip.m_name);
+        LuaApi::write(out, clip.m_duration);
+        LuaApi::write(out, static_cast<std::uint32_t>(clip.m_tracks.size()));
+        for(AnimationClipImpl::Track const& track : clip.m_tracks)
+        {
+            LuaApi::write(out, track.m_node);
+            LuaApi::write(out, track.m_positionTimes);
+            LuaApi::write(out, track.m_positions);
+            LuaApi::write(out, track.m_rotationTimes);
+            LuaApi::write(out, track.m_rotations);
+            LuaApi::write(out, track.m_scaleTimes);
+            LuaApi::write(out, track.m_scales);
+        }
+    }
+    return out.status() == QDataStream::Ok && f.commit();
+}
+
+void ModelFile::clear()
+{
+    m_nodes.clear();
+    m_meshes.clear();
+    m_materials.clear();
+    m_clips.clear();
+}
+
+}
@@ -0,0 +1,85 @@
+#ifndef LUAGL_MODELFILE_H
+#define LUAGL_MODELFILE_H
+#include <vector>
+#include "shared.h"
+#include "../world/clip.h"
+
+namespace LuaApi {
+    // One node of the file's hierarchy, stored parents first.
+    struct ModelNode {
+        std::string m_name;
+        std::uint32_t m_parent;
+        glm::mat4 m_transform;
+        std::vector<std::uint32_t> m_meshes;
+    };
+
+    // A model as ModelImpl builds it, kept on the CPU: either imported
+    // through Assimp, or read back from a file openrp-cook wrote, which
+    // skips the parsing and post-processing altogether. Vertex attributes
+    // are already laid out in the slots ModelImpl::load documents, and
+    // clips keep their float keys; ModelImpl compresses them.
+    //
+    // The cooked layout is a magic and version followed by the members in
+    // declaration order; counts and integers are little endian 32 bit
+    // words, floats and matrices raw in the host's order.
+    class ModelFile {
+    public:
+        enum : std::uint32_t {
+            MAGIC = 0x4D50524F, // "ORPM"
+            VERSION = 1,
+            NO_PARENT = 0xFFFFFFFF,
+            MATERIAL_TEXTURES = 11
+        };
+        struct Attribute {
+            std::uint32_t m_index;
+            std::uint32_t m_components;
+            std::vector<float> m_data;
+        };
+        struct Mesh {
+            std::string m_name;
+            std::uint32_t m_vertices;
+            std::uint32_t m_material;
+            std::vector<std::uint32_t> m_indices;
+            std::vector<Attribute> m_attributes;
+            // Skinned meshes: node index and inverse bind matrix of every
+            // palette entry.
+            std::vector<std::uint32_t> m_joints;
+            std::vector<glm::mat4> m_inverseBind;
+        };
+        struct MaterialTexture {
+            std::string m_path;
+            std::uint32_t m_uv;
+            // GL wrap mode.
+            std::uint32_t m_wrap;
+        };
+        struct Material {
+            glm::vec3 m_diffuse;
+            glm::vec3 m_specular;
+            glm::vec3 m_ambient;
+            glm::vec3 m_emissive;
+            // Opacity, shininess, shininess strength.
+            glm::vec3 m_oss;
+            // Diffuse, specular, ambient, emissive, normals, height,
+            // opacity, shininess, displacement, lightmap, reflection.
+            MaterialTexture m_textures[MATERIAL_TEXTURES];
+        };
+        struct Clip {
+            std::string m_name;
+            float m_duration;
+            std::vector<AnimationClipImpl::Track> m_tracks;
+        };
+
+        std::vector<ModelNode> m_nodes;
+        std::vector<Mesh> m_meshes;
+        std::vector<Material> m_materials;
+        std::vector<Clip> m_clips;
+
+        // Meshes are split to fit an Animator's joint palette.
+        bool import(std::string const& path);
+        bool read(std::string const& path);
+        bool write(std::string const& path) const;
+        void clear();
+    };
+}
+
+#endif
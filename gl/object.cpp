@@ -1,42 +1,10 @@
 #include "object.h"
 #include "drawable.h"
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
+#include "../core/manifest.h"
 
 namespace LuaApi {
 	
 // Model
-struct MatInfo {
-    aiColor3D diffuse;
-    aiColor3D specular;
-    aiColor3D ambient;
-    aiColor3D emissive;
-    aiVector3D oss;
-    
-    struct PerTex {
-        std::string tex;
-        int uv;
-        aiTextureMapMode map;
-    };
-    PerTex textures[DrawableState::MAX_TEXTURES];
-};
-
-GLenum TextureWrapToGL(aiTextureMapMode tmm)
-{
-    switch(tmm)
-    {
-    default:
-    case aiTextureMapMode_Wrap:
-        return GL_REPEAT;
-    case aiTextureMapMode_Decal:
-    case aiTextureMapMode_Clamp:
-        return GL_CLAMP_TO_BORDER;
-    case aiTextureMapMode_Mirror:
-        return GL_MIRRORED_REPEAT;
-    }
-}
-
 bool ModelImpl::load(std::string const& path)
 {
     // Attribute 0: Position
@@ -48,6 +16,8 @@ bool ModelImpl::load(std::string const& path)
     // Attribute 6: UV
     // Attribute 7: Color
     // ...
+    // Attribute 14: Joint indices (skinned meshes, instead of UV 5)
+    // Attribute 15: Joint weights (skinned meshes, instead of Color 5)
     
     // Uniform 0: Material Color
     // Uniform 1: Material Specular
@@ -78,330 +48,130 @@ bool ModelImpl::load(std::string const& path)
     // 10 - Uniform 28: Texture Reflection
     // 10 - Uniform 29: Reflection UV
     
-    Assimp::Importer importer;
-    aiScene const* scene = importer.ReadFile(path, 
-                                             aiProcess_CalcTangentSpace |
-                                             aiProcess_Triangulate |
-                                             aiProcess_JoinIdenticalVertices |
-                                             aiProcess_SortByPType);
-    if(!scene)
+    // A cooked copy skips Assimp altogether.
+    ModelFile file;
+    std::string const cooked = AssetManifest::Instance().lookup(path, AssetManifest::MODEL);
+    if((cooked.empty() || !file.read(cooked)) && !file.import(path))
         return false;
+    return build(file);
+}
+
+bool ModelImpl::build(ModelFile const& file)
+{
+    m_nodes = file.m_nodes;
     
-    m_bones.clear();
-    m_bones.reserve(scene->mNumMeshes);
+    // Load the clips
+    m_clips.clear();
+    for(ModelFile::Clip const& src : file.m_clips)
+    {
+        m_clips.emplace_back();
+        AnimationClip& clip = m_clips.back();
+        clip.Init();
+        clip->setName(src.m_name);
+        clip->setDuration(src.m_duration);
+        for(AnimationClipImpl::Track const& track : src.m_tracks)
+            clip->addTrack(track);
+        // A tenth of a millimetre and degree at metre scale.
+        clip->Compress(1e-4f, 1.7e-3f, 1e-4f);
+    }
     
     // Load the model
-    for(std::size_t i = 0; i < scene->mNumMeshes; ++i)
+    m_bones.clear();
+    m_bones.reserve(file.m_meshes.size());
+    for(ModelFile::Mesh const& mesh : file.m_meshes)
     {
-        aiMesh* mesh = scene->mMeshes[i];
-        
         m_bones.emplace_back();
         ModelBone& objectBone = m_bones.back();
         objectBone.Init();
+        objectBone->m_name = mesh.m_name;
         
         ModelStorage& currentModel = objectBone->m_model;
         currentModel.Init();
-        if(!currentModel->create_indexed(mesh->mNumVertices))
+        if(!currentModel->create_indexed(mesh.m_vertices))
             return false;
         currentModel->bind();
         
-        Lua::Array<float> pos;
-        Lua::Array<float> normal;
-        Lua::Array<float> tangent;
-        Lua::Array<float> bitangent;
-        std::uint32_t uvComponents[AI_MAX_NUMBER_OF_TEXTURECOORDS];
-        Lua::Array<float> uv[AI_MAX_NUMBER_OF_TEXTURECOORDS];
-        Lua::Array<float> color[AI_MAX_NUMBER_OF_COLOR_SETS];
-        
-        Lua::Array<std::uint16_t> ix16;
-        Lua::Array<std::uint32_t> ix32;
-        
-        // Allocate buffers
-        {
-            if(mesh->HasPositions())
-            {
-                pos.m_data.reserve(mesh->mNumVertices);
-            }
-            
-            if(mesh->HasNormals())
-            {
-                normal.m_data.reserve(mesh->mNumVertices);
-            }
-            
-            if(mesh->HasTangentsAndBitangents())
-            {
-                tangent.m_data.reserve(mesh->mNumVertices);
-                bitangent.m_data.reserve(mesh->mNumVertices);
-            }
-            
-            for(std::size_t i = 0; i < AI_MAX_NUMBER_OF_TEXTURECOORDS; ++i)
-            {
-                if(mesh->HasTextureCoords(i))
-                {
-                    uv[i].m_data.reserve(mesh->mNumVertices);
-                    uvComponents[i] = mesh->mNumUVComponents[i];
-                }
-                else
-                    uvComponents[i] = 0;
-            }
-            
-            for(std::size_t i = 0; i < AI_MAX_NUMBER_OF_COLOR_SETS; ++i)
-            {
-                if(mesh->HasVertexColors(i))
-                {
-                    color[i].m_data.reserve(mesh->mNumVertices);
-                }
-            }
-        }
-        
-        // Initialize Index Buffer
+        // Set the index buffers
+        if(mesh.m_vertices <= 0xFFFE && !mesh.m_indices.empty())
         {
-            std::size_t IndexCount = 0;
-            for(std::size_t j = 0; j < mesh->mNumFaces; ++j)
-            {
-                IndexCount += mesh->mFaces[j].mNumIndices;
-            }
-            
-            if(mesh->mNumVertices > 0xFFFE)
-            {
-                ix32.m_data.reserve(IndexCount);
-                
-                for(std::size_t j = 0; j < mesh->mNumFaces; ++j)
-                {
-                    aiFace const& face = mesh->mFaces[j];
-                    if(face.mNumIndices != 3)
-                        return false;
-                    for(std::size_t k = 0; k < 3; ++k) // face.mNumIndices
-                    {
-                        ix32.m_data.push_back(face.mIndices[k]);
-                    }
-                }
-            }
-            else
-            {
-                ix16.m_data.reserve(IndexCount);
-                
-                for(std::size_t j = 0; j < mesh->mNumFaces; ++j)
-                {
-                    aiFace const& face = mesh->mFaces[j];
-                    if(face.mNumIndices != 3)
-                        return false;
-                    for(std::size_t k = 0; k < 3; ++k) // face.mNumIndices
-                    {
-                        ix16.m_data.push_back(face.mIndices[k]);
-                    }
-                }
-            }
-        }
-        
-        // Parse the meshes
-        for(std::size_t i = 0; i < mesh->mNumVertices; ++i)
-        {            
-#define SET1(array, var) {array.m_data.push_back(var.x);}
-#define SET2(array, var) {array.m_data.push_back(var.x); array.m_data.push_back(var.y);}
-#define SET3(array, var) {array.m_data.push_back(var.x); array.m_data.push_back(var.y); array.m_data.push_back(var.z);}
-#define SETCOL(array, var) {array.m_data.push_back(var.r); array.m_data.push_back(var.g); array.m_data.push_back(var.b); array.m_data.push_back(var.a);}
-            
-            objectBone->m_name = mesh->mName.C_Str();
-            if(mesh->HasPositions())
-            {
-                aiVector3D vPos = mesh->mVertices[i];
-                SET3(pos, vPos);
-            }
-            
-            if(mesh->HasNormals())
-            {
-                aiVector3D vNormal = mesh->mNormals[i];
-                SET3(normal, vNormal);
-            }
-            
-            if(mesh->HasTangentsAndBitangents())
-            {
-                aiVector3D vTangent = mesh->mTangents[i];
-                aiVector3D vBitangent = mesh->mBitangents[i];
-                SET3(tangent, vTangent);
-                SET3(bitangent, vBitangent);
-            }
-            
-            
-            for(std::size_t j = 0; j < AI_MAX_NUMBER_OF_TEXTURECOORDS; ++j)
-            {
-                if(mesh->HasTextureCoords(j))
-                {
-                    aiVector3D vUV = mesh->mTextureCoords[j][i];
-                    
-                    switch(uvComponents[j])
-                    {
-                    case 1:
-                        SET1(uv[j], vUV);
-                        break;
-                    case 2:
-                        SET2(uv[j], vUV);
-                        break;
-                    case 3:
-                        SET3(uv[j], vUV);
-                        break;
-                    default:
-                        uvComponents[j] = 0;
-                    }
-                }
-            }
-            for(std::size_t j = 0; j < AI_MAX_NUMBER_OF_COLOR_SETS; ++j)
-            {
-                if(mesh->HasVertexColors(j))
-                {
-                    aiColor4D col = mesh->mColors[j][i];
-                    
-                    SETCOL(color[j], col);
-                }
-            }
+            Lua::Array<std::uint16_t> ix16;
+            ix16.m_data.assign(mesh.m_indices.begin(), mesh.m_indices.end());
+            if(!currentModel->setindices(ix16))
+                return false;
         }
-        
-        // Set the index buffers
+        else
         {
-            if(ix16.m_data.size())
-            {
-                if(!currentModel->setindices(ix16))
-                    return false;
-            }
-            else
-            {
-                if(!currentModel->setindices_32(ix32))
-                    return false;
-            }
+            Lua::Array<std::uint32_t> ix32;
+            ix32.m_data = mesh.m_indices;
+            if(!currentModel->setindices_32(ix32))
+                return false;
         }
         
         // Set the other buffers
+        for(ModelFile::Attribute const& attribute : mesh.m_attributes)
         {
-            if(mesh->HasPositions() && !currentModel->set3d(0,pos))
-                return false;
-            if(mesh->HasNormals() && !currentModel->set3d(1,normal))
-                return false;
-            if(mesh->HasTangentsAndBitangents() &&
-                    (!currentModel->set3d(2,tangent) ||
-                     !currentModel->set3d(3,bitangent)))
+            Lua::Array<float> data;
+            data.m_data = attribute.m_data;
+            bool set = false;
+            switch(attribute.m_components)
+            {
+            case 1:
+                set = currentModel->set1d(attribute.m_index, data);
+                break;
+            case 2:
+                set = currentModel->set2d(attribute.m_index, data);
+                break;
+            case 3:
+                set = currentModel->set3d(attribute.m_index, data);
+                break;
+            case 4:
+                set = currentModel->set4d(attribute.m_index, data);
+                break;
+            }
+            if(!set)
                 return false;
-            
-            for(std::size_t i = 0; i < AI_MAX_NUMBER_OF_TEXTURECOORDS; ++i)
-            {
-                if(!mesh->HasTextureCoords(i))
-                    continue;
-                switch(uvComponents[i])
-                {
-                case 1:
-                    if(!currentModel->set1d(4 + (i*2),uv[i]))
-                        return false;
-                    break;
-                case 2:
-                    if(!currentModel->set2d(4 + (i*2),uv[i]))
-                        return false;
-                    break;
-                case 3:
-                    if(!currentModel->set3d(4 + (i*2),uv[i]))
-                        return false;
-                    break;
-                }
-            }
-            
-            for(std::size_t i = 0; i < AI_MAX_NUMBER_OF_COLOR_SETS; ++i)
-            {
-                if(!mesh->HasVertexColors(i))
-                    continue;
-                if(!currentModel->set4d(5 + (i*2),color[i]))
-                    return false;
-            }
         }
+        objectBone->m_joints = mesh.m_joints;
+        objectBone->m_inverseBind = mesh.m_inverseBind;
         
         // Send the data to OpenGL
         if(!currentModel->lock())
             return false;
     }
     
-    std::vector<MatInfo> materials;
-    materials.reserve(scene->mNumMaterials);
-    
-    // Inspect and pack the materials
-    for(std::size_t i = 0; i < scene->mNumMaterials; ++i)
-    {
-        materials.emplace_back();
-        MatInfo& dstMat = materials.back();
-        
-        aiMaterial* material = scene->mMaterials[i];
-        aiColor3D color;
-        float f;
-        if(material->Get(AI_MATKEY_COLOR_DIFFUSE,color) == AI_SUCCESS)
-            dstMat.diffuse = color;
-        if(material->Get(AI_MATKEY_COLOR_SPECULAR,color) == AI_SUCCESS)
-            dstMat.specular = color;
-        if(material->Get(AI_MATKEY_COLOR_AMBIENT,color) == AI_SUCCESS)
-            dstMat.ambient = color;
-        if(material->Get(AI_MATKEY_COLOR_EMISSIVE,color) == AI_SUCCESS)
-            dstMat.emissive = color;
-        if(material->Get(AI_MATKEY_OPACITY,f) == AI_SUCCESS)
-            dstMat.oss.x = f;
-        if(material->Get(AI_MATKEY_SHININESS,f) == AI_SUCCESS)
-            dstMat.oss.y = f;
-        if(material->Get(AI_MATKEY_SHININESS_STRENGTH,f) == AI_SUCCESS)
-            dstMat.oss.z = f;
-        
-        aiString str;
-        unsigned int uv = 0;
-        aiTextureMapMode tmm = aiTextureMapMode_Wrap;
-        
-#define MAP_ASSIMP_MAT(assimp_mat, tex_unit)\
-        if(material->GetTexture(assimp_mat,0,&str,nullptr,&uv,nullptr,nullptr,&tmm) == AI_SUCCESS) {\
-            dstMat.textures[tex_unit].tex = str.C_Str();\
-            dstMat.textures[tex_unit].uv = uv;\
-            dstMat.textures[tex_unit].map = tmm;\
-        }
-        
-        MAP_ASSIMP_MAT(aiTextureType_DIFFUSE, 0);
-        MAP_ASSIMP_MAT(aiTextureType_SPECULAR, 1);
-        MAP_ASSIMP_MAT(aiTextureType_AMBIENT, 2);
-        MAP_ASSIMP_MAT(aiTextureType_EMISSIVE, 3);
-        MAP_ASSIMP_MAT(aiTextureType_NORMALS, 4);
-        MAP_ASSIMP_MAT(aiTextureType_HEIGHT, 5);
-        MAP_ASSIMP_MAT(aiTextureType_OPACITY, 6);
-        MAP_ASSIMP_MAT(aiTextureType_SHININESS, 7);
-        MAP_ASSIMP_MAT(aiTextureType_DISPLACEMENT, 8);
-        MAP_ASSIMP_MAT(aiTextureType_LIGHTMAP, 9);
-        MAP_ASSIMP_MAT(aiTextureType_REFLECTION, 10);
-    }
-    
     // Apply the materials
-    for(std::size_t i = 0; i < scene->mNumMeshes; ++i)
+    for(std::size_t i = 0; i < file.m_meshes.size(); ++i)
     {
-        aiMesh* mesh = scene->mMeshes[i];
         ModelBone& bone = m_bones[i];
-        if(mesh->mMaterialIndex < materials.size())
+        if(file.m_meshes[i].m_material < file.m_materials.size())
         {
-            MatInfo& mat = materials[mesh->mMaterialIndex];
+            ModelFile::Material const& mat = file.m_materials[file.m_meshes[i].m_material];
             
             Lua::Arg<bool> bTrue = Lua::CopyToArg<bool>(true);
-#define MAP3(propname, var) bone->Material()->Set ## propname(var.r, var.g, var.b)
+#define MAP3(propname, var) bone->Material()->Set ## propname(var.x, var.y, var.z)
 #define MAP1(propname, var) bone->Material()->Set ## propname(var)
 #define MAPTX(propname, id)\
             {\
-                if(!mat.textures[id].tex.empty())\
+                if(!mat.m_textures[id].m_path.empty())\
                 {\
                     Texture t;\
                     t.Init();\
-                    if(t->load(mat.textures[id].tex, bTrue))\
+                    if(t->load(mat.m_textures[id].m_path, bTrue))\
                     {\
-                        t->setwraps(TextureWrapToGL(mat.textures[id].map));\
+                        t->setwraps(mat.m_textures[id].m_wrap);\
                         bone->Material()->Set ## propname ## Texture(std::move(t));\
-                        bone->Material()->Set ## propname ## UV(mat.textures[id].uv);\
+                        bone->Material()->Set ## propname ## UV(mat.m_textures[id].m_uv);\
                     }\
                 }\
             }
             
-            MAP3(DiffuseColor, mat.diffuse);
-            MAP3(SpecularColor, mat.specular);
-            MAP3(AmbientColor, mat.ambient);
-            MAP3(EmissiveColor, mat.emissive);
-            MAP1(Opacity, mat.oss.x);
-            MAP1(Shininess, mat.oss.y);
-            MAP1(ShininessStrength, mat.oss.y);
+            MAP3(DiffuseColor, mat.m_diffuse);
+            MAP3(SpecularColor, mat.m_specular);
+            MAP3(AmbientColor, mat.m_ambient);
+            MAP3(EmissiveColor, mat.m_emissive);
+            MAP1(Opacity, mat.m_oss.x);
+            MAP1(Shininess, mat.m_oss.y);
+            MAP1(ShininessStrength, mat.m_oss.y);
             
             MAPTX(Diffuse, 0);
             MAPTX(Specular, 1);
@@ -420,6 +190,10 @@ bool ModelImpl::load(std::string const& path)
     return true;
 }
 
+std::vector<ModelBone> const& ModelImpl::bones() const { return m_bones; }
+std::vector<ModelNode> const& ModelImpl::nodes() const { return m_nodes; }
+std::vector<AnimationClip> const& ModelImpl::clips() const { return m_clips; }
+
 std::size_t ModelImpl::BoneCount() const {
     return m_bones.size();
 }
@@ -437,4 +211,40 @@ Lua::ReturnValues ModelImpl::GetBoneByNumber(std::size_t i) {
     return Lua::Return();
 }
 
+std::size_t ModelImpl::NodeCount() const {
+    return m_nodes.size();
+}
+Lua::ReturnValues ModelImpl::NodeName(std::size_t i) const {
+    if(i < m_nodes.size())
+        return Lua::Return(m_nodes[i].m_name);
+    return Lua::Return();
+}
+Lua::ReturnValues ModelImpl::NodeParent(std::size_t i) const {
+    if(i < m_nodes.size() && m_nodes[i].m_parent != ModelImpl::NO_PARENT)
+        return Lua::Return(static_cast<std::size_t>(m_nodes[i].m_parent));
+    return Lua::Return();
+}
+Mat4 ModelImpl::NodeTransform(std::size_t i) const {
+    if(i < m_nodes.size())
+        return Mat4(m_nodes[i].m_transform);
+    return Mat4();
+}
+
+std::size_t ModelImpl::ClipCount() const {
+    return m_clips.size();
+}
+Lua::ReturnValues ModelImpl::GetClipByNumber(std::size_t i) {
+    if(i < m_clips.size())
+        return Lua::Return(m_clips[i]);
+    return Lua::Return();
+}
+Lua::ReturnValues ModelImpl::GetClipByName(std::string const& name) {
+    for(std::size_t i = 0; i < m_clips.size(); ++i)
+    {
+        if(m_clips[i]->Name() == name)
+            return Lua::Return(m_clips[i]);
+    }
+    return Lua::Return();
+}
+
 }
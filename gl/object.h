@@ -2,16 +2,35 @@
 #define LUAGL_OBJECT_H
 #include "shared.h"
 #include "objectbone.h"
+#include "modelfile.h"
 
 namespace LuaApi {
 	class ModelImpl {
         std::vector<ModelBone> m_bones;
+        std::vector<ModelNode> m_nodes;
+        std::vector<AnimationClip> m_clips;
+        
+        bool build(ModelFile const&);
     public:
+        enum : std::uint32_t { NO_PARENT = ModelFile::NO_PARENT };
+        
         bool load(std::string const&);
+        std::vector<ModelBone> const& bones() const;
+        std::vector<ModelNode> const& nodes() const;
+        std::vector<AnimationClip> const& clips() const;
         
         std::size_t BoneCount() const;
         Lua::ReturnValues GetBoneByNumber(std::size_t);
         Lua::ReturnValues GetBoneByName(std::string const&);
+        
+        std::size_t NodeCount() const;
+        Lua::ReturnValues NodeName(std::size_t) const;
+        Lua::ReturnValues NodeParent(std::size_t) const;
+        Mat4 NodeTransform(std::size_t) const;
+        
+        std::size_t ClipCount() const;
+        Lua::ReturnValues GetClipByNumber(std::size_t);
+        Lua::ReturnValues GetClipByName(std::string const&);
     };
     typedef LuaApi::RefCounted<ModelImpl> Model;
 }
@@ -26,6 +45,13 @@ template <> struct MetatableDescriptor<LuaApi::ModelImpl> {
         mt["BoneCount"] = Lua::Transform(&LuaApi::ModelImpl::BoneCount);
         mt["BoneByName"] = Lua::Transform(&LuaApi::ModelImpl::GetBoneByName);
         mt["BoneByIndex"] = Lua::Transform(&LuaApi::ModelImpl::GetBoneByNumber);
+        mt["NodeCount"] = Lua::Transform(&LuaApi::ModelImpl::NodeCount);
+        mt["NodeName"] = Lua::Transform(&LuaApi::ModelImpl::NodeName);
+        mt["NodeParent"] = Lua::Transform(&LuaApi::ModelImpl::NodeParent);
+        mt["NodeTransform"] = Lua::Transform(&LuaApi::ModelImpl::NodeTransform);
+        mt["ClipCount"] = Lua::Transform(&LuaApi::ModelImpl::ClipCount);
+        mt["ClipByName"] = Lua::Transform(&LuaApi::ModelImpl::GetClipByName);
+        mt["ClipByIndex"] = Lua::Transform(&LuaApi::ModelImpl::GetClipByNumber);
     }
 };
 #endif
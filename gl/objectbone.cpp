@@ -3,7 +3,8 @@
 namespace LuaApi {
 
 ModelBoneImpl::ModelBoneImpl()
-    : m_boneId(static_cast<std::uint32_t>(-1))
+    : m_boneId(static_cast<std::uint32_t>(-1)),
+      m_world(1.f)
 {
     m_model.Init();
     m_material.Init();
@@ -15,5 +16,21 @@ std::string ModelBoneImpl::Name() const { return m_name; }
 std::uint32_t ModelBoneImpl::Bone() const { return m_boneId; }
 ObjectMaterial ModelBoneImpl::Material() { return m_material; }
 void ModelBoneImpl::SetMaterial(ObjectMaterial m) { m_material = std::move(m); }
+void ModelBoneImpl::SetWorld(glm::mat4 const& m) { m_world = m; }
+glm::mat4 const& ModelBoneImpl::world() const { return m_world; }
+Mat4 ModelBoneImpl::World() const { return Mat4(m_world); }
+void ModelBoneImpl::Draw()
+{
+    if(!m_model->good() || !ShaderImpl::uploadModel(m_world))
+        return;
+    m_model->draw();
+}
+ModelStorage const& ModelBoneImpl::storage() const { return m_model; }
+FixedReturn<float, 6> ModelBoneImpl::Bounds() const { return m_model->Bounds(); }
+FixedReturn<float, 4> ModelBoneImpl::BoundingSphere() const { return m_model->BoundingSphere(); }
+std::vector<std::uint32_t> const& ModelBoneImpl::joints() const { return m_joints; }
+std::vector<glm::mat4> const& ModelBoneImpl::inverseBind() const { return m_inverseBind; }
+bool ModelBoneImpl::IsSkinned() const { return !m_joints.empty(); }
+std::size_t ModelBoneImpl::JointCount() const { return m_joints.size(); }
 
 }
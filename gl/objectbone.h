@@ -12,6 +12,11 @@ namespace LuaApi {
         std::uint32_t m_boneId;
         ModelStorage m_model;
         ObjectMaterial m_material;
+        glm::mat4 m_world;
+        // Skinned meshes: node index and inverse bind matrix of every
+        // palette entry.
+        std::vector<std::uint32_t> m_joints;
+        std::vector<glm::mat4> m_inverseBind;
         
         void SetName(std::string);
         void SetBoneId(std::uint32_t);
@@ -22,6 +27,24 @@ namespace LuaApi {
         std::uint32_t Bone() const;
         ObjectMaterial Material();
         void SetMaterial(ObjectMaterial);
+        
+        // Written by the Scene the model is attached to.
+        void SetWorld(glm::mat4 const&);
+        glm::mat4 const& world() const;
+        Mat4 World() const;
+        // Writes World() to the shaders' Object block and draws the mesh
+        // with the program and textures bound by the caller.
+        void Draw() override;
+        
+        ModelStorage const& storage() const;
+        // Of the bone's mesh, in model space; see ModelStorage.
+        FixedReturn<float, 6> Bounds() const;
+        FixedReturn<float, 4> BoundingSphere() const;
+        
+        std::vector<std::uint32_t> const& joints() const;
+        std::vector<glm::mat4> const& inverseBind() const;
+        bool IsSkinned() const;
+        std::size_t JointCount() const;
     };
     
     typedef RefCounted<ModelBoneImpl> ModelBone;
@@ -37,6 +60,12 @@ template <> struct MetatableDescriptor<LuaApi::ModelBoneImpl> {
         mt["Bone"] = Lua::Transform(&LuaApi::ModelBoneImpl::Bone);
         mt["Material"] = Lua::Transform(&LuaApi::ModelBoneImpl::Material);
         mt["SetMaterial"] = Lua::Transform(&LuaApi::ModelBoneImpl::SetMaterial);
+        mt["World"] = Lua::Transform(&LuaApi::ModelBoneImpl::World);
+        mt["Draw"] = Lua::Transform(&LuaApi::ModelBoneImpl::Draw);
+        mt["Bounds"] = LuaApi::PushFixed(&LuaApi::ModelBoneImpl::Bounds);
+        mt["BoundingSphere"] = LuaApi::PushFixed(&LuaApi::ModelBoneImpl::BoundingSphere);
+        mt["IsSkinned"] = Lua::Transform(&LuaApi::ModelBoneImpl::IsSkinned);
+        mt["JointCount"] = Lua::Transform(&LuaApi::ModelBoneImpl::JointCount);
     }
 };
 
@@ -0,0 +1,113 @@
+#include "packer.h"
+#include <algorithm>
+#include <limits>
+
+namespace LuaApi {
+
+// SkylinePacker
+SkylinePacker::SkylinePacker() :
+    m_width(0),
+    m_height(0),
+    m_used(0)
+{}
+SkylinePacker::SkylinePacker(int width, int height)
+{
+    reset(width, height);
+}
+
+void SkylinePacker::reset(int width, int height)
+{
+    m_width = width;
+    m_height = height;
+    m_used = 0;
+    m_skyline.clear();
+    if(width > 0 && height > 0)
+        m_skyline.push_back({ 0, 0, width });
+}
+
+bool SkylinePacker::fits(std::size_t index, int width, int height, int& y) const
+{
+    int const x = m_skyline[index].m_x;
+    if(x + width > m_width)
+        return false;
+    y = 0;
+    for(int left = width; left > 0; ++index)
+    {
+        y = std::max(y, m_skyline[index].m_y);
+        if(y + height > m_height)
+            return false;
+        left -= m_skyline[index].m_width;
+    }
+    return true;
+}
+
+bool SkylinePacker::insert(int width, int height, int& x, int& y)
+{
+    if(width <= 0 || height <= 0)
+        return false;
+    std::size_t best = m_skyline.size();
+    int bestTop = std::numeric_limits<int>::max();
+    int bestWidth = std::numeric_limits<int>::max();
+    int bestY = 0;
+    for(std::size_t i = 0; i < m_skyline.size(); ++i)
+    {
+        int top;
+        if(!fits(i, width, height, top))
+            continue;
+        if(top + height < bestTop || (top + height == bestTop && m_skyline[i].m_width < bestWidth))
+        {
+            best = i;
+            bestTop = top + height;
+            bestWidth = m_skyline[i].m_width;
+            bestY = top;
+        }
+    }
+    if(best == m_skyline.size())
+        return false;
+
+    x = m_skyline[best].m_x;
+    y = bestY;
+    m_skyline.insert(m_skyline.begin() + best, { x, bestY + height, width });
+    // Cut the segments now under the new one.
+    int const right = x + width;
+    std::size_t i = best + 1;
+    while(i < m_skyline.size() && m_skyline[i].m_x < right)
+    {
+        Segment& s = m_skyline[i];
+        int const cut = right - s.m_x;
+        if(cut >= s.m_width)
+        {
+            m_skyline.erase(m_skyline.begin() + i);
+            continue;
+        }
+        s.m_x += cut;
+        s.m_width -= cut;
+        break;
+    }
+    // Join neighbours at the same height.
+    for(std::size_t j = 0; j + 1 < m_skyline.size();)
+    {
+        if(m_skyline[j].m_y == m_skyline[j + 1].m_y)
+        {
+            m_skyline[j].m_width += m_skyline[j + 1].m_width;
+            m_skyline.erase(m_skyline.begin() + j + 1);
+        }
+        else
+            ++j;
+    }
+    m_used += static_cast<std::uint64_t>(width) * height;
+    return true;
+}
+
+std::uint64_t SkylinePacker::used() const
+{
+    return m_used;
+}
+float SkylinePacker::occupancy() const
+{
+    if(m_width <= 0 || m_height <= 0)
+        return 0.f;
+    return static_cast<float>(static_cast<double>(m_used) / (static_cast<double>(m_width) * m_height));
+}
+
+}
@@ -0,0 +1,36 @@
+#ifndef LUAGL_PACKER_H
+#define LUAGL_PACKER_H
+#include <cstdint>
+#include <vector>
+
+namespace LuaApi {
+    // Skyline rectangle packer: the top edge of everything placed so far is
+    // kept as a list of horizontal segments, and each rectangle goes where
+    // its top ends up lowest, ties to the narrowest segment. Space is never
+    // given back; reset() to start over.
+    class SkylinePacker {
+        struct Segment {
+            int m_x;
+            int m_y;
+            int m_width;
+        };
+        std::vector<Segment> m_skyline;
+        int m_width;
+        int m_height;
+        std::uint64_t m_used;
+
+        bool fits(std::size_t index, int width, int height, int& y) const;
+    public:
+        SkylinePacker();
+        SkylinePacker(int width, int height);
+
+        void reset(int width, int height);
+        bool insert(int width, int height, int& x, int& y);
+        // Area of the rectangles placed.
+        std::uint64_t used() const;
+        // used() over the whole area.
+        float occupancy() const;
+    };
+}
+
+#endif
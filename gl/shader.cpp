@@ -1,7 +1,35 @@
 #include "shader.h"
+#include "uniformblock.h"
+#include "../world/animation.h"
+#include "../core/vfs.h"
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <cstring>
 
 namespace LuaApi {
+namespace {
+// std140 layout of the Object block.
+struct ObjectBlock {
+    float m_model[16];
+    float m_normal[16];
+};
+static_assert(sizeof(ObjectBlock) == 128, "Object block must match its std140 layout");
+
+SharedUniformBlock g_object(ShaderImpl::OBJECT_UBO_BINDING, sizeof(ObjectBlock));
+}
+
 // ShaderImpl
+char const* ShaderImpl::objectBlockName() { return "Object"; }
+
+bool ShaderImpl::uploadModel(glm::mat4 const& model)
+{
+    ObjectBlock block;
+    std::memcpy(block.m_model, glm::value_ptr(model), sizeof(block.m_model));
+    glm::mat4 const normal(glm::transpose(glm::inverse(glm::mat3(model))));
+    std::memcpy(block.m_normal, glm::value_ptr(normal), sizeof(block.m_normal));
+    return g_object.upload(&block, sizeof(block));
+}
+
 bool ShaderImpl::load(std::string const& shd1, std::string const& shd2, Lua::Arg<std::string> const& geom)
 {
     unload();
@@ -23,20 +51,26 @@ bool ShaderImpl::load(std::string const& shd1, std::string const& shd2, Lua::Arg
         unload();
         return false;
     }
+    bindBlocks();
     return true;
 }
 bool ShaderImpl::loadfromfile(std::string const& shd1, std::string const& shd2, Lua::Arg<std::string> const& geom)
+{
+    return loadfiles(shd1, shd2, geom ? &*geom : nullptr);
+}
+bool ShaderImpl::loadfiles(std::string const& shd1, std::string const& shd2, std::string const* geom)
 {
     unload();
     m_program = std::make_shared<QOpenGLShaderProgram>();
-    if(!m_program->addShaderFromSourceFile(QOpenGLShader::Vertex, QString::fromStdString(shd1)) ||
-            !m_program->addShaderFromSourceFile(QOpenGLShader::Fragment, QString::fromStdString(shd2)))
+    Vfs const& vfs = Vfs::Instance();
+    if(!m_program->addShaderFromSourceCode(QOpenGLShader::Vertex, vfs.read(shd1)) ||
+            !m_program->addShaderFromSourceCode(QOpenGLShader::Fragment, vfs.read(shd2)))
     {
         unload();
         return false;
     }
     
-    if(geom && !m_program->addShaderFromSourceFile(QOpenGLShader::Geometry, QString::fromStdString(*geom)))
+    if(geom && !m_program->addShaderFromSourceCode(QOpenGLShader::Geometry, vfs.read(*geom)))
     {
         unload();
         return false;
@@ -46,12 +80,41 @@ bool ShaderImpl::loadfromfile(std::string const& shd1, std::string const& shd2,
         unload();
         return false;
     }
+    bindBlocks();
     return true;
 }
+void ShaderImpl::bindBlocks()
+{
+    QOpenGLContext* context = QOpenGLContext::currentContext();
+    if(!context)
+        return;
+    QOpenGLExtraFunctions* f = context->extraFunctions();
+    struct Block { char const* m_name; GLuint m_binding; };
+    Block const blocks[] = {
+        { CameraImpl::blockName(), CameraImpl::UBO_BINDING },
+        { AnimatorImpl::blockName(), AnimatorImpl::PALETTE_UBO_BINDING },
+        { ShaderImpl::objectBlockName(), ShaderImpl::OBJECT_UBO_BINDING }
+    };
+    for(Block const& b : blocks)
+    {
+        GLuint index = f->glGetUniformBlockIndex(m_program->programId(), b.m_name);
+        if(index != GL_INVALID_INDEX)
+            f->glUniformBlockBinding(m_program->programId(), index, b.m_binding);
+    }
+}
 void ShaderImpl::unload()
 {
     m_program.reset();
 }
 QOpenGLShaderProgram* ShaderImpl::shader() const { return m_program.get(); }
 bool ShaderImpl::good() const { return m_program.get() != nullptr; }
+void ShaderImpl::SetCamera(Camera camera)
+{
+    if(camera.IsValid())
+        camera->Upload();
+}
+void ShaderImpl::SetModel(Mat4 model)
+{
+    uploadModel(model.value());
+}
 }
@@ -4,18 +4,40 @@
 #include "camera.h"
 
 namespace LuaApi {
+    // Programs get the shared uniform blocks bound when they link: Camera,
+    // Skin (see Animator) and Object, which holds the matrices of whatever
+    // is drawn next:
+    //
+    //   layout(std140) uniform Object {
+    //       mat4 g_model;
+    //       mat4 g_normalMatrix;   // inverse transpose of g_model
+    //   };
 	class ShaderImpl {
+    public:
+        enum { OBJECT_UBO_BINDING = 2 };
+        static char const* objectBlockName();
+        // Writes the Object block; ModelBone:Draw() does this itself.
+        static bool uploadModel(glm::mat4 const&);
+    private:
         std::shared_ptr<QOpenGLShaderProgram> m_program;
+        
+        // Points the program's shared uniform blocks at their fixed bindings.
+        void bindBlocks();
     public:
         ShaderImpl() =default;
         
         bool load(std::string const&, std::string const&, Lua::Arg<std::string> const&);
         bool loadfromfile(std::string const&, std::string const&, Lua::Arg<std::string> const&);
+        // Same, for C++ callers; geometry shader optional.
+        bool loadfiles(std::string const&, std::string const&, std::string const* = nullptr);
         void unload();
         QOpenGLShaderProgram* shader() const;
         bool good() const;
         
+        // Same as camera:Upload(); the block is shared by all programs.
         void SetCamera(Camera);
+        // For meshes drawn through ModelStorage:Draw().
+        void SetModel(Mat4);
     };
     
     typedef RefCounted<ShaderImpl> Shader;
@@ -31,6 +53,8 @@ template <> struct MetatableDescriptor<LuaApi::ShaderImpl> {
         mt["LoadFile"] = Lua::Transform(&LuaApi::ShaderImpl::loadfromfile);
         mt["IsValid"] = Lua::Transform(&LuaApi::ShaderImpl::good);
         mt["Unload"] = Lua::Transform(&LuaApi::ShaderImpl::unload);
+        mt["SetCamera"] = Lua::Transform(&LuaApi::ShaderImpl::SetCamera);
+        mt["SetModel"] = Lua::Transform(&LuaApi::ShaderImpl::SetModel);
     }
 };
 #endif
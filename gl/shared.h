@@ -10,5 +10,6 @@
 #include "state.h"
 #include "library.h"
 #include "../shared.h"
+#include "../core/binding.h"
 
 #endif
@@ -0,0 +1,300 @@
+#include "sprite.h"
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+namespace LuaApi {
+
+// SpriteBatchImpl
+SpriteBatchImpl::SpriteBatchImpl() :
+    m_program(nullptr),
+    m_viewportLocation(-1),
+    m_arrayLocation(-1),
+    m_distanceFieldLocation(-1),
+    m_texture(nullptr),
+    m_array(false),
+    m_distanceField(false),
+    m_vbo(QOpenGLBuffer::VertexBuffer),
+    m_ibo(QOpenGLBuffer::IndexBuffer),
+    m_ringOffset(0),
+    m_width(1.f),
+    m_height(1.f),
+    m_color(0xFFFFFFFF),
+    m_sprites(0),
+    m_draws(0)
+{
+    m_vertices.reserve(MAX_QUADS * 4);
+}
+
+bool SpriteBatchImpl::createBuffers()
+{
+    if(m_vao)
+        return true;
+    std::unique_ptr<QOpenGLVertexArrayObject> vao(new QOpenGLVertexArrayObject);
+    if(!vao->create() || !m_vbo.create() || !m_ibo.create())
+    {
+        m_vbo.destroy();
+        m_ibo.destroy();
+        return false;
+    }
+    vao->bind();
+    m_vbo.setUsagePattern(QOpenGLBuffer::StreamDraw);
+    m_vbo.bind();
+    m_vbo.allocate(MAX_QUADS * 4 * sizeof(SpriteVertex) * RING_BATCHES);
+    // Corners TL TR BL BR, two triangles per quad.
+    std::vector<std::uint16_t> indices(MAX_QUADS * 6);
+    for(std::size_t q = 0; q < MAX_QUADS; ++q)
+    {
+        std::uint16_t const v = static_cast<std::uint16_t>(q * 4);
+        std::uint16_t* ix = &indices[q * 6];
+        ix[0] = v;
+        ix[1] = v + 1;
+        ix[2] = v + 2;
+        ix[3] = v + 2;
+        ix[4] = v + 1;
+        ix[5] = v + 3;
+    }
+    m_ibo.setUsagePattern(QOpenGLBuffer::StaticDraw);
+    m_ibo.bind();
+    m_ibo.allocate(indices.data(), static_cast<int>(indices.size() * sizeof(std::uint16_t)));
+    vao->release();
+    m_vbo.release();
+    m_vao = std::move(vao);
+    m_ringOffset = 0;
+    return true;
+}
+
+QOpenGLShaderProgram* SpriteBatchImpl::program()
+{
+    QOpenGLShaderProgram* p = nullptr;
+    if(m_shader.IsValid() && m_shader->good())
+        p = m_shader->shader();
+    else
+    {
+        if(!m_default.IsValid())
+        {
+            m_default.Init();
+            m_default->loadfiles(":/shaders/sprite/vert.vsh", ":/shaders/sprite/frag.fsh");
+        }
+        if(m_default->good())
+            p = m_default->shader();
+    }
+    if(p != m_program)
+    {
+        m_program = p;
+        m_viewportLocation = p ? p->uniformLocation("g_viewport") : -1;
+        m_arrayLocation = p ? p->uniformLocation("g_array") : -1;
+        m_distanceFieldLocation = p ? p->uniformLocation("g_distanceField") : -1;
+    }
+    return p;
+}
+
+void SpriteBatchImpl::setTexture(QOpenGLTexture* texture, bool array, bool distanceField)
+{
+    if(texture == m_texture && array == m_array && distanceField == m_distanceField)
+        return;
+    Flush();
+    m_texture = texture;
+    m_array = array;
+    m_distanceField = distanceField;
+}
+
+void SpriteBatchImpl::SetViewport(float width, float height)
+{
+    if(width == m_width && height == m_height)
+        return;
+    Flush();
+    m_width = width > 0.f ? width : 1.f;
+    m_height = height > 0.f ? height : 1.f;
+}
+void SpriteBatchImpl::SetShader(Shader shader)
+{
+    if(shader.TryGet() == m_shader.TryGet())
+        return;
+    Flush();
+    m_shader = std::move(shader);
+}
+std::uint32_t SpriteBatchImpl::PackColor(float r, float g, float b, float a)
+{
+    auto channel = [](float c) {
+        return static_cast<std::uint32_t>(std::min(std::max(c, 0.f), 1.f) * 255.f + 0.5f);
+    };
+    return channel(r) | (channel(g) << 8) | (channel(b) << 16) | (channel(a) << 24);
+}
+void SpriteBatchImpl::SetColor(float r, float g, float b, float a)
+{
+    m_color = PackColor(r, g, b, a);
+}
+std::uint32_t SpriteBatchImpl::color() const
+{
+    return m_color;
+}
+
+bool SpriteBatchImpl::use(Texture const& texture)
+{
+    TextureImpl const* t = texture.TryGet();
+    if(!t || !t->good())
+        return false;
+    if(t->atlased())
+        return use(t->atlaspages());
+    if(!t->texture())
+        return false;
+    if(t->texture() != m_texture || m_array)
+    {
+        setTexture(t->texture(), false, false);
+        m_textureHandle = texture;
+        m_arrayHandle.SoftRelease();
+    }
+    return true;
+}
+bool SpriteBatchImpl::use(TextureArray const& texture, bool distanceField)
+{
+    TextureArrayImpl const* t = texture.TryGet();
+    if(!t || !t->good())
+        return false;
+    if(t->texture() != m_texture || !m_array || distanceField != m_distanceField)
+    {
+        setTexture(t->texture(), true, distanceField);
+        m_arrayHandle = texture;
+        m_textureHandle.SoftRelease();
+    }
+    return true;
+}
+void SpriteBatchImpl::quad(float x, float y, float w, float h, float u0, float v0, float u1, float v1,
+                           float layer, std::uint32_t color)
+{
+    if(m_vertices.size() + 4 > MAX_QUADS * 4)
+        Flush();
+    SpriteVertex v[4] = {
+        { x, y, u0, v0, layer, color },
+        { x + w, y, u1, v0, layer, color },
+        { x, y + h, u0, v1, layer, color },
+        { x + w, y + h, u1, v1, layer, color }
+    };
+    m_vertices.insert(m_vertices.end(), v, v + 4);
+}
+void SpriteBatchImpl::vertices(SpriteVertex const* v, std::size_t count)
+{
+    count &= ~std::size_t(3);
+    while(count)
+    {
+        if(m_vertices.size() == MAX_QUADS * 4)
+            Flush();
+        std::size_t n = std::min(count, MAX_QUADS * 4 - m_vertices.size());
+        m_vertices.insert(m_vertices.end(), v, v + n);
+        v += n;
+        count -= n;
+    }
+}
+
+void SpriteBatchImpl::Draw(Texture texture, float x, float y, float w, float h)
+{
+    DrawRegion(std::move(texture), x, y, w, h, 0.f, 0.f, 1.f, 1.f);
+}
+void SpriteBatchImpl::DrawRegion(Texture texture, float x, float y, float w, float h, float u0, float v0, float u1, float v1)
+{
+    if(texture.IsValid() && texture->streamed())
+    {
+        // Screen pixels the whole texture would span, along its longer edge.
+        FixedReturn<std::size_t, 2> const size = texture->size();
+        float const du = std::max(std::fabs(u1 - u0), 1e-6f);
+        float const dv = std::max(std::fabs(v1 - v0), 1e-6f);
+        float const scale = std::max(std::fabs(w) / (du * size.m_values[0]), std::fabs(h) / (dv * size.m_values[1]));
+        texture->request(scale * std::max(size.m_values[0], size.m_values[1]));
+    }
+    if(!use(texture))
+        return;
+    float layer = 0.f;
+    if(texture->atlased())
+    {
+        texture->mapuv(u0, v0);
+        texture->mapuv(u1, v1);
+        layer = static_cast<float>(texture->page());
+    }
+    quad(x, y, w, h, u0, v0, u1, v1, layer, m_color);
+}
+void SpriteBatchImpl::DrawLayer(TextureArray texture, std::uint32_t layer, float x, float y, float w, float h,
+                                float u0, float v0, float u1, float v1)
+{
+    if(use(texture))
+        quad(x, y, w, h, u0, v0, u1, v1, static_cast<float>(layer), m_color);
+}
+
+void SpriteBatchImpl::Flush()
+{
+    if(m_vertices.empty())
+        return;
+    QOpenGLContext* context = QOpenGLContext::currentContext();
+    QOpenGLShaderProgram* p = context ? program() : nullptr;
+    if(!p || !m_texture || !createBuffers())
+    {
+        m_vertices.clear();
+        return;
+    }
+    QOpenGLFunctions* f = context->functions();
+
+    std::size_t const bytes = m_vertices.size() * sizeof(SpriteVertex);
+    std::size_t const ring = MAX_QUADS * 4 * sizeof(SpriteVertex) * RING_BATCHES;
+    m_vbo.bind();
+    if(m_ringOffset + bytes > ring)
+    {
+        // Orphan: the driver hands out fresh storage while draws still
+        // reading the old one finish.
+        m_vbo.allocate(static_cast<int>(ring));
+        m_ringOffset = 0;
+    }
+    void* dst = m_vbo.mapRange(static_cast<int>(m_ringOffset), static_cast<int>(bytes),
+                               QOpenGLBuffer::RangeWrite | QOpenGLBuffer::RangeInvalidate | QOpenGLBuffer::RangeUnsynchronized);
+    if(!dst)
+    {
+        m_vbo.release();
+        m_vertices.clear();
+        return;
+    }
+    std::memcpy(dst, m_vertices.data(), bytes);
+    m_vbo.unmap();
+
+    m_vao->bind();
+    char const* base = reinterpret_cast<char const*>(m_ringOffset);
+    GLsizei const stride = sizeof(SpriteVertex);
+    f->glEnableVertexAttribArray(0);
+    f->glEnableVertexAttribArray(1);
+    f->glEnableVertexAttribArray(2);
+    f->glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, base + offsetof(SpriteVertex, m_x));
+    f->glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, base + offsetof(SpriteVertex, m_u));
+    f->glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, base + offsetof(SpriteVertex, m_color));
+    m_vbo.release();
+
+    p->bind();
+    if(m_viewportLocation >= 0)
+        p->setUniformValue(m_viewportLocation, m_width, m_height);
+    if(m_arrayLocation >= 0)
+        p->setUniformValue(m_arrayLocation, m_array ? 1 : 0);
+    if(m_distanceFieldLocation >= 0)
+        p->setUniformValue(m_distanceFieldLocation, m_distanceField ? 1 : 0);
+    m_texture->bind(m_array ? 1 : 0);
+
+    std::size_t const quads = m_vertices.size() / 4;
+    f->glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(quads * 6), GL_UNSIGNED_SHORT, nullptr);
+    m_vao->release();
+
+    m_ringOffset += bytes;
+    m_sprites += static_cast<std::uint32_t>(quads);
+    ++m_draws;
+    m_vertices.clear();
+}
+
+FixedReturn<std::uint32_t, 2> SpriteBatchImpl::Stats() const
+{
+    return ReturnFixed(m_sprites, m_draws);
+}
+void SpriteBatchImpl::ResetStats()
+{
+    m_sprites = 0;
+    m_draws = 0;
+}
+
+}
@@ -0,0 +1,129 @@
+#ifndef LUAGL_SPRITE_H
+#define LUAGL_SPRITE_H
+#include <memory>
+#include <vector>
+#include "shared.h"
+#include "shader.h"
+#include "texture.h"
+#include "texturearray.h"
+
+namespace LuaApi {
+    // Corners of a sprite in pixels from the top left; u, v, array layer;
+    // RGBA8 tint.
+    struct SpriteVertex {
+        float m_x, m_y;
+        float m_u, m_v, m_layer;
+        std::uint32_t m_color;
+    };
+
+    // Batched 2D quads in pixel coordinates.
+    // Quads are collected on the CPU and drawn with one call per run of
+    // the same texture and shader; a run ends on a texture or shader
+    // change, a full batch, or Flush(). Layers of one TextureArray are the
+    // same texture, so UI packed into array pages, or textures from a
+    // TextureAtlas, draws in a few calls.
+    //
+    // Vertices stream through a ring buffer written with unsynchronized
+    // maps, and orphaned when it wraps, so a flush never waits on the GPU.
+    // The default program is shaders/sprite; one set with SetShader needs
+    // the same inputs and uniforms. Blend and depth state are left to the
+    // caller.
+    class SpriteBatchImpl {
+    public:
+        enum {
+            MAX_QUADS = 8192,
+            RING_BATCHES = 4
+        };
+    private:
+        Shader m_shader;
+        Shader m_default;
+        QOpenGLShaderProgram* m_program;
+        int m_viewportLocation;
+        int m_arrayLocation;
+        int m_distanceFieldLocation;
+
+        // What the pending quads sample, and the handle keeping it alive.
+        QOpenGLTexture* m_texture;
+        bool m_array;
+        bool m_distanceField;
+        Texture m_textureHandle;
+        TextureArray m_arrayHandle;
+
+        std::unique_ptr<QOpenGLVertexArrayObject> m_vao;
+        QOpenGLBuffer m_vbo;
+        QOpenGLBuffer m_ibo;
+        std::size_t m_ringOffset;
+        std::vector<SpriteVertex> m_vertices;
+
+        float m_width;
+        float m_height;
+        std::uint32_t m_color;
+        std::uint32_t m_sprites;
+        std::uint32_t m_draws;
+
+        bool createBuffers();
+        QOpenGLShaderProgram* program();
+        void setTexture(QOpenGLTexture*, bool array, bool distanceField);
+    public:
+        SpriteBatchImpl();
+        SpriteBatchImpl(SpriteBatchImpl const&) =delete;
+        SpriteBatchImpl& operator= (SpriteBatchImpl const&) =delete;
+
+        void SetViewport(float width, float height);
+        // nil for the default program.
+        void SetShader(Shader);
+        void SetColor(float r, float g, float b, float a);
+        static std::uint32_t PackColor(float r, float g, float b, float a);
+        std::uint32_t color() const;
+
+        // For C++ producers: bind, then add quads or ready-made vertices
+        // (four per quad, in SpriteVertex corner order TL TR BL BR).
+        // A distance field array holds signed distance in alpha, 0.5 on
+        // the edge, and is drawn as an antialiased coverage mask.
+        bool use(Texture const&);
+        bool use(TextureArray const&, bool distanceField = false);
+        void quad(float x, float y, float w, float h, float u0, float v0, float u1, float v1,
+                  float layer, std::uint32_t color);
+        void vertices(SpriteVertex const*, std::size_t count);
+
+        void Draw(Texture, float x, float y, float w, float h);
+        void DrawRegion(Texture, float x, float y, float w, float h, float u0, float v0, float u1, float v1);
+        void DrawLayer(TextureArray, std::uint32_t layer, float x, float y, float w, float h,
+                       float u0, float v0, float u1, float v1);
+        void Flush();
+
+        // Sprites and draw calls since the last ResetStats.
+        FixedReturn<std::uint32_t, 2> Stats() const;
+        void ResetStats();
+    };
+
+    typedef RefCounted<SpriteBatchImpl> SpriteBatch;
+}
+
+template <> struct MetatableDescriptor<LuaApi::SpriteBatchImpl> {
+    static char const* name() { return "spritebatch_mt"; }
+    static char const* luaname() { return "SpriteBatch"; }
+    static char const* constructor() { return "New"; }
+    static bool construct(LuaApi::SpriteBatchImpl* v) { return Lua::DefaultConstructor(v); }
+    static void metatable(Lua::member_function_storage<LuaApi::SpriteBatchImpl>& mt) {
+#define REG_FNC(name) mt[ #name ] = Lua::Transform(&LuaApi::SpriteBatchImpl::name)
+        REG_FNC(SetViewport);
+        REG_FNC(SetShader);
+        REG_FNC(SetColor);
+        REG_FNC(Draw);
+        REG_FNC(DrawRegion);
+        REG_FNC(DrawLayer);
+        REG_FNC(Flush);
+        mt["Stats"] = LuaApi::PushFixed(&LuaApi::SpriteBatchImpl::Stats);
+        REG_FNC(ResetStats);
+#undef REG_FNC
+    }
+    static void direct(LuaApi::DirectMethods<LuaApi::SpriteBatchImpl>& dm) {
+        dm.Add("SetColor", &LuaApi::SpriteBatchImpl::SetColor);
+        dm.Add("Draw", &LuaApi::SpriteBatchImpl::Draw);
+        dm.Add("DrawRegion", &LuaApi::SpriteBatchImpl::DrawRegion);
+        dm.Add("DrawLayer", &LuaApi::SpriteBatchImpl::DrawLayer);
+    }
+};
+
+#endif
@@ -0,0 +1,283 @@
+#include "streaming.h"
+#include <QImage>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "texturefile.h"
+#include "../core/jobs.h"
+
+namespace LuaApi {
+
+// StreamedTexture
+StreamedTexture::StreamedTexture(std::string const& path, std::uint32_t width, std::uint32_t height) :
+    m_path(path),
+    m_width(width),
+    m_height(height),
+    m_levels(TextureStreamer::LevelCount(width, height)),
+    m_top(m_levels),
+    m_wanted(m_levels),
+    m_used(false),
+    m_lastUsed(0),
+    m_loading(false),
+    m_failed(false)
+{}
+
+QOpenGLTexture* StreamedTexture::texture() const
+{
+    return m_top < m_levels ? m_texture.get() : nullptr;
+}
+std::uint32_t StreamedTexture::width() const { return m_width; }
+std::uint32_t StreamedTexture::height() const { return m_height; }
+std::uint32_t StreamedTexture::levels() const { return m_levels; }
+std::uint32_t StreamedTexture::top() const { return m_top; }
+std::uint32_t StreamedTexture::baselevel() const
+{
+    std::uint32_t level = 0;
+    while(level + 1 < m_levels && std::max(m_width >> level, m_height >> level) > TextureStreamer::BASE_SIZE)
+        ++level;
+    return level;
+}
+std::size_t StreamedTexture::levelbytes(std::uint32_t level) const
+{
+    std::size_t const width = std::max<std::uint32_t>(m_width >> level, 1);
+    std::size_t const height = std::max<std::uint32_t>(m_height >> level, 1);
+    return width * height * 4;
+}
+std::size_t StreamedTexture::residentbytes() const
+{
+    std::size_t bytes = 0;
+    for(std::uint32_t level = m_top; level < m_levels; ++level)
+        bytes += levelbytes(level);
+    return bytes;
+}
+void StreamedTexture::request(float pixels)
+{
+    m_used = true;
+    if(pixels <= 0.f)
+        return;
+    float const ratio = std::max(m_width, m_height) / pixels;
+    std::uint32_t level = ratio > 1.f ? static_cast<std::uint32_t>(std::floor(std::log2(ratio))) : 0;
+    m_wanted = std::min(m_wanted, std::min(level, m_levels - 1));
+}
+
+// TextureStreamer
+TextureStreamer::TextureStreamer() :
+    m_budget(DEFAULT_BUDGET),
+    m_uploadRate(DEFAULT_UPLOAD_RATE),
+    m_frame(0),
+    m_residentBytes(0),
+    m_uploaded(0),
+    m_evicted(0),
+    m_loading(0)
+{}
+TextureStreamer::~TextureStreamer()
+{
+    // Loads still running push into m_finished.
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_idle.wait(lock, [this]() { return m_loading == 0; });
+}
+
+TextureStreamer& TextureStreamer::Instance()
+{
+    static TextureStreamer streamer;
+    return streamer;
+}
+std::uint32_t TextureStreamer::LevelCount(std::uint32_t width, std::uint32_t height)
+{
+    std::uint32_t levels = 1;
+    for(std::uint32_t size = std::max(width, height); size > 1; size >>= 1)
+        ++levels;
+    return levels;
+}
+
+std::shared_ptr<StreamedTexture> TextureStreamer::open(std::string const& path)
+{
+    QSize const size = TextureFile::ImageSize(path);
+    if(!size.isValid() || size.isEmpty())
+        return nullptr;
+    auto texture = std::make_shared<StreamedTexture>(path, size.width(), size.height());
+    m_textures.push_back(texture);
+    return texture;
+}
+
+void TextureStreamer::buildLevels(std::string const& path, std::uint32_t width, std::uint32_t height,
+                                  std::uint32_t from, std::uint32_t to, std::vector<Level>& levels)
+{
+    QImage const image = TextureFile::ReadImage(path).convertToFormat(QImage::Format_RGBA8888);
+    // The file may have changed since its header was read.
+    if(image.isNull() || static_cast<std::uint32_t>(image.width()) != width ||
+            static_cast<std::uint32_t>(image.height()) != height)
+        return;
+    std::vector<unsigned char> pixels(width * height * 4);
+    for(std::uint32_t y = 0; y < height; ++y)
+        std::memcpy(&pixels[y * width * 4], image.constScanLine(y), width * 4);
+    for(std::uint32_t level = 0; level < to; ++level)
+    {
+        if(level >= from)
+            levels.push_back({ level, width, height, pixels });
+        if(level + 1 == to)
+            break;
+        std::uint32_t const nextWidth = std::max<std::uint32_t>(width / 2, 1);
+        std::uint32_t const nextHeight = std::max<std::uint32_t>(height / 2, 1);
+        std::vector<unsigned char> next(nextWidth * nextHeight * 4);
+        TextureFile::Halve(pixels.data(), width, height, next.data(), nextWidth, nextHeight);
+        pixels.swap(next);
+        width = nextWidth;
+        height = nextHeight;
+    }
+    std::reverse(levels.begin(), levels.end());
+}
+
+void TextureStreamer::startLoad(std::shared_ptr<StreamedTexture> const& texture, std::uint32_t top)
+{
+    texture->m_loading = true;
+    ++m_loading;
+    std::weak_ptr<StreamedTexture> weak = texture;
+    std::string const path = texture->m_path;
+    std::uint32_t const width = texture->m_width;
+    std::uint32_t const height = texture->m_height;
+    std::uint32_t const to = texture->m_top;
+    RunAsync([this, weak, path, width, height, top, to]() {
+        Load load;
+        load.m_texture = weak;
+        load.m_next = 0;
+        buildLevels(path, width, height, top, to, load.m_levels);
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_finished.push_back(std::move(load));
+        --m_loading;
+        m_idle.notify_all();
+    });
+}
+
+void TextureStreamer::upload()
+{
+    m_uploaded = 0;
+    QOpenGLContext* context = QOpenGLContext::currentContext();
+    if(!context)
+        return;
+    QOpenGLFunctions* f = context->functions();
+    f->glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    // Always at least one level, so a level above the rate still lands.
+    while(!m_uploads.empty() && m_uploaded < m_uploadRate)
+    {
+        Load& load = m_uploads.front();
+        std::shared_ptr<StreamedTexture> texture = load.m_texture.lock();
+        if(!texture || load.m_levels.empty())
+        {
+            if(texture)
+            {
+                texture->m_loading = false;
+                texture->m_failed = true;
+            }
+            m_uploads.erase(m_uploads.begin());
+            continue;
+        }
+        if(!texture->m_texture)
+        {
+            texture->m_texture.reset(new QOpenGLTexture(QOpenGLTexture::Target2D));
+            texture->m_texture->create();
+            texture->m_texture->setMinificationFilter(QOpenGLTexture::LinearMipMapLinear);
+            texture->m_texture->setMagnificationFilter(QOpenGLTexture::Linear);
+            texture->m_memory.reset(new TextureMemory::Allocation(TextureMemory::STREAMED, texture->m_path, 0));
+        }
+        texture->m_texture->bind();
+        while(load.m_next < load.m_levels.size() && m_uploaded < m_uploadRate)
+        {
+            Level& level = load.m_levels[load.m_next++];
+            f->glTexImage2D(GL_TEXTURE_2D, level.m_level, GL_RGBA8, level.m_width, level.m_height, 0,
+                            GL_RGBA, GL_UNSIGNED_BYTE, level.m_pixels.data());
+            texture->m_top = level.m_level;
+            texture->m_texture->setMipLevelRange(texture->m_top, texture->m_levels - 1);
+            m_uploaded += level.m_pixels.size();
+            std::vector<unsigned char>().swap(level.m_pixels);
+        }
+        texture->m_texture->release();
+        texture->m_memory->resize(texture->residentbytes());
+        if(load.m_next < load.m_levels.size())
+            break;
+        texture->m_loading = false;
+        m_uploads.erase(m_uploads.begin());
+    }
+}
+
+void TextureStreamer::evict()
+{
+    QOpenGLContext* context = QOpenGLContext::currentContext();
+    if(!context)
+        return;
+    QOpenGLFunctions* f = context->functions();
+    while(m_residentBytes > m_budget)
+    {
+        std::shared_ptr<StreamedTexture> victim;
+        for(std::weak_ptr<StreamedTexture> const& weak : m_textures)
+        {
+            std::shared_ptr<StreamedTexture> texture = weak.lock();
+            // Loading textures would end up with a gap in their chain.
+            if(!texture || texture->m_loading || texture->m_lastUsed >= m_frame ||
+                    texture->m_top >= texture->baselevel())
+                continue;
+            if(!victim || texture->m_lastUsed < victim->m_lastUsed)
+                victim = std::move(texture);
+        }
+        if(!victim)
+            return;
+        std::uint32_t const level = victim->m_top++;
+        victim->m_texture->bind();
+        f->glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        victim->m_texture->setMipLevelRange(victim->m_top, victim->m_levels - 1);
+        victim->m_texture->release();
+        victim->m_memory->resize(victim->residentbytes());
+        m_residentBytes -= victim->levelbytes(level);
+        ++m_evicted;
+    }
+}
+
+void TextureStreamer::EndFrame()
+{
+    ++m_frame;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        for(Load& load : m_finished)
+            m_uploads.push_back(std::move(load));
+        m_finished.clear();
+    }
+    upload();
+
+    m_residentBytes = 0;
+    for(std::size_t i = 0; i < m_textures.size();)
+    {
+        std::shared_ptr<StreamedTexture> texture = m_textures[i].lock();
+        if(!texture)
+        {
+            m_textures[i] = std::move(m_textures.back());
+            m_textures.pop_back();
+            continue;
+        }
+        if(texture->m_used)
+        {
+            texture->m_lastUsed = m_frame;
+            texture->m_used = false;
+        }
+        std::uint32_t const wanted = std::min(texture->m_wanted, texture->baselevel());
+        texture->m_wanted = texture->m_levels;
+        if(!texture->m_loading && !texture->m_failed && wanted < texture->m_top)
+            startLoad(texture, wanted);
+        m_residentBytes += texture->residentbytes();
+        ++i;
+    }
+    evict();
+}
+
+void TextureStreamer::SetBudget(std::size_t bytes) { m_budget = bytes; }
+std::size_t TextureStreamer::Budget() const { return m_budget; }
+void TextureStreamer::SetUploadRate(std::size_t bytesPerFrame) { m_uploadRate = std::max<std::size_t>(bytesPerFrame, 1); }
+std::size_t TextureStreamer::UploadRate() const { return m_uploadRate; }
+std::size_t TextureStreamer::ResidentBytes() const { return m_residentBytes; }
+Lua::ReturnValues TextureStreamer::LuaStats() const
+{
+    return Lua::Return(m_residentBytes, m_budget, m_textures.size(), m_loading.load(), m_uploaded, m_evicted);
+}
+
+}
@@ -0,0 +1,129 @@
+#ifndef LUAGL_STREAMING_H
+#define LUAGL_STREAMING_H
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "shared.h"
+#include "texturememory.h"
+
+namespace LuaApi {
+    // A texture whose mip levels come and go. Resident levels are always
+    // a tail of the chain, [top, levels), kept in mutable storage with the
+    // base level pointing at the top one, so dropping or adding a level
+    // never reallocates the others.
+    class StreamedTexture {
+        friend class TextureStreamer;
+
+        std::string m_path;
+        std::unique_ptr<QOpenGLTexture> m_texture;
+        std::unique_ptr<TextureMemory::Allocation> m_memory;
+        std::uint32_t m_width;
+        std::uint32_t m_height;
+        std::uint32_t m_levels;
+        std::uint32_t m_top;
+        // Smallest level number asked for since the last EndFrame.
+        std::uint32_t m_wanted;
+        bool m_used;
+        std::uint64_t m_lastUsed;
+        bool m_loading;
+        bool m_failed;
+    public:
+        StreamedTexture(std::string const& path, std::uint32_t width, std::uint32_t height);
+        StreamedTexture(StreamedTexture const&) =delete;
+        StreamedTexture& operator= (StreamedTexture const&) =delete;
+
+        // Null until the first levels are uploaded.
+        QOpenGLTexture* texture() const;
+        std::uint32_t width() const;
+        std::uint32_t height() const;
+        std::uint32_t levels() const;
+        std::uint32_t top() const;
+        // The largest level kept however tight the budget.
+        std::uint32_t baselevel() const;
+        std::size_t levelbytes(std::uint32_t level) const;
+        std::size_t residentbytes() const;
+        // Used this frame, covering about pixels along the longer edge;
+        // 0 only marks it used.
+        void request(float pixels);
+    };
+
+    // Streams textures in by mip level under a GPU memory budget.
+    // A texture opens with only its levels up to BASE_SIZE. Draw feedback
+    // (StreamedTexture::request) raises the wanted level; EndFrame then
+    // starts a background load that decodes the file and builds the
+    // missing levels, and uploads finished levels smallest first, at most
+    // the upload rate per frame. When resident bytes exceed the budget the
+    // top level of the least recently used texture is dropped, down to
+    // its base levels; textures used this frame are left alone.
+    //
+    // One instance per process; everything but the loads runs on the
+    // thread with the GL context.
+    class TextureStreamer {
+    public:
+        enum {
+            BASE_SIZE = 64,
+            DEFAULT_BUDGET = 512 << 20,
+            DEFAULT_UPLOAD_RATE = 8 << 20
+        };
+    private:
+        struct Level {
+            std::uint32_t m_level;
+            std::uint32_t m_width;
+            std::uint32_t m_height;
+            std::vector<unsigned char> m_pixels;
+        };
+        // Levels of one load, smallest first.
+        struct Load {
+            std::weak_ptr<StreamedTexture> m_texture;
+            std::vector<Level> m_levels;
+            std::size_t m_next;
+        };
+
+        std::vector<std::weak_ptr<StreamedTexture>> m_textures;
+        std::size_t m_budget;
+        std::size_t m_uploadRate;
+        std::uint64_t m_frame;
+        std::size_t m_residentBytes;
+        std::size_t m_uploaded;
+        std::uint64_t m_evicted;
+
+        std::vector<Load> m_uploads;
+        mutable std::mutex m_lock;
+        std::condition_variable m_idle;
+        std::vector<Load> m_finished;
+        std::atomic<std::size_t> m_loading;
+
+        TextureStreamer();
+        ~TextureStreamer();
+        void startLoad(std::shared_ptr<StreamedTexture> const&, std::uint32_t top);
+        void upload();
+        void evict();
+        // Levels [from, to) of the file, smallest first; none if it fails
+        // to decode at the expected size.
+        static void buildLevels(std::string const& path, std::uint32_t width, std::uint32_t height,
+                                std::uint32_t from, std::uint32_t to, std::vector<Level>&);
+    public:
+        TextureStreamer(TextureStreamer const&) =delete;
+        TextureStreamer& operator= (TextureStreamer const&) =delete;
+        static TextureStreamer& Instance();
+        static std::uint32_t LevelCount(std::uint32_t width, std::uint32_t height);
+
+        // Reads only the file's header; the levels follow from EndFrame.
+        std::shared_ptr<StreamedTexture> open(std::string const& path);
+        // Once per frame with the context current.
+        void EndFrame();
+
+        void SetBudget(std::size_t bytes);
+        std::size_t Budget() const;
+        void SetUploadRate(std::size_t bytesPerFrame);
+        std::size_t UploadRate() const;
+        std::size_t ResidentBytes() const;
+        // Resident bytes, budget, textures, loads in flight, bytes uploaded
+        // last frame, levels evicted in total.
+        Lua::ReturnValues LuaStats() const;
+    };
+}
+
+#endif
@@ -1,30 +1,80 @@
 #include "texture.h"
+#include "atlas.h"
+#include "streaming.h"
+#include "../core/manifest.h"
 
 namespace LuaApi {
 
 // TextureImpl::TexData
-TextureImpl::TexData::TexData(QString const& qs, bool genMM)
-    : m_image(qs),
-      m_texture(m_image, genMM ? QOpenGLTexture::GenerateMipMaps
-                               : QOpenGLTexture::DontGenerateMipMaps) {}
+TextureImpl::TexData::TexData(std::string const& path, bool genMM)
+    : TexData(TextureFile::ReadImage(path), genMM, path) {}
+TextureImpl::TexData::TexData(QImage const& image, bool genMM, std::string const& path)
+    : m_texture(image, genMM ? QOpenGLTexture::GenerateMipMaps
+                             : QOpenGLTexture::DontGenerateMipMaps),
+      m_width(image.width()),
+      m_height(image.height()),
+      m_format(m_texture.format()),
+      m_memory(TextureMemory::TEXTURE, path,
+               m_texture.isCreated() ? TextureMemory::Bytes(m_width, m_height, 1, m_texture.mipLevels(),
+                                                            TextureMemory::TexelBytes(m_format))
+                                     : 0) {}
+TextureImpl::TexData::TexData(TextureFile const& file, bool genMM, std::string const& path)
+    : m_texture(QOpenGLTexture::Target2D),
+      m_width(file.width()),
+      m_height(file.height()),
+      m_format(file.textureformat()),
+      m_memory(TextureMemory::TEXTURE, path, 0)
+{
+    std::vector<TextureFile::Level> const& levels = file.levels();
+    int const count = genMM ? static_cast<int>(levels.size()) : 1;
+    m_texture.setFormat(m_format);
+    m_texture.setSize(m_width, m_height);
+    m_texture.setMipLevels(count);
+    m_texture.allocateStorage(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8);
+    if(!m_texture.isStorageAllocated())
+        return;
+    std::size_t bytes = 0;
+    for(int level = 0; level < count; ++level)
+    {
+        std::vector<unsigned char> const& data = levels[level].m_data;
+        if(file.format() == TextureFile::RGBA8)
+            m_texture.setData(level, QOpenGLTexture::RGBA, QOpenGLTexture::UInt8, data.data());
+        else
+            m_texture.setCompressedData(level, static_cast<int>(data.size()), data.data());
+        bytes += data.size();
+    }
+    m_memory.resize(bytes);
+}
 QOpenGLTexture& TextureImpl::TexData::texture()
 {
     return m_texture;
 }
 bool TextureImpl::TexData::good() const
 {
-    return (!m_image.isNull()) && (m_texture.isCreated());
+    return m_width && m_height && m_texture.isStorageAllocated();
 }
 std::size_t TextureImpl::TexData::width() const
 {
-    return m_image.width();
+    return m_width;
 }
 std::size_t TextureImpl::TexData::height() const
 {
-    return m_image.height();
+    return m_height;
+}
+QOpenGLTexture::TextureFormat TextureImpl::TexData::format() const
+{
+    return m_format;
 }
 
 // TextureImpl
+TextureImpl::TextureImpl() :
+    m_page(0),
+    m_x(0),
+    m_y(0),
+    m_width(0),
+    m_height(0)
+{}
+
 std::uint32_t TextureImpl::FilterToUint(QOpenGLTexture::Filter f, bool& r)
 {
     switch(f)
@@ -94,7 +144,13 @@ QOpenGLTexture::WrapMode TextureImpl::UintToWrap(std::uint32_t w, bool& r)
 bool TextureImpl::load(std::string const& path, Lua::Arg<bool> const& genMipMaps)
 {
     unload();
-    m_data = std::make_shared<TexData>(QString::fromStdString(path),genMipMaps.get_safe(false));
+    bool const mipmaps = genMipMaps.get_safe(false);
+    TextureFile cooked;
+    std::string const cookedPath = AssetManifest::Instance().lookup(path, AssetManifest::TEXTURE);
+    if(!cookedPath.empty() && cooked.read(cookedPath) && cooked.supported())
+        m_data = std::make_shared<TexData>(cooked, mipmaps, path);
+    else
+        m_data = std::make_shared<TexData>(path, mipmaps);
     if(!m_data->good())
     {
         unload();
@@ -102,20 +158,79 @@ bool TextureImpl::load(std::string const& path, Lua::Arg<bool> const& genMipMaps
     }
     return true;
 }
-void TextureImpl::unload() { m_data.reset(); }
-Lua::ReturnValues TextureImpl::size() const
+bool TextureImpl::stream(std::string const& path)
+{
+    unload();
+    m_stream = TextureStreamer::Instance().open(path);
+    return m_stream != nullptr;
+}
+void TextureImpl::place(std::shared_ptr<AtlasPages> atlas, std::uint32_t page, std::uint32_t x, std::uint32_t y,
+                        std::uint32_t width, std::uint32_t height)
+{
+    unload();
+    m_atlas = std::move(atlas);
+    m_page = page;
+    m_x = x;
+    m_y = y;
+    m_width = width;
+    m_height = height;
+}
+void TextureImpl::unload()
+{
+    m_data.reset();
+    m_atlas.reset();
+    m_stream.reset();
+}
+FixedReturn<std::size_t, 2> TextureImpl::size() const
 {
     if(m_data)
-        return Lua::Return(m_data->width(), m_data->height());
-    return Lua::Return<std::size_t, std::size_t>(0,0);
+        return ReturnFixed(m_data->width(), m_data->height());
+    if(m_atlas)
+        return ReturnFixed<std::size_t>(m_width, m_height);
+    if(m_stream)
+        return ReturnFixed<std::size_t>(m_stream->width(), m_stream->height());
+    return ReturnFixed<std::size_t>(0, 0);
 }
 QOpenGLTexture* TextureImpl::texture() const
 {
     if(m_data)
         return &(m_data->texture());
+    if(m_stream)
+        return m_stream->texture();
     return nullptr;
 }
-bool TextureImpl::good() const { return m_data != nullptr; }
+bool TextureImpl::good() const { return m_data != nullptr || m_atlas != nullptr || m_stream != nullptr; }
+bool TextureImpl::atlased() const { return m_atlas != nullptr; }
+bool TextureImpl::streamed() const { return m_stream != nullptr; }
+void TextureImpl::request(float pixels)
+{
+    if(m_stream)
+        m_stream->request(pixels);
+}
+std::uint32_t TextureImpl::page() const { return m_page; }
+void TextureImpl::mapuv(float& u, float& v) const
+{
+    if(!m_atlas)
+        return;
+    float const texel = 1.f / m_atlas->pagesize();
+    u = (m_x + u * m_width) * texel;
+    v = (m_y + v * m_height) * texel;
+}
+TextureArray TextureImpl::atlaspages() const
+{
+    if(m_atlas)
+        return m_atlas->pages();
+    return TextureArray();
+}
+Lua::ReturnValues TextureImpl::region() const
+{
+    if(!m_atlas)
+        return Lua::Return();
+    float u0 = 0.f, v0 = 0.f, u1 = 1.f, v1 = 1.f;
+    mapuv(u0, v0);
+    mapuv(u1, v1);
+    return Lua::Return(m_page, u0, v0, u1, v1);
+}
 std::uint32_t TextureImpl::magfilter() const {
     if(m_data)
     {
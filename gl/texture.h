@@ -1,23 +1,47 @@
 #ifndef LUAGL_TEXTURE_H
 #define LUAGL_TEXTURE_H
 #include "shared.h"
+#include "texturearray.h"
+#include "texturememory.h"
+#include "texturefile.h"
 
 namespace LuaApi {
+	class AtlasPages;
+	class StreamedTexture;
 
 	class TextureImpl {
         
+		// The decoded image only lives through the upload; its size and
+		// format are kept instead. Cooked textures upload their stored mip
+		// chain, or only its first level without mipmaps.
 		class TexData {
-			QImage m_image;
 			QOpenGLTexture m_texture;
+			std::uint32_t m_width;
+			std::uint32_t m_height;
+			QOpenGLTexture::TextureFormat m_format;
+			TextureMemory::Allocation m_memory;
+
+			TexData(QImage const&, bool, std::string const&);
 		public:
-			TexData(QString const&, bool);
+			TexData(std::string const&, bool);
+			TexData(TextureFile const&, bool, std::string const&);
 			QOpenGLTexture& texture();
 			bool good() const;
 			std::size_t width() const;
 			std::size_t height() const;
+			QOpenGLTexture::TextureFormat format() const;
 		};
         
 		std::shared_ptr<TexData> m_data;
+		// Set instead of m_data for a texture placed in a TextureAtlas.
+		std::shared_ptr<AtlasPages> m_atlas;
+		std::uint32_t m_page;
+		std::uint32_t m_x;
+		std::uint32_t m_y;
+		std::uint32_t m_width;
+		std::uint32_t m_height;
+		// Set instead of m_data for a texture streamed by mip level.
+		std::shared_ptr<StreamedTexture> m_stream;
 	protected:
 		static std::uint32_t FilterToUint(QOpenGLTexture::Filter, bool&);
 		static QOpenGLTexture::Filter UintToFilter(std::uint32_t, bool&);
@@ -25,17 +49,34 @@ namespace LuaApi {
 		static QOpenGLTexture::WrapMode UintToWrap(std::uint32_t, bool&);
 	public:
 		
-		TextureImpl() =default;
+		TextureImpl();
 		TextureImpl(TextureImpl const&) =default;
 		TextureImpl(TextureImpl&&) =default;
 		TextureImpl& operator= (TextureImpl const&) =default;
 		TextureImpl& operator= (TextureImpl&&) =default;
 
 		bool load(std::string const&, Lua::Arg<bool> const&);
+		// Through the TextureStreamer: small mips first, more on request.
+		bool stream(std::string const&);
+		void place(std::shared_ptr<AtlasPages>, std::uint32_t page, std::uint32_t x, std::uint32_t y,
+		           std::uint32_t width, std::uint32_t height);
 		void unload();
-		Lua::ReturnValues size() const;
+		FixedReturn<std::size_t, 2> size() const;
+		// Null for atlased textures, and streamed ones with nothing resident.
 		QOpenGLTexture* texture() const;
 		bool good() const;
+		bool atlased() const;
+		bool streamed() const;
+		// Draw feedback: used this frame, about pixels across its longer
+		// edge on screen, 0 if unknown. Streamed textures fetch mips to match.
+		void request(float pixels);
+		std::uint32_t page() const;
+		// From the texture's own [0, 1] coordinates to its atlas page.
+		void mapuv(float& u, float& v) const;
+		// The atlas pages, mipmaps up to date; invalid unless atlased.
+		TextureArray atlaspages() const;
+		// Page and u0, v0, u1, v1; nothing unless atlased.
+		Lua::ReturnValues region() const;
 		std::uint32_t magfilter() const;
 		std::uint32_t minfilter() const;
 		std::uint32_t wraps() const;
@@ -61,16 +102,32 @@ template <> struct MetatableDescriptor<LuaApi::TextureImpl> {
     static bool construct(LuaApi::TextureImpl* v) { return Lua::DefaultConstructor(v); }
     static void metatable(Lua::member_function_storage<LuaApi::TextureImpl>& mt) {
         mt["Anisotropy"] = Lua::Transform(&LuaApi::TextureImpl::anisotropy);
+        mt["IsAtlased"] = Lua::Transform(&LuaApi::TextureImpl::atlased);
         mt["IsValid"] = Lua::Transform(&LuaApi::TextureImpl::good);
         mt["LoadFile"] = Lua::Transform(&LuaApi::TextureImpl::load);
+        mt["LoadStreamed"] = Lua::Transform(&LuaApi::TextureImpl::stream);
         mt["MagFilter"] = Lua::Transform(&LuaApi::TextureImpl::magfilter);
         mt["MinFilter"] = Lua::Transform(&LuaApi::TextureImpl::minfilter);
+        mt["Region"] = Lua::Transform(&LuaApi::TextureImpl::region);
+        mt["Request"] = Lua::Transform(&LuaApi::TextureImpl::request);
         mt["SetAnisotropy"] = Lua::Transform(&LuaApi::TextureImpl::setanisotropy);
         mt["SetFilter"] = Lua::Transform(&LuaApi::TextureImpl::setfilter);
         mt["SetMagFilter"] = Lua::Transform(&LuaApi::TextureImpl::setmagfilter);
         mt["SetMinFilter"] = Lua::Transform(&LuaApi::TextureImpl::setminfilter);
-        mt["Size"] = Lua::Transform(&LuaApi::TextureImpl::size);
+        mt["Size"] = LuaApi::PushFixed(&LuaApi::TextureImpl::size);
         mt["Unload"] = Lua::Transform(&LuaApi::TextureImpl::unload);
     }
+    static void direct(LuaApi::DirectMethods<LuaApi::TextureImpl>& dm) {
+        dm.Add("Anisotropy", &LuaApi::TextureImpl::anisotropy);
+        dm.Add("MagFilter", &LuaApi::TextureImpl::magfilter);
+        dm.Add("MinFilter", &LuaApi::TextureImpl::minfilter);
+        dm.Add("Request", &LuaApi::TextureImpl::request);
+        dm.Add("SetAnisotropy", &LuaApi::TextureImpl::setanisotropy);
+        dm.Add("SetFilter", &LuaApi::TextureImpl::setfilter);
+        dm.Add("SetMagFilter", &LuaApi::TextureImpl::setmagfilter);
+        dm.Add("SetMinFilter", &LuaApi::TextureImpl::setminfilter);
+        dm.Add("Size", &LuaApi::TextureImpl::size);
+        dm.Add("Unload", &LuaApi::TextureImpl::unload);
+    }
 };
 #endif
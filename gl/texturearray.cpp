@@ -0,0 +1,133 @@
+#include "texturearray.h"
+#include <QImage>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <algorithm>
+#include "texturefile.h"
+
+namespace LuaApi {
+
+// TextureArrayImpl
+TextureArrayImpl::TextureArrayImpl() :
+    m_width(0),
+    m_height(0),
+    m_layers(0),
+    m_levels(0),
+    m_category(TextureMemory::ARRAY),
+    m_label("TextureArray")
+{}
+
+void TextureArrayImpl::setlabel(TextureMemory::Category category, std::string const& label)
+{
+    m_category = category;
+    m_label = label;
+}
+
+bool TextureArrayImpl::create(std::uint32_t width, std::uint32_t height, std::uint32_t layers, bool mipmaps)
+{
+    return allocate(width, height, layers, mipmaps ? 0 : 1);
+}
+bool TextureArrayImpl::allocate(std::uint32_t width, std::uint32_t height, std::uint32_t layers, std::uint32_t levels)
+{
+    unload();
+    if(!width || !height || !layers)
+        return false;
+    m_texture = std::make_shared<QOpenGLTexture>(QOpenGLTexture::Target2DArray);
+    m_texture->setSize(width, height);
+    m_texture->setLayers(layers);
+    m_texture->setFormat(QOpenGLTexture::RGBA8_UNorm);
+    int const maximum = m_texture->maximumMipLevels();
+    m_texture->setMipLevels(levels ? std::min(static_cast<int>(levels), maximum) : maximum);
+    m_texture->allocateStorage(QOpenGLTexture::RGBA, QOpenGLTexture::UInt8);
+    if(!m_texture->isStorageAllocated())
+    {
+        unload();
+        return false;
+    }
+    bool const mipmaps = m_texture->mipLevels() > 1;
+    m_texture->setMinificationFilter(mipmaps ? QOpenGLTexture::LinearMipMapLinear : QOpenGLTexture::Linear);
+    m_texture->setMagnificationFilter(QOpenGLTexture::Linear);
+    m_texture->setWrapMode(QOpenGLTexture::ClampToEdge);
+    m_width = width;
+    m_height = height;
+    m_layers = layers;
+    m_levels = static_cast<std::uint32_t>(m_texture->mipLevels());
+    m_memory = std::make_shared<TextureMemory::Allocation>(m_category, m_label,
+        TextureMemory::Bytes(width, height, layers, m_levels, TextureMemory::TexelBytes(m_texture->format())));
+    return true;
+}
+bool TextureArrayImpl::setlayer(std::uint32_t layer, QImage const& image)
+{
+    if(!m_texture || layer >= m_layers || image.isNull())
+        return false;
+    QImage rgba = image.convertToFormat(QImage::Format_RGBA8888);
+    if(rgba.width() != static_cast<int>(m_width) || rgba.height() != static_cast<int>(m_height))
+        rgba = rgba.scaled(m_width, m_height, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    m_texture->setData(0, layer, QOpenGLTexture::RGBA, QOpenGLTexture::UInt8, rgba.constBits());
+    return true;
+}
+bool TextureArrayImpl::loadlayer(std::uint32_t layer, std::string const& path)
+{
+    return setlayer(layer, TextureFile::ReadImage(path));
+}
+bool TextureArrayImpl::setregion(std::uint32_t layer, std::uint32_t x, std::uint32_t y, std::uint32_t width, std::uint32_t height,
+                                 unsigned char const* rgba)
+{
+    QOpenGLContext* context = QOpenGLContext::currentContext();
+    if(!m_texture || !context || !rgba || layer >= m_layers ||
+            x + width > m_width || y + height > m_height)
+        return false;
+    QOpenGLExtraFunctions* f = context->extraFunctions();
+    m_texture->bind();
+    f->glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    f->glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, x, y, layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+    m_texture->release();
+    return true;
+}
+bool TextureArrayImpl::copylayers(TextureArrayImpl const& from, std::uint32_t count)
+{
+    QOpenGLContext* context = QOpenGLContext::currentContext();
+    GL_t* f = context ? context->versionFunctions<GL_t>() : nullptr;
+    if(!f || !m_texture || !from.m_texture || from.m_width != m_width || from.m_height != m_height ||
+            from.m_levels != m_levels || count > m_layers || count > from.m_layers)
+        return false;
+    for(std::uint32_t level = 0; level < m_levels; ++level)
+    {
+        GLsizei const width = std::max<GLsizei>(m_width >> level, 1);
+        GLsizei const height = std::max<GLsizei>(m_height >> level, 1);
+        f->glCopyImageSubData(from.m_texture->textureId(), GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+                              m_texture->textureId(), GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+                              width, height, count);
+    }
+    return true;
+}
+void TextureArrayImpl::generatemipmaps()
+{
+    if(m_texture && m_levels > 1)
+        m_texture->generateMipMaps();
+}
+void TextureArrayImpl::unload()
+{
+    m_texture.reset();
+    m_memory.reset();
+    m_width = m_height = m_layers = m_levels = 0;
+}
+QOpenGLTexture* TextureArrayImpl::texture() const { return m_texture.get(); }
+bool TextureArrayImpl::good() const { return m_texture != nullptr; }
+FixedReturn<std::uint32_t, 3> TextureArrayImpl::size() const
+{
+    return ReturnFixed(m_width, m_height, m_layers);
+}
+std::uint32_t TextureArrayImpl::layers() const { return m_layers; }
+void TextureArrayImpl::setfilter(std::uint32_t flag)
+{
+    if(!m_texture || (flag != GL_NEAREST && flag != GL_LINEAR))
+        return;
+    QOpenGLTexture::Filter f = static_cast<QOpenGLTexture::Filter>(flag);
+    m_texture->setMagnificationFilter(f);
+    if(m_levels > 1)
+        f = flag == GL_NEAREST ? QOpenGLTexture::NearestMipMapNearest : QOpenGLTexture::LinearMipMapLinear;
+    m_texture->setMinificationFilter(f);
+}
+
+}
@@ -0,0 +1,64 @@
+#ifndef LUAGL_TEXTUREARRAY_H
+#define LUAGL_TEXTUREARRAY_H
+#include "shared.h"
+#include "texturememory.h"
+
+namespace LuaApi {
+    // 2D array texture: layers of the same size and format, sampled as one
+    // texture. Images loaded into a layer are scaled to the layer size.
+    class TextureArrayImpl {
+        std::shared_ptr<QOpenGLTexture> m_texture;
+        std::uint32_t m_width;
+        std::uint32_t m_height;
+        std::uint32_t m_layers;
+        std::uint32_t m_levels;
+        // Shared with m_texture by copies of the array.
+        std::shared_ptr<TextureMemory::Allocation> m_memory;
+        TextureMemory::Category m_category;
+        std::string m_label;
+    public:
+        TextureArrayImpl();
+
+        // How TextureMemory reports storage allocated from now on.
+        void setlabel(TextureMemory::Category, std::string const&);
+        bool create(std::uint32_t width, std::uint32_t height, std::uint32_t layers, bool mipmaps);
+        // With a given number of mip levels, 0 for the full chain.
+        bool allocate(std::uint32_t width, std::uint32_t height, std::uint32_t layers, std::uint32_t levels);
+        bool setlayer(std::uint32_t layer, QImage const&);
+        bool loadlayer(std::uint32_t layer, std::string const&);
+        // Tightly packed RGBA8 rows into part of mip 0 of one layer.
+        bool setregion(std::uint32_t layer, std::uint32_t x, std::uint32_t y, std::uint32_t width, std::uint32_t height,
+                       unsigned char const* rgba);
+        // Copies the first count layers, every mip level, on the GPU. Both
+        // arrays need the same size and levels.
+        bool copylayers(TextureArrayImpl const& from, std::uint32_t count);
+        // After the layers are filled, if created with mipmaps.
+        void generatemipmaps();
+        void unload();
+        QOpenGLTexture* texture() const;
+        bool good() const;
+        FixedReturn<std::uint32_t, 3> size() const;
+        std::uint32_t layers() const;
+        // GL_NEAREST or GL_LINEAR; mipmapped arrays keep using their mips.
+        void setfilter(std::uint32_t);
+    };
+
+    typedef RefCounted<TextureArrayImpl> TextureArray;
+}
+
+template <> struct MetatableDescriptor<LuaApi::TextureArrayImpl> {
+    static char const* name() { return "texturearray_mt"; }
+    static char const* luaname() { return "TextureArray"; }
+    static char const* constructor() { return "New"; }
+    static bool construct(LuaApi::TextureArrayImpl* v) { return Lua::DefaultConstructor(v); }
+    static void metatable(Lua::member_function_storage<LuaApi::TextureArrayImpl>& mt) {
+        mt["Create"] = Lua::Transform(&LuaApi::TextureArrayImpl::create);
+        mt["LoadLayer"] = Lua::Transform(&LuaApi::TextureArrayImpl::loadlayer);
+        mt["GenerateMipMaps"] = Lua::Transform(&LuaApi::TextureArrayImpl::generatemipmaps);
+        mt["Unload"] = Lua::Transform(&LuaApi::TextureArrayImpl::unload);
+        mt["IsValid"] = Lua::Transform(&LuaApi::TextureArrayImpl::good);
+        mt["Size"] = LuaApi::PushFixed(&LuaApi::TextureArrayImpl::size);
+        mt["SetFilter"] = Lua::Transform(&LuaApi::TextureArrayImpl::setfilter);
+    }
+};
+#endif
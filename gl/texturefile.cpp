@@ -0,0 +1,369 @@
+#include "texturefile.h"
+#include <QDataStream>
+#include <QFileInfo>
+#include <QImage>
+#include <QImageReader>
+#include <QOpenGLContext>
+#include <QSaveFile>
+#include <algorithm>
+#include <cstring>
+#include "../core/vfs.h"
+
+namespace {
+
+// The 4x4 block at bx, by, 16 RGBA texels.
+void fetchBlock(unsigned char const* rgba, std::uint32_t width, std::uint32_t height,
+                std::uint32_t bx, std::uint32_t by, unsigned char* block)
+{
+    for(std::uint32_t y = 0; y < 4; ++y)
+    {
+        std::uint32_t const sy = std::min(by * 4 + y, height - 1);
+        for(std::uint32_t x = 0; x < 4; ++x)
+        {
+            std::uint32_t const sx = std::min(bx * 4 + x, width - 1);
+            std::memcpy(block + (y * 4 + x) * 4, rgba + (sy * width + sx) * 4, 4);
+        }
+    }
+}
+
+std::uint16_t to565(int r, int g, int b)
+{
+    return static_cast<std::uint16_t>(((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | ((b * 31 + 127) / 255));
+}
+void from565(std::uint16_t c, int* rgb)
+{
+    int const r = (c >> 11) & 31;
+    int const g = (c >> 5) & 63;
+    int const b = c & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+// Endpoints from the block's bounding box, inset by a sixteenth so the
+// palette covers the bulk of the colours rather than the outliers; each
+// texel then takes the nearest of the four palette entries.
+void colorBlock(unsigned char const* block, unsigned char* out)
+{
+    int lo[3] = { 255, 255, 255 };
+    int hi[3] = { 0, 0, 0 };
+    for(int i = 0; i < 16; ++i)
+    {
+        for(int c = 0; c < 3; ++c)
+        {
+            lo[c] = std::min<int>(lo[c], block[i * 4 + c]);
+            hi[c] = std::max<int>(hi[c], block[i * 4 + c]);
+        }
+    }
+    for(int c = 0; c < 3; ++c)
+    {
+        int const inset = (hi[c] - lo[c]) / 16;
+        lo[c] += inset;
+        hi[c] -= inset;
+    }
+    std::uint16_t c0 = to565(hi[0], hi[1], hi[2]);
+    std::uint16_t c1 = to565(lo[0], lo[1], lo[2]);
+    if(c0 < c1)
+        std::swap(c0, c1);
+
+    std::uint32_t indices = 0;
+    if(c0 != c1)
+    {
+        int palette[4][3];
+        from565(c0, palette[0]);
+        from565(c1, palette[1]);
+        for(int c = 0; c < 3; ++c)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        for(int i = 0; i < 16; ++i)
+        {
+            int best = 0, bestDistance = 1 << 30;
+            for(int p = 0; p < 4; ++p)
+            {
+                int distance = 0;
+                for(int c = 0; c < 3; ++c)
+                {
+                    int const d = block[i * 4 + c] - palette[p][c];
+                    distance += d * d;
+                }
+                if(distance < bestDistance)
+                {
+                    best = p;
+                    bestDistance = distance;
+                }
+            }
+            indices |= static_cast<std::uint32_t>(best) << (2 * i);
+        }
+    }
+    out[0] = c0 & 0xFF;
+    out[1] = c0 >> 8;
+    out[2] = c1 & 0xFF;
+    out[3] = c1 >> 8;
+    for(int i = 0; i < 4; ++i)
+        out[4 + i] = (indices >> (8 * i)) & 0xFF;
+}
+
+// Eight-value mode between the block's extremes.
+void alphaBlock(unsigned char const* block, unsigned char* out)
+{
+    int a0 = 0, a1 = 255;
+    for(int i = 0; i < 16; ++i)
+    {
+        a0 = std::max<int>(a0, block[i * 4 + 3]);
+        a1 = std::min<int>(a1, block[i * 4 + 3]);
+    }
+    std::uint64_t indices = 0;
+    if(a0 != a1)
+    {
+        int palette[8];
+        palette[0] = a0;
+        palette[1] = a1;
+        for(int p = 1; p < 7; ++p)
+            palette[p + 1] = ((7 - p) * a0 + p * a1) / 7;
+        for(int i = 0; i < 16; ++i)
+        {
+            int best = 0, bestDistance = 256;
+            for(int p = 0; p < 8; ++p)
+            {
+                int const distance = std::abs(block[i * 4 + 3] - palette[p]);
+                if(distance < bestDistance)
+                {
+                    best = p;
+                    bestDistance = distance;
+                }
+            }
+            indices |= static_cast<std::uint64_t>(best) << (3 * i);
+        }
+    }
+    out[0] = static_cast<unsigned char>(a0);
+    out[1] = static_cast<unsigned char>(a1);
+    for(int i = 0; i < 6; ++i)
+        out[2 + i] = (indices >> (8 * i)) & 0xFF;
+}
+
+}
+
+namespace LuaApi {
+
+TextureFile::TextureFile() :
+    m_format(RGBA8),
+    m_width(0),
+    m_height(0)
+{}
+
+void TextureFile::Halve(unsigned char const* src, std::uint32_t width, std::uint32_t height,
+                        unsigned char* dst, std::uint32_t dstWidth, std::uint32_t dstHeight)
+{
+    for(std::uint32_t y = 0; y < dstHeight; ++y)
+    {
+        unsigned char const* row0 = src + std::min(2 * y, height - 1) * width * 4;
+        unsigned char const* row1 = src + std::min(2 * y + 1, height - 1) * width * 4;
+        for(std::uint32_t x = 0; x < dstWidth; ++x)
+        {
+            std::uint32_t const x0 = std::min(2 * x, width - 1) * 4;
+            std::uint32_t const x1 = std::min(2 * x + 1, width - 1) * 4;
+            for(std::uint32_t c = 0; c < 4; ++c)
+            {
+                std::uint32_t const sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+                *dst++ = static_cast<unsigned char>((sum + 2) / 4);
+            }
+        }
+    }
+}
+void TextureFile::CompressBC1(unsigned char const* rgba, std::uint32_t width, std::uint32_t height,
+                              std::vector<unsigned char>& out)
+{
+    std::uint32_t const blocksX = (width + 3) / 4;
+    std::uint32_t const blocksY = (height + 3) / 4;
+    out.resize(blocksX * blocksY * 8);
+    unsigned char block[64];
+    for(std::uint32_t by = 0; by < blocksY; ++by)
+    {
+        for(std::uint32_t bx = 0; bx < blocksX; ++bx)
+        {
+            fetchBlock(rgba, width, height, bx, by, block);
+            colorBlock(block, &out[(by * blocksX + bx) * 8]);
+        }
+    }
+}
+void TextureFile::CompressBC3(unsigned char const* rgba, std::uint32_t width, std::uint32_t height,
+                              std::vector<unsigned char>& out)
+{
+    std::uint32_t const blocksX = (width + 3) / 4;
+    std::uint32_t const blocksY = (height + 3) / 4;
+    out.resize(blocksX * blocksY * 16);
+    unsigned char block[64];
+    for(std::uint32_t by = 0; by < blocksY; ++by)
+    {
+        for(std::uint32_t bx = 0; bx < blocksX; ++bx)
+        {
+            fetchBlock(rgba, width, height, bx, by, block);
+            unsigned char* dst = &out[(by * blocksX + bx) * 16];
+            alphaBlock(block, dst);
+            colorBlock(block, dst + 8);
+        }
+    }
+}
+
+bool TextureFile::cook(QImage const& image, bool compress)
+{
+    m_levels.clear();
+    if(image.isNull())
+        return false;
+    QImage const rgba = image.convertToFormat(QImage::Format_RGBA8888);
+    m_width = static_cast<std::uint32_t>(rgba.width());
+    m_height = static_cast<std::uint32_t>(rgba.height());
+    m_format = compress ? BC3 : RGBA8;
+    std::uint32_t width = m_width;
+    std::uint32_t height = m_height;
+    std::vector<unsigned char> pixels(width * height * 4);
+    for(std::uint32_t y = 0; y < height; ++y)
+        std::memcpy(&pixels[y * width * 4], rgba.constScanLine(y), width * 4);
+    if(m_format == BC3)
+    {
+        // BC1 has no alpha worth using, but half the size.
+        bool opaque = true;
+        for(std::size_t i = 3; i < pixels.size() && opaque; i += 4)
+            opaque = pixels[i] == 255;
+        if(opaque)
+            m_format = BC1;
+    }
+    for(;;)
+    {
+        m_levels.push_back({ width, height, std::vector<unsigned char>() });
+        Level& level = m_levels.back();
+        switch(m_format)
+        {
+        case RGBA8:
+            level.m_data = pixels;
+            break;
+        case BC1:
+            CompressBC1(pixels.data(), width, height, level.m_data);
+            break;
+        case BC3:
+            CompressBC3(pixels.data(), width, height, level.m_data);
+            break;
+        }
+        if(width == 1 && height == 1)
+            break;
+        std::uint32_t const nextWidth = std::max<std::uint32_t>(width / 2, 1);
+        std::uint32_t const nextHeight = std::max<std::uint32_t>(height / 2, 1);
+        std::vector<unsigned char> next(nextWidth * nextHeight * 4);
+        Halve(pixels.data(), width, height, next.data(), nextWidth, nextHeight);
+        pixels.swap(next);
+        width = nextWidth;
+        height = nextHeight;
+    }
+    return true;
+}
+
+bool TextureFile::read(std::string const& path)
+{
+    m_levels.clear();
+    std::unique_ptr<QIODevice> f = Vfs::Instance().open(path);
+    if(!f)
+        return false;
+    QDataStream in(f.get());
+    in.setByteOrder(QDataStream::LittleEndian);
+    quint32 magic, version, format, width, height, levels;
+    in >> magic >> version >> format >> width >> height >> levels;
+    if(in.status() != QDataStream::Ok || magic != MAGIC || version != VERSION || format > BC3 ||
+            !width || !height || !levels || levels > 32)
+        return false;
+    m_format = static_cast<Format>(format);
+    m_width = width;
+    m_height = height;
+    m_levels.resize(levels);
+    for(std::uint32_t i = 0; i < levels; ++i)
+    {
+        Level& level = m_levels[i];
+        level.m_width = std::max<std::uint32_t>(width >> i, 1);
+        level.m_height = std::max<std::uint32_t>(height >> i, 1);
+        quint32 bytes;
+        in >> bytes;
+        if(in.status() != QDataStream::Ok || bytes > f->size())
+            break;
+        level.m_data.resize(bytes);
+        if(in.readRawData(reinterpret_cast<char*>(level.m_data.data()), bytes) != static_cast<int>(bytes))
+            break;
+    }
+    if(in.status() != QDataStream::Ok || m_levels.back().m_data.empty())
+    {
+        m_levels.clear();
+        return false;
+    }
+    return true;
+}
+bool TextureFile::write(std::string const& path) const
+{
+    if(m_levels.empty())
+        return false;
+    QSaveFile f(QString::fromStdString(path));
+    if(!f.open(QFile::WriteOnly))
+        return false;
+    QDataStream out(&f);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out << quint32(MAGIC) << quint32(VERSION) << quint32(m_format) << quint32(m_width) << quint32(m_height)
+        << quint32(m_levels.size());
+    for(Level const& level : m_levels)
+    {
+        out << quint32(level.m_data.size());
+        out.writeRawData(reinterpret_cast<char const*>(level.m_data.data()), static_cast<int>(level.m_data.size()));
+    }
+    return out.status() == QDataStream::Ok && f.commit();
+}
+
+QImage TextureFile::ReadImage(std::string const& path)
+{
+    std::unique_ptr<QIODevice> device = Vfs::Instance().open(path);
+    if(!device)
+        return QImage();
+    // Formats without a signature, TGA for one, need the suffix.
+    QImageReader reader(device.get(), QFileInfo(QString::fromStdString(path)).suffix().toLatin1());
+    return reader.read();
+}
+QSize TextureFile::ImageSize(std::string const& path)
+{
+    std::unique_ptr<QIODevice> device = Vfs::Instance().open(path);
+    if(!device)
+        return QSize();
+    QImageReader reader(device.get(), QFileInfo(QString::fromStdString(path)).suffix().toLatin1());
+    return reader.size();
+}
+
+TextureFile::Format TextureFile::format() const { return m_format; }
+std::uint32_t TextureFile::width() const { return m_width; }
+std::uint32_t TextureFile::height() const { return m_height; }
+std::vector<TextureFile::Level> const& TextureFile::levels() const { return m_levels; }
+std::size_t TextureFile::bytes() const
+{
+    std::size_t bytes = 0;
+    for(Level const& level : m_levels)
+        bytes += level.m_data.size();
+    return bytes;
+}
+QOpenGLTexture::TextureFormat TextureFile::textureformat() const
+{
+    switch(m_format)
+    {
+    case BC1:
+        return QOpenGLTexture::RGB_DXT1;
+    case BC3:
+        return QOpenGLTexture::RGBA_DXT5;
+    default:
+        return QOpenGLTexture::RGBA8_UNorm;
+    }
+}
+bool TextureFile::supported() const
+{
+    if(m_levels.empty())
+        return false;
+    if(m_format == RGBA8)
+        return true;
+    QOpenGLContext* context = QOpenGLContext::currentContext();
+    return context && context->hasExtension("GL_EXT_texture_compression_s3tc");
+}
+
+}
@@ -0,0 +1,69 @@
+#ifndef LUAGL_TEXTUREFILE_H
+#define LUAGL_TEXTUREFILE_H
+#include <vector>
+#include "shared.h"
+
+namespace LuaApi {
+    // A cooked texture: its whole mip chain, ready to upload without
+    // decoding. Opaque images are stored as BC1 and the rest as BC3, so
+    // they stay compressed on the GPU too; images that must stay exact
+    // can be cooked as plain RGBA8. Levels are box filtered from the one
+    // above, as glGenerateMipmap would.
+    //
+    // Layout: magic, version, format, width, height, level count, then
+    // every level from the largest as its byte count and data. All fields
+    // are little endian 32 bit words.
+    class TextureFile {
+    public:
+        enum Format : std::uint32_t {
+            RGBA8,
+            BC1,
+            BC3
+        };
+        enum : std::uint32_t {
+            MAGIC = 0x5450524F, // "ORPT"
+            VERSION = 1
+        };
+        struct Level {
+            std::uint32_t m_width;
+            std::uint32_t m_height;
+            std::vector<unsigned char> m_data;
+        };
+    private:
+        Format m_format;
+        std::uint32_t m_width;
+        std::uint32_t m_height;
+        std::vector<Level> m_levels;
+    public:
+        TextureFile();
+
+        bool cook(QImage const&, bool compress);
+        bool read(std::string const& path);
+        bool write(std::string const& path) const;
+
+        Format format() const;
+        std::uint32_t width() const;
+        std::uint32_t height() const;
+        std::vector<Level> const& levels() const;
+        std::size_t bytes() const;
+        QOpenGLTexture::TextureFormat textureformat() const;
+        // Whether the current context can sample the format.
+        bool supported() const;
+
+        // Source images, read through the Vfs.
+        static QImage ReadImage(std::string const& path);
+        // From the header alone; invalid if unreadable.
+        static QSize ImageSize(std::string const& path);
+        // 2x2 box filter of tightly packed RGBA8 rows; odd sizes reuse the
+        // last row or column.
+        static void Halve(unsigned char const* src, std::uint32_t width, std::uint32_t height,
+                          unsigned char* dst, std::uint32_t dstWidth, std::uint32_t dstHeight);
+        // Blocks of 4x4 texels, edges padded by repeating the last texel.
+        static void CompressBC1(unsigned char const* rgba, std::uint32_t width, std::uint32_t height,
+                                std::vector<unsigned char>& out);
+        static void CompressBC3(unsigned char const* rgba, std::uint32_t width, std::uint32_t height,
+                                std::vector<unsigned char>& out);
+    };
+}
+
+#endif
@@ -0,0 +1,163 @@
+#include "texturememory.h"
+#include <algorithm>
+
+namespace LuaApi {
+
+namespace {
+    char const* const g_categoryNames[TextureMemory::CATEGORY_COUNT] = {
+        "texture", "array", "atlas", "font", "streamed"
+    };
+}
+
+// TextureMemory::Allocation
+TextureMemory::Allocation::Allocation(Category category, std::string const& label, std::size_t bytes) :
+    m_category(category),
+    m_label(label),
+    m_bytes(bytes)
+{
+    TextureMemory::Instance().add(*this);
+}
+TextureMemory::Allocation::~Allocation()
+{
+    TextureMemory::Instance().remove(*this);
+}
+void TextureMemory::Allocation::resize(std::size_t bytes)
+{
+    TextureMemory::Instance().change(m_category, m_bytes, bytes);
+    m_bytes = bytes;
+}
+TextureMemory::Category TextureMemory::Allocation::category() const { return m_category; }
+std::string const& TextureMemory::Allocation::label() const { return m_label; }
+std::size_t TextureMemory::Allocation::bytes() const { return m_bytes; }
+
+// TextureMemory
+TextureMemory::TextureMemory() :
+    m_bytes(0),
+    m_peak(0)
+{
+    for(CategoryStats& stats : m_categories)
+        stats = { 0, 0 };
+}
+
+TextureMemory& TextureMemory::Instance()
+{
+    static TextureMemory memory;
+    return memory;
+}
+TextureMemory::Category TextureMemory::CategoryFromName(std::string const& name)
+{
+    for(std::size_t i = 0; i < CATEGORY_COUNT; ++i)
+    {
+        if(name == g_categoryNames[i])
+            return static_cast<Category>(i);
+    }
+    throw std::runtime_error("Unknown texture category: " + name);
+}
+
+std::size_t TextureMemory::TexelBytes(QOpenGLTexture::TextureFormat format)
+{
+    switch(format)
+    {
+    case QOpenGLTexture::R8_UNorm:
+    case QOpenGLTexture::AlphaFormat:
+    case QOpenGLTexture::LuminanceFormat:
+        return 1;
+    case QOpenGLTexture::RG8_UNorm:
+    case QOpenGLTexture::R16F:
+    case QOpenGLTexture::D16:
+    case QOpenGLTexture::LuminanceAlphaFormat:
+        return 2;
+    case QOpenGLTexture::RGB8_UNorm:
+    case QOpenGLTexture::SRGB8:
+    case QOpenGLTexture::RGBFormat:
+        return 3;
+    case QOpenGLTexture::RGBA8_UNorm:
+    case QOpenGLTexture::SRGB8_Alpha8:
+    case QOpenGLTexture::RGBAFormat:
+    case QOpenGLTexture::RG16F:
+    case QOpenGLTexture::R32F:
+    case QOpenGLTexture::RGB10A2:
+    case QOpenGLTexture::D24S8:
+    case QOpenGLTexture::D32F:
+        return 4;
+    case QOpenGLTexture::RGBA16F:
+    case QOpenGLTexture::RG32F:
+        return 8;
+    case QOpenGLTexture::RGB32F:
+        return 12;
+    case QOpenGLTexture::RGBA32F:
+        return 16;
+    case QOpenGLTexture::RGB_DXT1:
+    case QOpenGLTexture::RGBA_DXT1:
+    case QOpenGLTexture::RGBA_DXT3:
+    case QOpenGLTexture::RGBA_DXT5:
+        return 0;
+    default:
+        return 4;
+    }
+}
+std::size_t TextureMemory::Bytes(std::uint32_t width, std::uint32_t height, std::uint32_t layers,
+                                 std::uint32_t levels, std::size_t texelBytes)
+{
+    std::size_t bytes = 0;
+    for(std::uint32_t level = 0; level < levels; ++level)
+    {
+        std::size_t const w = std::max<std::uint32_t>(width >> level, 1);
+        std::size_t const h = std::max<std::uint32_t>(height >> level, 1);
+        bytes += w * h;
+    }
+    return bytes * layers * texelBytes;
+}
+
+void TextureMemory::add(Allocation const& allocation)
+{
+    m_allocations.insert(&allocation);
+    ++m_categories[allocation.category()].m_count;
+    change(allocation.category(), 0, allocation.bytes());
+}
+void TextureMemory::remove(Allocation const& allocation)
+{
+    m_allocations.erase(&allocation);
+    --m_categories[allocation.category()].m_count;
+    change(allocation.category(), allocation.bytes(), 0);
+}
+void TextureMemory::change(Category category, std::size_t from, std::size_t to)
+{
+    m_categories[category].m_bytes += to - from;
+    m_bytes += to - from;
+    m_peak = std::max(m_peak, m_bytes);
+}
+
+std::size_t TextureMemory::TotalBytes() const { return m_bytes; }
+std::size_t TextureMemory::PeakBytes() const { return m_peak; }
+std::size_t TextureMemory::Count() const { return m_allocations.size(); }
+void TextureMemory::ResetPeak() { m_peak = m_bytes; }
+
+Lua::ReturnValues TextureMemory::LuaStats() const
+{
+    return Lua::Return(m_bytes, m_allocations.size(), m_peak);
+}
+Lua::ReturnValues TextureMemory::LuaCategoryStats(std::string const& name) const
+{
+    CategoryStats const& stats = m_categories[CategoryFromName(name)];
+    return Lua::Return(stats.m_bytes, stats.m_count);
+}
+std::size_t TextureMemory::LuaTop(std::size_t n)
+{
+    std::vector<Allocation const*> sorted(m_allocations.begin(), m_allocations.end());
+    n = std::min(n, sorted.size());
+    std::partial_sort(sorted.begin(), sorted.begin() + n, sorted.end(),
+                      [](Allocation const* a, Allocation const* b) { return a->bytes() > b->bytes(); });
+    m_top.clear();
+    for(std::size_t i = 0; i < n; ++i)
+        m_top.push_back({ sorted[i]->label(), sorted[i]->category(), sorted[i]->bytes() });
+    return n;
+}
+Lua::ReturnValues TextureMemory::LuaConsumer(std::size_t i) const
+{
+    if(i < m_top.size())
+        return Lua::Return(m_top[i].m_label, std::string(g_categoryNames[m_top[i].m_category]), m_top[i].m_bytes);
+    return Lua::Return();
+}
+
+}
@@ -0,0 +1,91 @@
+#ifndef LUAGL_TEXTUREMEMORY_H
+#define LUAGL_TEXTUREMEMORY_H
+#include <unordered_set>
+#include <vector>
+#include "shared.h"
+
+namespace LuaApi {
+    // Accounts the GPU memory of every texture the engine allocates.
+    // Owners hold an Allocation for as long as their texture storage
+    // exists and keep its size up to date; sizes are computed from the
+    // dimensions, format and mip levels, so they match what was asked of
+    // the driver rather than what it happens to reserve.
+    //
+    // One instance per process, used from the thread with the GL context.
+    class TextureMemory {
+    public:
+        enum Category {
+            TEXTURE,
+            ARRAY,
+            ATLAS,
+            FONT,
+            STREAMED,
+            CATEGORY_COUNT
+        };
+
+        class Allocation {
+            Category m_category;
+            std::string m_label;
+            std::size_t m_bytes;
+        public:
+            Allocation(Category, std::string const& label, std::size_t bytes);
+            ~Allocation();
+            Allocation(Allocation const&) =delete;
+            Allocation& operator= (Allocation const&) =delete;
+
+            void resize(std::size_t bytes);
+            Category category() const;
+            std::string const& label() const;
+            std::size_t bytes() const;
+        };
+    private:
+        struct CategoryStats {
+            std::size_t m_bytes;
+            std::size_t m_count;
+        };
+        struct Consumer {
+            std::string m_label;
+            Category m_category;
+            std::size_t m_bytes;
+        };
+
+        std::unordered_set<Allocation const*> m_allocations;
+        CategoryStats m_categories[CATEGORY_COUNT];
+        std::size_t m_bytes;
+        std::size_t m_peak;
+        std::vector<Consumer> m_top;
+
+        TextureMemory();
+        void add(Allocation const&);
+        void remove(Allocation const&);
+        void change(Category, std::size_t from, std::size_t to);
+    public:
+        TextureMemory(TextureMemory const&) =delete;
+        TextureMemory& operator= (TextureMemory const&) =delete;
+        static TextureMemory& Instance();
+        static Category CategoryFromName(std::string const&);
+
+        // Bytes per texel; 0 for compressed formats.
+        static std::size_t TexelBytes(QOpenGLTexture::TextureFormat);
+        // Every level of a width x height x layers texture, down to levels.
+        static std::size_t Bytes(std::uint32_t width, std::uint32_t height, std::uint32_t layers,
+                                 std::uint32_t levels, std::size_t texelBytes);
+
+        std::size_t TotalBytes() const;
+        std::size_t PeakBytes() const;
+        std::size_t Count() const;
+        void ResetPeak();
+
+        // Total bytes, textures, peak bytes.
+        Lua::ReturnValues LuaStats() const;
+        // Bytes and textures of one category.
+        Lua::ReturnValues LuaCategoryStats(std::string const&) const;
+        // Takes a snapshot of the n largest textures, largest first, and
+        // returns how many it holds; LuaConsumer reads it by index.
+        std::size_t LuaTop(std::size_t n);
+        // Label, category and bytes of one snapshot entry.
+        Lua::ReturnValues LuaConsumer(std::size_t) const;
+    };
+}
+
+#endif
@@ -0,0 +1,62 @@
+#include "uniformblock.h"
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+
+namespace LuaApi {
+
+SharedUniformBlock::SharedUniformBlock(GLuint binding, std::size_t size) :
+    m_binding(binding),
+    m_size(size),
+    m_context(nullptr),
+    m_buffer(0),
+    m_owner(0),
+    m_version(0)
+{}
+
+void SharedUniformBlock::forget()
+{
+    QObject::disconnect(m_destroyed);
+    m_context = nullptr;
+    m_buffer = 0;
+    m_owner = 0;
+    m_version = 0;
+}
+
+bool SharedUniformBlock::bind(QOpenGLContext* context)
+{
+    if(m_context == context && m_buffer)
+        return true;
+    QOpenGLExtraFunctions* f = context->extraFunctions();
+    if(!f)
+        return false;
+    // A buffer of another context goes away with that context.
+    forget();
+    f->glGenBuffers(1, &m_buffer);
+    if(!m_buffer)
+        return false;
+    f->glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+    f->glBufferData(GL_UNIFORM_BUFFER, m_size, nullptr, GL_DYNAMIC_DRAW);
+    f->glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    f->glBindBufferBase(GL_UNIFORM_BUFFER, m_binding, m_buffer);
+    m_context = context;
+    m_destroyed = QObject::connect(context, &QOpenGLContext::aboutToBeDestroyed, [this] { forget(); });
+    return true;
+}
+
+bool SharedUniformBlock::upload(void const* data, std::size_t size, std::uint64_t owner, std::uint64_t version)
+{
+    QOpenGLContext* context = QOpenGLContext::currentContext();
+    if(!context || size > m_size || !bind(context))
+        return false;
+    if(owner && m_owner == owner && m_version == version)
+        return true;
+    QOpenGLExtraFunctions* f = context->extraFunctions();
+    f->glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+    f->glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+    f->glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    m_owner = owner;
+    m_version = version;
+    return true;
+}
+
+}
@@ -0,0 +1,31 @@
+#ifndef LUAGL_UNIFORMBLOCK_H
+#define LUAGL_UNIFORMBLOCK_H
+#include "shared.h"
+
+namespace LuaApi {
+    // A uniform buffer shared by every program through a fixed binding
+    // point. The buffer is made on the first upload in the current context
+    // and forgotten when that context goes away.
+    class SharedUniformBlock {
+        GLuint m_binding;
+        std::size_t m_size;
+        QOpenGLContext* m_context;
+        GLuint m_buffer;
+        QMetaObject::Connection m_destroyed;
+        std::uint64_t m_owner;
+        std::uint64_t m_version;
+
+        bool bind(QOpenGLContext*);
+        void forget();
+    public:
+        SharedUniformBlock(GLuint binding, std::size_t size);
+        SharedUniformBlock(SharedUniformBlock const&) =delete;
+        SharedUniformBlock& operator= (SharedUniformBlock const&) =delete;
+
+        // Writes the first size bytes. Skipped if owner is non-zero and the
+        // buffer already holds that owner's version.
+        bool upload(void const* data, std::size_t size, std::uint64_t owner = 0, std::uint64_t version = 0);
+    };
+}
+
+#endif
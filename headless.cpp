@@ -0,0 +1,177 @@
+#include "headless.h"
+#include <QCoreApplication>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+HeadlessContext::~HeadlessContext()
+{
+    if(m_context.isValid())
+        m_context.makeCurrent(&m_surface);
+    m_fbo.reset();
+}
+
+HeadlessRunner::HeadlessRunner(GameMode gamemode, int frames, QSize size, float fps) :
+    GameHost(gamemode),
+    m_frames(frames),
+    m_size(size),
+    m_frameInterval(1.0 / ((fps > 0.f) ? fps : 60.f)),
+    m_failed(false)
+{
+}
+
+HeadlessRunner::~HeadlessRunner()
+{
+    // Current while GameHost closes the Lua state.
+    if(m_context.isValid())
+        m_context.makeCurrent(&m_surface);
+}
+
+void HeadlessRunner::FatalError(QString const& title, QString const& description)
+{
+    std::fprintf(stderr, "%s: %s\n", qPrintable(title), qPrintable(description));
+    m_failed = true;
+}
+
+bool HeadlessRunner::initializeGL()
+{
+    QSurfaceFormat format;
+    format.setRenderableType(QSurfaceFormat::OpenGL);
+    format.setProfile(QSurfaceFormat::CoreProfile);
+    format.setVersion(4,4);
+    format.setSwapInterval(0);
+    
+    m_surface.setFormat(format);
+    m_surface.create();
+    m_context.setFormat(format);
+    if(!m_surface.isValid() || !m_context.create() || !m_context.makeCurrent(&m_surface))
+    {
+        FatalError(QCoreApplication::translate("HeadlessRunner", "Headless Error"),
+                   QCoreApplication::translate("HeadlessRunner", "Unable to create an offscreen OpenGL 4.4 core context."));
+        return false;
+    }
+    if(!initializeOpenGLFunctions())
+    {
+        FatalError(QCoreApplication::translate("HeadlessRunner", "Headless Error"),
+                   QCoreApplication::translate("HeadlessRunner", "The offscreen context does not provide OpenGL 4.4 core functions."));
+        return false;
+    }
+    
+    m_fbo.reset(new QOpenGLFramebufferObject(m_size, QOpenGLFramebufferObject::CombinedDepthStencil));
+    if(!m_fbo->isValid() || !m_fbo->bind())
+    {
+        FatalError(QCoreApplication::translate("HeadlessRunner", "Headless Error"),
+                   QCoreApplication::translate("HeadlessRunner", "Unable to create the offscreen framebuffer."));
+        return false;
+    }
+    glViewport(0, 0, m_size.width(), m_size.height());
+    
+    std::fprintf(stdout, "OpenGL %s (%s)\n",
+                 reinterpret_cast<char const*>(glGetString(GL_VERSION)),
+                 reinterpret_cast<char const*>(glGetString(GL_RENDERER)));
+    return true;
+}
+
+bool HeadlessRunner::renderFrame()
+{
+    m_fbo->bind();
+    m_pacer.BeginFrame();
+    
+    LuaApi::LuaHeap::Scope heapScope(m_heap, LuaApi::LuaHeap::FRAME);
+    if(preCallLuaFunction("begin_frame") && !callLuaFunction("begin_frame"))
+        return false;
+    if(!runTicks(m_scheduler.Advance(m_frameInterval)))
+        return false;
+    if(preCallLuaFunction("frame"))
+    {
+        state.pushnumber(m_scheduler.Alpha());
+        if(!callLuaFunction("frame",1))
+            return false;
+    }
+    if(preCallLuaFunction("end_frame") && !callLuaFunction("end_frame"))
+        return false;
+    LuaApi::TextureStreamer::Instance().EndFrame();
+    collectGarbage();
+    m_heap.EndFrame();
+    
+    // Without a swap nothing forces the GPU to finish; make each sample
+    // include the rendering work it submitted.
+    glFinish();
+    return true;
+}
+
+int HeadlessRunner::Run()
+{
+    if(!initializeGL() || !registerLuaFunctions(this))
+        return 1;
+    
+    glClearColor(0.0f,0.0f,0.0f,1.0f);
+    glClearDepthf(0.0f);
+    if(!runStartup())
+        return 1;
+    
+    if(preCallLuaFunction("resize"))
+    {
+        state.pushnumber(m_size.width());
+        state.pushnumber(m_size.height());
+        if(!callLuaFunction("resize",2))
+            return 1;
+    }
+    
+    m_frameTimes.reserve(m_frames);
+    for(int i = 0; i < m_frames; ++i)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if(!renderFrame() || m_failed)
+            return 1;
+        m_frameTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    
+    printReport();
+    return 0;
+}
+
+static double Percentile(std::vector<double> const& sorted, double p)
+{
+    if(sorted.empty())
+        return 0.0;
+    std::size_t ix = static_cast<std::size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(ix, sorted.size() - 1)];
+}
+
+void HeadlessRunner::printReport() const
+{
+    std::vector<double> sorted = m_frameTimes;
+    std::sort(sorted.begin(), sorted.end());
+    double total = 0.0;
+    for(auto it = sorted.begin(); it != sorted.end(); ++it)
+        total += *it;
+    double mean = sorted.empty() ? 0.0 : total / sorted.size();
+    
+    std::fprintf(stdout, "gamemode: %s\n", qPrintable(m_gamemode.Name));
+    std::fprintf(stdout, "frames: %u (%dx%d)\n", static_cast<unsigned>(sorted.size()), m_size.width(), m_size.height());
+    std::fprintf(stdout, "frame ms: mean %.3f  p50 %.3f  p90 %.3f  p95 %.3f  p99 %.3f  max %.3f\n",
+                 mean,
+                 Percentile(sorted, 0.50),
+                 Percentile(sorted, 0.90),
+                 Percentile(sorted, 0.95),
+                 Percentile(sorted, 0.99),
+                 sorted.empty() ? 0.0 : sorted.back());
+    std::fprintf(stdout, "ticks: %llu (dropped %llu)  tick ms: avg %.3f  max %.3f\n",
+                 static_cast<unsigned long long>(m_scheduler.Ticks()),
+                 static_cast<unsigned long long>(m_scheduler.DroppedTicks()),
+                 m_scheduler.AverageTickCost(),
+                 m_scheduler.MaxTickCost());
+    std::fprintf(stdout, "lua heap: live %.1f KiB  peak %.1f KiB  reserved %.1f KiB  rate %.1f KiB/s  failed %llu\n",
+                 m_heap.LiveBytes() / 1024.0,
+                 m_heap.PeakBytes() / 1024.0,
+                 m_heap.ReservedBytes() / 1024.0,
+                 m_heap.AllocationRate() / 1024.0,
+                 static_cast<unsigned long long>(m_heap.FailedAllocations()));
+    std::fprintf(stdout, "gc ms: avg %.3f  max %.3f  cycles %llu (full %llu)\n",
+                 m_collector.AverageCost(),
+                 m_collector.MaxCost(),
+                 static_cast<unsigned long long>(m_collector.Cycles()),
+                 static_cast<unsigned long long>(m_collector.FullCollects()));
+    std::fflush(stdout);
+}
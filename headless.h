@@ -0,0 +1,48 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QSize>
+#include "gamehost.h"
+
+// The offscreen GL objects. Being a base ahead of GameHost, they outlive
+// the Lua state, so GL objects still held by Lua are freed while the
+// context exists and is current; the FBO goes last.
+struct HeadlessContext
+{
+    ~HeadlessContext();
+    
+    QOffscreenSurface m_surface;
+    QOpenGLContext m_context;
+    std::unique_ptr<QOpenGLFramebufferObject> m_fbo;
+};
+
+// Runs a gamemode into an FBO on an offscreen surface for a fixed number
+// of frames, then prints frame-time percentiles. Simulation time advances
+// by a fixed interval per frame, so tick counts are reproducible.
+class HeadlessRunner : public GL_t, private HeadlessContext, public GameHost
+{
+public:
+    HeadlessRunner(GameMode gamemode, int frames, QSize size, float fps);
+    ~HeadlessRunner();
+    
+    int Run();
+    
+protected:
+    void FatalError(QString const& title, QString const& description) override;
+    
+private:
+    bool initializeGL();
+    bool renderFrame();
+    void printReport() const;
+    
+    int m_frames;
+    QSize m_size;
+    double m_frameInterval;
+    bool m_failed;
+    std::vector<double> m_frameTimes;
+};
+
+#endif // HEADLESS_H
@@ -1,5 +1,5 @@
 #include "link.h"
-#include "gamewindow.h"
+#include "gamehost.h"
 
 #define REG_NAMED_FUNC(name, fnc) state.luapp_add_translated_function( #name, Lua::Transform(fnc) )
 #define REG_FUNC(fnc) state.luapp_add_translated_function( #fnc, Lua::Transform(fnc))
@@ -12,6 +12,7 @@
 #define REG_NAMED_GL_FUNC(name, var) state.luapp_add_translated_function( #var, Lua::Transform(*gl, &GL_t::name ))
 #define REG_GL_FUNC(name) state.luapp_add_translated_function( #name, Lua::Transform(*gl, &GL_t::name ))
 #define REG_NAMED_AL_FUNC(name, var) state.luapp_add_translated_function( #var, Lua::Transform(&SoundContextProperties::name))
+#define REG_NAMED_FIXED_AL_FUNC(name, var) { state.pushcfunction(&PushFixedFunction<decltype(&SoundContextProperties::name), &SoundContextProperties::name>); state.setglobal( #var ); }
 #define REG_AL_FUNC(name) state.luapp_add_translated_function( #name, Lua::Transform(&SoundContextProperties::name))
 
 #define REG_EXPL_FUNC(name, var, arg) state.luapp_add_translated_function( #name, Lua::Transform(&var, arg))
@@ -50,33 +51,107 @@ void xglDepthMask(GL_t* gl, bool v)
     gl->glDepthMask(v ? 1 : 0);
 }
 
-bool Link::Init(GL_t* gl, GameWindow* gw, Lua::State& state)
+bool Link::Init(GL_t* gl, GameHost* gw, Lua::State& state)
 {
     registerEnums(state);
     
     // GL
-    state.luapp_register_object<LuaApi::ObjectMaterial>();
-    state.luapp_register_object<LuaApi::Texture>();
-    state.luapp_register_object<LuaApi::Shader>();
-    state.luapp_register_object<LuaApi::ModelStorage>();
-    state.luapp_register_object<LuaApi::ModelBone>();
-    state.luapp_register_object<LuaApi::Model>();
+    RegisterObject<LuaApi::ObjectMaterial>(state);
+    RegisterObject<LuaApi::Texture>(state);
+    RegisterObject<LuaApi::TextureArray>(state);
+    RegisterObject<LuaApi::TextureAtlas>(state);
+    RegisterObject<LuaApi::Shader>(state);
+    RegisterObject<LuaApi::Camera>(state);
+    RegisterObject<LuaApi::SpriteBatch>(state);
+    RegisterObject<LuaApi::Font>(state);
+    RegisterObject<LuaApi::TextBlock>(state);
+    RegisterObject<LuaApi::ModelStorage>(state);
+    RegisterObject<LuaApi::ModelBone>(state);
+    RegisterObject<LuaApi::Model>(state);
+    RegisterObject<LuaApi::AnimationClip>(state);
     
     // Misc
-    state.luapp_register_object<LuaApi::Timer>();
+    RegisterObject<LuaApi::Timer>(state);
+    
+    // Math
+    RegisterObject<LuaApi::Vec3>(state);
+    RegisterObject<LuaApi::Vec4>(state);
+    RegisterObject<LuaApi::Quat>(state);
+    RegisterObject<LuaApi::Mat4>(state);
+    RegisterObject<LuaApi::Vec3Array>(state);
+    RegisterObject<LuaApi::Mat4Array>(state);
+    RegisterObject<LuaApi::Scene>(state);
+    RegisterObject<LuaApi::SpatialGrid>(state);
+    RegisterObject<LuaApi::OcclusionBuffer>(state);
+    RegisterObject<LuaApi::CullList>(state);
+    RegisterObject<LuaApi::Entities>(state);
+    RegisterObject<LuaApi::Animator>(state);
+    RegisterObject<LuaApi::AnimationSystem>(state);
     
     // AL
-    state.luapp_register_object<LuaApi::DeviceList>();
-    state.luapp_register_object<LuaApi::Device>();
-    state.luapp_register_object<LuaApi::Context>();
-    state.luapp_register_object<LuaApi::SoundEmitter>();
+    RegisterObject<LuaApi::DeviceList>(state);
+    RegisterObject<LuaApi::Device>(state);
+    RegisterObject<LuaApi::Context>(state);
+    RegisterObject<LuaApi::SoundEmitter>(state);
     state.luapp_push_object<LuaApi::DeviceList>();
     state.setglobal("Audio");
         
     // Custom Functions
     REG_NAMED_FUNC(TimeI, impl::timei);
     REG_NAMED_FUNC(TimeF, impl::timef);
-    REG_NAMED_MEM_FUNC(Data, *gw, GameWindow, DataPath);
+    REG_NAMED_MEM_FUNC(Data, *gw, GameHost, DataPath);
+    
+    // Simulation
+    REG_NAMED_MEM_FUNC(SetTickRate, gw->Scheduler(), TickScheduler, SetRate);
+    REG_NAMED_MEM_FUNC(TickRate, gw->Scheduler(), TickScheduler, Rate);
+    REG_NAMED_MEM_FUNC(SetMaxTickSteps, gw->Scheduler(), TickScheduler, SetMaxSteps);
+    REG_NAMED_MEM_FUNC(MaxTickSteps, gw->Scheduler(), TickScheduler, MaxSteps);
+    REG_NAMED_MEM_FUNC(TickAlpha, gw->Scheduler(), TickScheduler, Alpha);
+    REG_NAMED_MEM_FUNC(TickStats, gw->Scheduler(), TickScheduler, LuaStats);
+    REG_NAMED_MEM_FUNC(ResetTickStats, gw->Scheduler(), TickScheduler, ResetStats);
+    
+    // Frame pacing
+    REG_NAMED_MEM_FUNC(SetFrameRateCap, gw->Pacer(), FramePacer, SetCap);
+    REG_NAMED_MEM_FUNC(FrameRateCap, gw->Pacer(), FramePacer, Cap);
+    REG_NAMED_MEM_FUNC(SetBackgroundFrameRate, gw->Pacer(), FramePacer, SetBackgroundCap);
+    REG_NAMED_MEM_FUNC(BackgroundFrameRate, gw->Pacer(), FramePacer, BackgroundCap);
+    REG_NAMED_MEM_FUNC(SetHiddenTickRate, gw->Pacer(), FramePacer, SetHiddenTickRate);
+    REG_NAMED_MEM_FUNC(SetLowLatency, gw->Pacer(), FramePacer, SetLowLatency);
+    REG_NAMED_MEM_FUNC(LowLatency, gw->Pacer(), FramePacer, LowLatency);
+    REG_NAMED_MEM_FUNC(SetSpinMargin, gw->Pacer(), FramePacer, SetSpinMargin);
+    REG_NAMED_MEM_FUNC(FrameStats, gw->Pacer(), FramePacer, LuaStats);
+    REG_NAMED_FUNC(SetSwapInterval, FramePacer::SetSwapInterval);
+    REG_NAMED_FUNC(SwapInterval, FramePacer::SwapInterval);
+    
+    // Script heap
+    REG_NAMED_MEM_FUNC(HeapStats, gw->Heap(), LuaHeap, LuaStats);
+    REG_NAMED_MEM_FUNC(HeapCategoryStats, gw->Heap(), LuaHeap, LuaCategoryStats);
+    REG_NAMED_MEM_FUNC(SetHeapLimit, gw->Heap(), LuaHeap, SetLimit);
+    REG_NAMED_MEM_FUNC(HeapLimit, gw->Heap(), LuaHeap, Limit);
+    REG_NAMED_MEM_FUNC(ResetHeapPeak, gw->Heap(), LuaHeap, ResetPeak);
+    
+    // Garbage collection pacing
+    REG_NAMED_MEM_FUNC(SetGcSliceLimits, gw->Collector(), GcPacer, SetSliceLimits);
+    REG_NAMED_MEM_FUNC(GcMinSlice, gw->Collector(), GcPacer, MinSlice);
+    REG_NAMED_MEM_FUNC(GcMaxSlice, gw->Collector(), GcPacer, MaxSlice);
+    REG_NAMED_MEM_FUNC(SetGcCeiling, gw->Collector(), GcPacer, SetCeiling);
+    REG_NAMED_MEM_FUNC(GcCeiling, gw->Collector(), GcPacer, Ceiling);
+    REG_NAMED_MEM_FUNC(GcStats, gw->Collector(), GcPacer, LuaStats);
+    REG_NAMED_MEM_FUNC(ResetGcStats, gw->Collector(), GcPacer, ResetStats);
+    
+    // Texture streaming
+    REG_NAMED_MEM_FUNC(SetTextureBudget, TextureStreamer::Instance(), TextureStreamer, SetBudget);
+    REG_NAMED_MEM_FUNC(TextureBudget, TextureStreamer::Instance(), TextureStreamer, Budget);
+    REG_NAMED_MEM_FUNC(SetTextureUploadRate, TextureStreamer::Instance(), TextureStreamer, SetUploadRate);
+    REG_NAMED_MEM_FUNC(TextureUploadRate, TextureStreamer::Instance(), TextureStreamer, UploadRate);
+    REG_NAMED_MEM_FUNC(TextureStreamingStats, TextureStreamer::Instance(), TextureStreamer, LuaStats);
+    
+    // Texture memory
+    REG_NAMED_MEM_FUNC(TextureMemoryStats, TextureMemory::Instance(), TextureMemory, LuaStats);
+    REG_NAMED_MEM_FUNC(TextureMemoryCategoryStats, TextureMemory::Instance(), TextureMemory, LuaCategoryStats);
+    REG_NAMED_MEM_FUNC(TextureMemoryTop, TextureMemory::Instance(), TextureMemory, LuaTop);
+    REG_NAMED_MEM_FUNC(TextureMemoryConsumer, TextureMemory::Instance(), TextureMemory, LuaConsumer);
+    REG_NAMED_MEM_FUNC(ResetTextureMemoryPeak, TextureMemory::Instance(), TextureMemory, ResetPeak);
     
     // OpenGL Functions
     REG_GL_FUNC(glEnable);
@@ -111,13 +186,18 @@ bool Link::Init(GL_t* gl, GameWindow* gw, Lua::State& state)
     REG_NAMED_AL_FUNC(setDistanceModel, SetDistanceModel);
     
     REG_NAMED_AL_FUNC(queryListenerGain, ListenerGain);
-    REG_NAMED_AL_FUNC(luaQueryListenerPosition, ListenerPosition);
-    REG_NAMED_AL_FUNC(luaQueryListenerVelocity, ListenerVelocity);
-    REG_NAMED_AL_FUNC(luaQueryListenerOrientation, ListenerOrientation);
+    REG_NAMED_FIXED_AL_FUNC(luaQueryListenerPosition, ListenerPosition);
+    REG_NAMED_FIXED_AL_FUNC(luaQueryListenerVelocity, ListenerVelocity);
+    REG_NAMED_FIXED_AL_FUNC(luaQueryListenerOrientation, ListenerOrientation);
     REG_NAMED_AL_FUNC(setListenerGain, SetListenerGain);
     REG_NAMED_AL_FUNC(setListenerPosition, SetListenerPosition);
     REG_NAMED_AL_FUNC(setListenerVelocity, SetListenerVelocity);
     REG_NAMED_AL_FUNC(setListenerOrientation, SetListenerOrientation);
+    REG_NAMED_AL_FUNC(queryListenerPositionVec, ListenerPositionVec);
+    REG_NAMED_AL_FUNC(queryListenerVelocityVec, ListenerVelocityVec);
+    REG_NAMED_AL_FUNC(setListenerPositionVec, SetListenerPositionVec);
+    REG_NAMED_AL_FUNC(setListenerVelocityVec, SetListenerVelocityVec);
+    REG_NAMED_AL_FUNC(setListenerOrientationVec, SetListenerOrientationVec);
        
     return true;
 }
@@ -4,6 +4,8 @@
 #include "state.h"
 #include "gl/all.h"
 #include "al/all.h"
+#include "core/all.h"
+#include "world/all.h"
 
 namespace LuaApi {
 
@@ -11,7 +13,7 @@ class Link {
     DeviceList m_deviceList;
 public:
     Link();
-    bool Init(GL_t*, GameWindow*, Lua::State&);
+    bool Init(GL_t*, GameHost*, Lua::State&);
     void registerEnums(Lua::State&);
 };
 
@@ -1,5 +1,31 @@
 #include "startupwindow.h"
+#include "headless.h"
 #include <QApplication>
+#include <QCommandLineParser>
+#include <cstdio>
+
+static int RunHeadless(QCommandLineParser const& parser)
+{
+    GameMode gamemode;
+    if(!GameMode::Find(parser.value("gamemode"), gamemode) || gamemode.Modules.isEmpty())
+    {
+        std::fprintf(stderr, "Unknown gamemode: %s\n", qPrintable(parser.value("gamemode")));
+        return 1;
+    }
+    
+    QStringList size = parser.value("size").split('x');
+    int w = (size.size() == 2) ? size.at(0).toInt() : 0;
+    int h = (size.size() == 2) ? size.at(1).toInt() : 0;
+    int frames = parser.value("frames").toInt();
+    if(w <= 0 || h <= 0 || frames <= 0)
+    {
+        std::fprintf(stderr, "Invalid --size or --frames\n");
+        return 1;
+    }
+    
+    HeadlessRunner runner(gamemode.WithApi(), frames, QSize(w,h), parser.value("fps").toFloat());
+    return runner.Run();
+}
 
 int main(int argc, char *argv[])
 {
@@ -9,8 +35,38 @@ int main(int argc, char *argv[])
          std::to_string(VERSION_MINOR) + "." +
          std::to_string(VERSION_PATCH)).c_str()
     );
+    
+    QStringList arguments;
+    for(int i = 0; i < argc; ++i)
+        arguments << QString::fromLocal8Bit(argv[i]);
+    
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addOptions({
+        { "headless", "Run a gamemode offscreen and print frame-time percentiles. "
+                      "Uses the 'offscreen' platform unless QT_QPA_PLATFORM is set "
+                      "(e.g. eglfs with EGL_PLATFORM=surfaceless for Mesa without X)." },
+        { "gamemode", "Gamemode to run headless.", "name", "rp" },
+        { "frames", "Number of frames to render headless.", "count", "600" },
+        { "size", "Offscreen framebuffer size.", "WxH", "1280x720" },
+        { "fps", "Simulated frame rate used to advance game time.", "fps", "60" }
+    });
+    // Only to pick the platform before the application exists; process()
+    // below handles --help, --version and unknown options either way.
+    parser.parse(arguments);
+    
+    if(parser.isSet("headless"))
+    {
+        if(qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+        QGuiApplication a(argc, argv);
+        parser.process(a);
+        return RunHeadless(parser);
+    }
 
     QApplication a(argc, argv);
+    parser.process(a);
     StartupWindow w;
     w.show();
 
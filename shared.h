@@ -4,14 +4,19 @@
 #include <QOpenGLFunctions_4_4_Core>
 #include <QFile>
 
+#include <cstdint>
 #include <exception>
 #include <memory>
+#include <new>
+#include <stdexcept>
 #include <type_traits>
 #include "state.h"
 #include "library.h"
+#include "core/pool.h"
 
 typedef QOpenGLFunctions_4_4_Core GL_t;
 class GameWindow;
+class GameHost;
 
 enum {
     KILOBYTE = 1024 * 1,
@@ -23,20 +28,135 @@ namespace LuaApi {
     typedef Lua::lua_exception gl_error;
     typedef Lua::lua_exception al_error;
 
+    // Fixed number of values returned straight onto the Lua stack.
+    // Lua::ReturnValues keeps its values in a heap-backed container, which
+    // hot getters returning a vector or a colour can't afford.
+    template <typename V, std::size_t N>
+    struct FixedReturn {
+        V m_values[N];
+        
+        int Push(lua_State* state) const {
+            for(std::size_t i = 0; i < N; ++i)
+                push(state, m_values[i]);
+            return static_cast<int>(N);
+        }
+    private:
+        template <typename U>
+        static typename std::enable_if<std::is_floating_point<U>::value>::type push(lua_State* state, U v) { lua_pushnumber(state, static_cast<lua_Number>(v)); }
+        template <typename U>
+        static typename std::enable_if<std::is_integral<U>::value>::type push(lua_State* state, U v) { lua_pushinteger(state, static_cast<lua_Integer>(v)); }
+    };
+    
+    template <typename V, typename ... Args>
+    FixedReturn<V, 1 + sizeof...(Args)> ReturnFixed(V v, Args ... args) {
+        return FixedReturn<V, 1 + sizeof...(Args)>{{ v, static_cast<V>(args)... }};
+    }
+    
+    // Metatable entry for a const getter returning FixedReturn.
+    template <typename T, typename V, std::size_t N>
+    Lua::ClassMemberFunctor<T> PushFixed(FixedReturn<V, N> (T::*fnc)() const) {
+        return Lua::ToFnc([fnc](T& obj, lua_State* state) -> int {
+            return (obj.*fnc)().Push(state);
+        });
+    }
+    
+    // Plain C function for a free function returning FixedReturn, for
+    // registration with pushcfunction.
+    template <typename F, F fnc>
+    int PushFixedFunction(lua_State* state) {
+        return fnc().Push(state);
+    }
+
+    template <typename T> class RefCounted;
+    
+    namespace impl {
+        template <typename T>
+        struct RefCountedNode {
+            std::uint32_t m_refs;
+            T m_value;
+            
+            template <typename ... Args>
+            RefCountedNode(Args&& ... args) : m_refs(1), m_value(std::forward<Args>(args)...) {}
+        };
+    }
+    
+    // Sole ownership of an entity, for handing it to another thread.
+    // RefCounted's count is not atomic, so the only way across a thread
+    // boundary is RefCounted::Transfer() on one side and the explicit
+    // RefCounted(Transferable&&) constructor on the other.
+    template <typename T>
+    class Transferable {
+        friend class RefCounted<T>;
+        RefCounted<T> m_ref;
+        explicit Transferable(RefCounted<T>&& ref) : m_ref(std::move(ref)) {}
+    public:
+        Transferable(Transferable&&) =default;
+        Transferable& operator= (Transferable&&) =default;
+        Transferable(Transferable const&) =delete;
+        Transferable& operator= (Transferable const&) =delete;
+        
+        bool IsValid() const { return m_ref.IsValid(); }
+    };
+    
+    // Intrusive, single-threaded reference count. The count lives next to
+    // the object in one block from the size-class pool.
     template <typename T>
     class RefCounted {
-        std::shared_ptr<T> m_data;
+        typedef impl::RefCountedNode<T> Node;
+        static_assert(alignof(Node) <= impl::SizeClassPool::ALIGNMENT, "Entity is over-aligned for the pool");
+        
+        Node* m_data;
+        
+        void retain() const {
+            if(m_data)
+                ++m_data->m_refs;
+        }
+        void release() {
+            Node* n = m_data;
+            m_data = nullptr;
+            if(n && --n->m_refs == 0)
+            {
+                n->~Node();
+                impl::SizeClassPool::Free(n, sizeof(Node));
+            }
+        }
     public:
-        RefCounted() {}
-        RefCounted(RefCounted const&) =default;
-        RefCounted(RefCounted &&) =default;
-        RefCounted& operator= (RefCounted const&) =default;
-        RefCounted& operator= (RefCounted &&) =default;
+        RefCounted() : m_data(nullptr) {}
+        RefCounted(RefCounted const& o) : m_data(o.m_data) { retain(); }
+        RefCounted(RefCounted&& o) : m_data(o.m_data) { o.m_data = nullptr; }
+        explicit RefCounted(Transferable<T>&& t) : RefCounted(std::move(t.m_ref)) {}
+        ~RefCounted() { release(); }
+        
+        RefCounted& operator= (RefCounted const& o) {
+            if(m_data != o.m_data)
+            {
+                o.retain();
+                release();
+                m_data = o.m_data;
+            }
+            return *this;
+        }
+        RefCounted& operator= (RefCounted&& o) {
+            if(this != &o)
+            {
+                release();
+                m_data = o.m_data;
+                o.m_data = nullptr;
+            }
+            return *this;
+        }
         
         template <typename ... Args>
         void Init(Args&& ... args)
         {
-            m_data = std::make_shared<T>(std::forward<Args>(args)...);
+            release();
+            void* block = impl::SizeClassPool::Allocate(sizeof(Node));
+            try {
+                m_data = new (block) Node(std::forward<Args>(args)...);
+            } catch(...) {
+                impl::SizeClassPool::Free(block, sizeof(Node));
+                throw;
+            }
         }
     
         bool IsValid() const {
@@ -44,25 +164,40 @@ namespace LuaApi {
         }
         
         void SoftRelease() {
-            m_data.reset();
+            release();
+        }
+        
+        std::uint32_t UseCount() const {
+            return m_data ? m_data->m_refs : 0;
+        }
+        
+        Transferable<T> Transfer() {
+            if(UseCount() > 1)
+                throw std::runtime_error(std::string("Cannot transfer a shared entity to another thread: ") + MetatableDescriptor<T>::name());
+            return Transferable<T>(std::move(*this));
         }
         
         T& Get() const {
             if(m_data == nullptr)
                 throw std::runtime_error(std::string("Usage of invalid entity: ") + MetatableDescriptor<T>::name());
-            return *m_data;
+            return m_data->m_value;
         }
         
         T* operator -> () const {
             if(m_data == nullptr)
                 throw std::runtime_error(std::string("Usage of invalid entity: ") + MetatableDescriptor<T>::name());
-            return m_data.get();
+            return &m_data->m_value;
         }
         
         T& operator * () const {
             return Get();
         }
         
+        // Unchecked access for callers that handle invalid entities themselves.
+        T* TryGet() const {
+            return m_data ? &m_data->m_value : nullptr;
+        }
+        
          //Problem is around here.
          //I'm unable to correctly pass lua_State*, most likely.
         int RunFunction(lua_State* state, Lua::ClassMemberFunctor<T> fnc) {
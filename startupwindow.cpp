@@ -4,10 +4,6 @@
 #include "gamemode.h"
 #include <QSurfaceFormat>
 
-static QList<GameMode> const g_gamemodes = {
-    { "Roleplay", "rp", QStringList() << "main.lua" }
-};
-
 StartupWindow::StartupWindow(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::StartupWindow),
@@ -17,8 +13,9 @@ StartupWindow::StartupWindow(QWidget *parent) :
     ui->setupUi(this);
     connect(ui->playNowButton, &QPushButton::clicked, this, &StartupWindow::StartGame);
 
+    QList<GameMode> const& gamemodes = GameMode::Available();
     int i = 0;
-    for(auto it = g_gamemodes.begin(); it != g_gamemodes.end(); ++it)
+    for(auto it = gamemodes.begin(); it != gamemodes.end(); ++it)
     {
         ui->gamemodeList->addItem(it->Name, i);
     }
@@ -41,18 +38,19 @@ void StartupWindow::StartGame()
 
     bool ok = false;
     int gamemodeIndex = ui->gamemodeList->currentData().toInt(&ok);
-    if(!ok || gamemodeIndex >= g_gamemodes.size())
+    if(!ok || gamemodeIndex >= GameMode::Available().size())
         return;
 
-    GameMode gamemode = g_gamemodes.at(gamemodeIndex);
+    GameMode gamemode = GameMode::Available().at(gamemodeIndex);
     if(gamemode.Modules.isEmpty())
         return;
-    gamemode.Modules.insert(gamemode.Modules.begin(),"/api/openrp.lua");
+    gamemode = gamemode.WithApi();
 
     QSurfaceFormat format;
     format.setRenderableType(QSurfaceFormat::OpenGL);
     format.setProfile(QSurfaceFormat::CoreProfile);
     format.setVersion(4,4);
+    format.setSwapInterval(LuaApi::FramePacer::SwapInterval());
 
     m_currentGame = new GameWindow(nullptr, gamemode, this);
 
@@ -0,0 +1,18 @@
+#ifndef LUAWORLD_ALL_H
+#define LUAWORLD_ALL_H
+#include "shared.h"
+#include "simd.h"
+#include "vector.h"
+#include "quat.h"
+#include "matrix.h"
+#include "batch.h"
+#include "bounds.h"
+#include "spatial.h"
+#include "occlusion.h"
+#include "cull.h"
+#include "scene.h"
+#include "entities.h"
+#include "clip.h"
+#include "animation.h"
+
+#endif
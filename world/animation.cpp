@@ -0,0 +1,296 @@
+#include "animation.h"
+#include "simd.h"
+#include "../core/jobs.h"
+#include "../gl/uniformblock.h"
+#include <algorithm>
+#include <cmath>
+
+namespace LuaApi {
+namespace {
+SharedUniformBlock g_palette(AnimatorImpl::PALETTE_UBO_BINDING, AnimatorImpl::MAX_JOINTS * sizeof(glm::mat4));
+}
+
+// AnimatorImpl
+char const* AnimatorImpl::blockName() { return "Skin"; }
+
+AnimatorImpl::AnimatorImpl() :
+    m_jointCount(0),
+    m_stride(0)
+{
+    for(Layer& l : m_layers)
+    {
+        l.m_time = 0.f;
+        l.m_speed = 1.f;
+        l.m_weight = 0.f;
+        l.m_loop = false;
+    }
+}
+
+void AnimatorImpl::SetModel(Model model)
+{
+    for(std::size_t i = 0; i < MAX_LAYERS; ++i)
+        Stop(i);
+    m_names.clear();
+    m_jointIds.clear();
+    m_parents.clear();
+    m_skins.clear();
+    m_bindPose.clear();
+    m_jointCount = 0;
+    m_stride = 0;
+    ModelImpl const* m = model.TryGet();
+    if(m)
+    {
+        std::vector<ModelNode> const& nodes = m->nodes();
+        m_jointCount = nodes.size();
+        m_stride = (m_jointCount + 3) & ~std::size_t(3);
+        m_bindPose.assign(simd::POSE_STREAMS * m_stride, 0.f);
+        for(std::size_t j = 0; j < m_jointCount; ++j)
+        {
+            m_names.push_back(nodes[j].m_name);
+            m_jointIds.emplace(nodes[j].m_name, static_cast<std::uint32_t>(j));
+            m_parents.push_back(nodes[j].m_parent);
+            glm::vec3 t, s;
+            glm::quat r;
+            DecomposeTRS(nodes[j].m_transform, t, r, s);
+            r = glm::normalize(r);
+            float const values[simd::POSE_STREAMS] = { t.x, t.y, t.z, r.x, r.y, r.z, r.w, s.x, s.y, s.z };
+            for(int c = 0; c < simd::POSE_STREAMS; ++c)
+                m_bindPose[c * m_stride + j] = values[c];
+        }
+        for(ModelBone const& bone : m->bones())
+        {
+            m_skins.emplace_back();
+            Skin& skin = m_skins.back();
+            skin.m_joints = bone->joints();
+            skin.m_inverseBind = bone->inverseBind();
+            skin.m_gather.resize(skin.m_joints.size());
+            skin.m_palette.assign(skin.m_joints.size(), glm::mat4(1.f));
+        }
+    }
+    m_pose = m_bindPose;
+    m_layerPose.resize(m_bindPose.size());
+    m_from.resize(m_bindPose.size());
+    m_to.resize(m_bindPose.size());
+    m_weights.resize(3 * m_stride);
+    m_local.resize(m_jointCount);
+    m_model.resize(m_jointCount);
+    evaluate();
+}
+std::size_t AnimatorImpl::JointCount() const { return m_jointCount; }
+Lua::ReturnValues AnimatorImpl::JointIndex(std::string const& name) const
+{
+    auto it = m_jointIds.find(name);
+    if(it != m_jointIds.end())
+        return Lua::Return(static_cast<std::size_t>(it->second));
+    return Lua::Return();
+}
+Lua::ReturnValues AnimatorImpl::JointName(std::size_t i) const
+{
+    if(i < m_names.size())
+        return Lua::Return(m_names[i]);
+    return Lua::Return();
+}
+
+bool AnimatorImpl::Play(std::size_t layer, AnimationClip clip, bool loop)
+{
+    AnimationClipImpl const* c = clip.TryGet();
+    if(layer >= MAX_LAYERS || !c)
+        return false;
+    Layer& l = m_layers[layer];
+    l.m_joints.clear();
+    for(std::size_t i = 0; i < c->trackCount(); ++i)
+    {
+        auto it = m_jointIds.find(c->trackNode(i));
+        l.m_joints.push_back(it != m_jointIds.end() ? it->second : NONE);
+    }
+    l.m_clip = std::move(clip);
+    l.m_time = 0.f;
+    l.m_speed = 1.f;
+    l.m_weight = 1.f;
+    l.m_loop = loop;
+    return true;
+}
+bool AnimatorImpl::Stop(std::size_t layer)
+{
+    if(layer >= MAX_LAYERS)
+        return false;
+    Layer& l = m_layers[layer];
+    l.m_clip.SoftRelease();
+    l.m_joints.clear();
+    l.m_time = 0.f;
+    l.m_weight = 0.f;
+    return true;
+}
+bool AnimatorImpl::SetWeight(std::size_t layer, float w)
+{
+    if(layer >= MAX_LAYERS)
+        return false;
+    m_layers[layer].m_weight = std::max(w, 0.f);
+    return true;
+}
+bool AnimatorImpl::SetSpeed(std::size_t layer, float s)
+{
+    if(layer >= MAX_LAYERS)
+        return false;
+    m_layers[layer].m_speed = s;
+    return true;
+}
+bool AnimatorImpl::SetTime(std::size_t layer, float t)
+{
+    if(layer >= MAX_LAYERS)
+        return false;
+    m_layers[layer].m_time = t;
+    advance(0.f);
+    return true;
+}
+float AnimatorImpl::Time(std::size_t layer) const
+{
+    return layer < MAX_LAYERS ? m_layers[layer].m_time : 0.f;
+}
+
+void AnimatorImpl::advance(float dt)
+{
+    for(Layer& l : m_layers)
+    {
+        AnimationClipImpl const* clip = l.m_clip.TryGet();
+        if(!clip)
+            continue;
+        float const duration = clip->duration();
+        float t = l.m_time + dt * l.m_speed;
+        if(duration <= 0.f)
+            t = 0.f;
+        else if(l.m_loop)
+        {
+            t = std::fmod(t, duration);
+            if(t < 0.f)
+                t += duration;
+        }
+        else
+            t = std::min(std::max(t, 0.f), duration);
+        l.m_time = t;
+    }
+}
+
+void AnimatorImpl::sampleLayer(Layer const& layer, float* out)
+{
+    // Unkeyed joints blend bind pose with itself.
+    std::copy(m_bindPose.begin(), m_bindPose.end(), m_from.begin());
+    std::copy(m_bindPose.begin(), m_bindPose.end(), m_to.begin());
+    std::fill(m_weights.begin(), m_weights.end(), 0.f);
+    AnimationClipImpl const* clip = layer.m_clip.TryGet();
+    for(std::size_t k = 0; k < layer.m_joints.size(); ++k)
+    {
+        if(layer.m_joints[k] != NONE)
+            clip->sample(k, layer.m_time, layer.m_joints[k], m_stride, m_from.data(), m_to.data(), m_weights.data());
+    }
+    simd::BlendPoses(m_from.data(), m_to.data(), m_weights.data(), out, m_jointCount, m_stride);
+}
+
+void AnimatorImpl::evaluate()
+{
+    if(!m_jointCount)
+        return;
+    float total = 0.f;
+    for(Layer const& l : m_layers)
+    {
+        if(l.m_weight <= 0.f || !l.m_clip.TryGet())
+            continue;
+        if(total == 0.f)
+            sampleLayer(l, m_pose.data());
+        else
+        {
+            // Running weighted average: each layer pulls the result towards
+            // itself by its share of the weight so far.
+            sampleLayer(l, m_layerPose.data());
+            std::fill(m_weights.begin(), m_weights.end(), l.m_weight / (total + l.m_weight));
+            simd::BlendPoses(m_pose.data(), m_layerPose.data(), m_weights.data(), m_pose.data(), m_jointCount, m_stride);
+        }
+        total += l.m_weight;
+    }
+    if(total == 0.f)
+        m_pose = m_bindPose;
+
+    simd::ComposePoses(m_pose.data(), glm::value_ptr(m_local[0]), m_jointCount, m_stride);
+    // Parents come first.
+    for(std::size_t j = 0; j < m_jointCount; ++j)
+    {
+        if(m_parents[j] == ModelImpl::NO_PARENT)
+            m_model[j] = m_local[j];
+        else
+            simd::MulMat4(glm::value_ptr(m_model[m_parents[j]]), glm::value_ptr(m_local[j]), glm::value_ptr(m_model[j]));
+    }
+    for(Skin& skin : m_skins)
+    {
+        std::size_t const n = skin.m_joints.size();
+        if(!n)
+            continue;
+        for(std::size_t i = 0; i < n; ++i)
+            skin.m_gather[i] = m_model[skin.m_joints[i]];
+        simd::MulMat4Pairs(glm::value_ptr(skin.m_gather[0]), glm::value_ptr(skin.m_inverseBind[0]),
+                           glm::value_ptr(skin.m_palette[0]), n);
+    }
+}
+
+void AnimatorImpl::Update(float dt)
+{
+    advance(dt);
+    evaluate();
+}
+
+Mat4 AnimatorImpl::JointMatrix(std::size_t i) const
+{
+    if(i < m_jointCount)
+        return Mat4(m_model[i]);
+    return Mat4();
+}
+std::size_t AnimatorImpl::PaletteCount() const { return m_skins.size(); }
+std::vector<glm::mat4> const& AnimatorImpl::palette(std::size_t mesh) const { return m_skins.at(mesh).m_palette; }
+bool AnimatorImpl::UploadPalette(std::size_t mesh) const
+{
+    if(mesh >= m_skins.size() || m_skins[mesh].m_palette.empty())
+        return false;
+    std::vector<glm::mat4> const& p = m_skins[mesh].m_palette;
+    return g_palette.upload(glm::value_ptr(p[0]), p.size() * sizeof(glm::mat4));
+}
+
+// AnimationSystemImpl
+bool AnimationSystemImpl::Add(Animator a)
+{
+    AnimatorImpl* p = a.TryGet();
+    if(!p)
+        return false;
+    for(Animator const& e : m_animators)
+    {
+        if(e.TryGet() == p)
+            return false;
+    }
+    m_animators.push_back(std::move(a));
+    return true;
+}
+bool AnimationSystemImpl::Remove(Animator a)
+{
+    AnimatorImpl* p = a.TryGet();
+    for(std::size_t i = 0; i < m_animators.size(); ++i)
+    {
+        if(m_animators[i].TryGet() == p)
+        {
+            m_animators[i] = std::move(m_animators.back());
+            m_animators.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+std::size_t AnimationSystemImpl::Count() const { return m_animators.size(); }
+void AnimationSystemImpl::Clear() { m_animators.clear(); }
+void AnimationSystemImpl::Update(float dt)
+{
+    // Each animator is evaluated by exactly one job; the handles are only
+    // read there.
+    ParallelFor(m_animators.size(), 2, [this, dt](std::size_t begin, std::size_t end) {
+        for(std::size_t i = begin; i < end; ++i)
+            m_animators[i].TryGet()->Update(dt);
+    });
+}
+
+}
@@ -0,0 +1,169 @@
+#ifndef LUAWORLD_ANIMATION_H
+#define LUAWORLD_ANIMATION_H
+#include <unordered_map>
+#include <vector>
+#include "shared.h"
+#include "matrix.h"
+#include "clip.h"
+#include "../gl/object.h"
+
+namespace LuaApi {
+    // Skeletal pose of one model instance.
+    // The skeleton is the model's node hierarchy. Up to MAX_LAYERS clips
+    // are sampled and blended by weight: each layer's keys are gathered
+    // per joint, then interpolated, blended and turned into matrices four
+    // joints at a time by the SIMD kernels. Joints a clip doesn't key keep
+    // their bind pose.
+    //
+    // Every skinned mesh of the model gets a palette, joint model-space
+    // matrix times inverse bind, which UploadPalette() writes to a shared
+    // uniform buffer at PALETTE_UBO_BINDING; shaders get it bound when they
+    // link. Joint indices and weights are vertex attributes 14 and 15:
+    //
+    //   layout(location = 14) in vec4 a_joints;
+    //   layout(location = 15) in vec4 a_weights;
+    //   layout(std140) uniform Skin {
+    //       mat4 g_palette[128];
+    //   };
+    //   mat4 skin = g_palette[int(a_joints.x)] * a_weights.x + ...;
+    class AnimatorImpl {
+    public:
+        enum {
+            MAX_LAYERS = 4,
+            MAX_JOINTS = 128,
+            PALETTE_UBO_BINDING = 1
+        };
+        enum : std::uint32_t { NONE = 0xFFFFFFFF };
+        static char const* blockName();
+    private:
+        struct Layer {
+            AnimationClip m_clip;
+            // Joint of every clip track, NONE if the skeleton lacks it.
+            std::vector<std::uint32_t> m_joints;
+            float m_time;
+            float m_speed;
+            float m_weight;
+            bool m_loop;
+        };
+        struct Skin {
+            std::vector<std::uint32_t> m_joints;
+            std::vector<glm::mat4> m_inverseBind;
+            std::vector<glm::mat4> m_gather;
+            std::vector<glm::mat4> m_palette;
+        };
+
+        std::vector<std::string> m_names;
+        std::unordered_map<std::string, std::uint32_t> m_jointIds;
+        std::vector<std::uint32_t> m_parents;
+        std::size_t m_jointCount;
+        // Pose buffers: simd::POSE_STREAMS streams of m_stride floats.
+        std::size_t m_stride;
+        std::vector<float> m_bindPose;
+        std::vector<float> m_pose;
+        std::vector<float> m_layerPose;
+        std::vector<float> m_from;
+        std::vector<float> m_to;
+        std::vector<float> m_weights;
+        std::vector<glm::mat4> m_local;
+        std::vector<glm::mat4> m_model;
+        std::vector<Skin> m_skins;
+        Layer m_layers[MAX_LAYERS];
+
+        void sampleLayer(Layer const&, float* out);
+    public:
+        AnimatorImpl();
+        AnimatorImpl(AnimatorImpl const&) =delete;
+        AnimatorImpl& operator= (AnimatorImpl const&) =delete;
+
+        // Takes the model's skeleton, skins and bind pose; stops all layers.
+        void SetModel(Model);
+        std::size_t JointCount() const;
+        Lua::ReturnValues JointIndex(std::string const&) const;
+        Lua::ReturnValues JointName(std::size_t) const;
+
+        bool Play(std::size_t layer, AnimationClip, bool loop);
+        bool Stop(std::size_t layer);
+        bool SetWeight(std::size_t layer, float);
+        bool SetSpeed(std::size_t layer, float);
+        bool SetTime(std::size_t layer, float);
+        float Time(std::size_t layer) const;
+
+        // Touches only this animator and its clips; safe on worker threads
+        // for distinct animators.
+        void advance(float dt);
+        void evaluate();
+        void Update(float dt);
+
+        // Model space, from the last evaluation.
+        Mat4 JointMatrix(std::size_t) const;
+        std::size_t PaletteCount() const;
+        std::vector<glm::mat4> const& palette(std::size_t mesh) const;
+        // Palette of the model's mesh, same index as Model:BoneByIndex.
+        bool UploadPalette(std::size_t mesh) const;
+    };
+
+    typedef RefCounted<AnimatorImpl> Animator;
+
+    // Advances and evaluates many animators in parallel on the job system.
+    class AnimationSystemImpl {
+        std::vector<Animator> m_animators;
+    public:
+        AnimationSystemImpl() =default;
+
+        bool Add(Animator);
+        bool Remove(Animator);
+        std::size_t Count() const;
+        void Clear();
+        void Update(float dt);
+    };
+
+    typedef RefCounted<AnimationSystemImpl> AnimationSystem;
+}
+
+template <> struct MetatableDescriptor<LuaApi::AnimatorImpl> {
+    static char const* name() { return "animator_mt"; }
+    static char const* luaname() { return "Animator"; }
+    static char const* constructor() { return "New"; }
+    static bool construct(LuaApi::AnimatorImpl* v) { return Lua::DefaultConstructor(v); }
+    static void metatable(Lua::member_function_storage<LuaApi::AnimatorImpl>& mt) {
+#define REG_FNC(name) mt[ #name ] = Lua::Transform(&LuaApi::AnimatorImpl::name)
+        REG_FNC(SetModel);
+        REG_FNC(JointCount);
+        REG_FNC(JointIndex);
+        REG_FNC(JointName);
+        REG_FNC(Play);
+        REG_FNC(Stop);
+        REG_FNC(SetWeight);
+        REG_FNC(SetSpeed);
+        REG_FNC(SetTime);
+        REG_FNC(Time);
+        REG_FNC(Update);
+        REG_FNC(JointMatrix);
+        REG_FNC(PaletteCount);
+        REG_FNC(UploadPalette);
+#undef REG_FNC
+    }
+    static void direct(LuaApi::DirectMethods<LuaApi::AnimatorImpl>& dm) {
+        dm.Add("SetWeight", &LuaApi::AnimatorImpl::SetWeight);
+        dm.Add("Update", &LuaApi::AnimatorImpl::Update);
+        dm.Add("UploadPalette", &LuaApi::AnimatorImpl::UploadPalette);
+    }
+};
+
+template <> struct MetatableDescriptor<LuaApi::AnimationSystemImpl> {
+    static char const* name() { return "animationsystem_mt"; }
+    static char const* luaname() { return "AnimationSystem"; }
+    static char const* constructor() { return "New"; }
+    static bool construct(LuaApi::AnimationSystemImpl* v) { return Lua::DefaultConstructor(v); }
+    static void metatable(Lua::member_function_storage<LuaApi::AnimationSystemImpl>& mt) {
+#define REG_FNC(name) mt[ #name ] = Lua::Transform(&LuaApi::AnimationSystemImpl::name)
+        REG_FNC(Add);
+        REG_FNC(Remove);
+        REG_FNC(Count);
+        REG_FNC(Clear);
+        REG_FNC(Update);
+#undef REG_FNC
+    }
+};
+
+#endif
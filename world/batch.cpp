@@ -0,0 +1,130 @@
+#include "batch.h"
+#include "simd.h"
+
+namespace LuaApi {
+
+// Vec3ArrayImpl
+std::vector<glm::vec4> const& Vec3ArrayImpl::points() const { return m_points; }
+
+void Vec3ArrayImpl::Resize(std::size_t n) { m_points.resize(n, glm::vec4(0.f, 0.f, 0.f, 1.f)); }
+std::size_t Vec3ArrayImpl::Size() const { return m_points.size(); }
+void Vec3ArrayImpl::Set(std::size_t i, Vec3 v)
+{
+    if(i < m_points.size())
+        m_points[i] = glm::vec4(v.value(), 1.f);
+}
+void Vec3ArrayImpl::SetXYZ(std::size_t i, float x, float y, float z)
+{
+    if(i < m_points.size())
+        m_points[i] = glm::vec4(x, y, z, 1.f);
+}
+Vec3 Vec3ArrayImpl::Get(std::size_t i) const
+{
+    if(i < m_points.size())
+        return Vec3(glm::vec3(m_points[i]));
+    return Vec3();
+}
+FixedReturn<float, 3> Vec3ArrayImpl::Unpack(std::size_t i) const
+{
+    if(i < m_points.size())
+        return ReturnFixed(m_points[i].x, m_points[i].y, m_points[i].z);
+    return ReturnFixed(0.f, 0.f, 0.f);
+}
+bool Vec3ArrayImpl::SetData(Lua::Array<float> const& data)
+{
+    if(data.m_data.size() % 3 != 0)
+        return false;
+    std::size_t n = data.m_data.size() / 3;
+    m_points.resize(n);
+    for(std::size_t i = 0; i < n; ++i)
+        m_points[i] = glm::vec4(data.m_data[i * 3], data.m_data[i * 3 + 1], data.m_data[i * 3 + 2], 1.f);
+    return true;
+}
+void Vec3ArrayImpl::CopyFrom(Vec3Array other)
+{
+    if(other.IsValid())
+        m_points = other->m_points;
+}
+
+void Vec3ArrayImpl::Transform(Mat4 m)
+{
+    if(m_points.empty())
+        return;
+    simd::TransformVec4Batch(m.data(), glm::value_ptr(m_points[0]), glm::value_ptr(m_points[0]), m_points.size());
+}
+void Vec3ArrayImpl::TransformFrom(Vec3Array src, Mat4 m)
+{
+    if(!src.IsValid())
+        return;
+    std::vector<glm::vec4> const& in = src->m_points;
+    m_points.resize(in.size());
+    if(in.empty())
+        return;
+    simd::TransformVec4Batch(m.data(), glm::value_ptr(in[0]), glm::value_ptr(m_points[0]), in.size());
+}
+Vec3 Vec3ArrayImpl::Min() const
+{
+    if(m_points.empty())
+        return Vec3();
+    glm::vec4 r = m_points[0];
+    for(auto it = m_points.begin() + 1; it != m_points.end(); ++it)
+        r = glm::min(r, *it);
+    return Vec3(glm::vec3(r));
+}
+Vec3 Vec3ArrayImpl::Max() const
+{
+    if(m_points.empty())
+        return Vec3();
+    glm::vec4 r = m_points[0];
+    for(auto it = m_points.begin() + 1; it != m_points.end(); ++it)
+        r = glm::max(r, *it);
+    return Vec3(glm::vec3(r));
+}
+
+// Mat4ArrayImpl
+std::vector<glm::mat4> const& Mat4ArrayImpl::matrices() const { return m_matrices; }
+
+void Mat4ArrayImpl::Resize(std::size_t n) { m_matrices.resize(n, glm::mat4(1.f)); }
+std::size_t Mat4ArrayImpl::Size() const { return m_matrices.size(); }
+void Mat4ArrayImpl::Set(std::size_t i, Mat4 m)
+{
+    if(i < m_matrices.size())
+        m_matrices[i] = m.value();
+}
+Mat4 Mat4ArrayImpl::Get(std::size_t i) const
+{
+    if(i < m_matrices.size())
+        return Mat4(m_matrices[i]);
+    return Mat4();
+}
+void Mat4ArrayImpl::CopyFrom(Mat4Array other)
+{
+    if(other.IsValid())
+        m_matrices = other->m_matrices;
+}
+
+void Mat4ArrayImpl::PreMultiply(Mat4 m)
+{
+    if(m_matrices.empty())
+        return;
+    float* d = glm::value_ptr(m_matrices[0]);
+    simd::MulMat4Batch(m.data(), d, d, m_matrices.size());
+}
+void Mat4ArrayImpl::PostMultiply(Mat4 m)
+{
+    float* d = m_matrices.empty() ? nullptr : glm::value_ptr(m_matrices[0]);
+    for(std::size_t i = 0; i < m_matrices.size(); ++i)
+        simd::MulMat4(d + i * 16, m.data(), d + i * 16);
+}
+bool Mat4ArrayImpl::MultiplyEach(Mat4Array other)
+{
+    if(!other.IsValid() || other->m_matrices.size() != m_matrices.size())
+        return false;
+    if(m_matrices.empty())
+        return true;
+    float* d = glm::value_ptr(m_matrices[0]);
+    simd::MulMat4Pairs(d, glm::value_ptr(other->m_matrices[0]), d, m_matrices.size());
+    return true;
+}
+
+}
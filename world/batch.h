@@ -0,0 +1,102 @@
+#ifndef LUAWORLD_BATCH_H
+#define LUAWORLD_BATCH_H
+#include <vector>
+#include "shared.h"
+#include "vector.h"
+#include "matrix.h"
+
+namespace LuaApi {
+    // Arrays that keep bulk math on the C++ side: one Lua call transforms
+    // or multiplies the whole array.
+    // Points are stored as xyzw with w = 1 so they stay 16 bytes apart for
+    // the SIMD kernels, and upload straight into a 4-component attribute.
+    class Vec3ArrayImpl {
+        std::vector<glm::vec4> m_points;
+    public:
+        std::vector<glm::vec4> const& points() const;
+        
+        void Resize(std::size_t);
+        std::size_t Size() const;
+        void Set(std::size_t, Vec3);
+        void SetXYZ(std::size_t, float, float, float);
+        Vec3 Get(std::size_t) const;
+        FixedReturn<float, 3> Unpack(std::size_t) const;
+        bool SetData(Lua::Array<float> const&);
+        void CopyFrom(RefCounted<Vec3ArrayImpl>);
+        
+        void Transform(Mat4);
+        void TransformFrom(RefCounted<Vec3ArrayImpl>, Mat4);
+        Vec3 Min() const;
+        Vec3 Max() const;
+    };
+    typedef RefCounted<Vec3ArrayImpl> Vec3Array;
+    
+    class Mat4ArrayImpl {
+        std::vector<glm::mat4> m_matrices;
+    public:
+        std::vector<glm::mat4> const& matrices() const;
+        
+        void Resize(std::size_t);
+        std::size_t Size() const;
+        void Set(std::size_t, Mat4);
+        Mat4 Get(std::size_t) const;
+        void CopyFrom(RefCounted<Mat4ArrayImpl>);
+        
+        // this[i] = m * this[i]
+        void PreMultiply(Mat4);
+        // this[i] = this[i] * m
+        void PostMultiply(Mat4);
+        // this[i] = this[i] * other[i]; false if the sizes differ.
+        bool MultiplyEach(RefCounted<Mat4ArrayImpl>);
+    };
+    typedef RefCounted<Mat4ArrayImpl> Mat4Array;
+}
+
+template <> struct MetatableDescriptor<LuaApi::Vec3ArrayImpl> {
+    static char const* name() { return "vec3array_mt"; }
+    static char const* luaname() { return "Vec3Array"; }
+    static char const* constructor() { return "New"; }
+    static bool construct(LuaApi::Vec3ArrayImpl* v) { return Lua::DefaultConstructor(v); }
+    static void metatable(Lua::member_function_storage<LuaApi::Vec3ArrayImpl>& mt) {
+#define REG_FNC(name) mt[ #name ] = Lua::Transform(&LuaApi::Vec3ArrayImpl::name)
+        REG_FNC(Resize);
+        REG_FNC(Size);
+        REG_FNC(Set);
+        REG_FNC(SetXYZ);
+        REG_FNC(Get);
+        REG_FNC(SetData);
+        REG_FNC(CopyFrom);
+        REG_FNC(Transform);
+        REG_FNC(TransformFrom);
+        REG_FNC(Min);
+        REG_FNC(Max);
+#undef REG_FNC
+    }
+    // Unpack only exists on the direct path; it returns a FixedReturn.
+    static void direct(LuaApi::DirectMethods<LuaApi::Vec3ArrayImpl>& dm) {
+        dm.Add("Size", &LuaApi::Vec3ArrayImpl::Size);
+        dm.Add("SetXYZ", &LuaApi::Vec3ArrayImpl::SetXYZ);
+        dm.Add("Unpack", &LuaApi::Vec3ArrayImpl::Unpack);
+    }
+};
+
+template <> struct MetatableDescriptor<LuaApi::Mat4ArrayImpl> {
+    static char const* name() { return "mat4array_mt"; }
+    static char const* luaname() { return "Mat4Array"; }
+    static char const* constructor() { return "New"; }
+    static bool construct(LuaApi::Mat4ArrayImpl* v) { return Lua::DefaultConstructor(v); }
+    static void metatable(Lua::member_function_storage<LuaApi::Mat4ArrayImpl>& mt) {
+#define REG_FNC(name) mt[ #name ] = Lua::Transform(&LuaApi::Mat4ArrayImpl::name)
+        REG_FNC(Resize);
+        REG_FNC(Size);
+        REG_FNC(Set);
+        REG_FNC(Get);
+        REG_FNC(CopyFrom);
+        REG_FNC(PreMultiply);
+        REG_FNC(PostMultiply);
+        REG_FNC(MultiplyEach);
+#undef REG_FNC
+    }
+};
+
+#endif
@@ -0,0 +1,123 @@
+#include "bounds.h"
+#include <algorithm>
+#include <cmath>
+
+namespace LuaApi {
+
+// Aabb
+Aabb Aabb::FromSphere(glm::vec3 const& center, float radius)
+{
+    return Aabb{center - glm::vec3(radius), center + glm::vec3(radius)};
+}
+
+Aabb Aabb::FromPoints(float const* points, std::size_t count, std::size_t stride)
+{
+    glm::vec3 lo(points[0], points[1], points[2]);
+    glm::vec3 hi = lo;
+    for(std::size_t i = 1; i < count; ++i)
+    {
+        glm::vec3 p(points[i * stride], points[i * stride + 1], points[i * stride + 2]);
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    return Aabb{lo, hi};
+}
+
+bool Aabb::Overlaps(Aabb const& o) const
+{
+    return m_min.x <= o.m_max.x && m_max.x >= o.m_min.x &&
+           m_min.y <= o.m_max.y && m_max.y >= o.m_min.y &&
+           m_min.z <= o.m_max.z && m_max.z >= o.m_min.z;
+}
+
+float Aabb::DistanceSquared(glm::vec3 const& p) const
+{
+    glm::vec3 d = glm::max(m_min - p, glm::max(glm::vec3(0.f), p - m_max));
+    return glm::dot(d, d);
+}
+
+bool Aabb::Ray(glm::vec3 const& origin, glm::vec3 const& invDir, float maxT, float& t) const
+{
+    float tMin = 0.f;
+    float tMax = maxT;
+    for(int i = 0; i < 3; ++i)
+    {
+        float t0 = (m_min[i] - origin[i]) * invDir[i];
+        float t1 = (m_max[i] - origin[i]) * invDir[i];
+        if(t0 > t1)
+            std::swap(t0, t1);
+        // NaN from 0 * inf (origin on a slab plane) is ignored by the
+        // comparisons below, which keeps the ray inside that slab.
+        if(t0 > tMin)
+            tMin = t0;
+        if(t1 < tMax)
+            tMax = t1;
+        if(tMin > tMax)
+            return false;
+    }
+    t = tMin;
+    return true;
+}
+
+glm::vec4 BoundingSphere(Aabb const& box, float const* points, std::size_t count, std::size_t stride)
+{
+    glm::vec3 const center = (box.m_min + box.m_max) * 0.5f;
+    float r2 = 0.f;
+    for(std::size_t i = 0; i < count; ++i)
+    {
+        glm::vec3 d = glm::vec3(points[i * stride], points[i * stride + 1], points[i * stride + 2]) - center;
+        r2 = std::max(r2, glm::dot(d, d));
+    }
+    return glm::vec4(center, std::sqrt(r2));
+}
+
+// Frustum
+Frustum Frustum::FromMatrix(glm::mat4 const& m)
+{
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    Frustum f;
+    f.m_planes[0] = row3 + row0;
+    f.m_planes[1] = row3 - row0;
+    f.m_planes[2] = row3 + row1;
+    f.m_planes[3] = row3 - row1;
+    f.m_planes[4] = row3 + row2;
+    f.m_planes[5] = row3 - row2;
+    for(int i = 0; i < 6; ++i)
+    {
+        float len = glm::length(glm::vec3(f.m_planes[i]));
+        if(len > 0.f)
+            f.m_planes[i] /= len;
+    }
+    return f;
+}
+
+bool Frustum::Intersects(Aabb const& box) const
+{
+    for(int i = 0; i < 6; ++i)
+    {
+        glm::vec4 const& p = m_planes[i];
+        // The corner furthest along the plane normal.
+        glm::vec3 v(p.x >= 0.f ? box.m_max.x : box.m_min.x,
+                    p.y >= 0.f ? box.m_max.y : box.m_min.y,
+                    p.z >= 0.f ? box.m_max.z : box.m_min.z);
+        if(glm::dot(glm::vec3(p), v) + p.w < 0.f)
+            return false;
+    }
+    return true;
+}
+
+bool Frustum::Intersects(glm::vec3 const& center, float radius) const
+{
+    for(int i = 0; i < 6; ++i)
+    {
+        if(glm::dot(glm::vec3(m_planes[i]), center) + m_planes[i].w < -radius)
+            return false;
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,35 @@
+#ifndef LUAWORLD_BOUNDS_H
+#define LUAWORLD_BOUNDS_H
+#include "shared.h"
+
+namespace LuaApi {
+    struct Aabb {
+        glm::vec3 m_min;
+        glm::vec3 m_max;
+
+        static Aabb FromSphere(glm::vec3 const& center, float radius);
+        // xyz at the start of every stride floats; count must be non-zero.
+        static Aabb FromPoints(float const* points, std::size_t count, std::size_t stride);
+        bool Overlaps(Aabb const&) const;
+        // Squared distance from p to the box, 0 inside.
+        float DistanceSquared(glm::vec3 const& p) const;
+        // Slab test; dir need not be normalised, t is in units of dir.
+        bool Ray(glm::vec3 const& origin, glm::vec3 const& invDir, float maxT, float& t) const;
+    };
+
+    // Centred on the box, just large enough for the points; xyz centre, w
+    // radius.
+    glm::vec4 BoundingSphere(Aabb const&, float const* points, std::size_t count, std::size_t stride);
+
+    // Planes point inwards, xyz normalised, w the offset.
+    struct Frustum {
+        glm::vec4 m_planes[6];
+
+        // Gribb/Hartmann extraction from a projection * view matrix.
+        static Frustum FromMatrix(glm::mat4 const&);
+        bool Intersects(Aabb const&) const;
+        bool Intersects(glm::vec3 const& center, float radius) const;
+    };
+}
+
+#endif
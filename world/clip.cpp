@@ -0,0 +1,446 @@
+#include "clip.h"
+#include <algorithm>
+#include <cmath>
+
+namespace LuaApi {
+namespace {
+    float const QUAT_RANGE = 0.70710678f;
+    float const TIME_STEPS = 65535.f;
+
+    // Index of the last key at or before time, and the factor towards the
+    // next one; clamped at both ends.
+    inline std::size_t FindKey(std::vector<float> const& times, float time, float& t)
+    {
+        std::size_t const n = times.size();
+        if(n < 2 || time <= times.front())
+        {
+            t = 0.f;
+            return 0;
+        }
+        if(time >= times.back())
+        {
+            t = 0.f;
+            return n - 1;
+        }
+        std::size_t k = std::upper_bound(times.begin(), times.end(), time) - times.begin() - 1;
+        float const span = times[k + 1] - times[k];
+        t = span > 0.f ? (time - times[k]) / span : 0.f;
+        return k;
+    }
+
+    // Same over packed times; time is in steps.
+    inline std::size_t FindKey(std::uint16_t const* times, std::size_t n, float time, float& t)
+    {
+        if(n < 2 || time <= times[0])
+        {
+            t = 0.f;
+            return 0;
+        }
+        if(time >= times[n - 1])
+        {
+            t = 0.f;
+            return n - 1;
+        }
+        std::size_t k = std::upper_bound(times, times + n, time) - times - 1;
+        float const span = float(times[k + 1]) - float(times[k]);
+        t = span > 0.f ? (time - times[k]) / span : 0.f;
+        return k;
+    }
+
+    // Smallest three: the largest component is made positive and dropped,
+    // its index goes in the top bits of the first two words.
+    inline void EncodeQuat(glm::vec4 const& q, std::uint16_t* out)
+    {
+        int largest = 0;
+        for(int i = 1; i < 4; ++i)
+        {
+            if(std::fabs(q[i]) > std::fabs(q[largest]))
+                largest = i;
+        }
+        float const sign = q[largest] < 0.f ? -1.f : 1.f;
+        std::uint16_t v[3];
+        for(int i = 0, k = 0; i < 4; ++i)
+        {
+            if(i == largest)
+                continue;
+            float n = std::min(std::max(q[i] * sign / QUAT_RANGE * 0.5f + 0.5f, 0.f), 1.f);
+            v[k++] = static_cast<std::uint16_t>(std::lround(n * 32767.f));
+        }
+        out[0] = static_cast<std::uint16_t>(v[0] | ((largest & 1) << 15));
+        out[1] = static_cast<std::uint16_t>(v[1] | ((largest >> 1) << 15));
+        out[2] = v[2];
+    }
+
+    inline glm::vec4 DecodeQuat(std::uint16_t const* in)
+    {
+        int const largest = (in[0] >> 15) | ((in[1] >> 15) << 1);
+        glm::vec4 q;
+        float sum = 0.f;
+        for(int i = 0, k = 0; i < 4; ++i)
+        {
+            if(i == largest)
+                continue;
+            float c = ((in[k++] & 0x7FFF) / 32767.f * 2.f - 1.f) * QUAT_RANGE;
+            q[i] = c;
+            sum += c * c;
+        }
+        q[largest] = std::sqrt(std::max(1.f - sum, 0.f));
+        return q;
+    }
+
+    inline void EncodeVec(glm::vec3 const& v, glm::vec3 const& min, glm::vec3 const& extent, std::uint16_t* out)
+    {
+        for(int c = 0; c < 3; ++c)
+        {
+            float n = extent[c] > 0.f ? (v[c] - min[c]) / extent[c] : 0.f;
+            out[c] = static_cast<std::uint16_t>(std::lround(std::min(std::max(n, 0.f), 1.f) * 65535.f));
+        }
+    }
+
+    inline glm::vec3 DecodeVec(std::uint16_t const* in, glm::vec3 const& min, glm::vec3 const& extent)
+    {
+        return glm::vec3(min.x + in[0] * extent.x / 65535.f,
+                         min.y + in[1] * extent.y / 65535.f,
+                         min.z + in[2] * extent.z / 65535.f);
+    }
+
+    // Rotations are xyzw, nlerped along the shorter arc like BlendPoses.
+    inline glm::vec4 Interpolate(int channel, glm::vec4 const& a, glm::vec4 const& b, float t)
+    {
+        if(channel != AnimationClipImpl::ROTATION)
+            return a + (b - a) * t;
+        float const wb = glm::dot(a, b) < 0.f ? -t : t;
+        glm::vec4 q = a * (1.f - t) + b * wb;
+        float const len = glm::length(q);
+        return len > 0.f ? q / len : q;
+    }
+
+    inline float Error(int channel, glm::vec4 const& a, glm::vec4 const& b)
+    {
+        switch(channel)
+        {
+        case AnimationClipImpl::POSITION:
+            return glm::length(glm::vec3(a) - glm::vec3(b));
+        case AnimationClipImpl::ROTATION:
+        {
+            // Rotation angle from the chord, which stays accurate for small
+            // angles where acos of the dot product doesn't.
+            float const chord = glm::dot(a, b) < 0.f ? glm::length(a + b) : glm::length(a - b);
+            return 4.f * std::asin(std::min(chord * 0.5f, 1.f));
+        }
+        default:
+            return std::max(std::max(std::fabs(a.x - b.x), std::fabs(a.y - b.y)), std::fabs(a.z - b.z));
+        }
+    }
+
+    // Value of the kept keys at time, as the packed sampler computes it.
+    inline glm::vec4 SampleKept(int channel, std::vector<float> const& times, std::vector<glm::vec4> const& values,
+                                std::vector<std::size_t> const& kept, float time)
+    {
+        std::size_t lo = 0, hi = kept.size() - 1;
+        if(hi == 0 || time <= times[kept[0]])
+            return values[kept[0]];
+        if(time >= times[kept[hi]])
+            return values[kept[hi]];
+        while(hi - lo > 1)
+        {
+            std::size_t mid = (lo + hi) / 2;
+            if(times[kept[mid]] <= time)
+                lo = mid;
+            else
+                hi = mid;
+        }
+        float const span = times[kept[hi]] - times[kept[lo]];
+        float const t = span > 0.f ? (time - times[kept[lo]]) / span : 0.f;
+        return Interpolate(channel, values[kept[lo]], values[kept[hi]], t);
+    }
+}
+
+// AnimationClipImpl
+AnimationClipImpl::AnimationClipImpl() :
+    m_duration(0.f),
+    m_compressed(false),
+    m_rawBytes(0),
+    m_maxError{0.f, 0.f, 0.f}
+{}
+
+void AnimationClipImpl::setName(std::string name) { m_name = std::move(name); }
+void AnimationClipImpl::setDuration(float d) { m_duration = d; }
+void AnimationClipImpl::addTrack(Track track)
+{
+    if(m_compressed)
+        return;
+    m_nodes.push_back(track.m_node);
+    m_rawBytes += (track.m_positions.size() + track.m_scales.size()) * (sizeof(float) + sizeof(glm::vec3)) +
+            track.m_rotations.size() * (sizeof(float) + sizeof(glm::quat));
+    m_tracks.push_back(std::move(track));
+}
+std::size_t AnimationClipImpl::trackCount() const { return m_nodes.size(); }
+std::string const& AnimationClipImpl::trackNode(std::size_t i) const { return m_nodes[i]; }
+float AnimationClipImpl::duration() const { return m_duration; }
+
+void AnimationClipImpl::sample(std::size_t track, float time, std::size_t joint, std::size_t stride,
+                               float* from, float* to, float* weights) const
+{
+    if(m_compressed)
+        samplePacked(m_packed[track], time, joint, stride, from, to, weights);
+    else
+        sampleRaw(m_tracks[track], time, joint, stride, from, to, weights);
+}
+
+void AnimationClipImpl::sampleRaw(Track const& tr, float time, std::size_t joint, std::size_t stride,
+                                  float* from, float* to, float* weights) const
+{
+    float t;
+    if(!tr.m_positions.empty())
+    {
+        std::size_t k = FindKey(tr.m_positionTimes, time, t);
+        glm::vec3 const& a = tr.m_positions[k];
+        glm::vec3 const& b = tr.m_positions[std::min(k + 1, tr.m_positions.size() - 1)];
+        for(int c = 0; c < 3; ++c)
+        {
+            from[c * stride + joint] = a[c];
+            to[c * stride + joint] = b[c];
+        }
+        weights[joint] = t;
+    }
+    if(!tr.m_rotations.empty())
+    {
+        std::size_t k = FindKey(tr.m_rotationTimes, time, t);
+        glm::quat const& a = tr.m_rotations[k];
+        glm::quat const& b = tr.m_rotations[std::min(k + 1, tr.m_rotations.size() - 1)];
+        from[3 * stride + joint] = a.x;
+        from[4 * stride + joint] = a.y;
+        from[5 * stride + joint] = a.z;
+        from[6 * stride + joint] = a.w;
+        to[3 * stride + joint] = b.x;
+        to[4 * stride + joint] = b.y;
+        to[5 * stride + joint] = b.z;
+        to[6 * stride + joint] = b.w;
+        weights[stride + joint] = t;
+    }
+    if(!tr.m_scales.empty())
+    {
+        std::size_t k = FindKey(tr.m_scaleTimes, time, t);
+        glm::vec3 const& a = tr.m_scales[k];
+        glm::vec3 const& b = tr.m_scales[std::min(k + 1, tr.m_scales.size() - 1)];
+        for(int c = 0; c < 3; ++c)
+        {
+            from[(7 + c) * stride + joint] = a[c];
+            to[(7 + c) * stride + joint] = b[c];
+        }
+        weights[2 * stride + joint] = t;
+    }
+}
+
+void AnimationClipImpl::samplePacked(PackedTrack const& tr, float time, std::size_t joint, std::size_t stride,
+                                     float* from, float* to, float* weights) const
+{
+    float const steps = m_duration > 0.f ? time / m_duration * TIME_STEPS : 0.f;
+    for(int channel = 0; channel < CHANNELS; ++channel)
+    {
+        PackedChannel const& ch = tr.m_channels[channel];
+        if(!ch.m_count)
+            continue;
+        float t;
+        std::size_t k = ch.m_first + FindKey(&m_times[ch.m_first], ch.m_count, steps, t);
+        std::size_t const next = std::min<std::size_t>(k + 1, ch.m_first + ch.m_count - 1);
+        std::uint16_t const* a = &m_values[k * 3];
+        std::uint16_t const* b = &m_values[next * 3];
+        if(channel == ROTATION)
+        {
+            glm::vec4 const qa = DecodeQuat(a);
+            glm::vec4 const qb = DecodeQuat(b);
+            for(int c = 0; c < 4; ++c)
+            {
+                from[(3 + c) * stride + joint] = qa[c];
+                to[(3 + c) * stride + joint] = qb[c];
+            }
+        }
+        else
+        {
+            glm::vec3 const va = DecodeVec(a, ch.m_min, ch.m_extent);
+            glm::vec3 const vb = DecodeVec(b, ch.m_min, ch.m_extent);
+            int const base = channel == POSITION ? 0 : 7;
+            for(int c = 0; c < 3; ++c)
+            {
+                from[(base + c) * stride + joint] = va[c];
+                to[(base + c) * stride + joint] = vb[c];
+            }
+        }
+        weights[channel * stride + joint] = t;
+    }
+}
+
+bool AnimationClipImpl::Compress(float position, float rotation, float scale)
+{
+    if(m_compressed)
+        return false;
+    float const tolerance[CHANNELS] = { position, rotation, scale };
+    std::vector<float> times;
+    std::vector<glm::vec4> raw;
+    std::vector<float> quantTimes;
+    std::vector<glm::vec4> decoded;
+    std::vector<std::uint16_t> qtimes;
+    std::vector<std::uint16_t> codes;
+    std::vector<std::size_t> kept;
+
+    m_packed.resize(m_tracks.size());
+    for(std::size_t i = 0; i < m_tracks.size(); ++i)
+    {
+        Track const& tr = m_tracks[i];
+        for(int channel = 0; channel < CHANNELS; ++channel)
+        {
+            PackedChannel& ch = m_packed[i].m_channels[channel];
+            ch.m_first = static_cast<std::uint32_t>(m_times.size());
+            ch.m_count = 0;
+            ch.m_min = glm::vec3(0.f);
+            ch.m_extent = glm::vec3(0.f);
+
+            times.clear();
+            raw.clear();
+            switch(channel)
+            {
+            case POSITION:
+                times = tr.m_positionTimes;
+                for(glm::vec3 const& v : tr.m_positions)
+                    raw.push_back(glm::vec4(v, 0.f));
+                break;
+            case ROTATION:
+                times = tr.m_rotationTimes;
+                for(glm::quat const& q : tr.m_rotations)
+                    raw.push_back(glm::vec4(q.x, q.y, q.z, q.w));
+                break;
+            default:
+                times = tr.m_scaleTimes;
+                for(glm::vec3 const& v : tr.m_scales)
+                    raw.push_back(glm::vec4(v, 0.f));
+            }
+            std::size_t const n = raw.size();
+            if(!n)
+                continue;
+
+            // Quantize every key, then decide which to keep by how well
+            // the decoded neighbours reproduce the originals.
+            if(channel != ROTATION)
+            {
+                glm::vec3 lo(raw[0]), hi(raw[0]);
+                for(glm::vec4 const& v : raw)
+                {
+                    lo = glm::min(lo, glm::vec3(v));
+                    hi = glm::max(hi, glm::vec3(v));
+                }
+                ch.m_min = lo;
+                ch.m_extent = hi - lo;
+            }
+            quantTimes.resize(n);
+            decoded.resize(n);
+            qtimes.resize(n);
+            codes.resize(n * 3);
+            for(std::size_t k = 0; k < n; ++k)
+            {
+                float q = m_duration > 0.f ? times[k] / m_duration * TIME_STEPS : 0.f;
+                qtimes[k] = static_cast<std::uint16_t>(std::lround(std::min(std::max(q, 0.f), TIME_STEPS)));
+                quantTimes[k] = qtimes[k];
+                if(channel == ROTATION)
+                {
+                    EncodeQuat(raw[k], &codes[k * 3]);
+                    decoded[k] = DecodeQuat(&codes[k * 3]);
+                }
+                else
+                {
+                    EncodeVec(glm::vec3(raw[k]), ch.m_min, ch.m_extent, &codes[k * 3]);
+                    decoded[k] = glm::vec4(DecodeVec(&codes[k * 3], ch.m_min, ch.m_extent), 0.f);
+                }
+                // Original times in steps too, to measure against.
+                times[k] = q;
+            }
+
+            kept.clear();
+            kept.push_back(0);
+            bool constant = true;
+            for(std::size_t k = 1; k < n && constant; ++k)
+                constant = Error(channel, decoded[0], raw[k]) <= tolerance[channel];
+            if(!constant)
+            {
+                // Greedy: extend the segment from the last kept key until
+                // one of the keys inside it is off by more than the
+                // tolerance.
+                std::size_t anchor = 0;
+                for(std::size_t end = 2; end < n; ++end)
+                {
+                    float const span = quantTimes[end] - quantTimes[anchor];
+                    for(std::size_t k = anchor + 1; k < end; ++k)
+                    {
+                        float t = span > 0.f ? (times[k] - quantTimes[anchor]) / span : 0.f;
+                        t = std::min(std::max(t, 0.f), 1.f);
+                        if(Error(channel, Interpolate(channel, decoded[anchor], decoded[end], t), raw[k]) > tolerance[channel])
+                        {
+                            anchor = end - 1;
+                            kept.push_back(anchor);
+                            break;
+                        }
+                    }
+                }
+                if(kept.back() != n - 1)
+                    kept.push_back(n - 1);
+            }
+
+            for(std::size_t k = 0; k < n; ++k)
+            {
+                glm::vec4 v = SampleKept(channel, quantTimes, decoded, kept, times[k]);
+                m_maxError[channel] = std::max(m_maxError[channel], Error(channel, v, raw[k]));
+            }
+            for(std::size_t k : kept)
+            {
+                m_times.push_back(qtimes[k]);
+                m_values.insert(m_values.end(), codes.begin() + k * 3, codes.begin() + k * 3 + 3);
+            }
+            ch.m_count = static_cast<std::uint32_t>(kept.size());
+        }
+    }
+    m_tracks.clear();
+    m_tracks.shrink_to_fit();
+    m_times.shrink_to_fit();
+    m_values.shrink_to_fit();
+    m_compressed = true;
+    return true;
+}
+bool AnimationClipImpl::IsCompressed() const { return m_compressed; }
+
+std::string AnimationClipImpl::Name() const { return m_name; }
+float AnimationClipImpl::Duration() const { return m_duration; }
+std::size_t AnimationClipImpl::TrackCount() const { return m_nodes.size(); }
+Lua::ReturnValues AnimationClipImpl::TrackNode(std::size_t i) const
+{
+    if(i < m_nodes.size())
+        return Lua::Return(m_nodes[i]);
+    return Lua::Return();
+}
+std::size_t AnimationClipImpl::KeyCount() const
+{
+    if(m_compressed)
+        return m_times.size();
+    std::size_t n = 0;
+    for(Track const& t : m_tracks)
+        n += t.m_positions.size() + t.m_rotations.size() + t.m_scales.size();
+    return n;
+}
+std::size_t AnimationClipImpl::Bytes() const
+{
+    if(!m_compressed)
+        return m_rawBytes;
+    return (m_times.size() + m_values.size()) * sizeof(std::uint16_t) + m_packed.size() * sizeof(PackedTrack);
+}
+std::size_t AnimationClipImpl::RawBytes() const { return m_rawBytes; }
+float AnimationClipImpl::CompressionRatio() const
+{
+    std::size_t const bytes = Bytes();
+    return bytes ? static_cast<float>(m_rawBytes) / bytes : 1.f;
+}
+FixedReturn<float, 3> AnimationClipImpl::MaxError() const
+{
+    return ReturnFixed(m_maxError[POSITION], m_maxError[ROTATION], m_maxError[SCALE]);
+}
+
+}
@@ -0,0 +1,132 @@
+#ifndef LUAWORLD_CLIP_H
+#define LUAWORLD_CLIP_H
+#include <vector>
+#include "shared.h"
+
+namespace LuaApi {
+    // Keyframed animation of named nodes, imported with a Model.
+    // Times are in seconds; each track keys position, rotation and scale
+    // independently. Clips are immutable once loaded or compressed, so
+    // animators on worker threads may sample the same clip.
+    //
+    // Compress() replaces the float keys with a packed form, six bytes per
+    // key plus a two byte time:
+    //  - rotations keep their three smallest components in 15 bits each,
+    //    the fourth is rebuilt from unit length;
+    //  - positions and scales are 16 bits per component within the
+    //    channel's own range;
+    //  - keys that linear interpolation of their neighbours reproduces
+    //    within the tolerance are dropped.
+    // The keys of a channel are adjacent in one array, so sampling touches
+    // two short runs of memory. Error is measured against the original
+    // keys, quantization included.
+    class AnimationClipImpl {
+    public:
+        struct Track {
+            std::string m_node;
+            std::vector<float> m_positionTimes;
+            std::vector<glm::vec3> m_positions;
+            std::vector<float> m_rotationTimes;
+            std::vector<glm::quat> m_rotations;
+            std::vector<float> m_scaleTimes;
+            std::vector<glm::vec3> m_scales;
+        };
+        enum Channel {
+            POSITION,
+            ROTATION,
+            SCALE,
+            CHANNELS
+        };
+    private:
+        // Keys [m_first, m_first + m_count) of m_times and m_values.
+        struct PackedChannel {
+            std::uint32_t m_first;
+            std::uint32_t m_count;
+            // Positions and scales: value = m_min + q * m_extent / 65535.
+            glm::vec3 m_min;
+            glm::vec3 m_extent;
+        };
+        struct PackedTrack {
+            PackedChannel m_channels[CHANNELS];
+        };
+
+        std::string m_name;
+        float m_duration;
+        std::vector<std::string> m_nodes;
+        std::vector<Track> m_tracks;
+
+        bool m_compressed;
+        std::vector<PackedTrack> m_packed;
+        // Time in 1/65535ths of the duration.
+        std::vector<std::uint16_t> m_times;
+        std::vector<std::uint16_t> m_values;
+        std::size_t m_rawBytes;
+        float m_maxError[CHANNELS];
+
+        void sampleRaw(Track const&, float time, std::size_t joint, std::size_t stride,
+                       float* from, float* to, float* weights) const;
+        void samplePacked(PackedTrack const&, float time, std::size_t joint, std::size_t stride,
+                          float* from, float* to, float* weights) const;
+    public:
+        AnimationClipImpl();
+
+        void setName(std::string);
+        void setDuration(float);
+        // Only before Compress().
+        void addTrack(Track);
+        std::size_t trackCount() const;
+        std::string const& trackNode(std::size_t) const;
+        float duration() const;
+
+        // The keys of a track around time, for simd::BlendPoses: the pose
+        // streams of from and to get the joint's values at the two keys,
+        // the three weight streams the blend factors. Streams without
+        // keys are left alone.
+        void sample(std::size_t track, float time, std::size_t joint, std::size_t stride,
+                    float* from, float* to, float* weights) const;
+
+        // Tolerances in model units, radians, and scale units. False if
+        // already compressed.
+        bool Compress(float position, float rotation, float scale);
+        bool IsCompressed() const;
+
+        std::string Name() const;
+        float Duration() const;
+        std::size_t TrackCount() const;
+        Lua::ReturnValues TrackNode(std::size_t) const;
+        std::size_t KeyCount() const;
+        // Bytes of key data now, and as float keys.
+        std::size_t Bytes() const;
+        std::size_t RawBytes() const;
+        float CompressionRatio() const;
+        // Largest position distance, rotation angle and scale difference
+        // from the original keys; zero before compression.
+        FixedReturn<float, 3> MaxError() const;
+    };
+
+    typedef RefCounted<AnimationClipImpl> AnimationClip;
+}
+
+template <> struct MetatableDescriptor<LuaApi::AnimationClipImpl> {
+    static char const* name() { return "animationclip_mt"; }
+    static char const* luaname() { return ""; }
+    static char const* constructor() { return ""; }
+    static bool construct(LuaApi::AnimationClipImpl* v) { return Lua::DefaultConstructor(v); }
+    static void metatable(Lua::member_function_storage<LuaApi::AnimationClipImpl>& mt) {
+#define REG_FNC(name) mt[ #name ] = Lua::Transform(&LuaApi::AnimationClipImpl::name)
+        REG_FNC(Name);
+        REG_FNC(Duration);
+        REG_FNC(TrackCount);
+        REG_FNC(TrackNode);
+        REG_FNC(KeyCount);
+        REG_FNC(Compress);
+        REG_FNC(IsCompressed);
+        REG_FNC(Bytes);
+        REG_FNC(RawBytes);
+        REG_FNC(CompressionRatio);
+        mt["MaxError"] = LuaApi::PushFixed(&LuaApi::AnimationClipImpl::MaxError);
+#undef REG_FNC
+    }
+};
+
+#endif
@@ -0,0 +1,191 @@
+#include "cull.h"
+#include "simd.h"
+#include "../core/jobs.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace LuaApi {
+
+CullListImpl::CullListImpl() :
+    m_count(0),
+    m_tested(0),
+    m_culled(0),
+    m_occludedCount(0)
+{
+}
+
+CullListImpl::Index CullListImpl::Add(ModelBone bone)
+{
+    if(!bone.IsValid())
+        throw std::runtime_error("CullList:Add needs a valid bone");
+    Index index;
+    if(!m_free.empty())
+    {
+        index = m_free.back();
+        m_free.pop_back();
+        m_bones[index] = std::move(bone);
+    }
+    else
+    {
+        index = static_cast<Index>(m_bones.size());
+        m_bones.push_back(std::move(bone));
+        m_x.push_back(0.f);
+        m_y.push_back(0.f);
+        m_z.push_back(0.f);
+        m_radius.push_back(0.f);
+        m_visible.push_back(0);
+        m_occluded.push_back(0);
+    }
+    ++m_count;
+    return index;
+}
+
+bool CullListImpl::Remove(Index index)
+{
+    if(index >= m_bones.size() || !m_bones[index].IsValid())
+        return false;
+    m_bones[index] = ModelBone();
+    m_visible[index] = 0;
+    m_free.push_back(index);
+    --m_count;
+    return true;
+}
+
+ModelBone CullListImpl::Bone(Index index) const
+{
+    if(index >= m_bones.size())
+        return ModelBone();
+    return m_bones[index];
+}
+
+std::size_t CullListImpl::Count() const { return m_count; }
+
+void CullListImpl::Clear()
+{
+    m_bones.clear();
+    m_free.clear();
+    m_x.clear();
+    m_y.clear();
+    m_z.clear();
+    m_radius.clear();
+    m_visible.clear();
+    m_occluded.clear();
+    m_visibleList.clear();
+    m_count = 0;
+    m_tested = 0;
+    m_culled = 0;
+    m_occludedCount = 0;
+}
+
+// World-space spheres for [begin, end). Only reads the handles, so it can
+// run on the pool.
+void CullListImpl::gather(std::size_t begin, std::size_t end)
+{
+    float const inf = std::numeric_limits<float>::infinity();
+    for(std::size_t i = begin; i < end; ++i)
+    {
+        ModelBoneImpl const* bone = m_bones[i].TryGet();
+        if(!bone)
+        {
+            // Far out of every frustum; dropped from the counts afterwards.
+            m_x[i] = m_y[i] = m_z[i] = 0.f;
+            m_radius[i] = -inf;
+            continue;
+        }
+        ModelStorageImpl const* storage = bone->storage().TryGet();
+        if(!storage || !storage->hasBounds())
+        {
+            m_x[i] = m_y[i] = m_z[i] = 0.f;
+            m_radius[i] = inf;
+            continue;
+        }
+        glm::mat4 const& m = bone->world();
+        glm::vec4 const& s = storage->sphere();
+        glm::vec4 c = m * glm::vec4(s.x, s.y, s.z, 1.f);
+        float scale = std::max(glm::dot(glm::vec3(m[0]), glm::vec3(m[0])),
+                      std::max(glm::dot(glm::vec3(m[1]), glm::vec3(m[1])),
+                               glm::dot(glm::vec3(m[2]), glm::vec3(m[2]))));
+        m_x[i] = c.x;
+        m_y[i] = c.y;
+        m_z[i] = c.z;
+        m_radius[i] = s.w * std::sqrt(scale);
+    }
+}
+
+// Box test of the frustum survivors in [begin, end). The buffer is only
+// read here.
+void CullListImpl::occlude(std::size_t begin, std::size_t end)
+{
+    OcclusionBufferImpl const* occlusion = m_occlusion.TryGet();
+    for(std::size_t i = begin; i < end; ++i)
+    {
+        m_occluded[i] = 0;
+        if(!occlusion || !m_visible[i])
+            continue;
+        ModelBoneImpl const* bone = m_bones[i].TryGet();
+        ModelStorageImpl const* storage = bone ? bone->storage().TryGet() : nullptr;
+        if(!storage || !storage->hasBounds())
+            continue;
+        if(!occlusion->visible(storage->bounds(), bone->world()))
+        {
+            m_visible[i] = 0;
+            m_occluded[i] = 1;
+        }
+    }
+}
+
+void CullListImpl::SetOcclusion(OcclusionBuffer occlusion) { m_occlusion = std::move(occlusion); }
+
+std::size_t CullListImpl::Cull(Mat4 viewProjection)
+{
+    m_frustum = Frustum::FromMatrix(viewProjection.value());
+    float const* planes = &m_frustum.m_planes[0].x;
+    std::size_t const size = m_bones.size();
+    std::size_t const blocks = (size + CullListImpl::BLOCK - 1) / CullListImpl::BLOCK;
+    ParallelFor(blocks, 1, [this, planes, size](std::size_t begin, std::size_t end) {
+        for(std::size_t b = begin; b < end; ++b)
+        {
+            std::size_t first = b * CullListImpl::BLOCK;
+            std::size_t last = std::min(size, first + CullListImpl::BLOCK);
+            gather(first, last);
+            simd::CullSpheres(planes, &m_x[first], &m_y[first], &m_z[first], &m_radius[first],
+                              last - first, &m_visible[first]);
+            occlude(first, last);
+        }
+    });
+
+    m_visibleList.clear();
+    m_occludedCount = 0;
+    for(std::size_t i = 0; i < size; ++i)
+    {
+        if(m_visible[i] && m_bones[i].IsValid())
+            m_visibleList.push_back(static_cast<Index>(i));
+        m_occludedCount += m_occluded[i];
+    }
+    m_tested = m_count;
+    m_culled = m_count - m_visibleList.size();
+    return m_visibleList.size();
+}
+
+bool CullListImpl::IsVisible(Index index) const
+{
+    return index < m_visible.size() && m_visible[index] && m_bones[index].IsValid();
+}
+
+std::vector<CullListImpl::Index> const& CullListImpl::visible() const { return m_visibleList; }
+
+int CullListImpl::Visible(lua_State* s)
+{
+    return PushSequence(s, 2, m_visibleList.data(), m_visibleList.size());
+}
+
+FixedReturn<std::uint32_t, 4> CullListImpl::Stats() const
+{
+    return ReturnFixed(static_cast<std::uint32_t>(m_tested),
+                       static_cast<std::uint32_t>(m_culled),
+                       static_cast<std::uint32_t>(m_tested - m_culled),
+                       static_cast<std::uint32_t>(m_occludedCount));
+}
+
+}
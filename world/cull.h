@@ -0,0 +1,98 @@
+#ifndef LUAWORLD_CULL_H
+#define LUAWORLD_CULL_H
+#include <vector>
+#include "shared.h"
+#include "bounds.h"
+#include "matrix.h"
+#include "occlusion.h"
+#include "../gl/objectbone.h"
+
+namespace LuaApi {
+    // Frustum culling of model bones by their bounding spheres.
+    // Cull() moves each bone's model-space sphere by the bone's world matrix
+    // (as written by the Scene) and tests the spheres four at a time in
+    // blocks of BLOCK on the job system. Bones without bounds are always
+    // visible.
+    //
+    // With an OcclusionBuffer set, bones that pass the frustum test are
+    // also tested by their bounding box against it; render the buffer with
+    // the same matrix before calling Cull.
+    //
+    // Entries are addressed by the index Add returned; indices of removed
+    // entries are reused. Visible(out) returns (indices, count) of the last
+    // Cull, reusing out like the SpatialGrid queries. Stats() returns the
+    // tested, culled and visible counts of the last Cull, then how many of
+    // the culled were occluded.
+    class CullListImpl {
+    public:
+        typedef std::uint32_t Index;
+        enum { BLOCK = 1024 };
+    private:
+        std::vector<ModelBone> m_bones;
+        std::vector<Index> m_free;
+        std::size_t m_count;
+
+        // Per entry, as of the last Cull.
+        std::vector<float> m_x;
+        std::vector<float> m_y;
+        std::vector<float> m_z;
+        std::vector<float> m_radius;
+        std::vector<std::uint8_t> m_visible;
+        std::vector<std::uint8_t> m_occluded;
+        std::vector<Index> m_visibleList;
+
+        Frustum m_frustum;
+        OcclusionBuffer m_occlusion;
+        std::size_t m_tested;
+        std::size_t m_culled;
+        std::size_t m_occludedCount;
+
+        void gather(std::size_t begin, std::size_t end);
+        void occlude(std::size_t begin, std::size_t end);
+    public:
+        CullListImpl();
+
+        Index Add(ModelBone);
+        bool Remove(Index);
+        ModelBone Bone(Index) const;
+        std::size_t Count() const;
+        void Clear();
+
+        // nil turns occlusion culling off.
+        void SetOcclusion(OcclusionBuffer);
+        // Number of visible entries.
+        std::size_t Cull(Mat4 viewProjection);
+        bool IsVisible(Index) const;
+        std::vector<Index> const& visible() const;
+        int Visible(lua_State*);
+        FixedReturn<std::uint32_t, 4> Stats() const;
+    };
+
+    typedef RefCounted<CullListImpl> CullList;
+}
+
+template <> struct MetatableDescriptor<LuaApi::CullListImpl> {
+    static char const* name() { return "culllist_mt"; }
+    static char const* luaname() { return "CullList"; }
+    static char const* constructor() { return "New"; }
+    static bool construct(LuaApi::CullListImpl* v) { return Lua::DefaultConstructor(v); }
+    static void metatable(Lua::member_function_storage<LuaApi::CullListImpl>& mt) {
+#define REG_FNC(name) mt[ #name ] = Lua::Transform(&LuaApi::CullListImpl::name)
+        REG_FNC(Add);
+        REG_FNC(Remove);
+        REG_FNC(Bone);
+        REG_FNC(Count);
+        REG_FNC(Clear);
+        REG_FNC(SetOcclusion);
+        REG_FNC(Cull);
+        REG_FNC(IsVisible);
+        mt["Stats"] = LuaApi::PushFixed(&LuaApi::CullListImpl::Stats);
+#undef REG_FNC
+    }
+    static void direct(LuaApi::DirectMethods<LuaApi::CullListImpl>& dm) {
+        dm.Add("IsVisible", &LuaApi::CullListImpl::IsVisible);
+        dm.AddRaw("Visible", &LuaApi::CullListImpl::Visible);
+    }
+};
+
+#endif
@@ -0,0 +1,938 @@
+#include "entities.h"
+#include "../core/jobs.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace LuaApi {
+
+namespace {
+    std::uint32_t const g_generationMask = (1u << (32 - EntitiesImpl::INDEX_BITS)) - 1;
+
+    // Transform field order.
+    enum { T_X, T_Y, T_Z, T_QX, T_QY, T_QZ, T_QW, T_SX, T_SY, T_SZ, T_DIRTY };
+    enum { V_RADIUS, V_VISIBLE };
+
+    std::uint32_t FloatBits(float v)
+    {
+        std::uint32_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        return bits;
+    }
+
+    float LoadFloat(unsigned char const* w)
+    {
+        float v;
+        std::memcpy(&v, w, sizeof(v));
+        return v;
+    }
+    void StoreFloat(unsigned char* w, float v) { std::memcpy(w, &v, sizeof(v)); }
+    std::uint32_t LoadWord(unsigned char const* w)
+    {
+        std::uint32_t v;
+        std::memcpy(&v, w, sizeof(v));
+        return v;
+    }
+    void StoreWord(unsigned char* w, std::uint32_t v) { std::memcpy(w, &v, sizeof(v)); }
+
+    inline std::uint64_t Bit(std::uint32_t component) { return std::uint64_t(1) << component; }
+
+    struct ChunkRef {
+        std::uint32_t m_archetype;
+        std::uint32_t m_chunk;
+    };
+}
+
+// HandleTable
+template <typename H>
+std::uint32_t EntitiesImpl::HandleTable<H>::Add(H h)
+{
+    if(!h.IsValid())
+        return 0;
+    if(!m_free.empty())
+    {
+        std::uint32_t i = m_free.back();
+        m_free.pop_back();
+        m_items[i] = std::move(h);
+        return i + 1;
+    }
+    m_items.push_back(std::move(h));
+    return static_cast<std::uint32_t>(m_items.size());
+}
+template <typename H>
+void EntitiesImpl::HandleTable<H>::Release(std::uint32_t slot)
+{
+    if(slot == 0 || slot > m_items.size())
+        return;
+    m_items[slot - 1] = H();
+    m_free.push_back(slot - 1);
+}
+template <typename H>
+H const* EntitiesImpl::HandleTable<H>::Get(std::uint32_t slot) const
+{
+    if(slot == 0 || slot > m_items.size() || !m_items[slot - 1].IsValid())
+        return nullptr;
+    return &m_items[slot - 1];
+}
+
+// EntitiesImpl
+EntitiesImpl::EntitiesImpl() :
+    m_alive(0),
+    m_viewer(0.f),
+    m_viewRange(0.f),
+    m_hasFrustum(false),
+    m_iterating(0)
+{
+    std::uint32_t const one = FloatBits(1.f);
+    registerComponent("Transform", {
+        { "x", FIELD_FLOAT, 0 }, { "y", FIELD_FLOAT, 0 }, { "z", FIELD_FLOAT, 0 },
+        { "qx", FIELD_FLOAT, 0 }, { "qy", FIELD_FLOAT, 0 }, { "qz", FIELD_FLOAT, 0 }, { "qw", FIELD_FLOAT, one },
+        { "sx", FIELD_FLOAT, one }, { "sy", FIELD_FLOAT, one }, { "sz", FIELD_FLOAT, one },
+        { "dirty", FIELD_BOOL, 1 }
+    });
+    registerComponent("Node", { { "node", FIELD_INT, 0 } });
+    registerComponent("Emitter", { { "emitter", FIELD_EMITTER, 0 } });
+    registerComponent("Model", { { "model", FIELD_MODEL, 0 } });
+    registerComponent("Visibility", { { "radius", FIELD_FLOAT, 0 }, { "visible", FIELD_BOOL, 1 } });
+
+    archetypeFor(0);
+    // Index 0 is never handed out, so 0 is never a valid id.
+    m_records.push_back(Record{0, 0, 0, 0, false});
+}
+
+std::uint32_t EntitiesImpl::registerComponent(std::string const& name, std::vector<Field> fields)
+{
+    if(m_components.size() >= EntitiesImpl::MAX_COMPONENTS || m_componentIds.count(name))
+        return EntitiesImpl::NONE;
+    std::uint32_t id = static_cast<std::uint32_t>(m_components.size());
+    m_components.push_back(Component{name, std::move(fields)});
+    m_componentIds[name] = id;
+    return id;
+}
+
+std::uint32_t EntitiesImpl::componentOf(std::string const& name) const
+{
+    auto it = m_componentIds.find(name);
+    return (it != m_componentIds.end()) ? it->second : EntitiesImpl::NONE;
+}
+
+std::uint32_t EntitiesImpl::fieldOf(std::uint32_t component, std::string const& name) const
+{
+    std::vector<Field> const& fields = m_components[component].m_fields;
+    for(std::size_t i = 0; i < fields.size(); ++i)
+    {
+        if(fields[i].m_name == name)
+            return static_cast<std::uint32_t>(i);
+    }
+    return EntitiesImpl::NONE;
+}
+
+std::uint32_t EntitiesImpl::archetypeFor(std::uint64_t mask)
+{
+    auto it = m_archetypeIds.find(mask);
+    if(it != m_archetypeIds.end())
+        return it->second;
+
+    m_archetypes.emplace_back();
+    Archetype& a = m_archetypes.back();
+    a.m_mask = mask;
+    std::uint32_t column = 1;
+    for(std::uint32_t c = 0; c < EntitiesImpl::MAX_COMPONENTS; ++c)
+    {
+        if(c < m_components.size() && (mask & Bit(c)))
+        {
+            a.m_columnOf[c] = column;
+            column += static_cast<std::uint32_t>(m_components[c].m_fields.size());
+        }
+        else
+            a.m_columnOf[c] = EntitiesImpl::NONE;
+    }
+    a.m_columns = column;
+    a.m_capacity = std::max<std::uint32_t>(1, EntitiesImpl::CHUNK_BYTES / (4 * column));
+
+    std::uint32_t id = static_cast<std::uint32_t>(m_archetypes.size() - 1);
+    m_archetypeIds[mask] = id;
+    return id;
+}
+
+EntitiesImpl::Record const* EntitiesImpl::find(EntityId id) const
+{
+    std::uint32_t index = id & EntitiesImpl::INDEX_MASK;
+    if(index == 0 || index >= m_records.size())
+        return nullptr;
+    Record const& r = m_records[index];
+    if(!r.m_alive || r.m_generation != (id >> EntitiesImpl::INDEX_BITS))
+        return nullptr;
+    return &r;
+}
+
+unsigned char* EntitiesImpl::word(Archetype const& a, Chunk const& c, std::uint32_t column, std::uint32_t row)
+{
+    return c.m_data.get() + (static_cast<std::size_t>(column) * a.m_capacity + row) * 4;
+}
+
+bool EntitiesImpl::locate(EntityId id, std::uint32_t component, std::uint32_t field, unsigned char*& w, FieldType& type)
+{
+    Record const* r = find(id);
+    if(!r || component == EntitiesImpl::NONE || field == EntitiesImpl::NONE)
+        return false;
+    Archetype const& a = m_archetypes[r->m_archetype];
+    std::uint32_t column = a.m_columnOf[component];
+    if(column == EntitiesImpl::NONE)
+        return false;
+    w = word(a, a.m_chunks[r->m_chunk], column + field, r->m_row);
+    type = m_components[component].m_fields[field].m_type;
+    return true;
+}
+
+void EntitiesImpl::placeRow(std::uint32_t archetype, EntityId id)
+{
+    Archetype& a = m_archetypes[archetype];
+    if(a.m_chunks.empty() || a.m_chunks.back().m_count == a.m_capacity)
+    {
+        Chunk c;
+        c.m_data.reset(new unsigned char[static_cast<std::size_t>(a.m_capacity) * a.m_columns * 4]);
+        c.m_count = 0;
+        a.m_chunks.push_back(std::move(c));
+    }
+    Chunk& c = a.m_chunks.back();
+    std::uint32_t row = c.m_count++;
+    StoreWord(word(a, c, 0, row), id);
+
+    Record& r = m_records[id & EntitiesImpl::INDEX_MASK];
+    r.m_archetype = archetype;
+    r.m_chunk = static_cast<std::uint32_t>(a.m_chunks.size() - 1);
+    r.m_row = row;
+}
+
+// Fills the hole with the archetype's last row, so chunks stay packed.
+void EntitiesImpl::removeRow(std::uint32_t archetype, std::uint32_t chunk, std::uint32_t row)
+{
+    Archetype& a = m_archetypes[archetype];
+    Chunk& last = a.m_chunks.back();
+    std::uint32_t const lastChunk = static_cast<std::uint32_t>(a.m_chunks.size() - 1);
+    std::uint32_t const lastRow = last.m_count - 1;
+    if(chunk != lastChunk || row != lastRow)
+    {
+        Chunk& hole = a.m_chunks[chunk];
+        for(std::uint32_t col = 0; col < a.m_columns; ++col)
+            std::memcpy(word(a, hole, col, row), word(a, last, col, lastRow), 4);
+        Record& moved = m_records[LoadWord(word(a, hole, 0, row)) & EntitiesImpl::INDEX_MASK];
+        moved.m_chunk = chunk;
+        moved.m_row = row;
+    }
+    if(--last.m_count == 0)
+        a.m_chunks.pop_back();
+}
+
+void EntitiesImpl::releaseHandles(Archetype const& a, Chunk const& c, std::uint32_t row, std::uint64_t components)
+{
+    for(std::uint32_t comp = 0; comp < m_components.size(); ++comp)
+    {
+        if(!(components & a.m_mask & Bit(comp)))
+            continue;
+        std::vector<Field> const& fields = m_components[comp].m_fields;
+        for(std::uint32_t f = 0; f < fields.size(); ++f)
+        {
+            releaseSlot(fields[f].m_type, LoadWord(word(a, c, a.m_columnOf[comp] + f, row)));
+        }
+    }
+    // The grid entry goes with the Visibility component.
+    if((components & a.m_mask & Bit(EntitiesImpl::VISIBILITY)) && m_grid.IsValid())
+        m_grid->Remove(LoadWord(word(a, c, 0, row)));
+}
+
+void EntitiesImpl::releaseSlot(FieldType type, std::uint32_t slot)
+{
+    if(type == FIELD_EMITTER)
+        m_emitters.Release(slot);
+    else if(type == FIELD_MODEL)
+        m_models.Release(slot);
+}
+
+bool EntitiesImpl::move(EntityId id, std::uint64_t mask)
+{
+    Record const* r = find(id);
+    if(!r)
+        return false;
+    std::uint32_t const from = r->m_archetype;
+    std::uint32_t const fromChunk = r->m_chunk;
+    std::uint32_t const fromRow = r->m_row;
+    if(m_archetypes[from].m_mask == mask)
+        return true;
+
+    std::uint32_t const to = archetypeFor(mask);
+    placeRow(to, id);
+    Record const& placed = m_records[id & EntitiesImpl::INDEX_MASK];
+    Archetype const& src = m_archetypes[from];
+    Archetype const& dst = m_archetypes[to];
+    Chunk const& srcChunk = src.m_chunks[fromChunk];
+    Chunk const& dstChunk = dst.m_chunks[placed.m_chunk];
+
+    for(std::uint32_t comp = 0; comp < m_components.size(); ++comp)
+    {
+        if(!(dst.m_mask & Bit(comp)))
+            continue;
+        std::vector<Field> const& fields = m_components[comp].m_fields;
+        bool const kept = (src.m_mask & Bit(comp)) != 0;
+        for(std::uint32_t f = 0; f < fields.size(); ++f)
+        {
+            unsigned char* out = word(dst, dstChunk, dst.m_columnOf[comp] + f, placed.m_row);
+            if(kept)
+                std::memcpy(out, word(src, srcChunk, src.m_columnOf[comp] + f, fromRow), 4);
+            else
+                StoreWord(out, fields[f].m_default);
+        }
+    }
+    releaseHandles(src, srcChunk, fromRow, src.m_mask & ~mask);
+    removeRow(from, fromChunk, fromRow);
+    return true;
+}
+
+bool EntitiesImpl::ensure(EntityId id, std::uint32_t component)
+{
+    Record const* r = find(id);
+    if(!r)
+        return false;
+    std::uint64_t mask = m_archetypes[r->m_archetype].m_mask;
+    if(mask & Bit(component))
+        return true;
+    if(m_iterating > 0)
+        return false;
+    return move(id, mask | Bit(component));
+}
+
+// Stores words into consecutive fields of a built-in component, adding the
+// component first. While Each runs that move has to wait, so the write is
+// queued behind it. A handle slot belongs to the entity once written.
+bool EntitiesImpl::write(EntityId id, std::uint32_t component, std::uint32_t field, std::uint32_t const* words, std::uint32_t count)
+{
+    if(!ensure(id, component))
+    {
+        if(m_iterating == 0 || !find(id))
+            return false;
+        Deferred d{Deferred::WRITE, id, component, field, count, {}};
+        std::copy(words, words + count, d.m_words);
+        m_deferred.push_back(d);
+        return true;
+    }
+    for(std::uint32_t i = 0; i < count; ++i)
+    {
+        unsigned char* w;
+        FieldType type;
+        if(!locate(id, component, field + i, w, type))
+            return false;
+        releaseSlot(type, LoadWord(w));
+        StoreWord(w, words[i]);
+    }
+    written(id, component);
+    return true;
+}
+
+// Keeps the systems in step with a built-in component that was written to.
+void EntitiesImpl::written(EntityId id, std::uint32_t component)
+{
+    switch(component)
+    {
+    case EntitiesImpl::TRANSFORM:
+    case EntitiesImpl::NODE:
+    case EntitiesImpl::EMITTER:
+        markDirty(id);
+        break;
+    case EntitiesImpl::VISIBILITY:
+        // Re-inserted with the new radius on the next Update.
+        if(m_grid.IsValid())
+            m_grid->Remove(id);
+        break;
+    default:
+        break;
+    }
+}
+
+bool EntitiesImpl::markDirty(EntityId id)
+{
+    unsigned char* w;
+    FieldType type;
+    if(!locate(id, EntitiesImpl::TRANSFORM, T_DIRTY, w, type))
+        return false;
+    StoreWord(w, 1);
+    return true;
+}
+
+bool EntitiesImpl::maskOf(Lua::Array<std::string> const& names, std::uint64_t& mask) const
+{
+    mask = 0;
+    for(auto it = names.m_data.begin(); it != names.m_data.end(); ++it)
+    {
+        std::uint32_t c = componentOf(*it);
+        if(c == EntitiesImpl::NONE)
+            return false;
+        mask |= Bit(c);
+    }
+    return true;
+}
+
+void EntitiesImpl::flushDeferred()
+{
+    std::vector<Deferred> ops;
+    ops.swap(m_deferred);
+    for(auto it = ops.begin(); it != ops.end(); ++it)
+    {
+        Record const* r = find(it->m_id);
+        if(!r)
+        {
+            // Destroyed since; a queued handle is still ours to release.
+            if(it->m_op == Deferred::WRITE)
+                releaseSlot(m_components[it->m_component].m_fields[it->m_field].m_type, it->m_words[0]);
+            continue;
+        }
+        std::uint64_t mask = m_archetypes[r->m_archetype].m_mask;
+        switch(it->m_op)
+        {
+        case Deferred::DESTROY:
+            Destroy(it->m_id);
+            break;
+        case Deferred::ADD:
+            move(it->m_id, mask | Bit(it->m_component));
+            break;
+        case Deferred::REMOVE:
+            move(it->m_id, mask & ~Bit(it->m_component));
+            break;
+        case Deferred::WRITE:
+            write(it->m_id, it->m_component, it->m_field, it->m_words, it->m_count);
+            break;
+        }
+    }
+}
+
+bool EntitiesImpl::RegisterComponent(std::string const& name, Lua::Array<std::string> const& specs)
+{
+    std::vector<Field> fields;
+    for(auto it = specs.m_data.begin(); it != specs.m_data.end(); ++it)
+    {
+        Field f{*it, FIELD_FLOAT, 0};
+        std::size_t colon = it->find(':');
+        if(colon != std::string::npos)
+        {
+            f.m_name = it->substr(0, colon);
+            std::string type = it->substr(colon + 1);
+            if(type == "int")
+                f.m_type = FIELD_INT;
+            else if(type == "bool")
+                f.m_type = FIELD_BOOL;
+            else if(type != "float")
+                return false;
+        }
+        fields.push_back(std::move(f));
+    }
+    return registerComponent(name, std::move(fields)) != EntitiesImpl::NONE;
+}
+
+bool EntitiesImpl::HasComponentType(std::string const& name) const { return componentOf(name) != EntitiesImpl::NONE; }
+
+EntitiesImpl::EntityId EntitiesImpl::Create()
+{
+    std::uint32_t index;
+    if(!m_freeRecords.empty())
+    {
+        index = m_freeRecords.back();
+        m_freeRecords.pop_back();
+    }
+    else
+    {
+        if(m_records.size() > EntitiesImpl::INDEX_MASK)
+            throw std::runtime_error("Too many entities");
+        index = static_cast<std::uint32_t>(m_records.size());
+        m_records.push_back(Record{0, 0, 0, 0, false});
+    }
+    Record& r = m_records[index];
+    r.m_alive = true;
+    EntityId id = index | (r.m_generation << EntitiesImpl::INDEX_BITS);
+    placeRow(0, id);
+    ++m_alive;
+    return id;
+}
+
+bool EntitiesImpl::Destroy(EntityId id)
+{
+    Record const* r = find(id);
+    if(!r)
+        return false;
+    if(m_iterating > 0)
+    {
+        m_deferred.push_back(Deferred{Deferred::DESTROY, id, 0});
+        return true;
+    }
+    Archetype const& a = m_archetypes[r->m_archetype];
+    releaseHandles(a, a.m_chunks[r->m_chunk], r->m_row, a.m_mask);
+    removeRow(r->m_archetype, r->m_chunk, r->m_row);
+
+    Record& dead = m_records[id & EntitiesImpl::INDEX_MASK];
+    dead.m_alive = false;
+    dead.m_generation = (dead.m_generation + 1) & g_generationMask;
+    m_freeRecords.push_back(id & EntitiesImpl::INDEX_MASK);
+    --m_alive;
+    return true;
+}
+
+bool EntitiesImpl::IsAlive(EntityId id) const { return find(id) != nullptr; }
+std::size_t EntitiesImpl::Count() const { return m_alive; }
+
+std::size_t EntitiesImpl::CountWith(Lua::Array<std::string> const& names) const
+{
+    std::uint64_t mask;
+    if(!maskOf(names, mask))
+        return 0;
+    std::size_t count = 0;
+    for(auto a = m_archetypes.begin(); a != m_archetypes.end(); ++a)
+    {
+        if((a->m_mask & mask) != mask)
+            continue;
+        for(auto c = a->m_chunks.begin(); c != a->m_chunks.end(); ++c)
+            count += c->m_count;
+    }
+    return count;
+}
+
+bool EntitiesImpl::Add(EntityId id, std::string const& name)
+{
+    std::uint32_t c = componentOf(name);
+    Record const* r = find(id);
+    if(!r || c == EntitiesImpl::NONE)
+        return false;
+    std::uint64_t mask = m_archetypes[r->m_archetype].m_mask;
+    if(mask & Bit(c))
+        return true;
+    if(m_iterating > 0)
+    {
+        m_deferred.push_back(Deferred{Deferred::ADD, id, c});
+        return true;
+    }
+    return move(id, mask | Bit(c));
+}
+
+bool EntitiesImpl::Remove(EntityId id, std::string const& name)
+{
+    std::uint32_t c = componentOf(name);
+    Record const* r = find(id);
+    if(!r || c == EntitiesImpl::NONE)
+        return false;
+    std::uint64_t mask = m_archetypes[r->m_archetype].m_mask;
+    if(!(mask & Bit(c)))
+        return true;
+    if(m_iterating > 0)
+    {
+        m_deferred.push_back(Deferred{Deferred::REMOVE, id, c});
+        return true;
+    }
+    return move(id, mask & ~Bit(c));
+}
+
+bool EntitiesImpl::Has(EntityId id, std::string const& name) const
+{
+    std::uint32_t c = componentOf(name);
+    Record const* r = find(id);
+    return r && c != EntitiesImpl::NONE && (m_archetypes[r->m_archetype].m_mask & Bit(c));
+}
+
+bool EntitiesImpl::Set(EntityId id, std::string const& component, std::string const& field, double v)
+{
+    std::uint32_t c = componentOf(component);
+    unsigned char* w;
+    FieldType type;
+    if(c == EntitiesImpl::NONE || !locate(id, c, fieldOf(c, field), w, type))
+        return false;
+    switch(type)
+    {
+    case FIELD_FLOAT:
+        StoreFloat(w, static_cast<float>(v));
+        break;
+    case FIELD_INT:
+        StoreWord(w, static_cast<std::uint32_t>(static_cast<std::int32_t>(v)));
+        break;
+    case FIELD_BOOL:
+        StoreWord(w, v != 0.0 ? 1 : 0);
+        break;
+    default:
+        // Handles go through SetEmitter/SetModel.
+        return false;
+    }
+    written(id, c);
+    return true;
+}
+
+double EntitiesImpl::Get(EntityId id, std::string const& component, std::string const& field)
+{
+    std::uint32_t c = componentOf(component);
+    unsigned char* w;
+    FieldType type;
+    if(c == EntitiesImpl::NONE || !locate(id, c, fieldOf(c, field), w, type))
+        return 0.0;
+    switch(type)
+    {
+    case FIELD_FLOAT:
+        return LoadFloat(w);
+    case FIELD_INT:
+        return static_cast<std::int32_t>(LoadWord(w));
+    default:
+        return LoadWord(w);
+    }
+}
+
+bool EntitiesImpl::SetPosition(EntityId id, float x, float y, float z)
+{
+    std::uint32_t const words[3] = { FloatBits(x), FloatBits(y), FloatBits(z) };
+    return write(id, EntitiesImpl::TRANSFORM, T_X, words, 3);
+}
+
+FixedReturn<float, 3> EntitiesImpl::Position(EntityId id) const
+{
+    Record const* r = find(id);
+    if(!r)
+        return ReturnFixed(0.f, 0.f, 0.f);
+    Archetype const& a = m_archetypes[r->m_archetype];
+    glm::vec3 p = worldPosition(a, a.m_chunks[r->m_chunk], r->m_row);
+    return ReturnFixed(p.x, p.y, p.z);
+}
+
+bool EntitiesImpl::SetRotation(EntityId id, Quat q)
+{
+    glm::quat const& v = q.value();
+    std::uint32_t const words[4] = { FloatBits(v.x), FloatBits(v.y), FloatBits(v.z), FloatBits(v.w) };
+    return write(id, EntitiesImpl::TRANSFORM, T_QX, words, 4);
+}
+
+bool EntitiesImpl::SetScale(EntityId id, Vec3 s)
+{
+    std::uint32_t const words[3] = { FloatBits(s.value()[0]), FloatBits(s.value()[1]), FloatBits(s.value()[2]) };
+    return write(id, EntitiesImpl::TRANSFORM, T_SX, words, 3);
+}
+
+bool EntitiesImpl::SetNode(EntityId id, std::uint32_t node)
+{
+    return write(id, EntitiesImpl::NODE, 0, &node, 1);
+}
+
+bool EntitiesImpl::SetEmitter(EntityId id, SoundEmitter emitter)
+{
+    std::uint32_t const slot = m_emitters.Add(std::move(emitter));
+    if(write(id, EntitiesImpl::EMITTER, 0, &slot, 1))
+        return true;
+    m_emitters.Release(slot);
+    return false;
+}
+
+bool EntitiesImpl::SetModel(EntityId id, Model model)
+{
+    std::uint32_t const slot = m_models.Add(std::move(model));
+    if(write(id, EntitiesImpl::MODEL, 0, &slot, 1))
+        return true;
+    m_models.Release(slot);
+    return false;
+}
+
+bool EntitiesImpl::SetVisibility(EntityId id, float radius)
+{
+    std::uint32_t const bits = FloatBits(radius);
+    return write(id, EntitiesImpl::VISIBILITY, V_RADIUS, &bits, 1);
+}
+
+bool EntitiesImpl::IsVisible(EntityId id)
+{
+    unsigned char* w;
+    FieldType type;
+    if(!locate(id, EntitiesImpl::VISIBILITY, V_VISIBLE, w, type))
+        return find(id) != nullptr;
+    return LoadWord(w) != 0;
+}
+
+void EntitiesImpl::SetScene(Scene scene) { m_scene = std::move(scene); }
+void EntitiesImpl::SetViewer(float x, float y, float z, float range)
+{
+    m_viewer = glm::vec3(x, y, z);
+    m_viewRange = range;
+}
+
+void EntitiesImpl::SetViewFrustum(Mat4 viewProjection)
+{
+    m_frustum = Frustum::FromMatrix(viewProjection.value());
+    m_hasFrustum = true;
+}
+
+void EntitiesImpl::ClearViewFrustum() { m_hasFrustum = false; }
+void EntitiesImpl::SetSpatialGrid(SpatialGrid grid) { m_grid = std::move(grid); }
+
+glm::vec3 EntitiesImpl::worldPosition(Archetype const& a, Chunk const& c, std::uint32_t row) const
+{
+    std::uint32_t nodeColumn = a.m_columnOf[EntitiesImpl::NODE];
+    if(nodeColumn != EntitiesImpl::NONE && m_scene.IsValid())
+    {
+        glm::mat4 const* m = m_scene->world(LoadWord(word(a, c, nodeColumn, row)));
+        if(m)
+            return glm::vec3((*m)[3]);
+    }
+    std::uint32_t t = a.m_columnOf[EntitiesImpl::TRANSFORM];
+    if(t == EntitiesImpl::NONE)
+        return glm::vec3(0.f);
+    return glm::vec3(LoadFloat(word(a, c, t + T_X, row)),
+                     LoadFloat(word(a, c, t + T_Y, row)),
+                     LoadFloat(word(a, c, t + T_Z, row)));
+}
+
+void EntitiesImpl::syncTransforms()
+{
+    if(!m_scene.IsValid())
+        return;
+    std::uint64_t const mask = Bit(EntitiesImpl::TRANSFORM) | Bit(EntitiesImpl::NODE);
+    for(auto a = m_archetypes.begin(); a != m_archetypes.end(); ++a)
+    {
+        if((a->m_mask & mask) != mask)
+            continue;
+        std::uint32_t const t = a->m_columnOf[EntitiesImpl::TRANSFORM];
+        std::uint32_t const n = a->m_columnOf[EntitiesImpl::NODE];
+        for(auto c = a->m_chunks.begin(); c != a->m_chunks.end(); ++c)
+        {
+            for(std::uint32_t row = 0; row < c->m_count; ++row)
+            {
+                if(!LoadWord(word(*a, *c, t + T_DIRTY, row)))
+                    continue;
+                float v[T_DIRTY];
+                for(std::uint32_t i = 0; i < T_DIRTY; ++i)
+                    v[i] = LoadFloat(word(*a, *c, t + i, row));
+                m_scene->setLocal(LoadWord(word(*a, *c, n, row)),
+                                  glm::vec3(v[T_X], v[T_Y], v[T_Z]),
+                                  glm::quat(v[T_QW], v[T_QX], v[T_QY], v[T_QZ]),
+                                  glm::vec3(v[T_SX], v[T_SY], v[T_SZ]));
+            }
+        }
+    }
+    m_scene->Update();
+}
+
+void EntitiesImpl::syncEmitters()
+{
+    for(auto a = m_archetypes.begin(); a != m_archetypes.end(); ++a)
+    {
+        if(!(a->m_mask & Bit(EntitiesImpl::EMITTER)))
+            continue;
+        std::uint32_t const e = a->m_columnOf[EntitiesImpl::EMITTER];
+        std::uint32_t const t = a->m_columnOf[EntitiesImpl::TRANSFORM];
+        std::uint32_t const n = a->m_columnOf[EntitiesImpl::NODE];
+        for(auto c = a->m_chunks.begin(); c != a->m_chunks.end(); ++c)
+        {
+            for(std::uint32_t row = 0; row < c->m_count; ++row)
+            {
+                SoundEmitter const* emitter = m_emitters.Get(LoadWord(word(*a, *c, e, row)));
+                if(!emitter)
+                    continue;
+                bool moved = (t != EntitiesImpl::NONE) && LoadWord(word(*a, *c, t + T_DIRTY, row));
+                if(!moved && n != EntitiesImpl::NONE && m_scene.IsValid())
+                    moved = m_scene->changed(LoadWord(word(*a, *c, n, row)));
+                if(!moved)
+                    continue;
+                glm::vec3 p = worldPosition(*a, *c, row);
+                (*emitter)->setPosition(p.x, p.y, p.z);
+            }
+        }
+    }
+}
+
+// Moves grid entries of entities whose transform or node changed this
+// frame; entities not in the grid yet are added.
+void EntitiesImpl::syncGrid()
+{
+    for(auto a = m_archetypes.begin(); a != m_archetypes.end(); ++a)
+    {
+        if(!(a->m_mask & Bit(EntitiesImpl::VISIBILITY)))
+            continue;
+        std::uint32_t const v = a->m_columnOf[EntitiesImpl::VISIBILITY];
+        std::uint32_t const t = a->m_columnOf[EntitiesImpl::TRANSFORM];
+        std::uint32_t const n = a->m_columnOf[EntitiesImpl::NODE];
+        for(auto c = a->m_chunks.begin(); c != a->m_chunks.end(); ++c)
+        {
+            for(std::uint32_t row = 0; row < c->m_count; ++row)
+            {
+                EntityId const id = LoadWord(word(*a, *c, 0, row));
+                bool moved = (t != EntitiesImpl::NONE) && LoadWord(word(*a, *c, t + T_DIRTY, row));
+                if(!moved && n != EntitiesImpl::NONE && m_scene.IsValid())
+                    moved = m_scene->changed(LoadWord(word(*a, *c, n, row)));
+                if(!moved && m_grid->Has(id))
+                    continue;
+                glm::vec3 p = worldPosition(*a, *c, row);
+                m_grid->SetSphere(id, p.x, p.y, p.z, LoadFloat(word(*a, *c, v + V_RADIUS, row)));
+            }
+        }
+    }
+}
+
+// Everything starts hidden; the grid's frustum hits that pass the same
+// tests as the parallel path are marked visible.
+void EntitiesImpl::cullWithGrid()
+{
+    m_inView.clear();
+    m_grid->queryFrustum(m_frustum, m_inView);
+    for(auto a = m_archetypes.begin(); a != m_archetypes.end(); ++a)
+    {
+        std::uint32_t const v = a->m_columnOf[EntitiesImpl::VISIBILITY];
+        if(v == EntitiesImpl::NONE)
+            continue;
+        for(auto c = a->m_chunks.begin(); c != a->m_chunks.end(); ++c)
+            std::memset(word(*a, *c, v + V_VISIBLE, 0), 0, c->m_count * 4);
+    }
+    for(auto it = m_inView.begin(); it != m_inView.end(); ++it)
+    {
+        Record const* r = find(*it);
+        if(!r)
+            continue;
+        Archetype const& a = m_archetypes[r->m_archetype];
+        Chunk const& c = a.m_chunks[r->m_chunk];
+        std::uint32_t const v = a.m_columnOf[EntitiesImpl::VISIBILITY];
+        if(v == EntitiesImpl::NONE)
+            continue;
+        glm::vec3 const p = worldPosition(a, c, r->m_row);
+        float const radius = LoadFloat(word(a, c, v + V_RADIUS, r->m_row));
+        if(m_viewRange > 0.f)
+        {
+            glm::vec3 d = p - m_viewer;
+            float reach = m_viewRange + radius;
+            if(glm::dot(d, d) > reach * reach)
+                continue;
+        }
+        // The grid tests the sphere's box; keep the result the same as
+        // without a grid.
+        if(!m_frustum.Intersects(p, radius))
+            continue;
+        StoreWord(word(a, c, v + V_VISIBLE, r->m_row), 1);
+    }
+}
+
+void EntitiesImpl::updateVisibility()
+{
+    // The grid isn't thread-safe, so both of these stay on this thread.
+    if(m_grid.IsValid())
+    {
+        syncGrid();
+        if(m_hasFrustum)
+        {
+            cullWithGrid();
+            return;
+        }
+    }
+
+    std::vector<ChunkRef> chunks;
+    for(std::uint32_t a = 0; a < m_archetypes.size(); ++a)
+    {
+        if(!(m_archetypes[a].m_mask & Bit(EntitiesImpl::VISIBILITY)))
+            continue;
+        for(std::uint32_t c = 0; c < m_archetypes[a].m_chunks.size(); ++c)
+            chunks.push_back(ChunkRef{a, c});
+    }
+    // Everything here is plain data, so chunks can go to the pool.
+    ParallelFor(chunks.size(), 4, [this, &chunks](std::size_t begin, std::size_t end) {
+        for(std::size_t i = begin; i < end; ++i)
+        {
+            Archetype const& a = m_archetypes[chunks[i].m_archetype];
+            Chunk const& c = a.m_chunks[chunks[i].m_chunk];
+            std::uint32_t const v = a.m_columnOf[EntitiesImpl::VISIBILITY];
+            for(std::uint32_t row = 0; row < c.m_count; ++row)
+            {
+                bool visible = true;
+                if(m_viewRange > 0.f || m_hasFrustum)
+                {
+                    glm::vec3 p = worldPosition(a, c, row);
+                    float radius = LoadFloat(word(a, c, v + V_RADIUS, row));
+                    if(m_viewRange > 0.f)
+                    {
+                        glm::vec3 d = p - m_viewer;
+                        float reach = m_viewRange + radius;
+                        visible = glm::dot(d, d) <= reach * reach;
+                    }
+                    if(visible && m_hasFrustum)
+                        visible = m_frustum.Intersects(p, radius);
+                }
+                StoreWord(word(a, c, v + V_VISIBLE, row), visible ? 1 : 0);
+            }
+        }
+    });
+}
+
+void EntitiesImpl::Update()
+{
+    syncTransforms();
+    syncEmitters();
+    updateVisibility();
+    for(auto a = m_archetypes.begin(); a != m_archetypes.end(); ++a)
+    {
+        std::uint32_t const t = a->m_columnOf[EntitiesImpl::TRANSFORM];
+        if(t == EntitiesImpl::NONE)
+            continue;
+        for(auto c = a->m_chunks.begin(); c != a->m_chunks.end(); ++c)
+            std::memset(word(*a, *c, t + T_DIRTY, 0), 0, c->m_count * 4);
+    }
+}
+
+int EntitiesImpl::Each(lua_State* s)
+{
+    std::uint64_t mask = 0;
+    if(lua_type(s, 2) == LUA_TSTRING)
+    {
+        std::uint32_t c = componentOf(lua_tostring(s, 2));
+        if(c == EntitiesImpl::NONE)
+        {
+            lua_pushstring(s, "Unknown component");
+            return -1;
+        }
+        mask = Bit(c);
+    }
+    else if(lua_type(s, 2) == LUA_TTABLE)
+    {
+        std::size_t n = lua_rawlen(s, 2);
+        for(std::size_t i = 1; i <= n; ++i)
+        {
+            lua_rawgeti(s, 2, static_cast<lua_Integer>(i));
+            std::uint32_t c = (lua_type(s, -1) == LUA_TSTRING) ? componentOf(lua_tostring(s, -1)) : EntitiesImpl::NONE;
+            lua_pop(s, 1);
+            if(c == EntitiesImpl::NONE)
+            {
+                lua_pushstring(s, "Unknown component");
+                return -1;
+            }
+            mask |= Bit(c);
+        }
+    }
+    if(mask == 0 || lua_type(s, 3) != LUA_TFUNCTION)
+    {
+        lua_pushstring(s, "Each expects a component name or list and a function");
+        return -1;
+    }
+
+    // Structural changes are queued meanwhile, so archetypes and their
+    // chunks stay put; Create() only touches the empty archetype, which a
+    // non-empty mask never matches.
+    ++m_iterating;
+    bool ok = true;
+    for(std::size_t ai = 0; ok && ai < m_archetypes.size(); ++ai)
+    {
+        if((m_archetypes[ai].m_mask & mask) != mask)
+            continue;
+        for(std::size_t ci = 0; ok && ci < m_archetypes[ai].m_chunks.size(); ++ci)
+        {
+            for(std::uint32_t row = 0; row < m_archetypes[ai].m_chunks[ci].m_count; ++row)
+            {
+                Archetype const& a = m_archetypes[ai];
+                lua_pushvalue(s, 3);
+                lua_pushinteger(s, static_cast<lua_Integer>(LoadWord(word(a, a.m_chunks[ci], 0, row))));
+                if(lua_pcall(s, 1, 0, 0) != 0)
+                {
+                    ok = false;
+                    break;
+                }
+            }
+        }
+    }
+    if(--m_iterating == 0)
+        flushDeferred();
+    return ok ? 0 : -1;
+}
+
+}
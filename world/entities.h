@@ -0,0 +1,253 @@
+#ifndef LUAWORLD_ENTITIES_H
+#define LUAWORLD_ENTITIES_H
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "shared.h"
+#include "vector.h"
+#include "quat.h"
+#include "scene.h"
+#include "spatial.h"
+
+namespace LuaApi {
+    // Entity/component store.
+    // Entities with the same set of components share an archetype, whose
+    // rows live in fixed-size chunks with one column per component field.
+    // Every field is four bytes (float, int, bool, or an index into the
+    // store's handle tables for emitters and models), so rows move between
+    // archetypes with plain copies.
+    //
+    // Ids carry a generation, so a destroyed entity's id stays dead. While
+    // Each() is running, Destroy/Add/Remove are queued and applied when the
+    // outermost Each returns, as are setters that need a new component.
+    //
+    // Built-in components and what Update() does with them:
+    //   Transform  x y z qx qy qz qw sx sy sz dirty
+    //   Node       node      -- pushes dirty transforms into the Scene
+    //   Emitter    emitter   -- follows Node, else Transform
+    //   Model      model     -- keeps the model alive
+    //   Visibility radius visible -- range test against the viewer, plus the
+    //                                view frustum if one is set
+    //
+    // With a SpatialGrid attached, every Visibility entity is kept in it as
+    // a sphere keyed by entity id, refreshed when it moves, and frustum
+    // culling becomes a grid query instead of a test per entity.
+    class EntitiesImpl {
+    public:
+        typedef std::uint32_t EntityId;
+        enum FieldType {
+            FIELD_FLOAT,
+            FIELD_INT,
+            FIELD_BOOL,
+            FIELD_EMITTER,
+            FIELD_MODEL
+        };
+        enum {
+            MAX_COMPONENTS = 64,
+            CHUNK_BYTES = 16 * 1024,
+            INDEX_BITS = 20
+        };
+        enum : std::uint32_t {
+            INDEX_MASK = (1u << INDEX_BITS) - 1,
+            NONE = 0xFFFFFFFF
+        };
+        enum BuiltIn {
+            TRANSFORM,
+            NODE,
+            EMITTER,
+            MODEL,
+            VISIBILITY,
+            BUILTIN_COUNT
+        };
+    private:
+        struct Field {
+            std::string m_name;
+            FieldType m_type;
+            std::uint32_t m_default;
+        };
+        struct Component {
+            std::string m_name;
+            std::vector<Field> m_fields;
+        };
+        struct Chunk {
+            std::unique_ptr<unsigned char[]> m_data;
+            std::uint32_t m_count;
+        };
+        struct Archetype {
+            std::uint64_t m_mask;
+            std::uint32_t m_capacity;
+            std::uint32_t m_columns;
+            // First column of each component, NONE if absent. Column 0 holds
+            // the entity ids.
+            std::uint32_t m_columnOf[MAX_COMPONENTS];
+            std::vector<Chunk> m_chunks;
+        };
+        struct Record {
+            std::uint32_t m_archetype;
+            std::uint32_t m_chunk;
+            std::uint32_t m_row;
+            std::uint32_t m_generation;
+            bool m_alive;
+        };
+        struct Deferred {
+            enum Op { DESTROY, ADD, REMOVE, WRITE } m_op;
+            EntityId m_id;
+            std::uint32_t m_component;
+            // WRITE only
+            std::uint32_t m_field;
+            std::uint32_t m_count;
+            std::uint32_t m_words[4];
+        };
+        // Handles kept alive by handle fields; slot 0 means none.
+        template <typename H>
+        struct HandleTable {
+            std::vector<H> m_items;
+            std::vector<std::uint32_t> m_free;
+
+            std::uint32_t Add(H);
+            void Release(std::uint32_t);
+            H const* Get(std::uint32_t) const;
+        };
+
+        std::vector<Component> m_components;
+        std::unordered_map<std::string, std::uint32_t> m_componentIds;
+        std::vector<Archetype> m_archetypes;
+        std::unordered_map<std::uint64_t, std::uint32_t> m_archetypeIds;
+        std::vector<Record> m_records;
+        std::vector<std::uint32_t> m_freeRecords;
+        std::size_t m_alive;
+
+        HandleTable<SoundEmitter> m_emitters;
+        HandleTable<Model> m_models;
+        Scene m_scene;
+        glm::vec3 m_viewer;
+        float m_viewRange;
+        SpatialGrid m_grid;
+        Frustum m_frustum;
+        bool m_hasFrustum;
+        std::vector<SpatialGridImpl::Key> m_inView;
+
+        int m_iterating;
+        std::vector<Deferred> m_deferred;
+
+        std::uint32_t registerComponent(std::string const&, std::vector<Field>);
+        std::uint32_t componentOf(std::string const&) const;
+        std::uint32_t fieldOf(std::uint32_t component, std::string const&) const;
+        std::uint32_t archetypeFor(std::uint64_t);
+        Record const* find(EntityId) const;
+        bool locate(EntityId, std::uint32_t component, std::uint32_t field, unsigned char*& word, FieldType& type);
+        static unsigned char* word(Archetype const&, Chunk const&, std::uint32_t column, std::uint32_t row);
+        void placeRow(std::uint32_t archetype, EntityId);
+        void removeRow(std::uint32_t archetype, std::uint32_t chunk, std::uint32_t row);
+        void releaseHandles(Archetype const&, Chunk const&, std::uint32_t row, std::uint64_t components);
+        void releaseSlot(FieldType, std::uint32_t slot);
+        bool move(EntityId, std::uint64_t mask);
+        bool ensure(EntityId, std::uint32_t component);
+        bool write(EntityId, std::uint32_t component, std::uint32_t field, std::uint32_t const* words, std::uint32_t count);
+        void written(EntityId, std::uint32_t component);
+        bool markDirty(EntityId);
+        bool maskOf(Lua::Array<std::string> const&, std::uint64_t&) const;
+        void flushDeferred();
+
+        void syncTransforms();
+        void syncEmitters();
+        void updateVisibility();
+        void syncGrid();
+        void cullWithGrid();
+        glm::vec3 worldPosition(Archetype const&, Chunk const&, std::uint32_t row) const;
+    public:
+        EntitiesImpl();
+        EntitiesImpl(EntitiesImpl const&) =delete;
+        EntitiesImpl& operator= (EntitiesImpl const&) =delete;
+
+        // Field specs are "name" (float) or "name:float|int|bool".
+        bool RegisterComponent(std::string const&, Lua::Array<std::string> const&);
+        bool HasComponentType(std::string const&) const;
+
+        EntityId Create();
+        bool Destroy(EntityId);
+        bool IsAlive(EntityId) const;
+        std::size_t Count() const;
+        std::size_t CountWith(Lua::Array<std::string> const&) const;
+
+        bool Add(EntityId, std::string const&);
+        bool Remove(EntityId, std::string const&);
+        bool Has(EntityId, std::string const&) const;
+        bool Set(EntityId, std::string const&, std::string const&, double);
+        double Get(EntityId, std::string const&, std::string const&);
+
+        bool SetPosition(EntityId, float, float, float);
+        FixedReturn<float, 3> Position(EntityId) const;
+        bool SetRotation(EntityId, Quat);
+        bool SetScale(EntityId, Vec3);
+        bool SetNode(EntityId, std::uint32_t);
+        bool SetEmitter(EntityId, SoundEmitter);
+        bool SetModel(EntityId, Model);
+        bool SetVisibility(EntityId, float);
+        bool IsVisible(EntityId);
+
+        void SetScene(Scene);
+        void SetViewer(float, float, float, float);
+        void SetViewFrustum(Mat4);
+        void ClearViewFrustum();
+        // Entries are not moved over from a previous grid.
+        void SetSpatialGrid(SpatialGrid);
+
+        // Runs the built-in systems: transform, audio sync, visibility.
+        void Update();
+
+        // Each(component | {components}, function(id) end)
+        int Each(lua_State*);
+    };
+
+    typedef RefCounted<EntitiesImpl> Entities;
+}
+
+template <> struct MetatableDescriptor<LuaApi::EntitiesImpl> {
+    static char const* name() { return "entities_mt"; }
+    static char const* luaname() { return "Entities"; }
+    static char const* constructor() { return "New"; }
+    static bool construct(LuaApi::EntitiesImpl* v) { return Lua::DefaultConstructor(v); }
+    static void metatable(Lua::member_function_storage<LuaApi::EntitiesImpl>& mt) {
+#define REG_FNC(name) mt[ #name ] = Lua::Transform(&LuaApi::EntitiesImpl::name)
+        REG_FNC(RegisterComponent);
+        REG_FNC(HasComponentType);
+        REG_FNC(Create);
+        REG_FNC(Destroy);
+        REG_FNC(IsAlive);
+        REG_FNC(Count);
+        REG_FNC(CountWith);
+        REG_FNC(Add);
+        REG_FNC(Remove);
+        REG_FNC(Has);
+        REG_FNC(Set);
+        REG_FNC(Get);
+        REG_FNC(SetPosition);
+        mt["Position"] = LuaApi::PushFixed(&LuaApi::EntitiesImpl::Position);
+        REG_FNC(SetRotation);
+        REG_FNC(SetScale);
+        REG_FNC(SetNode);
+        REG_FNC(SetEmitter);
+        REG_FNC(SetModel);
+        REG_FNC(SetVisibility);
+        REG_FNC(IsVisible);
+        REG_FNC(SetScene);
+        REG_FNC(SetViewer);
+        REG_FNC(SetViewFrustum);
+        REG_FNC(ClearViewFrustum);
+        REG_FNC(SetSpatialGrid);
+        REG_FNC(Update);
+#undef REG_FNC
+    }
+    static void direct(LuaApi::DirectMethods<LuaApi::EntitiesImpl>& dm) {
+        dm.Add("IsAlive", &LuaApi::EntitiesImpl::IsAlive);
+        dm.Add("Set", &LuaApi::EntitiesImpl::Set);
+        dm.Add("Get", &LuaApi::EntitiesImpl::Get);
+        dm.Add("SetPosition", &LuaApi::EntitiesImpl::SetPosition);
+        dm.Add("Position", &LuaApi::EntitiesImpl::Position);
+        dm.Add("IsVisible", &LuaApi::EntitiesImpl::IsVisible);
+        dm.AddRaw("Each", &LuaApi::EntitiesImpl::Each);
+    }
+};
+
+#endif
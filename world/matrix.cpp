@@ -0,0 +1,94 @@
+#include "matrix.h"
+#include "simd.h"
+
+namespace LuaApi {
+
+glm::mat4 ComposeTRS(glm::vec3 const& t, glm::quat const& r, glm::vec3 const& s)
+{
+    glm::mat3 rot = glm::mat3_cast(r);
+    return glm::mat4(glm::vec4(rot[0] * s.x, 0.f),
+                     glm::vec4(rot[1] * s.y, 0.f),
+                     glm::vec4(rot[2] * s.z, 0.f),
+                     glm::vec4(t, 1.f));
+}
+
+void DecomposeTRS(glm::mat4 const& m, glm::vec3& t, glm::quat& r, glm::vec3& s)
+{
+    t = glm::vec3(m[3]);
+    glm::vec3 axes[3] = { glm::vec3(m[0]), glm::vec3(m[1]), glm::vec3(m[2]) };
+    for(int i = 0; i < 3; ++i)
+    {
+        s[i] = glm::length(axes[i]);
+        if(s[i] > 0.f)
+            axes[i] /= s[i];
+    }
+    if(glm::dot(glm::cross(axes[0], axes[1]), axes[2]) < 0.f)
+    {
+        s.x = -s.x;
+        axes[0] = -axes[0];
+    }
+    r = glm::normalize(glm::quat_cast(glm::mat3(axes[0], axes[1], axes[2])));
+}
+
+Mat4::Mat4() : m_m(1.f) {}
+Mat4::Mat4(glm::mat4 const& m) : m_m(m) {}
+
+glm::mat4 const& Mat4::value() const { return m_m; }
+float const* Mat4::data() const { return glm::value_ptr(m_m); }
+
+void Mat4::SetIdentity() { m_m = glm::mat4(1.f); }
+void Mat4::SetTRS(Vec3 t, Quat r, Vec3 s) { m_m = ComposeTRS(t.value(), r.value(), s.value()); }
+void Mat4::SetTranslation(Vec3 t) { m_m = glm::translate(glm::mat4(1.f), t.value()); }
+void Mat4::SetRotation(Quat r) { m_m = glm::mat4_cast(r.value()); }
+void Mat4::SetScale(Vec3 s) { m_m = glm::scale(glm::mat4(1.f), s.value()); }
+void Mat4::SetPerspective(float fovy, float aspect, float zNear, float zFar) { m_m = glm::perspective(fovy, aspect, zNear, zFar); }
+void Mat4::SetOrtho(float left, float right, float bottom, float top, float zNear, float zFar) { m_m = glm::ortho(left, right, bottom, top, zNear, zFar); }
+void Mat4::SetLookAt(Vec3 eye, Vec3 center, Vec3 up) { m_m = glm::lookAt(eye.value(), center.value(), up.value()); }
+void Mat4::SetElement(std::size_t column, std::size_t row, float v)
+{
+    if(column < 4 && row < 4)
+        m_m[column][row] = v;
+}
+float Mat4::Element(std::size_t column, std::size_t row) const
+{
+    if(column < 4 && row < 4)
+        return m_m[column][row];
+    return 0.f;
+}
+FixedReturn<float, 16> Mat4::Unpack() const
+{
+    FixedReturn<float, 16> r;
+    float const* d = data();
+    for(std::size_t i = 0; i < 16; ++i)
+        r.m_values[i] = d[i];
+    return r;
+}
+
+Mat4 Mat4::Copy() const { return *this; }
+Mat4 Mat4::Mul(Mat4 o) const
+{
+    Mat4 r;
+    simd::MulMat4(data(), o.data(), glm::value_ptr(r.m_m));
+    return r;
+}
+Vec4 Mat4::MulVec4(Vec4 v) const
+{
+    glm::vec4 r;
+    simd::MulVec4(data(), glm::value_ptr(v.value()), glm::value_ptr(r));
+    return Vec4(r);
+}
+Vec3 Mat4::TransformPoint(Vec3 v) const
+{
+    glm::vec4 p(v.value(), 1.f);
+    glm::vec4 r;
+    simd::MulVec4(data(), glm::value_ptr(p), glm::value_ptr(r));
+    if(r.w != 0.f && r.w != 1.f)
+        return Vec3(glm::vec3(r) / r.w);
+    return Vec3(glm::vec3(r));
+}
+Vec3 Mat4::TransformDirection(Vec3 v) const { return Vec3(glm::mat3(m_m) * v.value()); }
+Mat4 Mat4::Inverse() const { return Mat4(glm::inverse(m_m)); }
+Mat4 Mat4::Transpose() const { return Mat4(glm::transpose(m_m)); }
+Vec3 Mat4::Translation() const { return Vec3(glm::vec3(m_m[3])); }
+
+}
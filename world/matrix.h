@@ -0,0 +1,76 @@
+#ifndef LUAWORLD_MATRIX_H
+#define LUAWORLD_MATRIX_H
+#include "shared.h"
+#include "vector.h"
+#include "quat.h"
+
+namespace LuaApi {
+    glm::mat4 ComposeTRS(glm::vec3 const& t, glm::quat const& r, glm::vec3 const& s);
+    // Shear is dropped; a mirrored basis comes back as a negative x scale.
+    void DecomposeTRS(glm::mat4 const&, glm::vec3& t, glm::quat& r, glm::vec3& s);
+    
+    // Column-major, like glm and GLSL. Products go through the SSE kernels
+    // in simd.h.
+    class Mat4 {
+        glm::mat4 m_m;
+    public:
+        Mat4();
+        explicit Mat4(glm::mat4 const&);
+        
+        glm::mat4 const& value() const;
+        float const* data() const;
+        
+        void SetIdentity();
+        void SetTRS(Vec3, Quat, Vec3);
+        void SetTranslation(Vec3);
+        void SetRotation(Quat);
+        void SetScale(Vec3);
+        void SetPerspective(float fovy, float aspect, float zNear, float zFar);
+        void SetOrtho(float left, float right, float bottom, float top, float zNear, float zFar);
+        void SetLookAt(Vec3, Vec3, Vec3);
+        void SetElement(std::size_t column, std::size_t row, float);
+        float Element(std::size_t column, std::size_t row) const;
+        FixedReturn<float, 16> Unpack() const;
+        
+        Mat4 Copy() const;
+        Mat4 Mul(Mat4) const;
+        Vec4 MulVec4(Vec4) const;
+        Vec3 TransformPoint(Vec3) const;
+        Vec3 TransformDirection(Vec3) const;
+        Mat4 Inverse() const;
+        Mat4 Transpose() const;
+        Vec3 Translation() const;
+    };
+}
+
+template <> struct MetatableDescriptor<LuaApi::Mat4> {
+    static char const* name() { return "mat4_mt"; }
+    static char const* luaname() { return "Mat4"; }
+    static char const* constructor() { return "New"; }
+    static bool construct(LuaApi::Mat4* v) { return Lua::DefaultConstructor(v); }
+    static void metatable(Lua::member_function_storage<LuaApi::Mat4>& mt) {
+#define REG_FNC(name) mt[ #name ] = Lua::Transform(&LuaApi::Mat4::name)
+        REG_FNC(SetIdentity);
+        REG_FNC(SetTRS);
+        REG_FNC(SetTranslation);
+        REG_FNC(SetRotation);
+        REG_FNC(SetScale);
+        REG_FNC(SetPerspective);
+        REG_FNC(SetOrtho);
+        REG_FNC(SetLookAt);
+        REG_FNC(SetElement);
+        REG_FNC(Element);
+        mt["Unpack"] = LuaApi::PushFixed(&LuaApi::Mat4::Unpack);
+        REG_FNC(Copy);
+        REG_FNC(Mul);
+        REG_FNC(MulVec4);
+        REG_FNC(TransformPoint);
+        REG_FNC(TransformDirection);
+        REG_FNC(Inverse);
+        REG_FNC(Transpose);
+        REG_FNC(Translation);
+#undef REG_FNC
+    }
+};
+
+#endif
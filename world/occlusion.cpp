@@ -0,0 +1,437 @@
+#include "occlusion.h"
+#include "simd.h"
+#include "../core/jobs.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define LUAWORLD_OCCLUSION_AVX2 1
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define LUAWORLD_OCCLUSION_SSE 1
+#endif
+
+namespace LuaApi {
+
+namespace {
+    float const g_empty = std::numeric_limits<float>::max();
+    float const g_minW = 1e-5f;
+
+    // Pixels x .. x + STEP - 1 of one row: depth = min(depth, z) where the
+    // pixel centre is inside all three edges.
+#if defined(LUAWORLD_OCCLUSION_AVX2)
+    int const STEP = 8;
+
+    inline void Span(float const (*edge)[3], float const* depth, float maxDepth, float* row, int x, float py)
+    {
+        __m256 const xs = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x) + 0.5f),
+                                        _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f));
+        __m256 const zero = _mm256_setzero_ps();
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for(int k = 0; k < 3; ++k)
+        {
+            __m256 e = _mm256_add_ps(_mm256_mul_ps(xs, _mm256_set1_ps(edge[k][0])),
+                                     _mm256_set1_ps(edge[k][1] * py + edge[k][2]));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(e, zero, _CMP_GE_OQ));
+        }
+        if(_mm256_movemask_ps(inside) == 0)
+            return;
+        __m256 z = _mm256_add_ps(_mm256_mul_ps(xs, _mm256_set1_ps(depth[0])),
+                                 _mm256_set1_ps(depth[1] * py + depth[2]));
+        z = _mm256_min_ps(z, _mm256_set1_ps(maxDepth));
+        __m256 const current = _mm256_loadu_ps(row + x);
+        _mm256_storeu_ps(row + x, _mm256_blendv_ps(current, _mm256_min_ps(current, z), inside));
+    }
+
+    // True if any of pixels x .. x + STEP - 1 is farther than z.
+    inline bool AnyFarther(float const* row, int x, float z)
+    {
+        __m256 farther = _mm256_cmp_ps(_mm256_loadu_ps(row + x), _mm256_set1_ps(z), _CMP_GT_OQ);
+        return _mm256_movemask_ps(farther) != 0;
+    }
+#elif defined(LUAWORLD_OCCLUSION_SSE)
+    int const STEP = 4;
+
+    inline void Span(float const (*edge)[3], float const* depth, float maxDepth, float* row, int x, float py)
+    {
+        __m128 const xs = _mm_add_ps(_mm_set1_ps(static_cast<float>(x) + 0.5f), _mm_setr_ps(0.f, 1.f, 2.f, 3.f));
+        __m128 const zero = _mm_setzero_ps();
+        __m128 inside = _mm_cmpeq_ps(zero, zero);
+        for(int k = 0; k < 3; ++k)
+        {
+            __m128 e = _mm_add_ps(_mm_mul_ps(xs, _mm_set1_ps(edge[k][0])),
+                                  _mm_set1_ps(edge[k][1] * py + edge[k][2]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(e, zero));
+        }
+        if(_mm_movemask_ps(inside) == 0)
+            return;
+        __m128 z = _mm_add_ps(_mm_mul_ps(xs, _mm_set1_ps(depth[0])),
+                              _mm_set1_ps(depth[1] * py + depth[2]));
+        z = _mm_min_ps(z, _mm_set1_ps(maxDepth));
+        __m128 const current = _mm_loadu_ps(row + x);
+        __m128 const nearer = _mm_min_ps(current, z);
+        _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, current)));
+    }
+
+    inline bool AnyFarther(float const* row, int x, float z)
+    {
+        return _mm_movemask_ps(_mm_cmpgt_ps(_mm_loadu_ps(row + x), _mm_set1_ps(z))) != 0;
+    }
+#else
+    int const STEP = 1;
+
+    inline void Span(float const (*edge)[3], float const* depth, float maxDepth, float* row, int x, float py)
+    {
+        float const px = static_cast<float>(x) + 0.5f;
+        for(int k = 0; k < 3; ++k)
+        {
+            if(edge[k][0] * px + edge[k][1] * py + edge[k][2] < 0.f)
+                return;
+        }
+        float z = std::min(depth[0] * px + depth[1] * py + depth[2], maxDepth);
+        row[x] = std::min(row[x], z);
+    }
+
+    inline bool AnyFarther(float const* row, int x, float z) { return row[x] > z; }
+#endif
+
+    // Edge from a to b; positive on its left, which is inside for a
+    // counter-clockwise triangle.
+    void Edge(glm::vec3 const& a, glm::vec3 const& b, float* out)
+    {
+        out[0] = a.y - b.y;
+        out[1] = b.x - a.x;
+        out[2] = -(out[0] * a.x + out[1] * a.y);
+    }
+}
+
+OcclusionBufferImpl::OcclusionBufferImpl() :
+    m_width(0),
+    m_height(0),
+    m_stride(0),
+    m_tilesX(0),
+    m_tilesY(0),
+    m_occluderCount(0),
+    m_viewProjection(1.f),
+    m_rendered(false),
+    m_drawnOccluders(0),
+    m_drawnTriangles(0),
+    m_tests(0),
+    m_occluded(0)
+{
+    SetResolution(256, 144);
+}
+
+void OcclusionBufferImpl::SetResolution(std::uint32_t width, std::uint32_t height)
+{
+    if(width == 0 || height == 0 || width > 4096 || height > 4096)
+        throw std::runtime_error("Occlusion buffer size must be within 1..4096");
+    m_width = static_cast<int>(width);
+    m_height = static_cast<int>(height);
+    m_tilesX = (m_width + OcclusionBufferImpl::TILE - 1) / OcclusionBufferImpl::TILE;
+    m_tilesY = (m_height + OcclusionBufferImpl::TILE - 1) / OcclusionBufferImpl::TILE;
+    // Whole tiles, so a SIMD step never reaches into the next tile.
+    m_stride = m_tilesX * OcclusionBufferImpl::TILE;
+    m_depth.assign(static_cast<std::size_t>(m_stride) * m_height, g_empty);
+    m_bins.assign(static_cast<std::size_t>(m_tilesX) * m_tilesY, std::vector<std::uint32_t>());
+    m_rendered = false;
+}
+
+std::uint32_t OcclusionBufferImpl::Width() const { return static_cast<std::uint32_t>(m_width); }
+std::uint32_t OcclusionBufferImpl::Height() const { return static_cast<std::uint32_t>(m_height); }
+
+OcclusionBufferImpl::OccluderId OcclusionBufferImpl::addOccluder(std::vector<glm::vec4> vertices, std::vector<std::uint32_t> indices)
+{
+    if(indices.empty() || indices.size() % 3 != 0)
+        throw std::runtime_error("Occluder indices must be non-empty triangles");
+    for(auto it = indices.begin(); it != indices.end(); ++it)
+    {
+        if(*it >= vertices.size())
+            throw std::runtime_error("Occluder index out of range");
+    }
+    OccluderId id;
+    if(!m_free.empty())
+    {
+        id = m_free.back();
+        m_free.pop_back();
+    }
+    else
+    {
+        m_occluders.push_back(Occluder());
+        id = static_cast<OccluderId>(m_occluders.size());
+    }
+    Occluder& o = m_occluders[id - 1];
+    o.m_vertices = std::move(vertices);
+    o.m_indices = std::move(indices);
+    o.m_world = glm::mat4(1.f);
+    o.m_bone = ModelBone();
+    o.m_used = true;
+    ++m_occluderCount;
+    return id;
+}
+
+OcclusionBufferImpl::Occluder* OcclusionBufferImpl::occluder(OccluderId id)
+{
+    if(id == 0 || id > m_occluders.size() || !m_occluders[id - 1].m_used)
+        return nullptr;
+    return &m_occluders[id - 1];
+}
+
+OcclusionBufferImpl::OccluderId OcclusionBufferImpl::AddOccluder(Vec3Array vertices, Lua::Array<std::uint32_t> const& indices)
+{
+    if(!vertices.IsValid())
+        throw std::runtime_error("AddOccluder needs a Vec3Array");
+    return addOccluder(vertices->points(), indices.m_data);
+}
+
+OcclusionBufferImpl::OccluderId OcclusionBufferImpl::AddOccluderBox(float minX, float minY, float minZ, float maxX, float maxY, float maxZ)
+{
+    // Corner i has max x if bit 0 is set, max y for bit 1, max z for bit 2.
+    std::vector<glm::vec4> corners;
+    for(int i = 0; i < 8; ++i)
+        corners.push_back(glm::vec4((i & 1) ? maxX : minX, (i & 2) ? maxY : minY, (i & 4) ? maxZ : minZ, 1.f));
+    // Counter-clockwise seen from outside.
+    static std::uint32_t const faces[] = {
+        0, 2, 3,  0, 3, 1,  // -z
+        4, 5, 7,  4, 7, 6,  // +z
+        0, 4, 6,  0, 6, 2,  // -x
+        1, 3, 7,  1, 7, 5,  // +x
+        0, 1, 5,  0, 5, 4,  // -y
+        2, 6, 7,  2, 7, 3   // +y
+    };
+    return addOccluder(std::move(corners), std::vector<std::uint32_t>(std::begin(faces), std::end(faces)));
+}
+
+bool OcclusionBufferImpl::SetOccluderWorld(OccluderId id, Mat4 world)
+{
+    Occluder* o = occluder(id);
+    if(!o)
+        return false;
+    o->m_world = world.value();
+    return true;
+}
+
+bool OcclusionBufferImpl::SetOccluderBone(OccluderId id, ModelBone bone)
+{
+    Occluder* o = occluder(id);
+    if(!o)
+        return false;
+    o->m_bone = std::move(bone);
+    return true;
+}
+
+bool OcclusionBufferImpl::RemoveOccluder(OccluderId id)
+{
+    Occluder* o = occluder(id);
+    if(!o)
+        return false;
+    *o = Occluder();
+    o->m_used = false;
+    m_free.push_back(id);
+    --m_occluderCount;
+    return true;
+}
+
+std::size_t OcclusionBufferImpl::OccluderCount() const { return m_occluderCount; }
+
+// Projects one clip-space triangle and bins it.
+void OcclusionBufferImpl::setup(glm::vec4 const& a, glm::vec4 const& b, glm::vec4 const& c)
+{
+    // Crossing the camera plane; skipping it only loses occlusion.
+    if(a.w < g_minW || b.w < g_minW || c.w < g_minW)
+        return;
+    float const w = static_cast<float>(m_width);
+    float const h = static_cast<float>(m_height);
+    glm::vec3 v[3];
+    glm::vec4 const* in[3] = { &a, &b, &c };
+    for(int i = 0; i < 3; ++i)
+    {
+        float inv = 1.f / in[i]->w;
+        v[i] = glm::vec3((in[i]->x * inv * 0.5f + 0.5f) * w,
+                         (in[i]->y * inv * 0.5f + 0.5f) * h,
+                         in[i]->z * inv);
+    }
+    // Twice the signed area; back faces and slivers are dropped.
+    float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+    if(!(area > 0.f))
+        return;
+
+    float minX = std::min(v[0].x, std::min(v[1].x, v[2].x));
+    float maxX = std::max(v[0].x, std::max(v[1].x, v[2].x));
+    float minY = std::min(v[0].y, std::min(v[1].y, v[2].y));
+    float maxY = std::max(v[0].y, std::max(v[1].y, v[2].y));
+    if(maxX < 0.f || maxY < 0.f || minX >= w || minY >= h)
+        return;
+
+    // Clamped before the cast: a vertex near the camera plane can project
+    // past the range of int.
+    Triangle t;
+    t.m_x0 = static_cast<int>(std::floor(std::max(0.f, minX)));
+    t.m_y0 = static_cast<int>(std::floor(std::max(0.f, minY)));
+    t.m_x1 = static_cast<int>(std::floor(std::min(w - 1.f, maxX)));
+    t.m_y1 = static_cast<int>(std::floor(std::min(h - 1.f, maxY)));
+    Edge(v[0], v[1], t.m_edge[0]);
+    Edge(v[1], v[2], t.m_edge[1]);
+    Edge(v[2], v[0], t.m_edge[2]);
+    // z is linear in screen space; weight each vertex by the edge facing it.
+    for(int k = 0; k < 3; ++k)
+        t.m_depth[k] = (t.m_edge[1][k] * v[0].z + t.m_edge[2][k] * v[1].z + t.m_edge[0][k] * v[2].z) / area;
+    // Farthest point of the triangle within the pixel, not its centre.
+    t.m_depth[2] += 0.5f * (std::fabs(t.m_depth[0]) + std::fabs(t.m_depth[1]));
+    t.m_maxDepth = std::max(v[0].z, std::max(v[1].z, v[2].z));
+
+    std::uint32_t const index = static_cast<std::uint32_t>(m_triangles.size());
+    m_triangles.push_back(t);
+    for(int ty = t.m_y0 / OcclusionBufferImpl::TILE; ty <= t.m_y1 / OcclusionBufferImpl::TILE; ++ty)
+        for(int tx = t.m_x0 / OcclusionBufferImpl::TILE; tx <= t.m_x1 / OcclusionBufferImpl::TILE; ++tx)
+            m_bins[ty * m_tilesX + tx].push_back(index);
+}
+
+void OcclusionBufferImpl::rasterizeTile(int tile)
+{
+    int const tx0 = (tile % m_tilesX) * OcclusionBufferImpl::TILE;
+    int const ty0 = (tile / m_tilesX) * OcclusionBufferImpl::TILE;
+    int const tx1 = tx0 + OcclusionBufferImpl::TILE - 1;
+    int const ty1 = std::min(ty0 + OcclusionBufferImpl::TILE, m_height) - 1;
+
+    std::vector<std::uint32_t> const& bin = m_bins[tile];
+    for(auto it = bin.begin(); it != bin.end(); ++it)
+    {
+        Triangle const& t = m_triangles[*it];
+        // Steps start on a multiple of STEP, and tiles are a whole number
+        // of steps wide, so the last step ends inside the tile.
+        int const x0 = std::max(t.m_x0, tx0) / STEP * STEP;
+        int const x1 = std::min(t.m_x1, tx1);
+        int const y0 = std::max(t.m_y0, ty0);
+        int const y1 = std::min(t.m_y1, ty1);
+        for(int y = y0; y <= y1; ++y)
+        {
+            float* row = &m_depth[static_cast<std::size_t>(y) * m_stride];
+            float const py = static_cast<float>(y) + 0.5f;
+            for(int x = x0; x <= x1; x += STEP)
+                Span(t.m_edge, t.m_depth, t.m_maxDepth, row, x, py);
+        }
+    }
+}
+
+std::size_t OcclusionBufferImpl::Render(Mat4 viewProjection)
+{
+    m_viewProjection = viewProjection.value();
+    std::fill(m_depth.begin(), m_depth.end(), g_empty);
+    for(auto it = m_bins.begin(); it != m_bins.end(); ++it)
+        it->clear();
+    m_triangles.clear();
+    m_drawnOccluders = 0;
+    m_tests = 0;
+    m_occluded = 0;
+
+    for(auto o = m_occluders.begin(); o != m_occluders.end(); ++o)
+    {
+        if(!o->m_used)
+            continue;
+        glm::mat4 const& world = o->m_bone.IsValid() ? o->m_bone->world() : o->m_world;
+        glm::mat4 mvp;
+        simd::MulMat4(glm::value_ptr(m_viewProjection), glm::value_ptr(world), glm::value_ptr(mvp));
+        m_clip.resize(o->m_vertices.size());
+        simd::TransformVec4Batch(glm::value_ptr(mvp), glm::value_ptr(o->m_vertices[0]),
+                                 glm::value_ptr(m_clip[0]), o->m_vertices.size());
+        std::size_t const before = m_triangles.size();
+        for(std::size_t i = 0; i + 2 < o->m_indices.size(); i += 3)
+            setup(m_clip[o->m_indices[i]], m_clip[o->m_indices[i + 1]], m_clip[o->m_indices[i + 2]]);
+        if(m_triangles.size() != before)
+            ++m_drawnOccluders;
+    }
+    m_drawnTriangles = static_cast<std::uint32_t>(m_triangles.size());
+
+    ParallelFor(m_bins.size(), 1, [this](std::size_t begin, std::size_t end) {
+        for(std::size_t tile = begin; tile < end; ++tile)
+            rasterizeTile(static_cast<int>(tile));
+    });
+    m_rendered = true;
+    return m_triangles.size();
+}
+
+bool OcclusionBufferImpl::visible(Aabb const& box, glm::mat4 const& world) const
+{
+    m_tests.fetch_add(1, std::memory_order_relaxed);
+    if(!m_rendered)
+        return true;
+    glm::mat4 mvp;
+    simd::MulMat4(glm::value_ptr(m_viewProjection), glm::value_ptr(world), glm::value_ptr(mvp));
+
+    float minX = g_empty, minY = g_empty, minZ = g_empty;
+    float maxX = -g_empty, maxY = -g_empty;
+    for(int i = 0; i < 8; ++i)
+    {
+        glm::vec4 corner((i & 1) ? box.m_max.x : box.m_min.x,
+                         (i & 2) ? box.m_max.y : box.m_min.y,
+                         (i & 4) ? box.m_max.z : box.m_min.z, 1.f);
+        glm::vec4 clip;
+        simd::MulVec4(glm::value_ptr(mvp), glm::value_ptr(corner), glm::value_ptr(clip));
+        // Reaches behind the camera.
+        if(clip.w < g_minW)
+            return true;
+        float inv = 1.f / clip.w;
+        float x = (clip.x * inv * 0.5f + 0.5f) * m_width;
+        float y = (clip.y * inv * 0.5f + 0.5f) * m_height;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        minZ = std::min(minZ, clip.z * inv);
+    }
+    // Off screen is the frustum test's business.
+    if(maxX < 0.f || maxY < 0.f || minX >= m_width || minY >= m_height)
+        return true;
+    // Clamped in float first, as in setup(); NaN ends up at the edges too.
+    int const x0 = static_cast<int>(std::floor(std::max(0.f, minX)));
+    int const x1 = static_cast<int>(std::floor(std::min(m_width - 1.f, maxX)));
+    int const y0 = static_cast<int>(std::floor(std::max(0.f, minY)));
+    int const y1 = static_cast<int>(std::floor(std::min(m_height - 1.f, maxY)));
+    for(int y = y0; y <= y1; ++y)
+    {
+        float const* row = &m_depth[static_cast<std::size_t>(y) * m_stride];
+        int x = x0;
+        for(; x <= x1 && x % STEP != 0; ++x)
+        {
+            if(row[x] > minZ)
+                return true;
+        }
+        for(; x + STEP - 1 <= x1; x += STEP)
+        {
+            if(AnyFarther(row, x, minZ))
+                return true;
+        }
+        for(; x <= x1; ++x)
+        {
+            if(row[x] > minZ)
+                return true;
+        }
+    }
+    m_occluded.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+bool OcclusionBufferImpl::TestBox(float minX, float minY, float minZ, float maxX, float maxY, float maxZ) const
+{
+    return visible(Aabb{glm::vec3(minX, minY, minZ), glm::vec3(maxX, maxY, maxZ)}, glm::mat4(1.f));
+}
+
+float OcclusionBufferImpl::Depth(std::uint32_t x, std::uint32_t y) const
+{
+    if(x >= static_cast<std::uint32_t>(m_width) || y >= static_cast<std::uint32_t>(m_height))
+        return 1.f;
+    float d = m_depth[static_cast<std::size_t>(y) * m_stride + x];
+    return (d == g_empty) ? 1.f : d;
+}
+
+FixedReturn<std::uint32_t, 4> OcclusionBufferImpl::Stats() const
+{
+    return ReturnFixed(m_drawnOccluders, m_drawnTriangles,
+                       m_tests.load(std::memory_order_relaxed),
+                       m_occluded.load(std::memory_order_relaxed));
+}
+
+}
@@ -0,0 +1,137 @@
+#ifndef LUAWORLD_OCCLUSION_H
+#define LUAWORLD_OCCLUSION_H
+#include <atomic>
+#include <vector>
+#include "shared.h"
+#include "bounds.h"
+#include "matrix.h"
+#include "batch.h"
+#include "../gl/objectbone.h"
+
+namespace LuaApi {
+    // Low-resolution software depth buffer for occlusion culling.
+    // Render() draws the occluder meshes: their triangles are transformed
+    // and binned into TILE x TILE pixel tiles on the calling thread, then
+    // the tiles are rasterised in parallel on the job system, eight pixels a
+    // step with AVX2, four with SSE. Afterwards visible() and TestBox() are
+    // read-only and may be called from jobs.
+    //
+    // Both sides err towards "visible": occluder triangles crossing the near
+    // plane are skipped, and each pixel stores the farthest depth the
+    // triangle reaches inside it. A box is occluded only if every pixel of
+    // its screen rectangle holds something nearer than the box's nearest
+    // corner.
+    //
+    // Occluders are closed, counter-clockwise, low-poly meshes (or boxes) in
+    // model space. Each is placed by SetOccluderWorld, or follows a bone.
+    class OcclusionBufferImpl {
+    public:
+        typedef std::uint32_t OccluderId;
+        enum {
+            TILE = 32,
+            // Row padding, so every SIMD step stays inside the buffer.
+            LANES = 8
+        };
+    private:
+        struct Occluder {
+            std::vector<glm::vec4> m_vertices;
+            std::vector<std::uint32_t> m_indices;
+            glm::mat4 m_world;
+            ModelBone m_bone;
+            bool m_used;
+        };
+        // Edge functions and depth plane in pixel coordinates.
+        struct Triangle {
+            float m_edge[3][3];
+            float m_depth[3];
+            float m_maxDepth;
+            int m_x0, m_y0, m_x1, m_y1;
+        };
+
+        int m_width;
+        int m_height;
+        int m_stride;
+        int m_tilesX;
+        int m_tilesY;
+        std::vector<float> m_depth;
+
+        std::vector<Occluder> m_occluders;
+        std::vector<OccluderId> m_free;
+        std::size_t m_occluderCount;
+
+        glm::mat4 m_viewProjection;
+        bool m_rendered;
+        std::vector<glm::vec4> m_clip;
+        std::vector<Triangle> m_triangles;
+        std::vector<std::vector<std::uint32_t>> m_bins;
+
+        std::uint32_t m_drawnOccluders;
+        std::uint32_t m_drawnTriangles;
+        mutable std::atomic<std::uint32_t> m_tests;
+        mutable std::atomic<std::uint32_t> m_occluded;
+
+        OccluderId addOccluder(std::vector<glm::vec4>, std::vector<std::uint32_t>);
+        Occluder* occluder(OccluderId);
+        void setup(glm::vec4 const&, glm::vec4 const&, glm::vec4 const&);
+        void rasterizeTile(int tile);
+    public:
+        OcclusionBufferImpl();
+        OcclusionBufferImpl(OcclusionBufferImpl const&) =delete;
+        OcclusionBufferImpl& operator= (OcclusionBufferImpl const&) =delete;
+
+        void SetResolution(std::uint32_t width, std::uint32_t height);
+        std::uint32_t Width() const;
+        std::uint32_t Height() const;
+
+        OccluderId AddOccluder(Vec3Array vertices, Lua::Array<std::uint32_t> const& indices);
+        OccluderId AddOccluderBox(float minX, float minY, float minZ, float maxX, float maxY, float maxZ);
+        bool SetOccluderWorld(OccluderId, Mat4);
+        // The bone's world matrix is read on every Render; nil stops following.
+        bool SetOccluderBone(OccluderId, ModelBone);
+        bool RemoveOccluder(OccluderId);
+        std::size_t OccluderCount() const;
+
+        // Number of triangles rasterised.
+        std::size_t Render(Mat4 viewProjection);
+        // Against the last Render; true before the first.
+        bool visible(Aabb const& box, glm::mat4 const& world) const;
+        bool TestBox(float minX, float minY, float minZ, float maxX, float maxY, float maxZ) const;
+        // NDC depth, 1 where nothing was drawn.
+        float Depth(std::uint32_t x, std::uint32_t y) const;
+
+        // Occluders and triangles drawn by the last Render, and the tests
+        // and occluded results since.
+        FixedReturn<std::uint32_t, 4> Stats() const;
+    };
+
+    typedef RefCounted<OcclusionBufferImpl> OcclusionBuffer;
+}
+
+template <> struct MetatableDescriptor<LuaApi::OcclusionBufferImpl> {
+    static char const* name() { return "occlusionbuffer_mt"; }
+    static char const* luaname() { return "OcclusionBuffer"; }
+    static char const* constructor() { return "New"; }
+    static bool construct(LuaApi::OcclusionBufferImpl* v) { return Lua::DefaultConstructor(v); }
+    static void metatable(Lua::member_function_storage<LuaApi::OcclusionBufferImpl>& mt) {
+#define REG_FNC(name) mt[ #name ] = Lua::Transform(&LuaApi::OcclusionBufferImpl::name)
+        REG_FNC(SetResolution);
+        REG_FNC(Width);
+        REG_FNC(Height);
+        REG_FNC(AddOccluder);
+        REG_FNC(AddOccluderBox);
+        REG_FNC(SetOccluderWorld);
+        REG_FNC(SetOccluderBone);
+        REG_FNC(RemoveOccluder);
+        REG_FNC(OccluderCount);
+        REG_FNC(Render);
+        REG_FNC(TestBox);
+        REG_FNC(Depth);
+        mt["Stats"] = LuaApi::PushFixed(&LuaApi::OcclusionBufferImpl::Stats);
+#undef REG_FNC
+    }
+    static void direct(LuaApi::DirectMethods<LuaApi::OcclusionBufferImpl>& dm) {
+        dm.Add("TestBox", &LuaApi::OcclusionBufferImpl::TestBox);
+    }
+};
+
+#endif
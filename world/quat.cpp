@@ -0,0 +1,42 @@
+#include "quat.h"
+
+namespace LuaApi {
+
+Quat::Quat() : m_q(1.f, 0.f, 0.f, 0.f) {}
+Quat::Quat(glm::quat const& q) : m_q(q) {}
+
+glm::quat const& Quat::value() const { return m_q; }
+
+void Quat::Set(float w, float x, float y, float z) { m_q = glm::quat(w, x, y, z); }
+void Quat::SetIdentity() { m_q = glm::quat(1.f, 0.f, 0.f, 0.f); }
+void Quat::SetAxisAngle(Vec3 axis, float radians)
+{
+    float len = glm::length(axis.value());
+    if(len <= 0.f)
+    {
+        SetIdentity();
+        return;
+    }
+    m_q = glm::angleAxis(radians, axis.value() / len);
+}
+void Quat::SetEuler(float pitch, float yaw, float roll) { m_q = glm::quat(glm::vec3(pitch, yaw, roll)); }
+void Quat::SetLookRotation(Vec3 forward, Vec3 up)
+{
+    // glm::lookAt builds a view matrix; its inverse rotation faces -Z
+    // along forward.
+    glm::mat3 view(glm::lookAt(glm::vec3(0.f), forward.value(), up.value()));
+    m_q = glm::quat_cast(glm::transpose(view));
+}
+FixedReturn<float, 4> Quat::Unpack() const { return ReturnFixed(m_q.w, m_q.x, m_q.y, m_q.z); }
+Vec3 Quat::Euler() const { return Vec3(glm::eulerAngles(m_q)); }
+
+Quat Quat::Copy() const { return *this; }
+Quat Quat::Mul(Quat o) const { return Quat(m_q * o.m_q); }
+Vec3 Quat::Rotate(Vec3 v) const { return Vec3(m_q * v.value()); }
+Quat Quat::Conjugate() const { return Quat(glm::conjugate(m_q)); }
+Quat Quat::Inverse() const { return Quat(glm::inverse(m_q)); }
+Quat Quat::Normalized() const { return Quat(glm::normalize(m_q)); }
+Quat Quat::Slerp(Quat o, float t) const { return Quat(glm::slerp(m_q, o.m_q, t)); }
+float Quat::Dot(Quat o) const { return glm::dot(m_q, o.m_q); }
+
+}
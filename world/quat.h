@@ -0,0 +1,60 @@
+#ifndef LUAWORLD_QUAT_H
+#define LUAWORLD_QUAT_H
+#include "shared.h"
+#include "vector.h"
+
+namespace LuaApi {
+    class Quat {
+        glm::quat m_q;
+    public:
+        Quat();
+        explicit Quat(glm::quat const&);
+        
+        glm::quat const& value() const;
+        
+        void Set(float w, float x, float y, float z);
+        void SetIdentity();
+        void SetAxisAngle(Vec3, float);
+        void SetEuler(float, float, float);
+        void SetLookRotation(Vec3, Vec3);
+        FixedReturn<float, 4> Unpack() const;
+        Vec3 Euler() const;
+        
+        Quat Copy() const;
+        Quat Mul(Quat) const;
+        Vec3 Rotate(Vec3) const;
+        Quat Conjugate() const;
+        Quat Inverse() const;
+        Quat Normalized() const;
+        Quat Slerp(Quat, float) const;
+        float Dot(Quat) const;
+    };
+}
+
+template <> struct MetatableDescriptor<LuaApi::Quat> {
+    static char const* name() { return "quat_mt"; }
+    static char const* luaname() { return "Quat"; }
+    static char const* constructor() { return "New"; }
+    static bool construct(LuaApi::Quat* v) { return Lua::DefaultConstructor(v); }
+    static void metatable(Lua::member_function_storage<LuaApi::Quat>& mt) {
+#define REG_FNC(name) mt[ #name ] = Lua::Transform(&LuaApi::Quat::name)
+        REG_FNC(Set);
+        REG_FNC(SetIdentity);
+        REG_FNC(SetAxisAngle);
+        REG_FNC(SetEuler);
+        REG_FNC(SetLookRotation);
+        mt["Unpack"] = LuaApi::PushFixed(&LuaApi::Quat::Unpack);
+        REG_FNC(Euler);
+        REG_FNC(Copy);
+        REG_FNC(Mul);
+        REG_FNC(Rotate);
+        REG_FNC(Conjugate);
+        REG_FNC(Inverse);
+        REG_FNC(Normalized);
+        REG_FNC(Slerp);
+        REG_FNC(Dot);
+#undef REG_FNC
+    }
+};
+
+#endif
@@ -0,0 +1,523 @@
+#include "scene.h"
+#include "simd.h"
+#include "../core/jobs.h"
+#include <algorithm>
+#include <atomic>
+
+namespace LuaApi {
+
+namespace {
+    template <typename T>
+    void Permute(std::vector<T>& v, std::vector<std::uint32_t> const& order)
+    {
+        std::vector<T> out;
+        out.reserve(order.size());
+        for(auto it = order.begin(); it != order.end(); ++it)
+            out.push_back(std::move(v[*it]));
+        v.swap(out);
+    }
+
+    template <typename T>
+    void EraseRange(std::vector<T>& v, std::uint32_t begin, std::uint32_t end)
+    {
+        v.erase(v.begin() + begin, v.begin() + end);
+    }
+
+    struct Range {
+        std::uint32_t m_begin;
+        std::uint32_t m_end;
+    };
+}
+
+SceneImpl::SceneImpl() :
+    m_orderStale(false)
+{
+}
+
+std::uint32_t SceneImpl::slotOf(NodeId id) const
+{
+    if(id == 0 || id > m_slot.size())
+        return SceneImpl::NO_SLOT;
+    return m_slot[id - 1];
+}
+
+SceneImpl::NodeId SceneImpl::allocate(std::uint32_t parentSlot)
+{
+    std::uint32_t slot = static_cast<std::uint32_t>(m_parent.size());
+    NodeId id = static_cast<NodeId>(m_slot.size() + 1);
+    m_slot.push_back(slot);
+
+    m_parent.push_back(parentSlot);
+    m_subtree.push_back(1);
+    m_translation.push_back(glm::vec3(0.f));
+    m_rotation.push_back(glm::quat(1.f, 0.f, 0.f, 0.f));
+    m_scale.push_back(glm::vec3(1.f));
+    m_world.push_back(glm::mat4(1.f));
+    m_dirty.push_back(1);
+    m_changed.push_back(0);
+    m_id.push_back(id);
+    m_name.emplace_back();
+
+    // A new root at the end is still in pre-order; a new child is not.
+    if(parentSlot != SceneImpl::NO_SLOT)
+        m_orderStale = true;
+    return id;
+}
+
+void SceneImpl::ensureOrder()
+{
+    if(!m_orderStale)
+        return;
+    m_orderStale = false;
+
+    std::uint32_t const n = static_cast<std::uint32_t>(m_parent.size());
+    std::vector<std::uint32_t> firstChild(n, SceneImpl::NO_SLOT);
+    std::vector<std::uint32_t> nextSibling(n, SceneImpl::NO_SLOT);
+    std::vector<std::uint32_t> roots;
+    // Walking backwards keeps siblings in their current order.
+    for(std::uint32_t i = n; i-- > 0; )
+    {
+        std::uint32_t p = m_parent[i];
+        if(p == SceneImpl::NO_SLOT)
+            roots.push_back(i);
+        else
+        {
+            nextSibling[i] = firstChild[p];
+            firstChild[p] = i;
+        }
+    }
+
+    std::vector<std::uint32_t> order;
+    order.reserve(n);
+    std::vector<std::uint32_t> stack(roots.begin(), roots.end());
+    while(!stack.empty())
+    {
+        std::uint32_t s = stack.back();
+        stack.pop_back();
+        order.push_back(s);
+        std::size_t mark = stack.size();
+        for(std::uint32_t c = firstChild[s]; c != SceneImpl::NO_SLOT; c = nextSibling[c])
+            stack.push_back(c);
+        std::reverse(stack.begin() + mark, stack.end());
+    }
+
+    std::vector<std::uint32_t> newSlot(n);
+    for(std::uint32_t i = 0; i < n; ++i)
+        newSlot[order[i]] = i;
+
+    Permute(m_parent, order);
+    Permute(m_translation, order);
+    Permute(m_rotation, order);
+    Permute(m_scale, order);
+    Permute(m_world, order);
+    Permute(m_dirty, order);
+    Permute(m_changed, order);
+    Permute(m_id, order);
+    Permute(m_name, order);
+
+    for(std::uint32_t i = 0; i < n; ++i)
+    {
+        if(m_parent[i] != SceneImpl::NO_SLOT)
+            m_parent[i] = newSlot[m_parent[i]];
+        m_slot[m_id[i] - 1] = i;
+        m_subtree[i] = 1;
+    }
+    for(std::uint32_t i = n; i-- > 0; )
+    {
+        if(m_parent[i] != SceneImpl::NO_SLOT)
+            m_subtree[m_parent[i]] += m_subtree[i];
+    }
+}
+
+SceneImpl::NodeId SceneImpl::CreateNode(Lua::Arg<NodeId> const& parent)
+{
+    std::uint32_t parentSlot = SceneImpl::NO_SLOT;
+    if(parent && *parent != 0)
+    {
+        parentSlot = slotOf(*parent);
+        if(parentSlot == SceneImpl::NO_SLOT)
+            return 0;
+    }
+    return allocate(parentSlot);
+}
+
+bool SceneImpl::DestroyNode(NodeId id)
+{
+    if(slotOf(id) == SceneImpl::NO_SLOT)
+        return false;
+    ensureOrder();
+    std::uint32_t const begin = slotOf(id);
+    std::uint32_t const size = m_subtree[begin];
+    std::uint32_t const end = begin + size;
+
+    for(std::uint32_t i = begin; i < end; ++i)
+        m_slot[m_id[i] - 1] = SceneImpl::NO_SLOT;
+    for(std::uint32_t p = m_parent[begin]; p != SceneImpl::NO_SLOT; p = m_parent[p])
+        m_subtree[p] -= size;
+
+    EraseRange(m_parent, begin, end);
+    EraseRange(m_subtree, begin, end);
+    EraseRange(m_translation, begin, end);
+    EraseRange(m_rotation, begin, end);
+    EraseRange(m_scale, begin, end);
+    EraseRange(m_world, begin, end);
+    EraseRange(m_dirty, begin, end);
+    EraseRange(m_changed, begin, end);
+    EraseRange(m_id, begin, end);
+    EraseRange(m_name, begin, end);
+
+    for(std::uint32_t i = begin; i < m_parent.size(); ++i)
+    {
+        if(m_parent[i] != SceneImpl::NO_SLOT && m_parent[i] >= end)
+            m_parent[i] -= size;
+        m_slot[m_id[i] - 1] = i;
+    }
+    dropDeadAttachments();
+    return true;
+}
+
+bool SceneImpl::IsNode(NodeId id) const { return slotOf(id) != SceneImpl::NO_SLOT; }
+std::size_t SceneImpl::NodeCount() const { return m_parent.size(); }
+
+bool SceneImpl::SetParent(NodeId id, NodeId parent)
+{
+    std::uint32_t s = slotOf(id);
+    if(s == SceneImpl::NO_SLOT)
+        return false;
+    std::uint32_t p = SceneImpl::NO_SLOT;
+    if(parent != 0)
+    {
+        p = slotOf(parent);
+        if(p == SceneImpl::NO_SLOT)
+            return false;
+        for(std::uint32_t a = p; a != SceneImpl::NO_SLOT; a = m_parent[a])
+        {
+            if(a == s)
+                return false;
+        }
+    }
+    if(m_parent[s] == p)
+        return true;
+    m_parent[s] = p;
+    m_dirty[s] = 1;
+    m_orderStale = true;
+    return true;
+}
+
+SceneImpl::NodeId SceneImpl::Parent(NodeId id) const
+{
+    std::uint32_t s = slotOf(id);
+    if(s == SceneImpl::NO_SLOT || m_parent[s] == SceneImpl::NO_SLOT)
+        return 0;
+    return m_id[m_parent[s]];
+}
+
+void SceneImpl::SetName(NodeId id, std::string const& name)
+{
+    std::uint32_t s = slotOf(id);
+    if(s != SceneImpl::NO_SLOT)
+        m_name[s] = name;
+}
+std::string SceneImpl::Name(NodeId id) const
+{
+    std::uint32_t s = slotOf(id);
+    return (s != SceneImpl::NO_SLOT) ? m_name[s] : std::string();
+}
+SceneImpl::NodeId SceneImpl::FindNode(std::string const& name) const
+{
+    auto it = std::find(m_name.begin(), m_name.end(), name);
+    if(it == m_name.end())
+        return 0;
+    return m_id[it - m_name.begin()];
+}
+
+void SceneImpl::SetTranslation(NodeId id, Vec3 v)
+{
+    std::uint32_t s = slotOf(id);
+    if(s == SceneImpl::NO_SLOT)
+        return;
+    m_translation[s] = v.value();
+    m_dirty[s] = 1;
+}
+void SceneImpl::SetTranslationXYZ(NodeId id, float x, float y, float z)
+{
+    std::uint32_t s = slotOf(id);
+    if(s == SceneImpl::NO_SLOT)
+        return;
+    m_translation[s] = glm::vec3(x, y, z);
+    m_dirty[s] = 1;
+}
+Vec3 SceneImpl::Translation(NodeId id) const
+{
+    std::uint32_t s = slotOf(id);
+    return (s != SceneImpl::NO_SLOT) ? Vec3(m_translation[s]) : Vec3();
+}
+void SceneImpl::SetRotation(NodeId id, Quat q)
+{
+    std::uint32_t s = slotOf(id);
+    if(s == SceneImpl::NO_SLOT)
+        return;
+    m_rotation[s] = q.value();
+    m_dirty[s] = 1;
+}
+Quat SceneImpl::Rotation(NodeId id) const
+{
+    std::uint32_t s = slotOf(id);
+    return (s != SceneImpl::NO_SLOT) ? Quat(m_rotation[s]) : Quat();
+}
+void SceneImpl::SetScale(NodeId id, Vec3 v)
+{
+    std::uint32_t s = slotOf(id);
+    if(s == SceneImpl::NO_SLOT)
+        return;
+    m_scale[s] = v.value();
+    m_dirty[s] = 1;
+}
+Vec3 SceneImpl::Scale(NodeId id) const
+{
+    std::uint32_t s = slotOf(id);
+    return (s != SceneImpl::NO_SLOT) ? Vec3(m_scale[s]) : Vec3(1.f, 1.f, 1.f);
+}
+void SceneImpl::SetLocal(NodeId id, Mat4 m)
+{
+    std::uint32_t s = slotOf(id);
+    if(s == SceneImpl::NO_SLOT)
+        return;
+    DecomposeTRS(m.value(), m_translation[s], m_rotation[s], m_scale[s]);
+    m_dirty[s] = 1;
+}
+Mat4 SceneImpl::Local(NodeId id) const
+{
+    std::uint32_t s = slotOf(id);
+    if(s == SceneImpl::NO_SLOT)
+        return Mat4();
+    return Mat4(ComposeTRS(m_translation[s], m_rotation[s], m_scale[s]));
+}
+
+glm::mat4 const* SceneImpl::world(NodeId id) const
+{
+    std::uint32_t s = slotOf(id);
+    return (s != SceneImpl::NO_SLOT) ? &m_world[s] : nullptr;
+}
+bool SceneImpl::changed(NodeId id) const
+{
+    std::uint32_t s = slotOf(id);
+    return s != SceneImpl::NO_SLOT && m_changed[s];
+}
+void SceneImpl::setLocal(NodeId id, glm::vec3 const& t, glm::quat const& r, glm::vec3 const& scale)
+{
+    std::uint32_t s = slotOf(id);
+    if(s == SceneImpl::NO_SLOT)
+        return;
+    m_translation[s] = t;
+    m_rotation[s] = r;
+    m_scale[s] = scale;
+    m_dirty[s] = 1;
+}
+Mat4 SceneImpl::World(NodeId id) const
+{
+    glm::mat4 const* m = world(id);
+    return m ? Mat4(*m) : Mat4();
+}
+FixedReturn<float, 3> SceneImpl::WorldPosition(NodeId id) const
+{
+    glm::mat4 const* m = world(id);
+    if(!m)
+        return ReturnFixed(0.f, 0.f, 0.f);
+    return ReturnFixed((*m)[3].x, (*m)[3].y, (*m)[3].z);
+}
+
+bool SceneImpl::updateNode(std::uint32_t i)
+{
+    std::uint32_t const p = m_parent[i];
+    bool const changed = m_dirty[i] || (p != SceneImpl::NO_SLOT && m_changed[p]);
+    m_changed[i] = changed ? 1 : 0;
+    m_dirty[i] = 0;
+    if(!changed)
+        return false;
+
+    glm::mat4 local = ComposeTRS(m_translation[i], m_rotation[i], m_scale[i]);
+    if(p == SceneImpl::NO_SLOT)
+        m_world[i] = local;
+    else
+        simd::MulMat4(glm::value_ptr(m_world[p]), glm::value_ptr(local), glm::value_ptr(m_world[i]));
+    return true;
+}
+
+std::size_t SceneImpl::updateRange(std::uint32_t begin, std::uint32_t end)
+{
+    std::size_t count = 0;
+    for(std::uint32_t i = begin; i < end; ++i)
+    {
+        if(updateNode(i))
+            ++count;
+    }
+    return count;
+}
+
+std::size_t SceneImpl::Update()
+{
+    ensureOrder();
+    std::uint32_t const n = static_cast<std::uint32_t>(m_parent.size());
+    std::size_t count = 0;
+    if(n <= SceneImpl::PARALLEL_GRAIN)
+        count = updateRange(0, n);
+    else
+    {
+        // Split oversized subtrees at their children, in pre-order, so the
+        // split roots come out parents first and the ranges can be merged
+        // with their neighbours.
+        std::vector<std::uint32_t> serial;
+        std::vector<Range> ranges;
+        std::vector<std::uint32_t> stack;
+        for(std::uint32_t r = 0; r < n; r += m_subtree[r])
+            stack.push_back(r);
+        std::reverse(stack.begin(), stack.end());
+        while(!stack.empty())
+        {
+            std::uint32_t s = stack.back();
+            stack.pop_back();
+            std::uint32_t const end = s + m_subtree[s];
+            if(m_subtree[s] <= SceneImpl::PARALLEL_GRAIN)
+            {
+                if(!ranges.empty() && ranges.back().m_end == s && end - ranges.back().m_begin <= SceneImpl::PARALLEL_GRAIN)
+                    ranges.back().m_end = end;
+                else
+                    ranges.push_back(Range{s, end});
+                continue;
+            }
+            serial.push_back(s);
+            std::size_t mark = stack.size();
+            for(std::uint32_t c = s + 1; c < end; c += m_subtree[c])
+                stack.push_back(c);
+            std::reverse(stack.begin() + mark, stack.end());
+        }
+
+        for(auto it = serial.begin(); it != serial.end(); ++it)
+        {
+            if(updateNode(*it))
+                ++count;
+        }
+        std::atomic<std::size_t> parallelCount(0);
+        ParallelFor(ranges.size(), 1, [this, &ranges, &parallelCount](std::size_t begin, std::size_t end) {
+            std::size_t local = 0;
+            for(std::size_t i = begin; i < end; ++i)
+                local += updateRange(ranges[i].m_begin, ranges[i].m_end);
+            parallelCount += local;
+        });
+        count += parallelCount;
+    }
+    pushAttachments();
+    return count;
+}
+
+void SceneImpl::pushAttachments()
+{
+    for(auto it = m_emitters.begin(); it != m_emitters.end(); ++it)
+    {
+        std::uint32_t s = slotOf(it->m_node);
+        if(s == SceneImpl::NO_SLOT || !m_changed[s])
+            continue;
+        glm::vec4 const& p = m_world[s][3];
+        it->m_emitter->setPosition(p.x, p.y, p.z);
+    }
+    for(auto it = m_models.begin(); it != m_models.end(); ++it)
+    {
+        std::vector<ModelBone> const& bones = it->m_model->bones();
+        std::size_t count = std::min(bones.size(), it->m_bones.size());
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            std::uint32_t s = slotOf(it->m_bones[i]);
+            if(s != SceneImpl::NO_SLOT && m_changed[s])
+                bones[i]->SetWorld(m_world[s]);
+        }
+    }
+}
+
+void SceneImpl::dropDeadAttachments()
+{
+    m_emitters.erase(std::remove_if(m_emitters.begin(), m_emitters.end(), [this](EmitterAttachment const& a) {
+        return slotOf(a.m_node) == SceneImpl::NO_SLOT;
+    }), m_emitters.end());
+    m_models.erase(std::remove_if(m_models.begin(), m_models.end(), [this](ModelAttachment const& a) {
+        return slotOf(a.m_node) == SceneImpl::NO_SLOT;
+    }), m_models.end());
+}
+
+bool SceneImpl::AttachModel(NodeId id, Model model)
+{
+    if(!model.IsValid() || slotOf(id) == SceneImpl::NO_SLOT)
+        return false;
+    DetachModel(model);
+
+    ModelAttachment a;
+    a.m_model = model;
+    a.m_node = id;
+
+    std::vector<ModelNode> const& nodes = model->nodes();
+    std::vector<NodeId> created(nodes.size(), 0);
+    for(std::size_t i = 0; i < nodes.size(); ++i)
+    {
+        ModelNode const& node = nodes[i];
+        bool const root = (node.m_parent == ModelImpl::NO_PARENT);
+        NodeId parent = root ? id : created[node.m_parent];
+        created[i] = allocate(slotOf(parent));
+        if(root)
+            a.m_roots.push_back(created[i]);
+        std::uint32_t s = slotOf(created[i]);
+        m_name[s] = node.m_name;
+        DecomposeTRS(node.m_transform, m_translation[s], m_rotation[s], m_scale[s]);
+    }
+
+    // Bones no node refers to stay on the attachment node.
+    a.m_bones.assign(model->bones().size(), 0);
+    for(std::size_t i = 0; i < nodes.size(); ++i)
+    {
+        for(auto mesh = nodes[i].m_meshes.begin(); mesh != nodes[i].m_meshes.end(); ++mesh)
+        {
+            if(*mesh < a.m_bones.size() && a.m_bones[*mesh] == 0)
+                a.m_bones[*mesh] = created[i];
+        }
+    }
+    for(auto it = a.m_bones.begin(); it != a.m_bones.end(); ++it)
+    {
+        if(*it == 0)
+            *it = id;
+    }
+    m_dirty[slotOf(id)] = 1;
+    m_models.push_back(std::move(a));
+    return true;
+}
+
+void SceneImpl::DetachModel(Model model)
+{
+    auto it = std::find_if(m_models.begin(), m_models.end(), [&model](ModelAttachment const& a) {
+        return a.m_model.TryGet() == model.TryGet();
+    });
+    if(it == m_models.end())
+        return;
+    std::vector<NodeId> roots;
+    roots.swap(it->m_roots);
+    m_models.erase(it);
+    for(auto r = roots.begin(); r != roots.end(); ++r)
+        DestroyNode(*r);
+}
+
+bool SceneImpl::AttachEmitter(NodeId id, SoundEmitter emitter)
+{
+    if(!emitter.IsValid() || slotOf(id) == SceneImpl::NO_SLOT)
+        return false;
+    DetachEmitter(emitter);
+    m_emitters.push_back(EmitterAttachment{emitter, id});
+    m_dirty[slotOf(id)] = 1;
+    return true;
+}
+
+void SceneImpl::DetachEmitter(SoundEmitter emitter)
+{
+    m_emitters.erase(std::remove_if(m_emitters.begin(), m_emitters.end(), [&emitter](EmitterAttachment const& a) {
+        return a.m_emitter.TryGet() == emitter.TryGet();
+    }), m_emitters.end());
+}
+
+}
@@ -0,0 +1,158 @@
+#ifndef LUAWORLD_SCENE_H
+#define LUAWORLD_SCENE_H
+#include <vector>
+#include "shared.h"
+#include "vector.h"
+#include "quat.h"
+#include "matrix.h"
+#include "../gl/object.h"
+#include "../al/emitter.h"
+
+namespace LuaApi {
+    // Transform hierarchy.
+    // Nodes are addressed by stable ids (0 is "no node") and stored as
+    // structure-of-arrays in depth-first pre-order, so every subtree is a
+    // contiguous run of slots behind its root. Structural edits only mark
+    // the order stale; it is rebuilt on the next Update or removal.
+    //
+    // Update() recomputes the world matrix of every node that was changed or
+    // sits below a changed node. Subtrees larger than PARALLEL_GRAIN are split
+    // at their children and the pieces run through ParallelFor; the ancestors
+    // left over from splitting are done first on the calling thread. Attached
+    // model bones and emitters are written afterwards, on the calling thread;
+    // ModelBone:Draw() hands a bone's matrix to shaders as g_model.
+    class SceneImpl {
+    public:
+        typedef std::uint32_t NodeId;
+        enum : std::uint32_t { NO_SLOT = 0xFFFFFFFF };
+        enum { PARALLEL_GRAIN = 256 };
+    private:
+        struct ModelAttachment {
+            Model m_model;
+            NodeId m_node;
+            // Scene nodes made for the model's root nodes, and the node each
+            // bone follows.
+            std::vector<NodeId> m_roots;
+            std::vector<NodeId> m_bones;
+        };
+        struct EmitterAttachment {
+            SoundEmitter m_emitter;
+            NodeId m_node;
+        };
+
+        // Per slot.
+        std::vector<std::uint32_t> m_parent;
+        std::vector<std::uint32_t> m_subtree;
+        std::vector<glm::vec3> m_translation;
+        std::vector<glm::quat> m_rotation;
+        std::vector<glm::vec3> m_scale;
+        std::vector<glm::mat4> m_world;
+        std::vector<std::uint8_t> m_dirty;
+        std::vector<std::uint8_t> m_changed;
+        std::vector<NodeId> m_id;
+        std::vector<std::string> m_name;
+
+        // Per id. Ids are not reused, so a stale id from a script can't
+        // address someone else's node.
+        std::vector<std::uint32_t> m_slot;
+        bool m_orderStale;
+
+        std::vector<ModelAttachment> m_models;
+        std::vector<EmitterAttachment> m_emitters;
+
+        std::uint32_t slotOf(NodeId) const;
+        NodeId allocate(std::uint32_t parentSlot);
+        void ensureOrder();
+        std::size_t updateRange(std::uint32_t begin, std::uint32_t end);
+        bool updateNode(std::uint32_t);
+        void pushAttachments();
+        void dropDeadAttachments();
+    public:
+        SceneImpl();
+
+        NodeId CreateNode(Lua::Arg<NodeId> const&);
+        bool DestroyNode(NodeId);
+        bool IsNode(NodeId) const;
+        std::size_t NodeCount() const;
+        bool SetParent(NodeId, NodeId);
+        NodeId Parent(NodeId) const;
+        void SetName(NodeId, std::string const&);
+        std::string Name(NodeId) const;
+        NodeId FindNode(std::string const&) const;
+
+        void SetTranslation(NodeId, Vec3);
+        void SetTranslationXYZ(NodeId, float, float, float);
+        Vec3 Translation(NodeId) const;
+        void SetRotation(NodeId, Quat);
+        Quat Rotation(NodeId) const;
+        void SetScale(NodeId, Vec3);
+        Vec3 Scale(NodeId) const;
+        void SetLocal(NodeId, Mat4);
+        Mat4 Local(NodeId) const;
+
+        // As of the last Update.
+        Mat4 World(NodeId) const;
+        FixedReturn<float, 3> WorldPosition(NodeId) const;
+        glm::mat4 const* world(NodeId) const;
+        // Whether the last Update recomputed the node.
+        bool changed(NodeId) const;
+        void setLocal(NodeId, glm::vec3 const&, glm::quat const&, glm::vec3 const&);
+
+        // Number of world matrices recomputed.
+        std::size_t Update();
+
+        // Builds the model's node hierarchy below the node; every bone then
+        // follows the scene node of the first model node that references it.
+        // Re-attaching a model moves it.
+        bool AttachModel(NodeId, Model);
+        void DetachModel(Model);
+        bool AttachEmitter(NodeId, SoundEmitter);
+        void DetachEmitter(SoundEmitter);
+    };
+
+    typedef RefCounted<SceneImpl> Scene;
+}
+
+template <> struct MetatableDescriptor<LuaApi::SceneImpl> {
+    static char const* name() { return "scene_mt"; }
+    static char const* luaname() { return "Scene"; }
+    static char const* constructor() { return "New"; }
+    static bool construct(LuaApi::SceneImpl* v) { return Lua::DefaultConstructor(v); }
+    static void metatable(Lua::member_function_storage<LuaApi::SceneImpl>& mt) {
+#define REG_FNC(name) mt[ #name ] = Lua::Transform(&LuaApi::SceneImpl::name)
+        REG_FNC(CreateNode);
+        REG_FNC(DestroyNode);
+        REG_FNC(IsNode);
+        REG_FNC(NodeCount);
+        REG_FNC(SetParent);
+        REG_FNC(Parent);
+        REG_FNC(SetName);
+        REG_FNC(Name);
+        REG_FNC(FindNode);
+        REG_FNC(SetTranslation);
+        REG_FNC(SetTranslationXYZ);
+        REG_FNC(Translation);
+        REG_FNC(SetRotation);
+        REG_FNC(Rotation);
+        REG_FNC(SetScale);
+        REG_FNC(Scale);
+        REG_FNC(SetLocal);
+        REG_FNC(Local);
+        REG_FNC(World);
+        mt["WorldPosition"] = LuaApi::PushFixed(&LuaApi::SceneImpl::WorldPosition);
+        REG_FNC(Update);
+        REG_FNC(AttachModel);
+        REG_FNC(DetachModel);
+        REG_FNC(AttachEmitter);
+        REG_FNC(DetachEmitter);
+#undef REG_FNC
+    }
+    static void direct(LuaApi::DirectMethods<LuaApi::SceneImpl>& dm) {
+        dm.Add("IsNode", &LuaApi::SceneImpl::IsNode);
+        dm.Add("SetTranslationXYZ", &LuaApi::SceneImpl::SetTranslationXYZ);
+        dm.Add("WorldPosition", &LuaApi::SceneImpl::WorldPosition);
+        dm.Add("Update", &LuaApi::SceneImpl::Update);
+    }
+};
+
+#endif
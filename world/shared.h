@@ -0,0 +1,12 @@
+#ifndef LUAWORLD_SHARED_H
+#define LUAWORLD_SHARED_H
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include "state.h"
+#include "library.h"
+#include "../shared.h"
+#include "../core/binding.h"
+
+#endif
@@ -0,0 +1,355 @@
+#include "simd.h"
+#include <cmath>
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define LUAWORLD_SSE 1
+#endif
+
+namespace LuaApi {
+namespace simd {
+
+namespace {
+    inline std::uint8_t CullSphere(float const* planes, float x, float y, float z, float r)
+    {
+        for(int p = 0; p < 6; ++p)
+        {
+            float const* plane = planes + p * 4;
+            if(plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < -r)
+                return 0;
+        }
+        return 1;
+    }
+    
+    inline void BlendPose(float const* a, float const* b, float const* t, float* out,
+                          std::size_t i, std::size_t stride)
+    {
+        float const tt = t[i], tr = t[stride + i], ts = t[2 * stride + i];
+        for(int c = 0; c < 3; ++c)
+        {
+            std::size_t k = c * stride + i;
+            out[k] = a[k] + (b[k] - a[k]) * tt;
+        }
+        for(int c = 7; c < 10; ++c)
+        {
+            std::size_t k = c * stride + i;
+            out[k] = a[k] + (b[k] - a[k]) * ts;
+        }
+        float dot = 0.f;
+        for(int c = 3; c < 7; ++c)
+            dot += a[c * stride + i] * b[c * stride + i];
+        float const wb = dot < 0.f ? -tr : tr;
+        float q[4], len = 0.f;
+        for(int c = 0; c < 4; ++c)
+        {
+            std::size_t k = (3 + c) * stride + i;
+            q[c] = a[k] * (1.f - tr) + b[k] * wb;
+            len += q[c] * q[c];
+        }
+        float const inv = len > 0.f ? 1.f / std::sqrt(len) : 0.f;
+        for(int c = 0; c < 4; ++c)
+            out[(3 + c) * stride + i] = q[c] * inv;
+    }
+    
+    inline void ComposePose(float const* p, std::size_t i, std::size_t stride, float* m)
+    {
+        float const x = p[3 * stride + i], y = p[4 * stride + i], z = p[5 * stride + i], w = p[6 * stride + i];
+        float const sx = p[7 * stride + i], sy = p[8 * stride + i], sz = p[9 * stride + i];
+        m[0] = (1.f - 2.f * (y * y + z * z)) * sx;
+        m[1] = 2.f * (x * y + w * z) * sx;
+        m[2] = 2.f * (x * z - w * y) * sx;
+        m[3] = 0.f;
+        m[4] = 2.f * (x * y - w * z) * sy;
+        m[5] = (1.f - 2.f * (x * x + z * z)) * sy;
+        m[6] = 2.f * (y * z + w * x) * sy;
+        m[7] = 0.f;
+        m[8] = 2.f * (x * z + w * y) * sz;
+        m[9] = 2.f * (y * z - w * x) * sz;
+        m[10] = (1.f - 2.f * (x * x + y * y)) * sz;
+        m[11] = 0.f;
+        m[12] = p[i];
+        m[13] = p[stride + i];
+        m[14] = p[2 * stride + i];
+        m[15] = 1.f;
+    }
+}
+
+#ifdef LUAWORLD_SSE
+namespace {
+    // Column c of the result is a * b.col(c): a linear combination of a's
+    // columns weighted by b's components.
+    inline __m128 Combine(__m128 const* cols, float const* v)
+    {
+        __m128 r = _mm_mul_ps(cols[0], _mm_set1_ps(v[0]));
+        r = _mm_add_ps(r, _mm_mul_ps(cols[1], _mm_set1_ps(v[1])));
+        r = _mm_add_ps(r, _mm_mul_ps(cols[2], _mm_set1_ps(v[2])));
+        r = _mm_add_ps(r, _mm_mul_ps(cols[3], _mm_set1_ps(v[3])));
+        return r;
+    }
+    
+    inline void Load(float const* m, __m128* cols)
+    {
+        cols[0] = _mm_loadu_ps(m);
+        cols[1] = _mm_loadu_ps(m + 4);
+        cols[2] = _mm_loadu_ps(m + 8);
+        cols[3] = _mm_loadu_ps(m + 12);
+    }
+    
+    inline void Mul(__m128 const* a, float const* b, float* out)
+    {
+        // Computed fully before storing, so out may alias b.
+        __m128 c0 = Combine(a, b);
+        __m128 c1 = Combine(a, b + 4);
+        __m128 c2 = Combine(a, b + 8);
+        __m128 c3 = Combine(a, b + 12);
+        _mm_storeu_ps(out, c0);
+        _mm_storeu_ps(out + 4, c1);
+        _mm_storeu_ps(out + 8, c2);
+        _mm_storeu_ps(out + 12, c3);
+    }
+}
+
+void MulMat4(float const* a, float const* b, float* out)
+{
+    __m128 cols[4];
+    Load(a, cols);
+    Mul(cols, b, out);
+}
+
+void MulVec4(float const* m, float const* v, float* out)
+{
+    __m128 cols[4];
+    Load(m, cols);
+    _mm_storeu_ps(out, Combine(cols, v));
+}
+
+void MulMat4Batch(float const* a, float const* b, float* out, std::size_t count)
+{
+    __m128 cols[4];
+    Load(a, cols);
+    for(std::size_t i = 0; i < count; ++i)
+        Mul(cols, b + i * 16, out + i * 16);
+}
+
+void MulMat4Pairs(float const* a, float const* b, float* out, std::size_t count)
+{
+    __m128 cols[4];
+    for(std::size_t i = 0; i < count; ++i)
+    {
+        Load(a + i * 16, cols);
+        Mul(cols, b + i * 16, out + i * 16);
+    }
+}
+
+void TransformVec4Batch(float const* m, float const* in, float* out, std::size_t count)
+{
+    __m128 cols[4];
+    Load(m, cols);
+    for(std::size_t i = 0; i < count; ++i)
+        _mm_storeu_ps(out + i * 4, Combine(cols, in + i * 4));
+}
+
+std::size_t CullSpheres(float const* planes, float const* x, float const* y, float const* z,
+                        float const* radius, std::size_t count, std::uint8_t* visible)
+{
+    // Four spheres per iteration against one plane at a time.
+    std::size_t drawn = 0;
+    std::size_t i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        __m128 const px = _mm_loadu_ps(x + i);
+        __m128 const py = _mm_loadu_ps(y + i);
+        __m128 const pz = _mm_loadu_ps(z + i);
+        __m128 const negR = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+        __m128 outside = _mm_setzero_ps();
+        for(int p = 0; p < 6; ++p)
+        {
+            float const* plane = planes + p * 4;
+            __m128 d = _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(plane[0])), _mm_set1_ps(plane[3]));
+            d = _mm_add_ps(d, _mm_mul_ps(py, _mm_set1_ps(plane[1])));
+            d = _mm_add_ps(d, _mm_mul_ps(pz, _mm_set1_ps(plane[2])));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(d, negR));
+        }
+        int const mask = _mm_movemask_ps(outside);
+        for(int k = 0; k < 4; ++k)
+        {
+            std::uint8_t v = (mask >> k) & 1 ? 0 : 1;
+            visible[i + k] = v;
+            drawn += v;
+        }
+    }
+    for(; i < count; ++i)
+    {
+        visible[i] = CullSphere(planes, x[i], y[i], z[i], radius[i]);
+        drawn += visible[i];
+    }
+    return drawn;
+}
+
+void BlendPoses(float const* a, float const* b, float const* t, float* out,
+                std::size_t count, std::size_t stride)
+{
+    // Four joints per iteration, one component stream at a time.
+    __m128 const one = _mm_set1_ps(1.f);
+    __m128 const signBit = _mm_set1_ps(-0.f);
+    std::size_t i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        __m128 const tt = _mm_loadu_ps(t + i);
+        __m128 const ts = _mm_loadu_ps(t + 2 * stride + i);
+        for(int c = 0; c < 3; ++c)
+        {
+            std::size_t k = c * stride + i;
+            __m128 const va = _mm_loadu_ps(a + k);
+            _mm_storeu_ps(out + k, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(b + k), va), tt)));
+            k += 7 * stride;
+            __m128 const vs = _mm_loadu_ps(a + k);
+            _mm_storeu_ps(out + k, _mm_add_ps(vs, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(b + k), vs), ts)));
+        }
+        
+        __m128 qa[4], qb[4];
+        __m128 dot = _mm_setzero_ps();
+        for(int c = 0; c < 4; ++c)
+        {
+            qa[c] = _mm_loadu_ps(a + (3 + c) * stride + i);
+            qb[c] = _mm_loadu_ps(b + (3 + c) * stride + i);
+            dot = _mm_add_ps(dot, _mm_mul_ps(qa[c], qb[c]));
+        }
+        __m128 const tr = _mm_loadu_ps(t + stride + i);
+        __m128 const wa = _mm_sub_ps(one, tr);
+        // Flip b's weight where the quaternions are in opposite hemispheres.
+        __m128 const wb = _mm_xor_ps(tr, _mm_and_ps(dot, signBit));
+        __m128 q[4];
+        __m128 len = _mm_setzero_ps();
+        for(int c = 0; c < 4; ++c)
+        {
+            q[c] = _mm_add_ps(_mm_mul_ps(qa[c], wa), _mm_mul_ps(qb[c], wb));
+            len = _mm_add_ps(len, _mm_mul_ps(q[c], q[c]));
+        }
+        __m128 const valid = _mm_cmpgt_ps(len, _mm_setzero_ps());
+        __m128 const inv = _mm_and_ps(valid, _mm_div_ps(one, _mm_sqrt_ps(len)));
+        for(int c = 0; c < 4; ++c)
+            _mm_storeu_ps(out + (3 + c) * stride + i, _mm_mul_ps(q[c], inv));
+    }
+    for(; i < count; ++i)
+        BlendPose(a, b, t, out, i, stride);
+}
+
+void ComposePoses(float const* pose, float* matrices, std::size_t count, std::size_t stride)
+{
+    // Rotation terms for four joints at once, then transposed into four
+    // column-major matrices.
+    __m128 const one = _mm_set1_ps(1.f);
+    __m128 const two = _mm_set1_ps(2.f);
+    std::size_t i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        __m128 const x = _mm_loadu_ps(pose + 3 * stride + i);
+        __m128 const y = _mm_loadu_ps(pose + 4 * stride + i);
+        __m128 const z = _mm_loadu_ps(pose + 5 * stride + i);
+        __m128 const w = _mm_loadu_ps(pose + 6 * stride + i);
+        __m128 const sx = _mm_loadu_ps(pose + 7 * stride + i);
+        __m128 const sy = _mm_loadu_ps(pose + 8 * stride + i);
+        __m128 const sz = _mm_loadu_ps(pose + 9 * stride + i);
+        __m128 const xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+        __m128 const xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+        __m128 const wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+        
+        __m128 cols[4][4];
+        cols[0][0] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+        cols[0][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+        cols[0][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+        cols[0][3] = _mm_setzero_ps();
+        cols[1][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+        cols[1][1] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+        cols[1][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+        cols[1][3] = _mm_setzero_ps();
+        cols[2][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+        cols[2][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+        cols[2][2] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+        cols[2][3] = _mm_setzero_ps();
+        cols[3][0] = _mm_loadu_ps(pose + i);
+        cols[3][1] = _mm_loadu_ps(pose + stride + i);
+        cols[3][2] = _mm_loadu_ps(pose + 2 * stride + i);
+        cols[3][3] = one;
+        for(int c = 0; c < 4; ++c)
+        {
+            _MM_TRANSPOSE4_PS(cols[c][0], cols[c][1], cols[c][2], cols[c][3]);
+            for(int j = 0; j < 4; ++j)
+                _mm_storeu_ps(matrices + (i + j) * 16 + c * 4, cols[c][j]);
+        }
+    }
+    for(; i < count; ++i)
+        ComposePose(pose, i, stride, matrices + i * 16);
+}
+#else
+namespace {
+    inline void Combine(float const* m, float const* v, float* out)
+    {
+        for(int r = 0; r < 4; ++r)
+            out[r] = m[r] * v[0] + m[4 + r] * v[1] + m[8 + r] * v[2] + m[12 + r] * v[3];
+    }
+}
+
+void MulMat4(float const* a, float const* b, float* out)
+{
+    float r[16];
+    for(int c = 0; c < 4; ++c)
+        Combine(a, b + c * 4, r + c * 4);
+    for(int i = 0; i < 16; ++i)
+        out[i] = r[i];
+}
+
+void MulVec4(float const* m, float const* v, float* out)
+{
+    float r[4];
+    Combine(m, v, r);
+    for(int i = 0; i < 4; ++i)
+        out[i] = r[i];
+}
+
+void MulMat4Batch(float const* a, float const* b, float* out, std::size_t count)
+{
+    for(std::size_t i = 0; i < count; ++i)
+        MulMat4(a, b + i * 16, out + i * 16);
+}
+
+void MulMat4Pairs(float const* a, float const* b, float* out, std::size_t count)
+{
+    for(std::size_t i = 0; i < count; ++i)
+        MulMat4(a + i * 16, b + i * 16, out + i * 16);
+}
+
+void TransformVec4Batch(float const* m, float const* in, float* out, std::size_t count)
+{
+    for(std::size_t i = 0; i < count; ++i)
+        MulVec4(m, in + i * 4, out + i * 4);
+}
+
+std::size_t CullSpheres(float const* planes, float const* x, float const* y, float const* z,
+                        float const* radius, std::size_t count, std::uint8_t* visible)
+{
+    std::size_t drawn = 0;
+    for(std::size_t i = 0; i < count; ++i)
+    {
+        visible[i] = CullSphere(planes, x[i], y[i], z[i], radius[i]);
+        drawn += visible[i];
+    }
+    return drawn;
+}
+
+void BlendPoses(float const* a, float const* b, float const* t, float* out,
+                std::size_t count, std::size_t stride)
+{
+    for(std::size_t i = 0; i < count; ++i)
+        BlendPose(a, b, t, out, i, stride);
+}
+
+void ComposePoses(float const* pose, float* matrices, std::size_t count, std::size_t stride)
+{
+    for(std::size_t i = 0; i < count; ++i)
+        ComposePose(pose, i, stride, matrices + i * 16);
+}
+#endif
+
+}
+}
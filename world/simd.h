@@ -0,0 +1,40 @@
+#ifndef LUAWORLD_SIMD_H
+#define LUAWORLD_SIMD_H
+#include <cstddef>
+#include <cstdint>
+
+namespace LuaApi {
+    // Column-major 4x4 float kernels over glm storage.
+    // SSE when the target has it, scalar otherwise; pointers need no
+    // particular alignment.
+    namespace simd {
+        void MulMat4(float const* a, float const* b, float* out);
+        void MulVec4(float const* m, float const* v, float* out);
+        
+        // out[i] = a * b[i]
+        void MulMat4Batch(float const* a, float const* b, float* out, std::size_t count);
+        // out[i] = a[i] * b[i]
+        void MulMat4Pairs(float const* a, float const* b, float* out, std::size_t count);
+        // Points are xyzw tuples; w is used as is.
+        void TransformVec4Batch(float const* m, float const* in, float* out, std::size_t count);
+        
+        // Spheres as separate x, y, z, radius arrays against six inward
+        // xyzw planes. visible[i] is 1 unless the sphere is fully behind a
+        // plane; returns the number visible.
+        std::size_t CullSpheres(float const* planes, float const* x, float const* y, float const* z,
+                                float const* radius, std::size_t count, std::uint8_t* visible);
+        
+        // Joint poses are POSE_STREAMS arrays of stride floats each:
+        // translation x y z, rotation x y z w, scale x y z.
+        enum { POSE_STREAMS = 10 };
+        // out = a blended towards b. t holds three weight streams, for
+        // translation, rotation (shortest-arc nlerp) and scale. out may be
+        // a or b.
+        void BlendPoses(float const* a, float const* b, float const* t, float* out,
+                        std::size_t count, std::size_t stride);
+        // Column-major T * R * S per joint; rotations must be unit length.
+        void ComposePoses(float const* pose, float* matrices, std::size_t count, std::size_t stride);
+    }
+}
+
+#endif
@@ -0,0 +1,480 @@
+#include "spatial.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace LuaApi {
+
+namespace {
+    int const g_cellLimit = (1 << (SpatialGridImpl::CELL_BITS - 1)) - 1;
+
+    bool Numbers(lua_State* s, int first, int count, float* out)
+    {
+        for(int i = 0; i < count; ++i)
+        {
+            if(lua_type(s, first + i) != LUA_TNUMBER)
+                return false;
+            out[i] = static_cast<float>(lua_tonumber(s, first + i));
+        }
+        return true;
+    }
+
+    bool Finite(glm::vec3 const& v)
+    {
+        return std::isfinite(v.x) && std::isfinite(v.y) && std::isfinite(v.z);
+    }
+
+    long long CellCount(glm::ivec3 const& lo, glm::ivec3 const& hi)
+    {
+        return static_cast<long long>(hi.x - lo.x + 1) * (hi.y - lo.y + 1) * (hi.z - lo.z + 1);
+    }
+}
+
+SpatialGridImpl::SpatialGridImpl() :
+    m_cellSize(8.f),
+    m_count(0),
+    m_stamp(0)
+{
+}
+
+void SpatialGridImpl::SetCellSize(float size)
+{
+    if(!(size > 0.f))
+        throw std::runtime_error("Cell size must be positive");
+    if(size == m_cellSize)
+        return;
+    m_cellSize = size;
+    m_cells.clear();
+    m_oversized.clear();
+    for(std::uint32_t slot = 0; slot < m_items.size(); ++slot)
+    {
+        if(m_items[slot].m_used)
+            link(slot);
+    }
+}
+
+float SpatialGridImpl::CellSize() const { return m_cellSize; }
+
+glm::ivec3 SpatialGridImpl::cellOf(glm::vec3 const& p) const
+{
+    glm::vec3 c = glm::floor(p / m_cellSize);
+    float const limit = static_cast<float>(g_cellLimit);
+    c = glm::clamp(c, glm::vec3(-limit), glm::vec3(limit));
+    return glm::ivec3(c);
+}
+
+std::uint64_t SpatialGridImpl::cellKey(int x, int y, int z)
+{
+    std::uint64_t const mask = (std::uint64_t(1) << SpatialGridImpl::CELL_BITS) - 1;
+    return  (static_cast<std::uint64_t>(x + g_cellLimit) & mask) |
+           ((static_cast<std::uint64_t>(y + g_cellLimit) & mask) << SpatialGridImpl::CELL_BITS) |
+           ((static_cast<std::uint64_t>(z + g_cellLimit) & mask) << (2 * SpatialGridImpl::CELL_BITS));
+}
+
+void SpatialGridImpl::link(std::uint32_t slot)
+{
+    Item& item = m_items[slot];
+    item.m_lo = cellOf(item.m_bounds.m_min);
+    item.m_hi = cellOf(item.m_bounds.m_max);
+    item.m_oversized = CellCount(item.m_lo, item.m_hi) > SpatialGridImpl::MAX_ITEM_CELLS;
+    if(item.m_oversized)
+    {
+        m_oversized.push_back(slot);
+        return;
+    }
+    for(int z = item.m_lo.z; z <= item.m_hi.z; ++z)
+        for(int y = item.m_lo.y; y <= item.m_hi.y; ++y)
+            for(int x = item.m_lo.x; x <= item.m_hi.x; ++x)
+                m_cells[cellKey(x, y, z)].push_back(slot);
+}
+
+void SpatialGridImpl::unlink(std::uint32_t slot)
+{
+    Item const& item = m_items[slot];
+    if(item.m_oversized)
+    {
+        m_oversized.erase(std::find(m_oversized.begin(), m_oversized.end(), slot));
+        return;
+    }
+    for(int z = item.m_lo.z; z <= item.m_hi.z; ++z)
+    {
+        for(int y = item.m_lo.y; y <= item.m_hi.y; ++y)
+        {
+            for(int x = item.m_lo.x; x <= item.m_hi.x; ++x)
+            {
+                auto cell = m_cells.find(cellKey(x, y, z));
+                std::vector<std::uint32_t>& slots = cell->second;
+                *std::find(slots.begin(), slots.end(), slot) = slots.back();
+                slots.pop_back();
+                if(slots.empty())
+                    m_cells.erase(cell);
+            }
+        }
+    }
+}
+
+void SpatialGridImpl::set(Key key, Aabb const& bounds)
+{
+    if(!(glm::all(glm::lessThanEqual(bounds.m_min, bounds.m_max))))
+        throw std::runtime_error("Invalid bounds");
+
+    auto it = m_slots.find(key);
+    if(it != m_slots.end())
+    {
+        Item& item = m_items[it->second];
+        if(glm::all(glm::equal(cellOf(bounds.m_min), item.m_lo)) &&
+           glm::all(glm::equal(cellOf(bounds.m_max), item.m_hi)))
+        {
+            item.m_bounds = bounds;
+            return;
+        }
+        unlink(it->second);
+        item.m_bounds = bounds;
+        link(it->second);
+        return;
+    }
+
+    std::uint32_t slot;
+    if(!m_free.empty())
+    {
+        slot = m_free.back();
+        m_free.pop_back();
+    }
+    else
+    {
+        slot = static_cast<std::uint32_t>(m_items.size());
+        m_items.push_back(Item());
+    }
+    Item& item = m_items[slot];
+    item.m_key = key;
+    item.m_bounds = bounds;
+    item.m_used = true;
+    item.m_stamp = 0;
+    link(slot);
+    m_slots[key] = slot;
+    ++m_count;
+}
+
+void SpatialGridImpl::SetSphere(Key key, float x, float y, float z, float radius)
+{
+    set(key, Aabb::FromSphere(glm::vec3(x, y, z), std::max(radius, 0.f)));
+}
+
+void SpatialGridImpl::SetBox(Key key, float minX, float minY, float minZ, float maxX, float maxY, float maxZ)
+{
+    set(key, Aabb{glm::vec3(minX, minY, minZ), glm::vec3(maxX, maxY, maxZ)});
+}
+
+bool SpatialGridImpl::Remove(Key key)
+{
+    auto it = m_slots.find(key);
+    if(it == m_slots.end())
+        return false;
+    unlink(it->second);
+    m_items[it->second].m_used = false;
+    m_free.push_back(it->second);
+    m_slots.erase(it);
+    --m_count;
+    return true;
+}
+
+bool SpatialGridImpl::Has(Key key) const { return m_slots.count(key) != 0; }
+std::size_t SpatialGridImpl::Count() const { return m_count; }
+
+void SpatialGridImpl::Clear()
+{
+    m_items.clear();
+    m_free.clear();
+    m_slots.clear();
+    m_cells.clear();
+    m_oversized.clear();
+    m_count = 0;
+}
+
+std::uint32_t SpatialGridImpl::nextStamp()
+{
+    if(++m_stamp == 0)
+    {
+        for(auto it = m_items.begin(); it != m_items.end(); ++it)
+            it->m_stamp = 0;
+        m_stamp = 1;
+    }
+    return m_stamp;
+}
+
+// True the first time a slot is seen in the current query.
+bool SpatialGridImpl::visit(std::uint32_t slot)
+{
+    if(m_items[slot].m_stamp == m_stamp)
+        return false;
+    m_items[slot].m_stamp = m_stamp;
+    return true;
+}
+
+// Runs test on every item listed in the cell range, once each, and
+// collects the slots that pass into m_hits. Large ranges walk the occupied
+// cells instead of the range.
+template <typename Test>
+void SpatialGridImpl::gather(glm::ivec3 const& lo, glm::ivec3 const& hi, Test const& test)
+{
+    nextStamp();
+    m_hits.clear();
+    for(auto it = m_oversized.begin(); it != m_oversized.end(); ++it)
+    {
+        if(visit(*it) && test(m_items[*it]))
+            m_hits.push_back(*it);
+    }
+    auto scan = [this, &test](std::vector<std::uint32_t> const& slots) {
+        for(auto it = slots.begin(); it != slots.end(); ++it)
+        {
+            if(visit(*it) && test(m_items[*it]))
+                m_hits.push_back(*it);
+        }
+    };
+    if(CellCount(lo, hi) > static_cast<long long>(m_cells.size()))
+    {
+        std::uint64_t const mask = (std::uint64_t(1) << SpatialGridImpl::CELL_BITS) - 1;
+        for(auto cell = m_cells.begin(); cell != m_cells.end(); ++cell)
+        {
+            int x = static_cast<int>(cell->first & mask) - g_cellLimit;
+            int y = static_cast<int>((cell->first >> SpatialGridImpl::CELL_BITS) & mask) - g_cellLimit;
+            int z = static_cast<int>((cell->first >> (2 * SpatialGridImpl::CELL_BITS)) & mask) - g_cellLimit;
+            if(x >= lo.x && x <= hi.x && y >= lo.y && y <= hi.y && z >= lo.z && z <= hi.z)
+                scan(cell->second);
+        }
+        return;
+    }
+    for(int z = lo.z; z <= hi.z; ++z)
+    {
+        for(int y = lo.y; y <= hi.y; ++y)
+        {
+            for(int x = lo.x; x <= hi.x; ++x)
+            {
+                auto cell = m_cells.find(cellKey(x, y, z));
+                if(cell != m_cells.end())
+                    scan(cell->second);
+            }
+        }
+    }
+}
+
+// Both leave the hits in m_hits. Shapes that can't hit anything, or
+// whose cells can't be computed (cellOf casts to int, NaN included), are
+// rejected before cellOf.
+void SpatialGridImpl::gatherBox(Aabb const& box)
+{
+    if(!glm::all(glm::lessThanEqual(box.m_min, box.m_max)))
+    {
+        m_hits.clear();
+        return;
+    }
+    gather(cellOf(box.m_min), cellOf(box.m_max), [&box](Item const& item) {
+        return item.m_bounds.Overlaps(box);
+    });
+}
+
+void SpatialGridImpl::gatherSphere(glm::vec3 const& center, float radius)
+{
+    // Squaring would turn a negative radius into a positive one.
+    if(!Finite(center) || !(radius >= 0.f))
+    {
+        m_hits.clear();
+        return;
+    }
+    Aabb box = Aabb::FromSphere(center, radius);
+    float const r2 = radius * radius;
+    gather(cellOf(box.m_min), cellOf(box.m_max), [&center, r2](Item const& item) {
+        return item.m_bounds.DistanceSquared(center) <= r2;
+    });
+}
+
+void SpatialGridImpl::queryBox(Aabb const& box, std::vector<Key>& out)
+{
+    gatherBox(box);
+    for(auto it = m_hits.begin(); it != m_hits.end(); ++it)
+        out.push_back(m_items[*it].m_key);
+}
+
+void SpatialGridImpl::querySphere(glm::vec3 const& center, float radius, std::vector<Key>& out)
+{
+    gatherSphere(center, radius);
+    for(auto it = m_hits.begin(); it != m_hits.end(); ++it)
+        out.push_back(m_items[*it].m_key);
+}
+
+void SpatialGridImpl::queryFrustum(Frustum const& frustum, std::vector<Key>& out)
+{
+    // A frustum's box is usually most of the world, so walk the occupied
+    // cells and reject whole cells first.
+    nextStamp();
+    for(auto it = m_oversized.begin(); it != m_oversized.end(); ++it)
+    {
+        if(visit(*it) && frustum.Intersects(m_items[*it].m_bounds))
+            out.push_back(m_items[*it].m_key);
+    }
+    std::uint64_t const mask = (std::uint64_t(1) << SpatialGridImpl::CELL_BITS) - 1;
+    for(auto cell = m_cells.begin(); cell != m_cells.end(); ++cell)
+    {
+        glm::vec3 c(static_cast<float>(static_cast<int>(cell->first & mask) - g_cellLimit),
+                    static_cast<float>(static_cast<int>((cell->first >> SpatialGridImpl::CELL_BITS) & mask) - g_cellLimit),
+                    static_cast<float>(static_cast<int>((cell->first >> (2 * SpatialGridImpl::CELL_BITS)) & mask) - g_cellLimit));
+        Aabb cellBox{c * m_cellSize, (c + 1.f) * m_cellSize};
+        // Items are listed in every cell their box touches, so an item
+        // that reaches into the frustum is listed in a cell that does too.
+        if(!frustum.Intersects(cellBox))
+            continue;
+        for(auto it = cell->second.begin(); it != cell->second.end(); ++it)
+        {
+            if(visit(*it) && frustum.Intersects(m_items[*it].m_bounds))
+                out.push_back(m_items[*it].m_key);
+        }
+    }
+}
+
+// Leaves the hits in m_rayHits as (distance, slot), nearest first.
+void SpatialGridImpl::trace(glm::vec3 const& origin, glm::vec3 const& dir, float maxDistance)
+{
+    m_rayHits.clear();
+    // Both ends go through cellOf.
+    if(!Finite(origin) || !Finite(origin + dir * maxDistance))
+        return;
+    glm::vec3 const invDir = 1.f / dir;
+    nextStamp();
+    auto test = [this, &origin, &invDir, maxDistance](std::uint32_t slot) {
+        float t;
+        if(visit(slot) && m_items[slot].m_bounds.Ray(origin, invDir, maxDistance, t))
+            m_rayHits.push_back(std::make_pair(t, slot));
+    };
+    for(auto it = m_oversized.begin(); it != m_oversized.end(); ++it)
+        test(*it);
+
+    glm::vec3 const end = origin + dir * maxDistance;
+    glm::ivec3 cell = cellOf(origin);
+    glm::ivec3 const last = cellOf(end);
+    glm::ivec3 const span = glm::abs(last - cell);
+    long long const steps = static_cast<long long>(span.x) + span.y + span.z;
+
+    if(steps + 1 > static_cast<long long>(m_cells.size()))
+    {
+        // Longer than the number of occupied cells: cheaper to test those.
+        for(auto c = m_cells.begin(); c != m_cells.end(); ++c)
+            for(auto it = c->second.begin(); it != c->second.end(); ++it)
+                test(*it);
+    }
+    else
+    {
+        // Amanatides-Woo traversal of the cells along the segment.
+        glm::ivec3 step;
+        glm::vec3 tMax;
+        glm::vec3 tDelta;
+        for(int i = 0; i < 3; ++i)
+        {
+            if(dir[i] > 0.f)
+            {
+                step[i] = 1;
+                tMax[i] = ((cell[i] + 1) * m_cellSize - origin[i]) * invDir[i];
+                tDelta[i] = m_cellSize * invDir[i];
+            }
+            else if(dir[i] < 0.f)
+            {
+                step[i] = -1;
+                tMax[i] = (cell[i] * m_cellSize - origin[i]) * invDir[i];
+                tDelta[i] = -m_cellSize * invDir[i];
+            }
+            else
+            {
+                step[i] = 0;
+                tMax[i] = std::numeric_limits<float>::infinity();
+                tDelta[i] = std::numeric_limits<float>::infinity();
+            }
+        }
+        for(long long n = 0; n <= steps; ++n)
+        {
+            auto c = m_cells.find(cellKey(cell.x, cell.y, cell.z));
+            if(c != m_cells.end())
+                for(auto it = c->second.begin(); it != c->second.end(); ++it)
+                    test(*it);
+            int axis = (tMax.x < tMax.y) ? (tMax.x < tMax.z ? 0 : 2) : (tMax.y < tMax.z ? 1 : 2);
+            cell[axis] += step[axis];
+            tMax[axis] += tDelta[axis];
+        }
+    }
+
+    std::sort(m_rayHits.begin(), m_rayHits.end());
+}
+
+void SpatialGridImpl::raycast(glm::vec3 const& origin, glm::vec3 const& dir, float maxDistance,
+                              std::vector<std::pair<float, Key>>& out)
+{
+    trace(origin, dir, maxDistance);
+    for(auto it = m_rayHits.begin(); it != m_rayHits.end(); ++it)
+        out.push_back(std::make_pair(it->first, m_items[it->second].m_key));
+}
+
+int SpatialGridImpl::pushHits(lua_State* s, int outIndex)
+{
+    m_keys.clear();
+    for(auto it = m_hits.begin(); it != m_hits.end(); ++it)
+        m_keys.push_back(m_items[*it].m_key);
+    return PushSequence(s, outIndex, m_keys.data(), m_keys.size());
+}
+
+int SpatialGridImpl::QueryRadius(lua_State* s)
+{
+    float v[4];
+    if(!Numbers(s, 2, 4, v))
+    {
+        lua_pushstring(s, "QueryRadius expects x, y, z, radius");
+        return -1;
+    }
+    gatherSphere(glm::vec3(v[0], v[1], v[2]), v[3]);
+    return pushHits(s, 6);
+}
+
+int SpatialGridImpl::QueryBox(lua_State* s)
+{
+    float v[6];
+    if(!Numbers(s, 2, 6, v))
+    {
+        lua_pushstring(s, "QueryBox expects minX, minY, minZ, maxX, maxY, maxZ");
+        return -1;
+    }
+    gatherBox(Aabb{glm::vec3(v[0], v[1], v[2]), glm::vec3(v[3], v[4], v[5])});
+    return pushHits(s, 8);
+}
+
+int SpatialGridImpl::Raycast(lua_State* s)
+{
+    float v[7];
+    if(!Numbers(s, 2, 7, v))
+    {
+        lua_pushstring(s, "Raycast expects ox, oy, oz, dx, dy, dz, maxDistance");
+        return -1;
+    }
+    glm::vec3 dir(v[3], v[4], v[5]);
+    float const len = glm::length(dir);
+    if(!(len > 0.f) || !(v[6] >= 0.f) || std::isinf(v[6]))
+    {
+        lua_pushstring(s, "Raycast needs a non-zero direction and a finite distance");
+        return -1;
+    }
+    trace(glm::vec3(v[0], v[1], v[2]), dir / len, v[6]);
+    m_hits.clear();
+    for(auto it = m_rayHits.begin(); it != m_rayHits.end(); ++it)
+        m_hits.push_back(it->second);
+    int n = pushHits(s, 9);
+    if(m_rayHits.empty())
+        lua_pushnil(s);
+    else
+        lua_pushnumber(s, m_rayHits.front().first);
+    return n + 1;
+}
+
+Lua::Array<SpatialGridImpl::Key> SpatialGridImpl::QueryFrustum(Mat4 m)
+{
+    Lua::Array<Key> result;
+    queryFrustum(Frustum::FromMatrix(m.value()), result.m_data);
+    return result;
+}
+
+}
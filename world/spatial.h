@@ -0,0 +1,128 @@
+#ifndef LUAWORLD_SPATIAL_H
+#define LUAWORLD_SPATIAL_H
+#include <unordered_map>
+#include <vector>
+#include "shared.h"
+#include "bounds.h"
+#include "matrix.h"
+
+namespace LuaApi {
+    // Hashed uniform grid of boxes and spheres, keyed by a caller-chosen id
+    // (entity ids, for the Entities store).
+    // Only occupied cells exist, so the world has no fixed extent. An item
+    // is listed in every cell its box touches; items spanning more than
+    // MAX_ITEM_CELLS cells go to a separate list that every query checks.
+    // Moving an item within the same cells only rewrites its bounds.
+    //
+    // QueryRadius/QueryBox/Raycast return (ids, count). Passing a table as
+    // the last argument reuses it; entries past count are cleared. Raycast
+    // sorts by distance and also returns the nearest hit distance.
+    class SpatialGridImpl {
+    public:
+        typedef std::uint32_t Key;
+        enum {
+            MAX_ITEM_CELLS = 64,
+            CELL_BITS = 21
+        };
+    private:
+        struct Item {
+            Key m_key;
+            Aabb m_bounds;
+            glm::ivec3 m_lo;
+            glm::ivec3 m_hi;
+            bool m_used;
+            bool m_oversized;
+            std::uint32_t m_stamp;
+        };
+
+        float m_cellSize;
+        std::vector<Item> m_items;
+        std::vector<std::uint32_t> m_free;
+        std::unordered_map<Key, std::uint32_t> m_slots;
+        std::unordered_map<std::uint64_t, std::vector<std::uint32_t>> m_cells;
+        std::vector<std::uint32_t> m_oversized;
+        std::size_t m_count;
+
+        // Scratch for queries.
+        std::uint32_t m_stamp;
+        std::vector<std::uint32_t> m_hits;
+        std::vector<Key> m_keys;
+        std::vector<std::pair<float, std::uint32_t>> m_rayHits;
+
+        glm::ivec3 cellOf(glm::vec3 const&) const;
+        static std::uint64_t cellKey(int x, int y, int z);
+        void link(std::uint32_t slot);
+        void unlink(std::uint32_t slot);
+        void set(Key, Aabb const&);
+        std::uint32_t nextStamp();
+        bool visit(std::uint32_t slot);
+        template <typename Test>
+        void gather(glm::ivec3 const& lo, glm::ivec3 const& hi, Test const&);
+        void gatherBox(Aabb const&);
+        void gatherSphere(glm::vec3 const& center, float radius);
+        void trace(glm::vec3 const& origin, glm::vec3 const& dir, float maxDistance);
+        int pushHits(lua_State*, int outIndex);
+    public:
+        SpatialGridImpl();
+
+        void SetCellSize(float);
+        float CellSize() const;
+
+        void SetSphere(Key, float x, float y, float z, float radius);
+        void SetBox(Key, float minX, float minY, float minZ, float maxX, float maxY, float maxZ);
+        bool Remove(Key);
+        bool Has(Key) const;
+        std::size_t Count() const;
+        void Clear();
+
+        // For C++ callers; keys are appended to out.
+        void queryBox(Aabb const&, std::vector<Key>& out);
+        void querySphere(glm::vec3 const&, float radius, std::vector<Key>& out);
+        void queryFrustum(Frustum const&, std::vector<Key>& out);
+        // Hits sorted by distance along dir, which must be normalised.
+        void raycast(glm::vec3 const& origin, glm::vec3 const& dir, float maxDistance,
+                     std::vector<std::pair<float, Key>>& out);
+
+        // QueryRadius(x, y, z, r [, out])
+        int QueryRadius(lua_State*);
+        // QueryBox(minX, minY, minZ, maxX, maxY, maxZ [, out])
+        int QueryBox(lua_State*);
+        // Raycast(ox, oy, oz, dx, dy, dz, maxDistance [, out])
+        int Raycast(lua_State*);
+        // Once per frame, so a fresh table is fine.
+        Lua::Array<Key> QueryFrustum(Mat4);
+    };
+
+    typedef RefCounted<SpatialGridImpl> SpatialGrid;
+}
+
+template <> struct MetatableDescriptor<LuaApi::SpatialGridImpl> {
+    static char const* name() { return "spatialgrid_mt"; }
+    static char const* luaname() { return "SpatialGrid"; }
+    static char const* constructor() { return "New"; }
+    static bool construct(LuaApi::SpatialGridImpl* v) { return Lua::DefaultConstructor(v); }
+    static void metatable(Lua::member_function_storage<LuaApi::SpatialGridImpl>& mt) {
+#define REG_FNC(name) mt[ #name ] = Lua::Transform(&LuaApi::SpatialGridImpl::name)
+        REG_FNC(SetCellSize);
+        REG_FNC(CellSize);
+        REG_FNC(SetSphere);
+        REG_FNC(SetBox);
+        REG_FNC(Remove);
+        REG_FNC(Has);
+        REG_FNC(Count);
+        REG_FNC(Clear);
+        REG_FNC(QueryFrustum);
+#undef REG_FNC
+    }
+    static void direct(LuaApi::DirectMethods<LuaApi::SpatialGridImpl>& dm) {
+        dm.Add("SetSphere", &LuaApi::SpatialGridImpl::SetSphere);
+        dm.Add("SetBox", &LuaApi::SpatialGridImpl::SetBox);
+        dm.Add("Remove", &LuaApi::SpatialGridImpl::Remove);
+        dm.Add("Has", &LuaApi::SpatialGridImpl::Has);
+        dm.AddRaw("QueryRadius", &LuaApi::SpatialGridImpl::QueryRadius);
+        dm.AddRaw("QueryBox", &LuaApi::SpatialGridImpl::QueryBox);
+        dm.AddRaw("Raycast", &LuaApi::SpatialGridImpl::Raycast);
+    }
+};
+
+#endif
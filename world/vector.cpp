@@ -0,0 +1,75 @@
+#include "vector.h"
+
+namespace LuaApi {
+
+// Vec3
+Vec3::Vec3() : m_v(0.f) {}
+Vec3::Vec3(float x, float y, float z) : m_v(x, y, z) {}
+Vec3::Vec3(glm::vec3 const& v) : m_v(v) {}
+
+glm::vec3 const& Vec3::value() const { return m_v; }
+
+void Vec3::Set(float x, float y, float z) { m_v = glm::vec3(x, y, z); }
+void Vec3::SetX(float x) { m_v.x = x; }
+void Vec3::SetY(float y) { m_v.y = y; }
+void Vec3::SetZ(float z) { m_v.z = z; }
+float Vec3::X() const { return m_v.x; }
+float Vec3::Y() const { return m_v.y; }
+float Vec3::Z() const { return m_v.z; }
+FixedReturn<float, 3> Vec3::Unpack() const { return ReturnFixed(m_v.x, m_v.y, m_v.z); }
+
+Vec3 Vec3::Copy() const { return *this; }
+Vec3 Vec3::Add(Vec3 o) const { return Vec3(m_v + o.m_v); }
+Vec3 Vec3::Sub(Vec3 o) const { return Vec3(m_v - o.m_v); }
+Vec3 Vec3::Mul(Vec3 o) const { return Vec3(m_v * o.m_v); }
+Vec3 Vec3::Scale(float s) const { return Vec3(m_v * s); }
+Vec3 Vec3::Negate() const { return Vec3(-m_v); }
+float Vec3::Dot(Vec3 o) const { return glm::dot(m_v, o.m_v); }
+Vec3 Vec3::Cross(Vec3 o) const { return Vec3(glm::cross(m_v, o.m_v)); }
+float Vec3::Length() const { return glm::length(m_v); }
+float Vec3::LengthSquared() const { return glm::dot(m_v, m_v); }
+float Vec3::Distance(Vec3 o) const { return glm::distance(m_v, o.m_v); }
+Vec3 Vec3::Normalized() const
+{
+    float len = glm::length(m_v);
+    return (len > 0.f) ? Vec3(m_v / len) : Vec3();
+}
+Vec3 Vec3::Lerp(Vec3 o, float t) const { return Vec3(glm::mix(m_v, o.m_v, t)); }
+Vec3 Vec3::Min(Vec3 o) const { return Vec3(glm::min(m_v, o.m_v)); }
+Vec3 Vec3::Max(Vec3 o) const { return Vec3(glm::max(m_v, o.m_v)); }
+
+// Vec4
+Vec4::Vec4() : m_v(0.f) {}
+Vec4::Vec4(float x, float y, float z, float w) : m_v(x, y, z, w) {}
+Vec4::Vec4(glm::vec4 const& v) : m_v(v) {}
+
+glm::vec4 const& Vec4::value() const { return m_v; }
+
+void Vec4::Set(float x, float y, float z, float w) { m_v = glm::vec4(x, y, z, w); }
+void Vec4::SetX(float x) { m_v.x = x; }
+void Vec4::SetY(float y) { m_v.y = y; }
+void Vec4::SetZ(float z) { m_v.z = z; }
+void Vec4::SetW(float w) { m_v.w = w; }
+float Vec4::X() const { return m_v.x; }
+float Vec4::Y() const { return m_v.y; }
+float Vec4::Z() const { return m_v.z; }
+float Vec4::W() const { return m_v.w; }
+FixedReturn<float, 4> Vec4::Unpack() const { return ReturnFixed(m_v.x, m_v.y, m_v.z, m_v.w); }
+Vec3 Vec4::XYZ() const { return Vec3(glm::vec3(m_v)); }
+
+Vec4 Vec4::Copy() const { return *this; }
+Vec4 Vec4::Add(Vec4 o) const { return Vec4(m_v + o.m_v); }
+Vec4 Vec4::Sub(Vec4 o) const { return Vec4(m_v - o.m_v); }
+Vec4 Vec4::Mul(Vec4 o) const { return Vec4(m_v * o.m_v); }
+Vec4 Vec4::Scale(float s) const { return Vec4(m_v * s); }
+Vec4 Vec4::Negate() const { return Vec4(-m_v); }
+float Vec4::Dot(Vec4 o) const { return glm::dot(m_v, o.m_v); }
+float Vec4::Length() const { return glm::length(m_v); }
+Vec4 Vec4::Normalized() const
+{
+    float len = glm::length(m_v);
+    return (len > 0.f) ? Vec4(m_v / len) : Vec4();
+}
+Vec4 Vec4::Lerp(Vec4 o, float t) const { return Vec4(glm::mix(m_v, o.m_v, t)); }
+
+}
@@ -0,0 +1,143 @@
+#ifndef LUAWORLD_VECTOR_H
+#define LUAWORLD_VECTOR_H
+#include "shared.h"
+
+namespace LuaApi {
+    // Value types: every Lua userdata holds its own copy, and methods that
+    // produce a vector return a new one.
+    class Vec3 {
+        glm::vec3 m_v;
+    public:
+        Vec3();
+        Vec3(float, float, float);
+        explicit Vec3(glm::vec3 const&);
+        
+        glm::vec3 const& value() const;
+        
+        void Set(float, float, float);
+        void SetX(float);
+        void SetY(float);
+        void SetZ(float);
+        float X() const;
+        float Y() const;
+        float Z() const;
+        FixedReturn<float, 3> Unpack() const;
+        
+        Vec3 Copy() const;
+        Vec3 Add(Vec3) const;
+        Vec3 Sub(Vec3) const;
+        Vec3 Mul(Vec3) const;
+        Vec3 Scale(float) const;
+        Vec3 Negate() const;
+        float Dot(Vec3) const;
+        Vec3 Cross(Vec3) const;
+        float Length() const;
+        float LengthSquared() const;
+        float Distance(Vec3) const;
+        Vec3 Normalized() const;
+        Vec3 Lerp(Vec3, float) const;
+        Vec3 Min(Vec3) const;
+        Vec3 Max(Vec3) const;
+    };
+    
+    class Vec4 {
+        glm::vec4 m_v;
+    public:
+        Vec4();
+        Vec4(float, float, float, float);
+        explicit Vec4(glm::vec4 const&);
+        
+        glm::vec4 const& value() const;
+        
+        void Set(float, float, float, float);
+        void SetX(float);
+        void SetY(float);
+        void SetZ(float);
+        void SetW(float);
+        float X() const;
+        float Y() const;
+        float Z() const;
+        float W() const;
+        FixedReturn<float, 4> Unpack() const;
+        Vec3 XYZ() const;
+        
+        Vec4 Copy() const;
+        Vec4 Add(Vec4) const;
+        Vec4 Sub(Vec4) const;
+        Vec4 Mul(Vec4) const;
+        Vec4 Scale(float) const;
+        Vec4 Negate() const;
+        float Dot(Vec4) const;
+        float Length() const;
+        Vec4 Normalized() const;
+        Vec4 Lerp(Vec4, float) const;
+    };
+}
+
+template <> struct MetatableDescriptor<LuaApi::Vec3> {
+    static char const* name() { return "vec3_mt"; }
+    static char const* luaname() { return "Vec3"; }
+    static char const* constructor() { return "New"; }
+    static bool construct(LuaApi::Vec3* v) { return Lua::DefaultConstructor(v); }
+    static void metatable(Lua::member_function_storage<LuaApi::Vec3>& mt) {
+#define REG_FNC(name) mt[ #name ] = Lua::Transform(&LuaApi::Vec3::name)
+        REG_FNC(Set);
+        REG_FNC(SetX);
+        REG_FNC(SetY);
+        REG_FNC(SetZ);
+        REG_FNC(X);
+        REG_FNC(Y);
+        REG_FNC(Z);
+        mt["Unpack"] = LuaApi::PushFixed(&LuaApi::Vec3::Unpack);
+        REG_FNC(Copy);
+        REG_FNC(Add);
+        REG_FNC(Sub);
+        REG_FNC(Mul);
+        REG_FNC(Scale);
+        REG_FNC(Negate);
+        REG_FNC(Dot);
+        REG_FNC(Cross);
+        REG_FNC(Length);
+        REG_FNC(LengthSquared);
+        REG_FNC(Distance);
+        REG_FNC(Normalized);
+        REG_FNC(Lerp);
+        REG_FNC(Min);
+        REG_FNC(Max);
+#undef REG_FNC
+    }
+};
+
+template <> struct MetatableDescriptor<LuaApi::Vec4> {
+    static char const* name() { return "vec4_mt"; }
+    static char const* luaname() { return "Vec4"; }
+    static char const* constructor() { return "New"; }
+    static bool construct(LuaApi::Vec4* v) { return Lua::DefaultConstructor(v); }
+    static void metatable(Lua::member_function_storage<LuaApi::Vec4>& mt) {
+#define REG_FNC(name) mt[ #name ] = Lua::Transform(&LuaApi::Vec4::name)
+        REG_FNC(Set);
+        REG_FNC(SetX);
+        REG_FNC(SetY);
+        REG_FNC(SetZ);
+        REG_FNC(SetW);
+        REG_FNC(X);
+        REG_FNC(Y);
+        REG_FNC(Z);
+        REG_FNC(W);
+        mt["Unpack"] = LuaApi::PushFixed(&LuaApi::Vec4::Unpack);
+        REG_FNC(XYZ);
+        REG_FNC(Copy);
+        REG_FNC(Add);
+        REG_FNC(Sub);
+        REG_FNC(Mul);
+        REG_FNC(Scale);
+        REG_FNC(Negate);
+        REG_FNC(Dot);
+        REG_FNC(Length);
+        REG_FNC(Normalized);
+        REG_FNC(Lerp);
+#undef REG_FNC
+    }
+};
+
+#endif